@@ -0,0 +1,655 @@
+#include "iodserver.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <grp.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <system_error>
+
+static std::system_error systemError(const char *what)
+{
+    return std::system_error(errno, std::generic_category(), what);
+}
+
+// Same clock as the sampler, so published DIO data can be ordered.
+static uint64_t timestampNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               sampler_clock_t::now().time_since_epoch()
+    )
+        .count();
+}
+
+static bool isDioCommand(uint32_t command)
+{
+    return command >= (uint32_t)IodCommand::SetOutputMode &&
+           command <= (uint32_t)IodCommand::WriteGroup;
+}
+
+static bool isPoeCommand(uint32_t command)
+{
+    return command >= (uint32_t)IodCommand::SetPortState &&
+           command <= (uint32_t)IodCommand::GetBudgetTotal;
+}
+
+IodServer::IodServer(
+    RsDioImpl *dio,
+    RsPoeImpl *poe,
+    const IodServerConfig &config
+)
+    : mp_dio(dio),
+      mp_poe(poe),
+      m_config(config),
+      mp_state(nullptr),
+      m_socket(-1),
+      m_wake{-1, -1},
+      m_stopping(false),
+      m_dioData(),
+      m_sweepTimestamp(0),
+      m_readings(),
+      m_poeStopping(false),
+      m_sweepPending(false)
+{
+    try {
+        if (pipe2(m_wake, O_CLOEXEC | O_NONBLOCK) != 0)
+            throw systemError("Failed to create the wake pipe");
+
+        // A segment left behind by a daemon that crashed would still be
+        // mapped by its old clients, so it's replaced rather than reused.
+        shm_unlink(m_config.shmName.c_str());
+        int shm = shm_open(
+            m_config.shmName.c_str(),
+            O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC,
+            0644
+        );
+        if (shm < 0) throw systemError("Failed to create the shared memory");
+
+        if (ftruncate(shm, sizeof(IodSharedState)) != 0) {
+            close(shm);
+            throw systemError("Failed to size the shared memory");
+        }
+
+        void *state = mmap(
+            nullptr,
+            sizeof(IodSharedState),
+            PROT_READ | PROT_WRITE,
+            MAP_SHARED,
+            shm,
+            0
+        );
+        close(shm);
+        if (state == MAP_FAILED)
+            throw systemError("Failed to map the shared memory");
+
+        // The segment starts out zeroed, which is a valid initial state for
+        // everything in it.
+        mp_state = (IodSharedState *)state;
+        mp_state->magic = kIodMagic;
+        mp_state->version = kIodVersion;
+
+        IodLayout &layout = mp_state->layout;
+        if (mp_dio) {
+            layout.hasDio = true;
+            if (!m_config.dioFile.empty()) {
+                iodCopyString(
+                    layout.dioFile,
+                    sizeof(layout.dioFile),
+                    iodCanonicalPath(m_config.dioFile.c_str())
+                );
+            }
+
+            rs::diomap_t dios = mp_dio->getPinList();
+            for (const auto &dio : dios) {
+                if (dio.first < 0 || dio.first >= kIodMaxDios) continue;
+
+                for (const auto &pin : dio.second) {
+                    if (pin.first < 0 || pin.first > 63) continue;
+
+                    uint64_t bit = 1ULL << pin.first;
+                    if (pin.second.supportsInput)
+                        layout.inputs[dio.first] |= bit;
+                    if (pin.second.supportsOutput)
+                        layout.outputs[dio.first] |= bit;
+                }
+
+                if (mp_dio->canSetOutputMode(dio.first))
+                    layout.outputModes |= 1u << dio.first;
+            }
+        }
+
+        if (mp_poe) {
+            layout.hasPoe = true;
+            if (!m_config.poeFile.empty()) {
+                iodCopyString(
+                    layout.poeFile,
+                    sizeof(layout.poeFile),
+                    iodCanonicalPath(m_config.poeFile.c_str())
+                );
+            }
+
+            std::vector<int> ports = mp_poe->getPortList();
+            for (int port : ports) {
+                if (layout.portCount == kIodMaxPorts) break;
+                layout.ports[layout.portCount++] = port;
+            }
+
+            publishPoe();
+        }
+
+        sockaddr_un address = {};
+        if (m_config.socketPath.empty() ||
+            m_config.socketPath.size() >= sizeof(address.sun_path)) {
+            throw std::system_error(
+                std::make_error_code(std::errc::invalid_argument),
+                "Invalid socket path"
+            );
+        }
+
+        address.sun_family = AF_UNIX;
+        memcpy(
+            address.sun_path,
+            m_config.socketPath.data(),
+            m_config.socketPath.size()
+        );
+
+        m_socket = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (m_socket < 0) throw systemError("Failed to create the socket");
+
+        unlink(m_config.socketPath.c_str());
+        if (bind(m_socket, (const sockaddr *)&address, sizeof(address)) != 0)
+            throw systemError("Failed to bind the socket");
+
+        // bind applies the umask, so the mode is set afterwards. Clients
+        // can't connect until listen is called.
+        if (chmod(m_config.socketPath.c_str(), m_config.socketMode) != 0)
+            throw systemError("Failed to set the mode of the socket");
+
+        if (!m_config.socketGroup.empty()) {
+            group *socketGroup = getgrnam(m_config.socketGroup.c_str());
+            if (!socketGroup) {
+                throw std::system_error(
+                    std::make_error_code(std::errc::invalid_argument),
+                    "Unknown socket group"
+                );
+            }
+
+            gid_t gid = socketGroup->gr_gid;
+            if (chown(m_config.socketPath.c_str(), -1, gid) != 0)
+                throw systemError("Failed to set the group of the socket");
+        }
+
+        if (listen(m_socket, 16) != 0)
+            throw systemError("Failed to listen on the socket");
+
+        if (mp_dio) {
+            mp_dio->setSnapshotCallback(
+                [this](uint64_t timestamp, const rs::DioSnapshot &snapshot) {
+                    publishDio(timestamp, snapshot, false);
+                }
+            );
+
+            mp_dio->startSampling(m_config.samplingIntervalUs);
+            if (mp_dio->getLastError()) {
+                throw std::system_error(
+                    mp_dio->getLastError(),
+                    mp_dio->getLastErrorString()
+                );
+            }
+        }
+
+        if (mp_poe) {
+            m_poeThread = std::thread(&IodServer::runPoe, this);
+            mp_poe->setTelemetryListener(this);
+            mp_poe->startTelemetry(m_config.telemetryIntervalMs);
+            if (mp_poe->getLastError()) {
+                throw std::system_error(
+                    mp_poe->getLastError(),
+                    mp_poe->getLastErrorString()
+                );
+            }
+        }
+    }
+    catch (...) {
+        release();
+        throw;
+    }
+}
+
+IodServer::~IodServer() { release(); }
+
+void IodServer::run()
+{
+    std::vector<pollfd> fds;
+    while (!m_stopping) {
+        fds.clear();
+        fds.push_back({m_wake[0], POLLIN, 0});
+        fds.push_back({m_socket, POLLIN, 0});
+        for (int client : m_clients) fds.push_back({client, POLLIN, 0});
+
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            throw systemError("Failed to poll the clients");
+        }
+
+        if (fds[0].revents) {
+            char buffer[64];
+            while (read(m_wake[0], buffer, sizeof(buffer)) > 0) {
+            }
+
+            if (m_stopping) break;
+
+            std::lock_guard<std::mutex> lock(m_poeMutex);
+            m_clients.insert(
+                m_clients.end(),
+                m_returnedClients.begin(),
+                m_returnedClients.end()
+            );
+            m_returnedClients.clear();
+        }
+
+        // Clients accepted or returned above aren't in fds yet, so they're
+        // served on the next round.
+        for (size_t i = 2; i < fds.size(); ++i) {
+            if (!fds[i].revents) continue;
+
+            ClientState state = serveClient(fds[i].fd);
+            if (state == ClientState::Served) continue;
+
+            if (state == ClientState::Gone) close(fds[i].fd);
+            m_clients.erase(
+                std::find(m_clients.begin(), m_clients.end(), fds[i].fd)
+            );
+        }
+
+        if (fds[1].revents) acceptClient();
+    }
+}
+
+void IodServer::stop()
+{
+    m_stopping = true;
+    wake();
+}
+
+void IodServer::onSweep(const TelemetrySweep &sweep)
+{
+    if (!sweep.valid) return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_sweepMutex);
+        const IodLayout &layout = mp_state->layout;
+        for (size_t i = 0; i < sweep.ports.size(); ++i) {
+            for (uint32_t index = 0; index < layout.portCount; ++index) {
+                if (layout.ports[index] == sweep.ports[i])
+                    m_readings[index] = sweep.readings[i];
+            }
+        }
+        m_sweepTimestamp = sweep.timestamp;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_poeMutex);
+        m_sweepPending = true;
+    }
+    m_poeCondition.notify_one();
+}
+
+void IodServer::release()
+{
+    // Neither thread may touch the segment once it's unmapped.
+    if (mp_dio) {
+        mp_dio->stopSampling();
+        mp_dio->setSnapshotCallback(nullptr);
+    }
+
+    if (mp_poe) {
+        mp_poe->stopTelemetry();
+        mp_poe->setTelemetryListener(nullptr);
+    }
+
+    if (m_poeThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_poeMutex);
+            m_poeStopping = true;
+        }
+        m_poeCondition.notify_one();
+        m_poeThread.join();
+    }
+
+    for (const auto &pending : m_poeRequests) close(pending.first);
+    m_poeRequests.clear();
+    for (int client : m_returnedClients) close(client);
+    m_returnedClients.clear();
+    for (int client : m_clients) close(client);
+    m_clients.clear();
+
+    if (m_socket >= 0) {
+        close(m_socket);
+        unlink(m_config.socketPath.c_str());
+        m_socket = -1;
+    }
+
+    if (mp_state) {
+        munmap(mp_state, sizeof(IodSharedState));
+        shm_unlink(m_config.shmName.c_str());
+        mp_state = nullptr;
+    }
+
+    for (int &fd : m_wake) {
+        if (fd >= 0) close(fd);
+        fd = -1;
+    }
+}
+
+// Only wakes run up; a full pipe already does that.
+void IodServer::wake()
+{
+    char byte = 0;
+    ssize_t written = write(m_wake[1], &byte, 1);
+    (void)written;
+}
+
+// Handles the PoE requests and publishes the PoE block after every sweep.
+// Requests go first, a client is waiting for them.
+void IodServer::runPoe()
+{
+    std::unique_lock<std::mutex> lock(m_poeMutex);
+    while (true) {
+        m_poeCondition.wait(lock, [this] {
+            return m_poeStopping || m_sweepPending || !m_poeRequests.empty();
+        });
+        if (m_poeStopping) break;
+
+        if (m_poeRequests.empty()) {
+            m_sweepPending = false;
+            lock.unlock();
+            publishPoe();
+            lock.lock();
+            continue;
+        }
+
+        std::pair<int, IodRequest> pending = m_poeRequests.front();
+        m_poeRequests.pop_front();
+        lock.unlock();
+
+        IodResponse response = {};
+        handle(pending.second, response);
+        bool sent = sendResponse(pending.first, response);
+        if (!sent) close(pending.first);
+
+        lock.lock();
+        if (sent) {
+            m_returnedClients.push_back(pending.first);
+            wake();
+        }
+    }
+}
+
+// Called by the sampling thread with every scan, and by handleDio after a
+// request changed the pins. A scan older than what's published is dropped,
+// so it can't undo the change. A change only updates the pins that can be
+// outputs, so the inputs keep the sampler's debounced states.
+void IodServer::publishDio(
+    uint64_t timestamp,
+    const rs::DioSnapshot &snapshot,
+    bool outputsOnly
+)
+{
+    std::lock_guard<std::mutex> lock(m_dioMutex);
+    if (timestamp < m_dioData.timestamp) return;
+
+    const IodLayout &layout = mp_state->layout;
+    m_dioData.timestamp = timestamp;
+    for (int dio = 0; dio < kIodMaxDios; ++dio) {
+        uint64_t mask = outputsOnly ? layout.outputs[dio] : ~0ULL;
+        m_dioData.states[dio] =
+            (m_dioData.states[dio] & ~mask) | (snapshot.states[dio] & mask);
+        m_dioData.valid[dio] = snapshot.valid[dio];
+    }
+    iodPublish(mp_state->dio, m_dioData);
+}
+
+// Only called from the PoE thread, or before it's started, so the PoE block
+// has a single writer.
+void IodServer::publishPoe()
+{
+    const IodLayout &layout = mp_state->layout;
+    IodPoeData data = {};
+    {
+        std::lock_guard<std::mutex> lock(m_sweepMutex);
+        data.timestamp = m_sweepTimestamp;
+        for (uint32_t index = 0; index < layout.portCount; ++index) {
+            data.ports[index].voltage = m_readings[index].voltage;
+            data.ports[index].current = m_readings[index].current;
+            data.ports[index].power = m_readings[index].power;
+        }
+    }
+
+    std::map<int, rs::PoeState> states = mp_poe->getCachedPortStates();
+    for (uint32_t index = 0; index < layout.portCount; ++index) {
+        int port = layout.ports[index];
+        auto it = states.find(port);
+        rs::PoeState state =
+            it != states.end() ? it->second : rs::PoeState::Error;
+        data.ports[index].state = static_cast<int32_t>(state);
+        data.ports[index].energy = mp_poe->getPortEnergyEx(port).valueOr(0);
+    }
+
+    iodPublish(mp_state->poe, data);
+}
+
+void IodServer::acceptClient()
+{
+    int client = accept4(m_socket, nullptr, nullptr, SOCK_CLOEXEC);
+    if (client >= 0) m_clients.push_back(client);
+}
+
+// Gone means the client left or broke the protocol. A client whose PoE
+// request was handed to the PoE thread doesn't send anything until it has
+// the response, so it's left out of the poll until then.
+IodServer::ClientState IodServer::serveClient(int client)
+{
+    IodRequest request;
+    ssize_t size = recv(client, &request, sizeof(request), MSG_DONTWAIT);
+    if (size < 0) {
+        return errno == EAGAIN || errno == EINTR ? ClientState::Served
+                                                 : ClientState::Gone;
+    }
+    if (size != (ssize_t)sizeof(request)) return ClientState::Gone;
+
+    request.name[sizeof(request.name) - 1] = '\0';
+    if (mp_poe && isPoeCommand(request.command)) {
+        {
+            std::lock_guard<std::mutex> lock(m_poeMutex);
+            m_poeRequests.push_back(std::make_pair(client, request));
+        }
+        m_poeCondition.notify_one();
+        return ClientState::HandedOff;
+    }
+
+    IodResponse response = {};
+    handle(request, response);
+    return sendResponse(client, response) ? ClientState::Served
+                                          : ClientState::Gone;
+}
+
+// Clients wait for their response, so it always fits in the socket buffer
+// and a client that doesn't read it is broken.
+bool IodServer::sendResponse(int client, const IodResponse &response)
+{
+    return send(client, &response, sizeof(response),
+                MSG_DONTWAIT | MSG_NOSIGNAL) == (ssize_t)sizeof(response);
+}
+
+void IodServer::handle(const IodRequest &request, IodResponse &response)
+{
+    IodCommand command = static_cast<IodCommand>(request.command);
+    if (command == IodCommand::Hello) {
+        response.value = kIodVersion;
+        iodCopyString(
+            response.message, sizeof(response.message), m_config.shmName
+        );
+        return;
+    }
+
+    bool isDio = isDioCommand(request.command);
+    bool isPoe = isPoeCommand(request.command);
+    if ((isDio && !mp_dio) || (isPoe && !mp_poe) || (!isDio && !isPoe)) {
+        iodEncodeError(
+            std::make_error_code(std::errc::function_not_supported),
+            "Not available through rsiod",
+            response
+        );
+        return;
+    }
+
+    if (isDio)
+        handleDio(request, response);
+    else
+        handlePoe(request, response);
+}
+
+void IodServer::handleDio(const IodRequest &request, IodResponse &response)
+{
+    bool changed = false;
+    switch (static_cast<IodCommand>(request.command)) {
+        case IodCommand::SetOutputMode:
+            mp_dio->setOutputMode(
+                request.target, static_cast<rs::OutputMode>(request.arg)
+            );
+            changed = true;
+            break;
+        case IodCommand::GetOutputMode:
+            response.value =
+                static_cast<int64_t>(mp_dio->getOutputMode(request.target));
+            break;
+        case IodCommand::DigitalRead:
+            response.value =
+                mp_dio->digitalRead(request.target, request.pin, request.arg);
+            break;
+        case IodCommand::DigitalWrite:
+            mp_dio->digitalWrite(request.target, request.pin, request.arg);
+            changed = true;
+            break;
+        case IodCommand::SetPinDirection:
+            mp_dio->setPinDirection(
+                request.target,
+                request.pin,
+                static_cast<rs::PinDirection>(request.arg)
+            );
+            changed = true;
+            break;
+        case IodCommand::GetPinDirection:
+            response.value = static_cast<int64_t>(
+                mp_dio->getPinDirection(request.target, request.pin)
+            );
+            break;
+        case IodCommand::ReadGroup:
+            response.value = (int64_t)mp_dio->readGroup(request.name);
+            break;
+        case IodCommand::WriteGroup:
+            mp_dio->writeGroup(request.name, request.value);
+            changed = true;
+            break;
+        default:
+            break;
+    }
+
+    // Clients read the pins from the segment, so a change has to show up
+    // there before the response does instead of with the next scan.
+    std::error_code error = mp_dio->getLastError();
+    std::string message = mp_dio->getLastErrorString();
+    if (changed && !error) {
+        rs::Result<rs::DioSnapshot> snapshot = mp_dio->readAllPackedEx();
+        if (snapshot) publishDio(timestampNow(), snapshot.value(), true);
+    }
+    iodEncodeError(error, message, response);
+}
+
+void IodServer::handlePoe(const IodRequest &request, IodResponse &response)
+{
+    const IodLayout &layout = mp_state->layout;
+    bool changed = false;
+    switch (static_cast<IodCommand>(request.command)) {
+        case IodCommand::SetPortState:
+            mp_poe->setPortState(
+                request.target, static_cast<rs::PoeState>(request.arg)
+            );
+            changed = true;
+            break;
+        case IodCommand::SetPortStates: {
+            if (request.count > kIodMaxPorts) {
+                iodEncodeError(
+                    std::make_error_code(std::errc::invalid_argument),
+                    "Invalid port",
+                    response
+                );
+                return;
+            }
+
+            std::map<int, rs::PoeState> states;
+            for (uint32_t i = 0; i < request.count; ++i) {
+                states[request.ports[i]] =
+                    static_cast<rs::PoeState>(request.states[i]);
+            }
+            mp_poe->setPortStates(states);
+            changed = true;
+            break;
+        }
+        case IodCommand::Resync:
+            mp_poe->resync();
+            changed = true;
+            break;
+        case IodCommand::ResetPortEnergy:
+            mp_poe->resetPortEnergy(request.target);
+            changed = true;
+            break;
+        case IodCommand::SetBudgetLimit:
+            mp_poe->setBudgetLimit(request.watts);
+            break;
+        case IodCommand::SetPortPriority:
+            mp_poe->setPortPriority(request.target, request.arg);
+            break;
+        case IodCommand::SetPortPowerLimit:
+            mp_poe->setPortPowerLimit(request.target, request.watts);
+            break;
+        case IodCommand::GetShedPorts: {
+            std::vector<int> ports = mp_poe->getShedPorts();
+            for (int port : ports) {
+                for (uint32_t index = 0; index < layout.portCount; ++index) {
+                    if (layout.ports[index] == port)
+                        response.value |= 1LL << index;
+                }
+            }
+            break;
+        }
+        case IodCommand::GetBudgetConsumed:
+            response.value = mp_poe->getBudgetConsumed();
+            break;
+        case IodCommand::GetBudgetAvailable:
+            response.value = mp_poe->getBudgetAvailable();
+            break;
+        case IodCommand::GetBudgetTotal:
+            response.value = mp_poe->getBudgetTotal();
+            break;
+        default:
+            break;
+    }
+
+    // Clients read the states and energy from the segment, so a change has
+    // to show up there before the response does.
+    std::error_code error = mp_poe->getLastError();
+    std::string message = mp_poe->getLastErrorString();
+    if (changed && !error) publishPoe();
+    iodEncodeError(error, message, response);
+}
@@ -0,0 +1,113 @@
+#ifndef IODSERVER_H
+#define IODSERVER_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../dio/src/rsdioimpl.h"
+#include "../poe/src/poetelemetry.h"
+#include "../poe/src/rspoeimpl.h"
+#include "../utils/iodprotocol.h"
+
+struct IodServerConfig {
+    std::string socketPath;
+    // Permissions of the socket, and its group if not empty. Anyone who can
+    // connect can change the hardware.
+    int socketMode;
+    std::string socketGroup;
+    std::string shmName;
+    int samplingIntervalUs;
+    int telemetryIntervalMs;
+    // The configuration files dio and poe were loaded from. Clients check
+    // the files they're given against these.
+    std::string dioFile;
+    std::string poeFile;
+};
+
+// The daemon side of rsiod. Owns the shared memory segment and the socket,
+// publishes every scan of dio and every telemetry sweep of poe, and serves
+// the requests of the clients on the thread calling run().
+//
+// Either dio or poe may be null. Both are used by this object only, and
+// must outlive it.
+//
+// The DIO block is published by the sampling thread, and by run() after a
+// request changed a pin so the client's next read sees it. PoE requests are
+// handed to a thread of their own along with their client, so DIO requests
+// never wait behind the SMBus. That thread is also the only writer of the
+// PoE block. Telemetry listeners must not call back into RsPoeImpl, so a
+// sweep only wakes it, and it publishes the readings with the port states
+// RsPoeImpl keeps instead of reading them from the controller.
+class IodServer : private TelemetryListener {
+   public:
+    // Throws std::system_error if the socket or shared memory can't be set
+    // up.
+    IodServer(RsDioImpl *dio, RsPoeImpl *poe, const IodServerConfig &config);
+    ~IodServer();
+
+    // Serves clients until stop is called.
+    void run();
+    // Makes run return. Async-signal-safe.
+    void stop();
+
+   private:
+    // What became of a client after serveClient.
+    enum class ClientState { Served, HandedOff, Gone };
+
+    void onSweep(const TelemetrySweep &sweep) override;
+
+    void release();
+    void wake();
+    void runPoe();
+    void publishDio(
+        uint64_t timestamp,
+        const rs::DioSnapshot &snapshot,
+        bool outputsOnly
+    );
+    void publishPoe();
+    void acceptClient();
+    ClientState serveClient(int client);
+    bool sendResponse(int client, const IodResponse &response);
+    void handle(const IodRequest &request, IodResponse &response);
+    void handleDio(const IodRequest &request, IodResponse &response);
+    void handlePoe(const IodRequest &request, IodResponse &response);
+
+    RsDioImpl *mp_dio;
+    RsPoeImpl *mp_poe;
+    IodServerConfig m_config;
+
+    IodSharedState *mp_state;
+    int m_socket;
+    int m_wake[2];
+    std::vector<int> m_clients;
+    std::atomic<bool> m_stopping;
+
+    // Last data published to the DIO block.
+    std::mutex m_dioMutex;
+    IodDioData m_dioData;
+
+    // Readings of the last valid sweep, by index into the layout's ports.
+    std::mutex m_sweepMutex;
+    uint64_t m_sweepTimestamp;
+    PortReading m_readings[kIodMaxPorts];
+
+    // Clients with a PoE request are out of m_clients until the PoE thread
+    // has sent the response and returns them.
+    std::thread m_poeThread;
+    std::mutex m_poeMutex;
+    std::condition_variable m_poeCondition;
+    bool m_poeStopping;
+    bool m_sweepPending;
+    std::deque<std::pair<int, IodRequest>> m_poeRequests;
+    std::vector<int> m_returnedClients;
+};
+
+#endif  // IODSERVER_H
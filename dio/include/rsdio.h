@@ -1,6 +1,10 @@
 #ifndef RSDIO_H
 #define RSDIO_H
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
 #include <map>
 #include <string>
 #include <system_error>
@@ -11,6 +15,9 @@
 #include "rsdio_export.h"
 #endif
 
+#include "rsresult.h"
+#include "rsthread.h"
+
 namespace rs {
 
 struct PinInfo {
@@ -32,6 +39,91 @@ enum class OutputMode { Source = -1, Sink = -2 };
 
 enum class PinDirection { Input, Output };
 
+enum class Edge { Rising = 1, Falling = 2, Both = 3 };
+
+enum class DebounceMode { None, Consecutive, Integrator };
+
+struct DioEvent {
+    uint64_t timestamp;  // Monotonic time in nanoseconds.
+    int dio;
+    int pin;
+    bool state;  // State of the pin after the edge.
+};
+
+typedef std::function<void(const DioEvent &)> DioCallback;
+
+struct DioRecord {
+    uint64_t timestamp;  // Monotonic time in nanoseconds.
+    uint64_t states;     // Bit n is the state of pin n.
+};
+
+struct DioCaptureStats {
+    uint64_t captured;  // Records written to the capture buffer.
+    uint64_t overruns;  // Records lost because the capture buffer was full.
+    uint64_t buffered;  // Records waiting to be read from the buffer.
+    float jitterAvgUs;  // Average delay of a scan past its schedule.
+    float jitterMaxUs;  // Worst delay of a scan past its schedule.
+};
+
+struct PwmStats {
+    uint64_t edges;     // Edges generated on all pins.
+    float jitterAvgUs;  // Average delay of an edge past its schedule.
+    float jitterMaxUs;  // Worst delay of an edge past its schedule.
+};
+
+// Layout of playback buffers and files. Files are a plain array of these in
+// host byte order.
+struct PlaybackStep {
+    uint64_t deltaUs;  // Time since the previous step, or since the start.
+    uint64_t mask;     // Bit n set means pin n is changed by this step.
+    uint64_t value;    // Bit n is the new state of pin n.
+};
+
+struct PlaybackStats {
+    uint64_t played;      // Steps written so far.
+    uint64_t total;       // Steps in the buffer or file.
+    bool running;         // Whether steps are still being played.
+    float latenessAvgUs;  // Average delay of a step past its schedule.
+    float latenessMaxUs;  // Worst delay of a step past its schedule.
+};
+
+struct CounterStats {
+    uint64_t count;        // Edges counted since the counter was started.
+    float frequencyHz;     // Signal frequency over the counter window.
+    float maxFrequencyHz;  // Highest frequency the sample rate can measure.
+};
+
+struct EncoderStats {
+    int64_t position;    // Quadrature steps counted, 4 per encoder cycle.
+    int direction;       // 1 or -1 for the last step, 0 before the first.
+    uint64_t errors;     // Steps lost because both pins changed at once.
+    float maxCountRate;  // Highest step rate the sample rate can follow.
+};
+
+struct PinStats {
+    uint64_t transitions;  // Edges seen while sampling.
+    uint64_t highTimeUs;   // Time the pin was seen HIGH.
+    uint64_t lowTimeUs;    // Time the pin was seen LOW.
+    float dutyCycle;       // Fraction of the time the pin was HIGH.
+    uint64_t lastChange;   // Monotonic time of the last edge in nanoseconds.
+};
+
+struct ReadCacheStats {
+    uint64_t hits;    // Reads served from the cache.
+    uint64_t misses;  // Reads that had to read the register.
+};
+
+// Connectors 0 through kMaxDios - 1 fit in a DioSnapshot.
+const int kMaxDios = 8;
+
+// Most handles getPinHandle hands out for one XML file.
+const int kMaxPinHandles = 256;
+
+struct DioSnapshot {
+    uint64_t states[kMaxDios];  // Bit n of states[dio] is the state of pin n.
+    uint64_t valid[kMaxDios];   // Bit n of valid[dio] is set if pin n exists.
+};
+
 class RsDio {
    public:
     virtual ~RsDio() {}
@@ -45,13 +137,131 @@ class RsDio {
     virtual void setOutputMode(int dio, OutputMode mode) = 0;
     virtual OutputMode getOutputMode(int dio) = 0;
 
-    virtual bool digitalRead(int dio, int pin) = 0;
+    virtual bool digitalRead(int dio, int pin, bool bypassCache = false) = 0;
     virtual void digitalWrite(int dio, int pin, bool state) = 0;
 
     virtual void setPinDirection(int dio, int pin, PinDirection dir) = 0;
     virtual PinDirection getPinDirection(int dio, int pin) = 0;
 
     virtual std::map<int, bool> readAll(int dio) = 0;
+    virtual DioSnapshot readAllPacked() = 0;
+
+    virtual uint64_t readGroup(const char *name) = 0;
+    virtual void writeGroup(const char *name, uint64_t value) = 0;
+
+    virtual void startSampling(int intervalUs) = 0;
+    virtual void stopSampling() = 0;
+
+    virtual int attachCallback(
+        int dio,
+        int pin,
+        Edge edge,
+        DioCallback callback
+    ) = 0;
+    virtual int attachConnectorCallback(
+        int dio,
+        uint64_t pinMask,
+        Edge edge,
+        DioCallback callback
+    ) = 0;
+    virtual void detachCallback(int handle) = 0;
+
+    virtual void setDebounce(
+        int dio,
+        int pin,
+        DebounceMode mode,
+        int samples
+    ) = 0;
+
+    virtual void startCapture(
+        int dio,
+        int intervalUs,
+        DioRecord *buffer,
+        size_t size
+    ) = 0;
+    virtual void stopCapture() = 0;
+    virtual size_t readCapture(DioRecord *records, size_t count) = 0;
+    virtual DioCaptureStats getCaptureStats() = 0;
+
+    virtual void startPwm(int dio, int pin, int periodUs, float duty) = 0;
+    virtual void stopPwm(int dio, int pin) = 0;
+    virtual void pulse(int dio, int pin, int widthUs) = 0;
+    virtual PwmStats getPwmStats() = 0;
+
+    virtual void startPlayback(
+        int dio,
+        const PlaybackStep *steps,
+        size_t count,
+        float *latenessUs
+    ) = 0;
+    virtual void startPlaybackFile(
+        int dio,
+        const char *fileName,
+        float *latenessUs
+    ) = 0;
+    virtual void stopPlayback() = 0;
+    virtual PlaybackStats getPlaybackStats() = 0;
+
+    virtual void setWriteCombining(bool enabled, int windowUs) = 0;
+    virtual void flush() = 0;
+
+    virtual void startCounter(int dio, int pin, Edge edge) = 0;
+    virtual void stopCounter(int dio, int pin) = 0;
+    virtual CounterStats getCounterStats(int dio, int pin) = 0;
+    virtual void setCounterWindow(int windowMs) = 0;
+
+    virtual void addEncoder(
+        const char *name,
+        int dio,
+        int pinA,
+        int pinB
+    ) = 0;
+    virtual void removeEncoder(const char *name) = 0;
+    virtual void resetEncoder(const char *name) = 0;
+    virtual EncoderStats getEncoderStats(const char *name) = 0;
+
+    virtual PinStats getPinStats(int dio, int pin) = 0;
+    virtual std::map<int, PinStats> getAllPinStats(int dio) = 0;
+    virtual void resetPinStats() = 0;
+
+    virtual void setThreadConfig(const ThreadConfig &config) = 0;
+    virtual JitterReport getJitterReport() = 0;
+
+    // Real-time subset. Handles are looked up and the thread is set up
+    // beforehand, after that the rt functions never allocate, throw or set
+    // the last error, and report errors through their return value.
+    virtual int getPinHandle(int dio, int pin) = 0;
+    virtual std::error_code rtAttachThread(bool lockMemory) noexcept = 0;
+    virtual void rtDetachThread() noexcept = 0;
+    virtual std::error_code rtReadPin(int handle, bool &state) noexcept = 0;
+    virtual std::error_code rtWritePin(int handle, bool state) noexcept = 0;
+    virtual std::error_code rtReadPacked(int dio, uint64_t &states) noexcept = 0;
+    virtual std::error_code rtWritePacked(
+        int dio,
+        uint64_t mask,
+        uint64_t states
+    ) noexcept = 0;
+
+    virtual void setReadCacheMaxAge(int maxAgeUs) = 0;
+    virtual ReadCacheStats getReadCacheStats() = 0;
+
+    // Variants of the pin functions that return their error along with the
+    // value instead of setting the last error.
+    virtual Result<bool> digitalReadEx(
+        int dio,
+        int pin,
+        bool bypassCache = false
+    ) = 0;
+    virtual Result<void> digitalWriteEx(int dio, int pin, bool state) = 0;
+    virtual Result<PinDirection> getPinDirectionEx(int dio, int pin) = 0;
+    virtual Result<void> setPinDirectionEx(
+        int dio,
+        int pin,
+        PinDirection dir
+    ) = 0;
+    virtual Result<DioSnapshot> readAllPackedEx() = 0;
+    virtual Result<uint64_t> readGroupEx(const char *name) = 0;
+    virtual Result<void> writeGroupEx(const char *name, uint64_t value) = 0;
 
     virtual std::error_code getLastError() const = 0;
     virtual std::string getLastErrorString() const = 0;
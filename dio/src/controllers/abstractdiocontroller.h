@@ -2,6 +2,7 @@
 #define ABSTRACTDIOCONTROLLER_H
 
 #include <stdint.h>
+#include <map>
 #include <system_error>  
 
 enum PinMode
@@ -39,6 +40,9 @@ struct PinConfig
 };
 
 
+typedef std::map<int, PinConfig> pinconfigmap_t;
+typedef std::map<int, pinconfigmap_t> dioconfigmap_t;
+
 class AbstractDioController
 {
 public:
@@ -52,6 +56,27 @@ public:
 	virtual void setPinState(const PinConfig &config, bool state) = 0;
 
 	virtual void printRegs() = 0;
+
+	// Raw access to the GPIO data registers for the sampling and PWM threads.
+	// acquireGpioAccess grants the calling thread access to every data
+	// register once so getGpioRegister is a single port read. Grants nest per
+	// thread: each acquire needs its own release, and only the last release
+	// revokes the access. offset is the same as PinConfig::offset.
+	virtual void acquireGpioAccess() {}
+	virtual void releaseGpioAccess() {}
+	virtual uint8_t getGpioRegister(uint8_t offset) { throw std::system_error(std::make_error_code(std::errc::function_not_supported)); }
+	virtual void setGpioRegister(uint8_t offset, uint8_t data) { throw std::system_error(std::make_error_code(std::errc::function_not_supported)); }
+
+	// Clears the bits in clearMask and then sets the ones in setMask. Every
+	// write to a data register outside of setPinState goes through here so a
+	// controller shared between threads or instances can make the
+	// read-modify-write atomic with setPinState. Registers that are entirely
+	// replaced aren't read first.
+	virtual void modifyGpioRegister(uint8_t offset, uint8_t clearMask, uint8_t setMask)
+	{
+		uint8_t data = clearMask == 0xff ? 0 : getGpioRegister(offset) & ~clearMask;
+		setGpioRegister(offset, data | setMask);
+	}
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,178 @@
+#include "controllerregistry.h"
+
+#include <map>
+#include <mutex>
+#include <set>
+#include <utility>
+
+namespace {
+
+// Forwards every call to the controller it owns under one lock, so the LDN
+// the chip has selected can't change halfway through another instance's
+// read-modify-write. Pins are only initialized by the first instance that
+// uses them, so a later instance doesn't undo the direction an earlier one
+// set. Pin and raw register reads are single port accesses and skip the
+// lock.
+//
+// Raw register writes only take the lock of their data register, which
+// setPinState takes as well. That keeps them atomic with each other without
+// making the rt functions wait for a pin mode change.
+class SharedController : public AbstractDioController {
+   public:
+    explicit SharedController(AbstractDioController *controller)
+        : mp_controller(controller)
+    {
+    }
+
+    ~SharedController() { delete mp_controller; }
+
+    void initPin(const PinConfig &config) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto pin = std::make_pair(config.offset, config.bitmask);
+        if (m_initialized.count(pin)) return;
+
+        mp_controller->initPin(config);
+        m_initialized.insert(pin);
+    }
+
+    PinMode getPinMode(const PinConfig &config) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return mp_controller->getPinMode(config);
+    }
+
+    void setPinMode(const PinConfig &config, PinMode mode) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        mp_controller->setPinMode(config, mode);
+    }
+
+    // A single data register read, so readers of different registers don't
+    // wait for each other.
+    bool getPinState(const PinConfig &config) override
+    {
+        return mp_controller->getPinState(config);
+    }
+
+    void setPinState(const PinConfig &config, bool state) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::lock_guard<std::mutex> registerLock(registerMutex(config.offset));
+        mp_controller->setPinState(config, state);
+    }
+
+    void printRegs() override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        mp_controller->printRegs();
+    }
+
+    void acquireGpioAccess() override { mp_controller->acquireGpioAccess(); }
+    void releaseGpioAccess() override { mp_controller->releaseGpioAccess(); }
+
+    uint8_t getGpioRegister(uint8_t offset) override
+    {
+        return mp_controller->getGpioRegister(offset);
+    }
+
+    void setGpioRegister(uint8_t offset, uint8_t data) override
+    {
+        std::lock_guard<std::mutex> lock(registerMutex(offset));
+        mp_controller->setGpioRegister(offset, data);
+    }
+
+    void modifyGpioRegister(
+        uint8_t offset,
+        uint8_t clearMask,
+        uint8_t setMask
+    ) override
+    {
+        std::lock_guard<std::mutex> lock(registerMutex(offset));
+        mp_controller->modifyGpioRegister(offset, clearMask, setMask);
+    }
+
+   private:
+    static const int kRegisterLocks = 8;
+
+    std::mutex &registerMutex(uint8_t offset)
+    {
+        return m_registerMutex[offset % kRegisterLocks];
+    }
+
+    AbstractDioController *mp_controller;
+    std::mutex m_mutex;
+    std::mutex m_registerMutex[kRegisterLocks];
+    std::set<std::pair<uint8_t, uint8_t>> m_initialized;
+};
+
+struct Entry {
+    SharedController *controller;
+    std::string config;
+    int handles;
+};
+
+// Never destroyed, so handles released during static destruction still find
+// the registry.
+std::mutex &registryMutex()
+{
+    static std::mutex *mutex = new std::mutex;
+    return *mutex;
+}
+
+std::map<std::string, Entry> &registry()
+{
+    static std::map<std::string, Entry> *entries =
+        new std::map<std::string, Entry>;
+    return *entries;
+}
+
+// Closing the chip happens under the registry lock too, so it can't overlap
+// with acquire opening it again.
+void release(const std::string &key)
+{
+    std::lock_guard<std::mutex> lock(registryMutex());
+    auto it = registry().find(key);
+    if (it == registry().end() || --it->second.handles > 0) return;
+
+    delete it->second.controller;
+    registry().erase(it);
+}
+
+}  // namespace
+
+std::shared_ptr<AbstractDioController> ControllerRegistry::acquire(
+    const std::string &key,
+    const std::string &config,
+    const factory_t &create
+)
+{
+    std::lock_guard<std::mutex> lock(registryMutex());
+    auto it = registry().find(key);
+    if (it == registry().end()) {
+        Entry entry;
+        entry.controller = new SharedController(create());
+        entry.config = config;
+        entry.handles = 0;
+        it = registry().insert(std::make_pair(key, entry)).first;
+    }
+    else if (it->second.config != config) {
+        throw std::system_error(
+            std::make_error_code(std::errc::device_or_resource_busy),
+            "DIO controller already in use with a different configuration"
+        );
+    }
+
+    ++it->second.handles;
+    return std::shared_ptr<AbstractDioController>(
+        it->second.controller,
+        [key](AbstractDioController *) { release(key); }
+    );
+}
+
+int ControllerRegistry::useCount(const std::string &key)
+{
+    std::lock_guard<std::mutex> lock(registryMutex());
+    auto it = registry().find(key);
+    return it == registry().end() ? 0 : it->second.handles;
+}
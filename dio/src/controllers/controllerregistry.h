@@ -0,0 +1,36 @@
+#ifndef CONTROLLERREGISTRY_H
+#define CONTROLLERREGISTRY_H
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "abstractdiocontroller.h"
+
+// Process-wide registry of the SuperIO controllers in use, keyed by chip and
+// configuration port.
+//
+// Every RsDio that talks to the same chip gets the same controller, so the
+// chip is only probed and set up once, there is one LDN cache instead of one
+// per instance going stale, and one lock serializes every configuration
+// register access. The controller is closed again once the last handle to
+// it is released.
+class ControllerRegistry {
+   public:
+    typedef std::function<AbstractDioController *()> factory_t;
+
+    // Returns the controller registered under key, calling create if there
+    // is none yet. config describes the setup create applies; asking for a
+    // controller that is already open with a different config throws
+    // device_or_resource_busy.
+    static std::shared_ptr<AbstractDioController> acquire(
+        const std::string &key,
+        const std::string &config,
+        const factory_t &create
+    );
+
+    // Number of handles to the controller registered under key.
+    static int useCount(const std::string &key);
+};
+
+#endif  // CONTROLLERREGISTRY_H
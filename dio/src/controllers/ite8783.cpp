@@ -31,6 +31,8 @@ static const uint8_t kGpioBaseRegisterL =
     0x63;  // SuperIO register that holds the low byte of the base address
            // register (BAR) for the GPIO pins.
 
+static const uint8_t kGpioSets = 6;  // Data registers at the GPIO BAR.
+
 static const uint8_t kPolarityBar = 0xB0;
 static const uint8_t kPolarityMax = 0xB4;
 static const uint8_t kPullUpBar = 0xB8;
@@ -130,15 +132,10 @@ void Ite8783::setPinMode(const PinConfig &config, PinMode mode)
 
 bool Ite8783::getPinState(const PinConfig &config)
 {
-    uint16_t reg = m_baseAddress + config.offset;
-    if (ioperm(reg, 1, 1))
-        throw std::system_error(
-            std::make_error_code(std::errc::operation_not_permitted)
-        );
-
+    acquireGpioAccess();
     bool state = false;
-    uint8_t data = inb(reg);
-    ioperm(reg, 1, 0);
+    uint8_t data = inb(m_baseAddress + config.offset);
+    releaseGpioAccess();
     if ((data & config.bitmask) == config.bitmask)
         state = true;
     else
@@ -165,11 +162,7 @@ void Ite8783::setPinState(const PinConfig &config, bool state)
 
     if (config.invert) state = !state;
     uint16_t reg = m_baseAddress + config.offset;
-    if (ioperm(reg, 1, 1))
-        throw std::system_error(
-            std::make_error_code(std::errc::operation_not_permitted)
-        );
-
+    acquireGpioAccess();
     uint8_t data = inb(reg);
     if (state)
         data |= config.bitmask;
@@ -177,7 +170,51 @@ void Ite8783::setPinState(const PinConfig &config, bool state)
         data &= ~config.bitmask;
 
     outb(data, reg);
-    ioperm(reg, 1, 0);
+    releaseGpioAccess();
+}
+
+// ioperm grants belong to the thread, so revoking the access after a single
+// pin read would also take it from a sampler or rt thread that holds a
+// long-lived grant and calls the pin functions from a callback. Grants are
+// counted per thread and only the last release revokes the access.
+static thread_local int gpioGrants = 0;
+
+void Ite8783::acquireGpioAccess()
+{
+    if (gpioGrants == 0 && ioperm(m_baseAddress, kGpioSets, 1))
+        throw std::system_error(
+            std::make_error_code(std::errc::operation_not_permitted)
+        );
+
+    ++gpioGrants;
+}
+
+void Ite8783::releaseGpioAccess()
+{
+    if (gpioGrants > 0 && --gpioGrants == 0)
+        ioperm(m_baseAddress, kGpioSets, 0);
+}
+
+uint8_t Ite8783::getGpioRegister(uint8_t offset)
+{
+    if (offset >= kGpioSets)
+        throw std::system_error(
+            std::make_error_code(std::errc::invalid_argument),
+            "Invalid GPIO set"
+        );
+
+    return inb(m_baseAddress + offset);
+}
+
+void Ite8783::setGpioRegister(uint8_t offset, uint8_t data)
+{
+    if (offset >= kGpioSets)
+        throw std::system_error(
+            std::make_error_code(std::errc::invalid_argument),
+            "Invalid GPIO set"
+        );
+
+    outb(data, m_baseAddress + offset);
 }
 
 void Ite8783::printRegs() {}
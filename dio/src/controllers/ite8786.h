@@ -30,6 +30,11 @@ public:
 
 	void printRegs() override;
 
+	void acquireGpioAccess() override;
+	void releaseGpioAccess() override;
+	uint8_t getGpioRegister(uint8_t offset) override;
+	void setGpioRegister(uint8_t offset, uint8_t data) override;
+
 private:
 	uint8_t m_currentLdn;
 	uint16_t m_baseAddress;
@@ -0,0 +1,94 @@
+#include "debouncefilter.h"
+
+const int DebounceFilter::kPlanes;
+const int DebounceFilter::kMaxSamples;
+
+DebounceFilter::DebounceFilter() { clear(); }
+
+void DebounceFilter::configure(
+    uint8_t rawBit,
+    rs::DebounceMode mode,
+    int samples
+)
+{
+    uint64_t bit = 1ULL << rawBit;
+    m_consecutiveMask &= ~bit;
+    m_integratorMask &= ~bit;
+    if (mode == rs::DebounceMode::Consecutive) m_consecutiveMask |= bit;
+    if (mode == rs::DebounceMode::Integrator) m_integratorMask |= bit;
+
+    for (int k = 0; k < kPlanes; ++k) {
+        if ((samples >> k) & 1)
+            m_threshold[k] |= bit;
+        else
+            m_threshold[k] &= ~bit;
+    }
+}
+
+void DebounceFilter::clear()
+{
+    m_consecutiveMask = 0;
+    m_integratorMask = 0;
+    m_state = 0;
+    for (int k = 0; k < kPlanes; ++k) {
+        m_threshold[k] = 0;
+        m_counter[k] = 0;
+    }
+}
+
+void DebounceFilter::reset(uint64_t raw)
+{
+    // Integrators of pins that start out high start out full.
+    m_state = raw;
+    for (int k = 0; k < kPlanes; ++k)
+        m_counter[k] = m_threshold[k] & m_integratorMask & raw;
+}
+
+uint64_t DebounceFilter::apply(uint64_t raw)
+{
+    uint64_t diff = (raw ^ m_state) & m_consecutiveMask;
+    uint64_t up = raw & m_integratorMask & ~equalsThreshold();
+    uint64_t down = ~raw & m_integratorMask & ~isZero();
+
+    // Ripple carry / borrow through the planes. Consecutive counters only
+    // ever count up.
+    uint64_t carry = diff | up;
+    uint64_t borrow = down;
+    for (int k = 0; k < kPlanes; ++k) {
+        uint64_t c = m_counter[k];
+        m_counter[k] = c ^ (carry | borrow);
+        carry &= c;
+        borrow &= ~c;
+    }
+
+    // A consecutive counter starts over on every sample that matches the
+    // output and once it flips the output.
+    uint64_t full = equalsThreshold();
+    uint64_t flip = diff & full;
+    uint64_t restart = (m_consecutiveMask & ~diff) | flip;
+    for (int k = 0; k < kPlanes; ++k) m_counter[k] &= ~restart;
+    m_state ^= flip;
+
+    m_state |= m_integratorMask & full;
+    m_state &= ~(m_integratorMask & isZero());
+
+    uint64_t pass = ~(m_consecutiveMask | m_integratorMask);
+    m_state = (m_state & ~pass) | (raw & pass);
+    return m_state;
+}
+
+uint64_t DebounceFilter::equalsThreshold() const
+{
+    uint64_t equal = ~0ULL;
+    for (int k = 0; k < kPlanes; ++k) equal &= ~(m_counter[k] ^ m_threshold[k]);
+
+    return equal;
+}
+
+uint64_t DebounceFilter::isZero() const
+{
+    uint64_t zero = ~0ULL;
+    for (int k = 0; k < kPlanes; ++k) zero &= ~m_counter[k];
+
+    return zero;
+}
@@ -0,0 +1,49 @@
+#ifndef DEBOUNCEFILTER_H
+#define DEBOUNCEFILTER_H
+
+#include <stdint.h>
+
+#include "../include/rsdio.h"
+
+// Debounces every bit of a raw register word (see DioSample) at once.
+//
+// Each bit has a small counter. The counters are stored bit-sliced: plane k
+// holds bit k of all 64 counters, so updating every counter is a handful of
+// mask operations no matter how many pins are filtered. Bits without a
+// filter pass straight through.
+//
+// Consecutive: the output follows the input once it has differed from the
+// output for N samples in a row.
+// Integrator: the counter moves towards the input by one every sample and
+// the output only changes when it reaches 0 or N.
+class DebounceFilter {
+   public:
+    static const int kPlanes = 4;
+    static const int kMaxSamples = (1 << kPlanes) - 1;
+
+    DebounceFilter();
+
+    void configure(uint8_t rawBit, rs::DebounceMode mode, int samples);
+    void clear();
+
+    // Starts over with the output set to raw.
+    void reset(uint64_t raw);
+    uint64_t apply(uint64_t raw);
+
+    uint64_t filteredMask() const
+    {
+        return m_consecutiveMask | m_integratorMask;
+    }
+
+   private:
+    uint64_t equalsThreshold() const;
+    uint64_t isZero() const;
+
+    uint64_t m_consecutiveMask;
+    uint64_t m_integratorMask;
+    uint64_t m_threshold[kPlanes];
+    uint64_t m_counter[kPlanes];
+    uint64_t m_state;
+};
+
+#endif  // DEBOUNCEFILTER_H
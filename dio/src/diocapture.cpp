@@ -0,0 +1,106 @@
+#include "diocapture.h"
+
+DioCapture::DioCapture()
+    : m_active(false),
+      mp_buffer(nullptr),
+      m_size(0),
+      m_every(1),
+      m_skipped(0),
+      m_head(0),
+      m_tail(0),
+      m_captured(0),
+      m_overruns(0),
+      m_latenessTotal(0),
+      m_latenessMax(0)
+{
+}
+
+void DioCapture::start(
+    const PinPacker &packer,
+    rs::DioRecord *buffer,
+    size_t size
+)
+{
+    m_packer = packer;
+    mp_buffer = buffer;
+    m_size = size;
+    m_head = 0;
+    m_tail = 0;
+    m_captured = 0;
+    m_overruns = 0;
+    m_latenessTotal = 0;
+    m_latenessMax = 0;
+    m_active = true;
+}
+
+void DioCapture::setDecimation(int every) { m_every = every > 1 ? every : 1; }
+
+void DioCapture::stop() { m_active = false; }
+
+size_t DioCapture::read(rs::DioRecord *records, size_t count)
+{
+    if (!mp_buffer) return 0;
+
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    size_t available = m_head.load(std::memory_order_acquire) - tail;
+    if (count > available) count = available;
+
+    for (size_t i = 0; i < count; ++i) {
+        records[i] = mp_buffer[(tail + i) % m_size];
+    }
+
+    m_tail.store(tail + count, std::memory_order_release);
+    return count;
+}
+
+rs::DioCaptureStats DioCapture::stats() const
+{
+    rs::DioCaptureStats s;
+    s.captured = m_captured.load();
+    s.overruns = m_overruns.load();
+    s.buffered = m_head.load() - m_tail.load();
+
+    uint64_t scans = s.captured + s.overruns;
+    s.jitterAvgUs =
+        scans > 0 ? (float)(m_latenessTotal.load() / 1000.0 / scans) : 0.0f;
+    s.jitterMaxUs = (float)(m_latenessMax.load() / 1000.0);
+    return s;
+}
+
+void DioCapture::onSamplingStarted(const DioSample &sample)
+{
+    m_skipped = 0;
+    if (m_active) push(sample);
+}
+
+void DioCapture::onSample(const DioSample &sample)
+{
+    if (++m_skipped < m_every) return;
+
+    m_skipped = 0;
+    if (m_active) push(sample);
+}
+
+void DioCapture::push(const DioSample &sample)
+{
+    // Only the sampling thread writes these, so plain load / store pairs are
+    // enough.
+    m_latenessTotal.store(
+        m_latenessTotal.load(std::memory_order_relaxed) + sample.lateness,
+        std::memory_order_relaxed
+    );
+    if (sample.lateness > m_latenessMax.load(std::memory_order_relaxed))
+        m_latenessMax.store(sample.lateness, std::memory_order_relaxed);
+
+    size_t head = m_head.load(std::memory_order_relaxed);
+    if (head - m_tail.load(std::memory_order_acquire) >= m_size) {
+        ++m_overruns;
+        return;
+    }
+
+    rs::DioRecord &record = mp_buffer[head % m_size];
+    record.timestamp = sample.timestamp;
+    record.states = m_packer.pack(sample.raw);
+    m_head.store(head + 1, std::memory_order_release);
+    ++m_captured;
+}
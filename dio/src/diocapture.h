@@ -0,0 +1,52 @@
+#ifndef DIOCAPTURE_H
+#define DIOCAPTURE_H
+
+#include <stdint.h>
+
+#include <atomic>
+
+#include "../include/rsdio.h"
+#include "diosampler.h"
+#include "pinpacker.h"
+
+// Records the state of one connector for every scan of the sampler, or every
+// nth one if the sampler runs faster than the capture needs, into a single
+// producer / single consumer ring over a buffer owned by the caller. The
+// sampling thread is the only producer so pushing a record never blocks or
+// allocates.
+class DioCapture : public SampleListener {
+   public:
+    DioCapture();
+
+    // Must only be called while the sampler is stopped.
+    void start(const PinPacker &packer, rs::DioRecord *buffer, size_t size);
+    void setDecimation(int every);
+    void stop();
+
+    size_t read(rs::DioRecord *records, size_t count);
+    rs::DioCaptureStats stats() const;
+
+    void onSamplingStarted(const DioSample &sample) override;
+    void onSample(const DioSample &sample) override;
+
+   private:
+    void push(const DioSample &sample);
+
+    std::atomic<bool> m_active;
+    PinPacker m_packer;
+    rs::DioRecord *mp_buffer;
+    size_t m_size;
+    int m_every;
+    int m_skipped;  // Scans since the last record.
+
+    // Free running counters, the buffer index is the counter modulo m_size.
+    std::atomic<size_t> m_head;
+    std::atomic<size_t> m_tail;
+
+    std::atomic<uint64_t> m_captured;
+    std::atomic<uint64_t> m_overruns;
+    std::atomic<uint64_t> m_latenessTotal;
+    std::atomic<uint64_t> m_latenessMax;
+};
+
+#endif  // DIOCAPTURE_H
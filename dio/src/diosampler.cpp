@@ -0,0 +1,197 @@
+#include "diosampler.h"
+
+static uint64_t timestampNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               sampler_clock_t::now().time_since_epoch()
+    )
+        .count();
+}
+
+GpioSetList::GpioSetList() : m_count(0) {}
+
+GpioSetList::GpioSetList(const dioconfigmap_t &dioMap) : m_count(0)
+{
+    // The output mode pins (negative ids) never change on their own and are
+    // left out.
+    bool used[kMaxGpioSets] = {false};
+    for (const auto &dio : dioMap) {
+        for (const auto &pin : dio.second) {
+            if (pin.first >= 0 && pin.second.offset < kMaxGpioSets)
+                used[pin.second.offset] = true;
+        }
+    }
+
+    for (uint8_t offset = 0; offset < kMaxGpioSets; ++offset) {
+        if (used[offset]) m_offsets[m_count++] = offset;
+    }
+}
+
+GpioSetList::GpioSetList(uint64_t rawMask) : m_count(0)
+{
+    for (uint8_t offset = 0; offset < kMaxGpioSets; ++offset) {
+        if ((rawMask >> (offset * 8)) & 0xff) m_offsets[m_count++] = offset;
+    }
+}
+
+uint64_t GpioSetList::read(AbstractDioController *controller) const
+{
+    uint64_t raw = 0;
+    for (size_t i = 0; i < m_count; ++i) {
+        uint8_t offset = m_offsets[i];
+        raw |= (uint64_t)controller->getGpioRegister(offset) << (offset * 8);
+    }
+
+    return raw;
+}
+
+void GpioSetList::write(
+    AbstractDioController *controller,
+    uint64_t rawMask,
+    uint64_t raw
+) const
+{
+    for (size_t i = 0; i < m_count; ++i) {
+        uint8_t offset = m_offsets[i];
+        uint8_t mask = (rawMask >> (offset * 8)) & 0xff;
+        uint8_t bits = (raw >> (offset * 8)) & mask;
+        if (!mask) continue;
+
+        controller->modifyGpioRegister(offset, mask, bits);
+    }
+}
+
+DioSampler::DioSampler(
+    AbstractDioController *controller,
+    const dioconfigmap_t &dioMap,
+    const std::vector<SampleListener *> &listeners,
+    int intervalUs,
+    DebounceFilter *filter,
+    JitterHistogram *jitter
+)
+    : mp_controller(controller),
+      m_listeners(listeners),
+      m_interval(intervalUs),
+      mp_filter(filter),
+      mp_jitter(jitter),
+      m_gpioSets(dioMap),
+      m_hasState(false),
+      m_state(0),
+      m_scans(0),
+      m_errors(0),
+      m_running(true),
+      m_firstScanDone(false)
+{
+    if (mp_jitter) mp_jitter->clear(intervalUs * 1000LL);
+    m_thread = std::thread(&DioSampler::run, this);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_firstScanCondition.wait(lock, [this] { return m_firstScanDone; });
+}
+
+DioSampler::~DioSampler() { stop(); }
+
+std::error_code DioSampler::configureThread(const rs::ThreadConfig &config)
+{
+    return applyThreadConfig(m_thread, config);
+}
+
+void DioSampler::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_stopCondition.notify_all();
+
+    if (m_thread.joinable()) m_thread.join();
+}
+
+void DioSampler::run()
+{
+    try {
+        mp_controller->acquireGpioAccess();
+    }
+    catch (...) {
+        ++m_errors;
+        setFirstScanDone();
+        return;
+    }
+
+    DioSample sample;
+    bool started = false;
+    sampler_clock_t::time_point next = sampler_clock_t::now();
+    sampler_clock_t::time_point last;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_stopCondition.wait_until(lock, next, [this] {
+                    return !m_running;
+                }))
+                break;
+        }
+
+        // Like the PoE telemetry, don't try to catch up on missed scans.
+        sampler_clock_t::time_point now = sampler_clock_t::now();
+        sample.lateness =
+            now > next ? std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             now - next
+                         )
+                             .count()
+                       : 0;
+        next += m_interval;
+        if (next < now) next = now + m_interval;
+        if (mp_jitter && started)
+            mp_jitter->add(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    now - last
+                )
+                    .count()
+            );
+        last = now;
+
+        uint64_t raw;
+        try {
+            raw = m_gpioSets.read(mp_controller);
+        }
+        catch (...) {
+            ++m_errors;
+            if (!started) setFirstScanDone();
+            continue;
+        }
+
+        sample.timestamp = timestampNow();
+        ++m_scans;
+        if (!started) {
+            if (mp_filter) mp_filter->reset(raw);
+            sample.raw = raw;
+            sample.changed = 0;
+            m_state = raw;
+            m_hasState = true;
+            for (SampleListener *listener : m_listeners)
+                listener->onSamplingStarted(sample);
+            started = true;
+            setFirstScanDone();
+            continue;
+        }
+
+        if (mp_filter) raw = mp_filter->apply(raw);
+        sample.changed = raw ^ sample.raw;
+        sample.raw = raw;
+        m_state.store(raw, std::memory_order_release);
+        for (SampleListener *listener : m_listeners)
+            listener->onSample(sample);
+    }
+
+    mp_controller->releaseGpioAccess();
+}
+
+void DioSampler::setFirstScanDone()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_firstScanDone = true;
+    }
+    m_firstScanCondition.notify_all();
+}
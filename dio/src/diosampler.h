@@ -0,0 +1,132 @@
+#ifndef DIOSAMPLER_H
+#define DIOSAMPLER_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../../utils/threadconfig.h"
+#include "controllers/abstractdiocontroller.h"
+#include "debouncefilter.h"
+
+typedef std::chrono::steady_clock sampler_clock_t;
+
+// Number of GPIO data registers that fit in a raw sample.
+static const uint8_t kMaxGpioSets = 8;
+
+// One scan of every GPIO data register used by the connectors. Byte n of raw
+// holds the data register at offset n, so a pin lives at bit
+// offset * 8 + bit. Register bytes that weren't scanned are always zero.
+struct DioSample {
+    uint64_t timestamp;  // Monotonic time in nanoseconds.
+    uint64_t raw;
+    uint64_t changed;  // Bits that differ from the previous sample.
+    uint64_t lateness;  // Nanoseconds the scan started after its schedule.
+};
+
+// The GPIO data registers that hold connector pins. Reading them is one port
+// read per register, however many pins each one holds.
+class GpioSetList {
+   public:
+    GpioSetList();
+    explicit GpioSetList(const dioconfigmap_t &dioMap);
+    // The registers that hold any of the bits in rawMask.
+    explicit GpioSetList(uint64_t rawMask);
+
+    // Returns the registers packed like DioSample::raw.
+    uint64_t read(AbstractDioController *controller) const;
+    // Sets the bits in rawMask to the ones in raw. Registers that are
+    // entirely covered by rawMask are written without reading them first.
+    void write(
+        AbstractDioController *controller,
+        uint64_t rawMask,
+        uint64_t raw
+    ) const;
+
+   private:
+    uint8_t m_offsets[kMaxGpioSets];
+    size_t m_count;
+};
+
+// Returns the bit of a pin in DioSample::raw.
+inline uint8_t rawBit(const PinConfig &config)
+{
+    uint8_t bit = 0;
+    while (bit < 8 && !(config.bitmask & (1 << bit))) ++bit;
+    return config.offset * 8 + bit;
+}
+
+// Every consumer of the sampled input state implements this interface so all
+// of them share one scan of the registers. Listeners are called from the
+// sampling thread and must not block.
+class SampleListener {
+   public:
+    virtual ~SampleListener() {}
+
+    // Called with the first scan after sampling (re)starts. There are no
+    // changes to report for it since there's nothing to compare it to.
+    virtual void onSamplingStarted(const DioSample &) {}
+    virtual void onSample(const DioSample &sample) = 0;
+};
+
+// Periodically reads every GPIO data register used by the connectors and
+// hands the result to each listener. A scan is one port read per register
+// and doesn't allocate anything. If a debounce filter is given, listeners
+// only ever see the filtered state. If a histogram is given, it's cleared and
+// then gets the time between the starts of consecutive scans. The
+// constructor returns once the first scan has been tried, so every change
+// after that is seen by the listeners.
+class DioSampler {
+   public:
+    DioSampler(
+        AbstractDioController *controller,
+        const dioconfigmap_t &dioMap,
+        const std::vector<SampleListener *> &listeners,
+        int intervalUs,
+        DebounceFilter *filter = nullptr,
+        JitterHistogram *jitter = nullptr
+    );
+    ~DioSampler();
+
+    void stop();
+    // Applies config to the background thread.
+    std::error_code configureThread(const rs::ThreadConfig &config);
+
+    // Latest (filtered) raw register word. Only valid once hasState is true.
+    bool hasState() const { return m_hasState; }
+    uint64_t state() const { return m_state; }
+
+    uint64_t scanCount() const { return m_scans; }
+    uint64_t errorCount() const { return m_errors; }
+
+   private:
+    void run();
+    void setFirstScanDone();
+
+    AbstractDioController *mp_controller;
+    std::vector<SampleListener *> m_listeners;
+    std::chrono::microseconds m_interval;
+    DebounceFilter *mp_filter;
+    JitterHistogram *mp_jitter;
+
+    GpioSetList m_gpioSets;
+
+    std::atomic<bool> m_hasState;
+    std::atomic<uint64_t> m_state;
+    std::atomic<uint64_t> m_scans;
+    std::atomic<uint64_t> m_errors;
+
+    bool m_running;
+    bool m_firstScanDone;
+    std::mutex m_mutex;
+    std::condition_variable m_stopCondition;
+    std::condition_variable m_firstScanCondition;
+    std::thread m_thread;
+};
+
+#endif  // DIOSAMPLER_H
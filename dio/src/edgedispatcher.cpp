@@ -0,0 +1,73 @@
+#include "edgedispatcher.h"
+
+EdgeDispatcher::EdgeDispatcher() : m_nextHandle(1) {}
+
+int EdgeDispatcher::attach(
+    int dio,
+    const pinconfigmap_t &pins,
+    rs::Edge edge,
+    const rs::DioCallback &callback
+)
+{
+    Watch watch;
+    watch.dio = dio;
+    watch.rawMask = 0;
+    watch.rising = ((int)edge & (int)rs::Edge::Rising) != 0;
+    watch.falling = ((int)edge & (int)rs::Edge::Falling) != 0;
+    watch.callback = callback;
+    for (const auto &pair : pins) {
+        WatchedPin pin;
+        pin.pin = pair.first;
+        pin.rawBit = rawBit(pair.second);
+        pin.invert = pair.second.invert;
+        watch.pins.push_back(pin);
+        watch.rawMask |= 1ULL << pin.rawBit;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    watch.handle = m_nextHandle++;
+    m_watches.push_back(watch);
+    return watch.handle;
+}
+
+bool EdgeDispatcher::detach(int handle)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto it = m_watches.begin(); it != m_watches.end(); ++it) {
+        if (it->handle == handle) {
+            m_watches.erase(it);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void EdgeDispatcher::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_watches.clear();
+}
+
+void EdgeDispatcher::onSample(const DioSample &sample)
+{
+    if (!sample.changed) return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const Watch &watch : m_watches) {
+        if (!(sample.changed & watch.rawMask)) continue;
+
+        rs::DioEvent event;
+        event.timestamp = sample.timestamp;
+        event.dio = watch.dio;
+        for (const WatchedPin &pin : watch.pins) {
+            if (!(sample.changed & (1ULL << pin.rawBit))) continue;
+
+            event.pin = pin.pin;
+            event.state = ((sample.raw >> pin.rawBit) & 1) != pin.invert;
+            if ((event.state && watch.rising) ||
+                (!event.state && watch.falling))
+                watch.callback(event);
+        }
+    }
+}
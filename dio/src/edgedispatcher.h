@@ -0,0 +1,55 @@
+#ifndef EDGEDISPATCHER_H
+#define EDGEDISPATCHER_H
+
+#include <stdint.h>
+
+#include <mutex>
+#include <vector>
+
+#include "../include/rsdio.h"
+#include "diosampler.h"
+
+// Turns the changed bits of every sample into per-pin edge callbacks.
+// A sample without changes is a single AND per watch.
+class EdgeDispatcher : public SampleListener {
+   public:
+    EdgeDispatcher();
+
+    // pins holds the id and config of every pin to watch on the connector.
+    int attach(
+        int dio,
+        const pinconfigmap_t &pins,
+        rs::Edge edge,
+        const rs::DioCallback &callback
+    );
+    bool detach(int handle);
+    void clear();
+
+    void onSample(const DioSample &sample) override;
+
+   private:
+    struct WatchedPin {
+        int pin;
+        uint8_t rawBit;
+        bool invert;
+    };
+
+    struct Watch {
+        int handle;
+        int dio;
+        uint64_t rawMask;
+        bool rising;
+        bool falling;
+        std::vector<WatchedPin> pins;
+        rs::DioCallback callback;
+    };
+
+    // Callbacks run with the lock held so a watch can't be detached while
+    // it's being dispatched. Attaching or detaching from inside a callback
+    // isn't allowed for the same reason.
+    std::mutex m_mutex;
+    std::vector<Watch> m_watches;
+    int m_nextHandle;
+};
+
+#endif  // EDGEDISPATCHER_H
@@ -0,0 +1,174 @@
+#include "pinpacker.h"
+
+#include "diosampler.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <cpuid.h>
+#include <immintrin.h>
+#include <string.h>
+
+// pext and pdep are microcoded on AMD before Zen 3, where they take up to
+// a few hundred cycles depending on the mask and lose to the table lookup.
+// Those are family 0x17, and 0x18 for the Hygon parts based on Zen.
+static bool hasSlowBmi2()
+{
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx)) return false;
+
+    char vendor[12];
+    memcpy(vendor, &ebx, 4);
+    memcpy(vendor + 4, &edx, 4);
+    memcpy(vendor + 8, &ecx, 4);
+    if (memcmp(vendor, "AuthenticAMD", 12) != 0 &&
+        memcmp(vendor, "HygonGenuine", 12) != 0)
+        return false;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+
+    unsigned family = (eax >> 8) & 0xf;
+    if (family == 0xf) family += (eax >> 20) & 0xff;
+    return family == 0x17 || family == 0x18;
+}
+
+static bool detectBmi2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("bmi2") && !hasSlowBmi2();
+}
+
+__attribute__((target("bmi2"))) static uint64_t moveBits(
+    uint64_t word,
+    const uint64_t *from,
+    const uint64_t *to,
+    size_t count
+)
+{
+    uint64_t result = 0;
+    for (size_t i = 0; i < count; ++i)
+        result |= _pdep_u64(_pext_u64(word, from[i]), to[i]);
+
+    return result;
+}
+#else
+static bool detectBmi2() { return false; }
+
+static uint64_t moveBits(uint64_t, const uint64_t *, const uint64_t *, size_t)
+{
+    return 0;
+}
+#endif
+
+static const bool kHasBmi2 = detectBmi2();
+
+static uint8_t highestBit(uint64_t mask)
+{
+    uint8_t bit = 0;
+    while (mask >>= 1) ++bit;
+    return bit;
+}
+
+PinPacker::PinPacker()
+    : m_useBmi2(false), m_rawMask(0), m_pinMask(0), m_invertMask(0)
+{
+}
+
+PinPacker::PinPacker(const pinconfigmap_t &pins, bool allowBmi2)
+    : m_useBmi2(allowBmi2 && kHasBmi2),
+      m_rawMask(0),
+      m_pinMask(0),
+      m_invertMask(0)
+{
+    // Pins that don't fit in either word are left out. The output mode pins
+    // have negative ids and never show up here.
+    uint8_t pinOf[64];
+    for (const auto &pair : pins) {
+        if (pair.first < 0 || pair.first > 63) continue;
+        if (pair.second.offset >= kMaxGpioSets) continue;
+
+        uint8_t bit = rawBit(pair.second);
+        pinOf[bit] = pair.first;
+        m_rawMask |= 1ULL << bit;
+        m_pinMask |= 1ULL << pair.first;
+        if (pair.second.invert) m_invertMask |= 1ULL << pair.first;
+    }
+
+    // Walk the register bits in order and put each pin in the first group
+    // whose pins are all below it, so every group keeps both orders the same.
+    for (uint8_t bit = 0; bit < 64; ++bit) {
+        if (!(m_rawMask & (1ULL << bit))) continue;
+
+        uint8_t pin = pinOf[bit];
+        size_t group = 0;
+        while (group < m_groupPins.size() &&
+               highestBit(m_groupPins[group]) > pin)
+            ++group;
+
+        if (group == m_groupPins.size()) {
+            m_groupRaw.push_back(0);
+            m_groupPins.push_back(0);
+        }
+        m_groupRaw[group] |= 1ULL << bit;
+        m_groupPins[group] |= 1ULL << pin;
+
+        addTable(m_packTables, bit / 8, bit % 8, 1ULL << pin);
+        addTable(m_unpackTables, pin / 8, pin % 8, 1ULL << bit);
+    }
+}
+
+void PinPacker::addTable(
+    std::vector<ByteTable> &tables,
+    uint8_t byte,
+    uint8_t bit,
+    uint64_t target
+)
+{
+    ByteTable *table = nullptr;
+    for (ByteTable &existing : tables) {
+        if (existing.shift == byte * 8) table = &existing;
+    }
+
+    if (!table) {
+        tables.emplace_back();
+        table = &tables.back();
+        table->shift = byte * 8;
+        for (int value = 0; value < 256; ++value) table->bits[value] = 0;
+    }
+
+    for (int value = 0; value < 256; ++value) {
+        if (value & (1 << bit)) table->bits[value] |= target;
+    }
+}
+
+uint64_t PinPacker::lookup(const std::vector<ByteTable> &tables, uint64_t word)
+{
+    uint64_t result = 0;
+    for (const ByteTable &table : tables)
+        result |= table.bits[(word >> table.shift) & 0xff];
+
+    return result;
+}
+
+uint64_t PinPacker::pack(uint64_t raw) const
+{
+    uint64_t states = m_useBmi2 ? moveBits(
+                                      raw,
+                                      m_groupRaw.data(),
+                                      m_groupPins.data(),
+                                      m_groupRaw.size()
+                                  )
+                                : lookup(m_packTables, raw);
+
+    return states ^ m_invertMask;
+}
+
+uint64_t PinPacker::unpack(uint64_t states) const
+{
+    states ^= m_invertMask;
+
+    if (m_useBmi2)
+        return moveBits(
+            states, m_groupPins.data(), m_groupRaw.data(), m_groupPins.size()
+        );
+
+    return lookup(m_unpackTables, states);
+}
@@ -0,0 +1,63 @@
+#ifndef PINPACKER_H
+#define PINPACKER_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "controllers/abstractdiocontroller.h"
+
+// Converts between a raw register word (see DioSample) and the logical state
+// word of a connector, where bit n is the state of pin n with the pin's
+// invert setting applied.
+//
+// The pin map is compiled up front. On CPUs with fast BMI2 every group of
+// pins whose register bits are in the same order as their pin numbers is
+// moved with one pext / pdep pair, which usually means one pair per
+// register. Other CPUs, including AMD before Zen 3, use one table lookup per
+// register byte instead.
+class PinPacker {
+   public:
+    PinPacker();
+    // allowBmi2 is only there so the tests can cover the table path.
+    explicit PinPacker(const pinconfigmap_t &pins, bool allowBmi2 = true);
+
+    uint64_t pack(uint64_t raw) const;
+    uint64_t unpack(uint64_t states) const;
+    // Register bits of the pins in pins, without applying invert.
+    uint64_t toRawMask(uint64_t pins) const
+    {
+        return unpack(pins ^ m_invertMask);
+    }
+
+    // Register bits and logical pins this connector uses.
+    uint64_t rawMask() const { return m_rawMask; }
+    uint64_t pinMask() const { return m_pinMask; }
+
+   private:
+    // The bits set in the other word by every value of one byte.
+    struct ByteTable {
+        uint8_t shift;
+        uint64_t bits[256];
+    };
+
+    static void addTable(
+        std::vector<ByteTable> &tables,
+        uint8_t byte,
+        uint8_t bit,
+        uint64_t target
+    );
+    static uint64_t lookup(const std::vector<ByteTable> &tables, uint64_t word);
+
+    bool m_useBmi2;
+    // Group n moves the bits in m_groupRaw[n] to the pins in m_groupPins[n].
+    std::vector<uint64_t> m_groupRaw;
+    std::vector<uint64_t> m_groupPins;
+    std::vector<ByteTable> m_packTables;
+    std::vector<ByteTable> m_unpackTables;
+    uint64_t m_rawMask;
+    uint64_t m_pinMask;
+    uint64_t m_invertMask;  // Logical pins that are inverted.
+};
+
+#endif  // PINPACKER_H
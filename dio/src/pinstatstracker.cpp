@@ -0,0 +1,81 @@
+#include "pinstatstracker.h"
+
+PinStatsTracker::PinStatsTracker()
+    : m_sampling(false), m_state(0), m_lastTimestamp(0)
+{
+    clear();
+}
+
+void PinStatsTracker::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // Time already spent at the current level is dropped as well.
+    for (int bit = 0; bit < 64; ++bit) {
+        m_transitions[bit] = 0;
+        m_levelTime[0][bit] = 0;
+        m_levelTime[1][bit] = 0;
+        m_since[bit] = m_lastTimestamp;
+        m_lastEdge[bit] = 0;
+    }
+}
+
+rs::PinStats PinStatsTracker::stats(const PinConfig &config)
+{
+    uint8_t bit = rawBit(config);
+    int level = config.invert ? 0 : 1;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint64_t levelTime[2] = {m_levelTime[0][bit], m_levelTime[1][bit]};
+    if (m_sampling)
+        levelTime[(m_state >> bit) & 1] += m_lastTimestamp - m_since[bit];
+
+    rs::PinStats s;
+    s.transitions = m_transitions[bit];
+    s.highTimeUs = levelTime[level] / 1000;
+    s.lowTimeUs = levelTime[!level] / 1000;
+    uint64_t total = levelTime[0] + levelTime[1];
+    s.dutyCycle = total > 0 ? (float)((double)levelTime[level] / total) : 0.0f;
+    s.lastChange = m_lastEdge[bit];
+    return s;
+}
+
+void PinStatsTracker::onSamplingStarted(const DioSample &sample)
+{
+    // Whatever happened while sampling was stopped isn't counted, so the
+    // levels start over from this scan.
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_sampling) closeIntervals(m_lastTimestamp);
+    for (int bit = 0; bit < 64; ++bit) m_since[bit] = sample.timestamp;
+    m_state = sample.raw;
+    m_lastTimestamp = sample.timestamp;
+    m_sampling = true;
+}
+
+void PinStatsTracker::onSample(const DioSample &sample)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_lastTimestamp = sample.timestamp;
+
+    uint64_t changed = sample.changed;
+    while (changed) {
+        int bit = __builtin_ctzll(changed);
+        changed &= changed - 1;
+
+        m_levelTime[(m_state >> bit) & 1][bit] +=
+            sample.timestamp - m_since[bit];
+        m_since[bit] = sample.timestamp;
+        m_lastEdge[bit] = sample.timestamp;
+        ++m_transitions[bit];
+    }
+    m_state = sample.raw;
+}
+
+// Called with m_mutex held. Adds the time up to timestamp to the current
+// level of every bit.
+void PinStatsTracker::closeIntervals(uint64_t timestamp)
+{
+    for (int bit = 0; bit < 64; ++bit) {
+        m_levelTime[(m_state >> bit) & 1][bit] += timestamp - m_since[bit];
+        m_since[bit] = timestamp;
+    }
+}
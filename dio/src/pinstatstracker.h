@@ -0,0 +1,42 @@
+#ifndef PINSTATSTRACKER_H
+#define PINSTATSTRACKER_H
+
+#include <stdint.h>
+
+#include <mutex>
+
+#include "../include/rsdio.h"
+#include "diosampler.h"
+
+// Keeps transition counts and time spent at each level for every bit of the
+// sampler's register snapshots.
+//
+// Nothing is done per pin on a scan without changes. On a scan with changes
+// only the bits set in the changed mask are visited, and the time since a
+// bit's last edge is added to the level it just left by indexing with the
+// old state instead of branching on it.
+class PinStatsTracker : public SampleListener {
+   public:
+    PinStatsTracker();
+
+    void clear();
+    rs::PinStats stats(const PinConfig &config);
+
+    void onSamplingStarted(const DioSample &sample) override;
+    void onSample(const DioSample &sample) override;
+
+   private:
+    void closeIntervals(uint64_t timestamp);
+
+    std::mutex m_mutex;
+    bool m_sampling;
+    uint64_t m_state;
+    uint64_t m_lastTimestamp;
+
+    uint64_t m_transitions[64];
+    uint64_t m_levelTime[2][64];  // Nanoseconds spent low / high.
+    uint64_t m_since[64];         // Start of the current level.
+    uint64_t m_lastEdge[64];
+};
+
+#endif  // PINSTATSTRACKER_H
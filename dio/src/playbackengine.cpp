@@ -0,0 +1,222 @@
+#include "playbackengine.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <system_error>
+
+constexpr int64_t PlaybackEngine::kSpinNs;
+
+typedef std::chrono::steady_clock playback_clock_t;
+
+static int64_t timestampNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               playback_clock_t::now().time_since_epoch()
+    )
+        .count();
+}
+
+PlaybackEngine::PlaybackEngine(AbstractDioController *controller)
+    : mp_controller(controller),
+      mp_steps(nullptr),
+      m_count(0),
+      mp_lateness(nullptr),
+      mp_mapping(nullptr),
+      m_mappingSize(0),
+      m_stopping(false),
+      m_running(false),
+      m_played(0),
+      m_latenessTotal(0),
+      m_latenessMax(0)
+{
+}
+
+PlaybackEngine::~PlaybackEngine() { stop(); }
+
+void PlaybackEngine::play(
+    const PinPacker &packer,
+    const rs::PlaybackStep *steps,
+    size_t count,
+    float *lateness
+)
+{
+    stop();
+    start(packer, steps, count, lateness);
+}
+
+void PlaybackEngine::playFile(
+    const PinPacker &packer,
+    const char *fileName,
+    float *lateness
+)
+{
+    stop();
+
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0) throw std::system_error(errno, std::generic_category());
+
+    struct stat info;
+    if (fstat(fd, &info) < 0) {
+        int error = errno;
+        close(fd);
+        throw std::system_error(error, std::generic_category());
+    }
+
+    size_t size = info.st_size;
+    if (size == 0 || size % sizeof(rs::PlaybackStep) != 0) {
+        close(fd);
+        throw std::system_error(
+            std::make_error_code(std::errc::invalid_argument),
+            "File doesn't hold whole playback steps"
+        );
+    }
+
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+        int error = errno;
+        close(fd);
+        throw std::system_error(error, std::generic_category());
+    }
+    close(fd);
+
+    // The steps are read front to back exactly once.
+    madvise(mapping, size, MADV_SEQUENTIAL);
+    madvise(mapping, size, MADV_WILLNEED);
+    mp_mapping = mapping;
+    m_mappingSize = size;
+
+    start(
+        packer,
+        static_cast<const rs::PlaybackStep *>(mapping),
+        size / sizeof(rs::PlaybackStep),
+        lateness
+    );
+}
+
+void PlaybackEngine::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_stopCondition.notify_all();
+
+    if (m_thread.joinable()) m_thread.join();
+    unmap();
+}
+
+rs::PlaybackStats PlaybackEngine::stats() const
+{
+    rs::PlaybackStats s;
+    s.played = m_played;
+    s.total = m_count;
+    s.running = m_running;
+
+    uint64_t played = s.played;
+    s.latenessAvgUs =
+        played > 0 ? (float)(m_latenessTotal / 1000.0 / played) : 0.0f;
+    s.latenessMaxUs = (float)(m_latenessMax / 1000.0);
+    return s;
+}
+
+void PlaybackEngine::start(
+    const PinPacker &packer,
+    const rs::PlaybackStep *steps,
+    size_t count,
+    float *lateness
+)
+{
+    m_packer = packer;
+    mp_steps = steps;
+    m_count = count;
+    mp_lateness = lateness;
+    m_stopping = false;
+    m_played = 0;
+    m_latenessTotal = 0;
+    m_latenessMax = 0;
+    m_running = true;
+    m_thread = std::thread(&PlaybackEngine::run, this);
+    // Playback works without the config, just with more lateness.
+    applyThreadConfig(m_thread, m_threadConfig);
+}
+
+std::error_code PlaybackEngine::configureThread(const rs::ThreadConfig &config)
+{
+    m_threadConfig = config;
+    if (!m_running) return std::error_code();
+
+    return applyThreadConfig(m_thread, config);
+}
+
+void PlaybackEngine::run()
+{
+    try {
+        mp_controller->acquireGpioAccess();
+    }
+    catch (...) {
+        m_running = false;
+        return;
+    }
+
+    int64_t due = timestampNow();
+    for (size_t i = 0; i < m_count; ++i) {
+        const rs::PlaybackStep &step = mp_steps[i];
+        due += (int64_t)step.deltaUs * 1000;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (due - timestampNow() > kSpinNs) {
+                playback_clock_t::time_point wake(
+                    std::chrono::nanoseconds(due - kSpinNs)
+                );
+                m_stopCondition.wait_until(lock, wake, [this] {
+                    return m_stopping;
+                });
+            }
+            if (m_stopping) break;
+        }
+
+        uint64_t mask = m_packer.toRawMask(step.mask);
+        uint64_t raw = m_packer.unpack(step.value) & mask;
+        while (timestampNow() < due) {
+        }
+
+        try {
+            for (uint8_t offset = 0; offset < kMaxGpioSets; ++offset) {
+                uint8_t registerMask = (mask >> (offset * 8)) & 0xff;
+                if (!registerMask) continue;
+
+                // Only the step's pins change, the rest of the register keeps
+                // whatever other code wrote to it in the meantime.
+                mp_controller->modifyGpioRegister(
+                    offset, registerMask, (raw >> (offset * 8)) & registerMask
+                );
+            }
+        }
+        catch (...) {
+            break;
+        }
+
+        int64_t lateness = timestampNow() - due;
+        if (mp_lateness) mp_lateness[i] = lateness / 1000.0f;
+        m_latenessTotal += lateness;
+        if (lateness > m_latenessMax) m_latenessMax = lateness;
+        ++m_played;
+    }
+
+    mp_controller->releaseGpioAccess();
+    m_running = false;
+}
+
+void PlaybackEngine::unmap()
+{
+    if (!mp_mapping) return;
+
+    munmap(mp_mapping, m_mappingSize);
+    mp_mapping = nullptr;
+    m_mappingSize = 0;
+    mp_steps = nullptr;
+}
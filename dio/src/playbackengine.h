@@ -0,0 +1,84 @@
+#ifndef PLAYBACKENGINE_H
+#define PLAYBACKENGINE_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "../../utils/threadconfig.h"
+#include "../include/rsdio.h"
+#include "controllers/abstractdiocontroller.h"
+#include "diosampler.h"
+#include "pinpacker.h"
+
+// Plays a list of timed output steps on one connector from its own thread.
+//
+// A step changes only its own pins, with one atomic modifyGpioRegister per
+// register it touches, so writes other code makes to the rest of the
+// register while playback runs are kept.
+// Like the PWM scheduler, the thread sleeps until shortly before each step
+// and spins the rest of the way. A new thread is started for every playback
+// and gets the last thread config that was set.
+class PlaybackEngine {
+   public:
+    // The last part of every wait is spent spinning instead of sleeping.
+    static constexpr int64_t kSpinNs = 100000;
+
+    explicit PlaybackEngine(AbstractDioController *controller);
+    ~PlaybackEngine();
+
+    // steps has to stay valid until playback is done or stopped. lateness
+    // can be null.
+    void play(
+        const PinPacker &packer,
+        const rs::PlaybackStep *steps,
+        size_t count,
+        float *lateness
+    );
+    // Maps fileName, which holds nothing but PlaybackSteps, and plays it.
+    // Throws std::system_error if the file can't be mapped.
+    void playFile(const PinPacker &packer, const char *fileName, float *lateness);
+    void stop();
+
+    rs::PlaybackStats stats() const;
+
+    // Applies config to the playback thread and every later one.
+    std::error_code configureThread(const rs::ThreadConfig &config);
+
+   private:
+    void start(
+        const PinPacker &packer,
+        const rs::PlaybackStep *steps,
+        size_t count,
+        float *lateness
+    );
+    void run();
+    void unmap();
+
+    AbstractDioController *mp_controller;
+    rs::ThreadConfig m_threadConfig;
+
+    PinPacker m_packer;
+    const rs::PlaybackStep *mp_steps;
+    size_t m_count;
+    float *mp_lateness;
+    void *mp_mapping;
+    size_t m_mappingSize;
+
+    std::mutex m_mutex;
+    std::condition_variable m_stopCondition;
+    bool m_stopping;
+    std::atomic<bool> m_running;
+
+    std::atomic<uint64_t> m_played;
+    std::atomic<int64_t> m_latenessTotal;
+    std::atomic<int64_t> m_latenessMax;
+
+    std::thread m_thread;
+};
+
+#endif  // PLAYBACKENGINE_H
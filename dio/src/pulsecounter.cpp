@@ -0,0 +1,181 @@
+#include "pulsecounter.h"
+
+#include <utility>
+
+const int PulseCounter::kPlanes;
+const int PulseCounter::kFoldScans;
+const int PulseCounter::kHistory;
+
+// One second unless changed.
+static const int64_t kDefaultWindow = 1000000000;
+
+PulseCounter::PulseCounter() : m_window(kDefaultWindow) { clear(); }
+
+void PulseCounter::start(const PinConfig &config, rs::Edge edge)
+{
+    uint8_t bit = rawBit(config);
+    bool rising = ((int)edge & (int)rs::Edge::Rising) != 0;
+    bool falling = ((int)edge & (int)rs::Edge::Falling) != 0;
+    // A logical rising edge on an inverted pin is a falling edge of the bit.
+    if (config.invert) std::swap(rising, falling);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    forget(bit);
+    if (rising) m_risingMask |= 1ULL << bit;
+    if (falling) m_fallingMask |= 1ULL << bit;
+    if (rising && falling) m_bothMask |= 1ULL << bit;
+}
+
+void PulseCounter::stop(const PinConfig &config)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    forget(rawBit(config));
+}
+
+bool PulseCounter::isCounting(const PinConfig &config)
+{
+    uint64_t bit = 1ULL << rawBit(config);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return ((m_risingMask | m_fallingMask) & bit) != 0;
+}
+
+void PulseCounter::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_risingMask = 0;
+    m_fallingMask = 0;
+    m_bothMask = 0;
+    for (int k = 0; k < kPlanes; ++k) m_planes[k] = 0;
+    m_pendingScans = 0;
+    for (int bit = 0; bit < 64; ++bit) m_totals[bit] = 0;
+    m_historyCount = 0;
+    m_historyNext = 0;
+    m_nextSnapshot = 0;
+    m_startTimestamp = 0;
+    m_lastTimestamp = 0;
+    m_scans = 0;
+}
+
+void PulseCounter::setWindow(int64_t window)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_window = window;
+    m_historyCount = 0;
+    m_nextSnapshot = 0;
+}
+
+rs::CounterStats PulseCounter::stats(const PinConfig &config)
+{
+    uint8_t bit = rawBit(config);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    rs::CounterStats s;
+    s.count = m_totals[bit] + pending(bit);
+    s.frequencyHz = 0.0f;
+    s.maxFrequencyHz = 0.0f;
+
+    if (m_scans > 0 && m_lastTimestamp > m_startTimestamp) {
+        // Each level of a signal has to be seen at least once.
+        double rate =
+            m_scans * 1e9 / (double)(m_lastTimestamp - m_startTimestamp);
+        s.maxFrequencyHz = (float)(rate / 2.0);
+    }
+
+    // Use the oldest snapshot that's still inside the window.
+    const Snapshot *oldest = nullptr;
+    for (int i = 0; i < m_historyCount; ++i) {
+        const Snapshot &snapshot = m_history[i];
+        if (m_lastTimestamp - snapshot.timestamp > (uint64_t)m_window)
+            continue;
+        if (!oldest || snapshot.timestamp < oldest->timestamp)
+            oldest = &snapshot;
+    }
+
+    if (oldest && m_lastTimestamp > oldest->timestamp) {
+        double edges = (double)(s.count - oldest->totals[bit]);
+        if (m_bothMask & (1ULL << bit)) edges /= 2.0;
+        s.frequencyHz = (float)(
+            edges * 1e9 / (double)(m_lastTimestamp - oldest->timestamp)
+        );
+    }
+
+    return s;
+}
+
+void PulseCounter::onSamplingStarted(const DioSample &sample)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    fold(sample.timestamp);
+    m_historyCount = 0;
+    m_nextSnapshot = 0;
+    m_startTimestamp = sample.timestamp;
+    m_lastTimestamp = sample.timestamp;
+    m_scans = 0;
+}
+
+void PulseCounter::onSample(const DioSample &sample)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint64_t edges = sample.changed & ((sample.raw & m_risingMask) |
+                                       (~sample.raw & m_fallingMask));
+
+    // Ripple-carry add of one to every counter with an edge.
+    for (int k = 0; k < kPlanes && edges; ++k) {
+        uint64_t carry = m_planes[k] & edges;
+        m_planes[k] ^= edges;
+        edges = carry;
+    }
+
+    ++m_scans;
+    m_lastTimestamp = sample.timestamp;
+    if (++m_pendingScans >= kFoldScans || sample.timestamp >= m_nextSnapshot)
+        fold(sample.timestamp);
+}
+
+// Called with m_mutex held.
+void PulseCounter::fold(uint64_t timestamp)
+{
+    uint64_t counting = m_risingMask | m_fallingMask;
+    uint64_t used = 0;
+    for (int k = 0; k < kPlanes; ++k) used |= m_planes[k];
+
+    for (uint8_t bit = 0; bit < 64 && used; ++bit) {
+        if (!(used & (1ULL << bit))) continue;
+
+        m_totals[bit] += pending(bit);
+        used &= ~(1ULL << bit);
+    }
+    for (int k = 0; k < kPlanes; ++k) m_planes[k] = 0;
+    m_pendingScans = 0;
+
+    if (timestamp < m_nextSnapshot || !counting) return;
+
+    Snapshot &snapshot = m_history[m_historyNext];
+    snapshot.timestamp = timestamp;
+    for (int bit = 0; bit < 64; ++bit) snapshot.totals[bit] = m_totals[bit];
+    m_historyNext = (m_historyNext + 1) % kHistory;
+    if (m_historyCount < kHistory) ++m_historyCount;
+    m_nextSnapshot = timestamp + m_window / (kHistory - 1);
+}
+
+// Called with m_mutex held. Returns what's in the small counter of a bit.
+uint64_t PulseCounter::pending(uint8_t bit) const
+{
+    uint64_t value = 0;
+    for (int k = 0; k < kPlanes; ++k)
+        value |= ((m_planes[k] >> bit) & 1) << k;
+
+    return value;
+}
+
+// Called with m_mutex held. Stops counting on a bit and zeroes its count.
+void PulseCounter::forget(uint8_t bit)
+{
+    uint64_t mask = ~(1ULL << bit);
+    m_risingMask &= mask;
+    m_fallingMask &= mask;
+    m_bothMask &= mask;
+    for (int k = 0; k < kPlanes; ++k) m_planes[k] &= mask;
+    m_totals[bit] = 0;
+    for (int i = 0; i < kHistory; ++i) m_history[i].totals[bit] = 0;
+}
@@ -0,0 +1,69 @@
+#ifndef PULSECOUNTER_H
+#define PULSECOUNTER_H
+
+#include <stdint.h>
+
+#include <mutex>
+
+#include "../include/rsdio.h"
+#include "diosampler.h"
+
+// Counts edges on any number of input pins from the sampler's register
+// snapshots.
+//
+// Edges are first added to bit-sliced counters (plane k holds bit k of all 64
+// counters), so one scan costs the same handful of mask operations no matter
+// how many pins count. Every kFoldScans scans, before the small counters can
+// overflow, they're added to the 64-bit totals. The totals are also kept for
+// the last window so the frequency can be worked out from them.
+class PulseCounter : public SampleListener {
+   public:
+    static const int kPlanes = 8;
+    static const int kFoldScans = (1 << kPlanes) - 1;
+    static const int kHistory = 8;
+
+    PulseCounter();
+
+    // Starts counting edges on a pin from 0. Any previous count is lost.
+    void start(const PinConfig &config, rs::Edge edge);
+    void stop(const PinConfig &config);
+    bool isCounting(const PinConfig &config);
+    void clear();
+
+    void setWindow(int64_t window);
+    rs::CounterStats stats(const PinConfig &config);
+
+    void onSamplingStarted(const DioSample &sample) override;
+    void onSample(const DioSample &sample) override;
+
+   private:
+    struct Snapshot {
+        uint64_t timestamp;
+        uint64_t totals[64];
+    };
+
+    void fold(uint64_t timestamp);
+    uint64_t pending(uint8_t bit) const;
+    void forget(uint8_t bit);
+
+    std::mutex m_mutex;
+    uint64_t m_risingMask;
+    uint64_t m_fallingMask;
+    uint64_t m_bothMask;
+
+    uint64_t m_planes[kPlanes];
+    int m_pendingScans;
+    uint64_t m_totals[64];
+
+    int64_t m_window;  // Nanoseconds
+    Snapshot m_history[kHistory];
+    int m_historyCount;
+    int m_historyNext;
+    uint64_t m_nextSnapshot;
+
+    uint64_t m_startTimestamp;
+    uint64_t m_lastTimestamp;
+    uint64_t m_scans;
+};
+
+#endif  // PULSECOUNTER_H
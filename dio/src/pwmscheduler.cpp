@@ -0,0 +1,255 @@
+#include "pwmscheduler.h"
+
+#include <limits>
+
+#include "diosampler.h"
+
+constexpr int64_t PwmScheduler::kMergeWindowNs;
+constexpr int64_t PwmScheduler::kSpinNs;
+
+static const int64_t kNever = std::numeric_limits<int64_t>::max();
+
+static int64_t timestampNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               pwm_clock_t::now().time_since_epoch()
+    )
+        .count();
+}
+
+PwmScheduler::PwmScheduler(AbstractDioController *controller)
+    : mp_controller(controller),
+      m_running(true),
+      m_edges(0),
+      m_latenessTotal(0),
+      m_latenessMax(0)
+{
+    m_thread = std::thread(&PwmScheduler::run, this);
+}
+
+PwmScheduler::~PwmScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_wakeCondition.notify_all();
+
+    if (m_thread.joinable()) m_thread.join();
+}
+
+// Every change to a PWM pin goes through the scheduling thread. Its register
+// writes only touch the channel bits and go through modifyGpioRegister, so
+// they don't undo a digitalWrite to another pin of the same register. A new
+// channel starts with an edge that is due right away.
+void PwmScheduler::startPwm(const PinConfig &config, int64_t period, float duty)
+{
+    Channel channel;
+    channel.offset = config.offset;
+    channel.bitmask = config.bitmask;
+    channel.invert = config.invert;
+    channel.period = period;
+    channel.highTime = (int64_t)(period * duty);
+    channel.hold = false;
+    channel.state = false;
+    channel.nextEdge = timestampNow();
+
+    if (duty <= 0.0f) {
+        stop(config);
+        return;
+    }
+
+    if (duty >= 1.0f) {
+        channel.period = 0;
+        channel.hold = true;
+    }
+
+    addChannel(channel);
+}
+
+void PwmScheduler::pulse(const PinConfig &config, int64_t width)
+{
+    Channel channel;
+    channel.offset = config.offset;
+    channel.bitmask = config.bitmask;
+    channel.invert = config.invert;
+    channel.period = 0;
+    channel.highTime = width;
+    channel.hold = false;
+    channel.state = false;
+    channel.nextEdge = timestampNow();
+    addChannel(channel);
+}
+
+bool PwmScheduler::stop(const PinConfig &config)
+{
+    // A stopped channel turns into one last falling edge.
+    Channel channel;
+    channel.offset = config.offset;
+    channel.bitmask = config.bitmask;
+    channel.invert = config.invert;
+    channel.period = 0;
+    channel.highTime = 0;
+    channel.hold = false;
+    channel.state = true;
+    channel.nextEdge = timestampNow();
+
+    bool found = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const Channel &existing : m_channels) {
+            if (existing.offset == config.offset &&
+                existing.bitmask == config.bitmask)
+                found = true;
+        }
+    }
+
+    addChannel(channel);
+    return found;
+}
+
+rs::PwmStats PwmScheduler::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    rs::PwmStats s;
+    s.edges = m_edges;
+    s.jitterAvgUs =
+        m_edges > 0 ? (float)(m_latenessTotal / 1000.0 / m_edges) : 0.0f;
+    s.jitterMaxUs = (float)(m_latenessMax / 1000.0);
+    return s;
+}
+
+std::error_code PwmScheduler::configureThread(const rs::ThreadConfig &config)
+{
+    return applyThreadConfig(m_thread, config);
+}
+
+void PwmScheduler::addChannel(const Channel &channel)
+{
+    // applyEdges only has bits for the first kMaxGpioSets registers, and a
+    // channel it can't apply would never advance and keep run() spinning.
+    if (channel.offset >= kMaxGpioSets) return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        removeChannel(channel.offset, channel.bitmask);
+        m_channels.push_back(channel);
+    }
+    m_wakeCondition.notify_all();
+}
+
+void PwmScheduler::removeChannel(uint8_t offset, uint8_t bitmask)
+{
+    for (auto it = m_channels.begin(); it != m_channels.end(); ++it) {
+        if (it->offset == offset && it->bitmask == bitmask) {
+            m_channels.erase(it);
+            return;
+        }
+    }
+}
+
+void PwmScheduler::run()
+{
+    try {
+        mp_controller->acquireGpioAccess();
+    }
+    catch (...) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_running) {
+        int64_t next = kNever;
+        for (const Channel &channel : m_channels) {
+            if (channel.nextEdge < next) next = channel.nextEdge;
+        }
+
+        if (next == kNever) {
+            m_wakeCondition.wait(lock);
+            continue;
+        }
+
+        // Sleep through most of the wait and start over in case the channels
+        // changed in the meantime.
+        if (next - timestampNow() > kSpinNs) {
+            pwm_clock_t::time_point wake(
+                std::chrono::nanoseconds(next - kSpinNs)
+            );
+            m_wakeCondition.wait_until(lock, wake);
+            continue;
+        }
+
+        lock.unlock();
+        while (timestampNow() < next) {
+        }
+        lock.lock();
+
+        if (m_running) applyEdges(timestampNow());
+    }
+
+    lock.unlock();
+    mp_controller->releaseGpioAccess();
+}
+
+// Called with m_mutex held.
+void PwmScheduler::applyEdges(int64_t now)
+{
+    uint8_t setBits[kMaxGpioSets] = {0};
+    uint8_t clearBits[kMaxGpioSets] = {0};
+    uint8_t touched = 0;
+
+    for (auto it = m_channels.begin(); it != m_channels.end();) {
+        Channel &channel = *it;
+        if (channel.nextEdge > now + kMergeWindowNs) {
+            ++it;
+            continue;
+        }
+
+        int64_t lateness = now - channel.nextEdge;
+        if (lateness < 0) lateness = 0;
+        ++m_edges;
+        m_latenessTotal += lateness;
+        if (lateness > m_latenessMax) m_latenessMax = lateness;
+
+        channel.state = !channel.state;
+        if (channel.state != channel.invert)
+            setBits[channel.offset] |= channel.bitmask;
+        else
+            clearBits[channel.offset] |= channel.bitmask;
+        touched |= 1 << channel.offset;
+
+        if (channel.period > 0) {
+            // If the thread fell behind, restart the waveform from now
+            // instead of firing a burst of late edges.
+            channel.nextEdge += channel.state
+                                    ? channel.highTime
+                                    : channel.period - channel.highTime;
+            if (channel.nextEdge < now) channel.nextEdge = now;
+            ++it;
+        }
+        else if (channel.hold) {
+            channel.nextEdge = kNever;
+            ++it;
+        }
+        else if (channel.state) {
+            channel.nextEdge += channel.highTime;
+            ++it;
+        }
+        else {
+            // The falling edge of a pulse or a stopped channel.
+            it = m_channels.erase(it);
+        }
+    }
+
+    for (uint8_t offset = 0; offset < kMaxGpioSets; ++offset) {
+        if (!(touched & (1 << offset))) continue;
+
+        try {
+            mp_controller->modifyGpioRegister(
+                offset, clearBits[offset] | setBits[offset], setBits[offset]
+            );
+        }
+        catch (...) {
+        }
+    }
+}
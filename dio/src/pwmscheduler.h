@@ -0,0 +1,79 @@
+#ifndef PWMSCHEDULER_H
+#define PWMSCHEDULER_H
+
+#include <stdint.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../../utils/threadconfig.h"
+#include "../include/rsdio.h"
+#include "controllers/abstractdiocontroller.h"
+
+typedef std::chrono::steady_clock pwm_clock_t;
+
+// Generates PWM signals and single pulses on output pins from one thread.
+//
+// The thread sleeps until shortly before the next edge and spins the rest of
+// the way, since a plain sleep overshoots by far more than a PWM period can
+// tolerate. Every edge that is due at the same time is merged per GPIO
+// register so each register is written once per edge no matter how many of
+// its pins change.
+class PwmScheduler {
+   public:
+    // Edges closer together than this are handled as one.
+    static constexpr int64_t kMergeWindowNs = 2000;
+    // The last part of every wait is spent spinning instead of sleeping.
+    static constexpr int64_t kSpinNs = 100000;
+
+    explicit PwmScheduler(AbstractDioController *controller);
+    ~PwmScheduler();
+
+    // period and width are in nanoseconds. A duty cycle of 0 or 1 simply
+    // holds the pin low or high. Pins outside the first kMaxGpioSets
+    // registers are ignored.
+    void startPwm(const PinConfig &config, int64_t period, float duty);
+    void pulse(const PinConfig &config, int64_t width);
+    // Removes any PWM or pulse on the pin and drives it low.
+    bool stop(const PinConfig &config);
+
+    rs::PwmStats stats() const;
+
+    // Applies config to the background thread.
+    std::error_code configureThread(const rs::ThreadConfig &config);
+
+   private:
+    struct Channel {
+        uint8_t offset;
+        uint8_t bitmask;
+        bool invert;
+        int64_t period;  // 0 for a single pulse
+        int64_t highTime;
+        bool hold;         // Stay high after the first edge
+        int64_t nextEdge;  // Monotonic time in nanoseconds
+        bool state;        // Logical state of the pin
+    };
+
+    void run();
+    void addChannel(const Channel &channel);
+    void removeChannel(uint8_t offset, uint8_t bitmask);
+    void applyEdges(int64_t now);
+
+    AbstractDioController *mp_controller;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wakeCondition;
+    std::vector<Channel> m_channels;
+    bool m_running;
+
+    uint64_t m_edges;
+    int64_t m_latenessTotal;
+    int64_t m_latenessMax;
+
+    std::thread m_thread;
+};
+
+#endif  // PWMSCHEDULER_H
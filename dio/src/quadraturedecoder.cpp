@@ -0,0 +1,149 @@
+#include "quadraturedecoder.h"
+
+// Step for every previous (high two bits) and current state of a pair, A
+// being the high bit of a state. A leading B counts up. 2 marks both pins
+// changing at once, where the direction can't be known.
+static const int8_t kMissed = 2;
+static const int8_t kSteps[16] = {
+    // to: 00 01 10 11
+    0, -1, 1, kMissed,  // from 00
+    1, 0, kMissed, -1,  // from 01
+    -1, kMissed, 0, 1,  // from 10
+    kMissed, 1, -1, 0   // from 11
+};
+
+QuadratureDecoder::QuadratureDecoder()
+    : m_rawMask(0),
+      m_pendingStart(false),
+      m_startTimestamp(0),
+      m_lastTimestamp(0),
+      m_scans(0)
+{
+}
+
+void QuadratureDecoder::add(
+    const std::string &name,
+    const PinConfig &a,
+    const PinConfig &b
+)
+{
+    Encoder encoder;
+    encoder.bitA = rawBit(a);
+    encoder.bitB = rawBit(b);
+    encoder.invertA = a.invert;
+    encoder.invertB = b.invert;
+    encoder.started = false;
+    encoder.state = 0;
+    encoder.position = 0;
+    encoder.direction = 0;
+    encoder.errors = 0;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_encoders[name] = encoder;
+    updateMask();
+    m_pendingStart = true;
+}
+
+bool QuadratureDecoder::remove(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    bool found = m_encoders.erase(name) > 0;
+    updateMask();
+    return found;
+}
+
+bool QuadratureDecoder::reset(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_encoders.find(name);
+    if (it == m_encoders.end()) return false;
+
+    it->second.position = 0;
+    it->second.direction = 0;
+    it->second.errors = 0;
+    return true;
+}
+
+bool QuadratureDecoder::stats(const std::string &name, rs::EncoderStats &stats)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_encoders.find(name);
+    if (it == m_encoders.end()) return false;
+
+    stats.position = it->second.position;
+    stats.direction = it->second.direction;
+    stats.errors = it->second.errors;
+
+    // At most one step can be seen per scan.
+    uint64_t elapsed = m_lastTimestamp - m_startTimestamp;
+    stats.maxCountRate = elapsed > 0 ? (float)(m_scans * 1e9 / elapsed) : 0.0f;
+    return true;
+}
+
+void QuadratureDecoder::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_encoders.clear();
+    updateMask();
+}
+
+void QuadratureDecoder::onSamplingStarted(const DioSample &sample)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto &pair : m_encoders) {
+        pair.second.state = readState(pair.second, sample.raw);
+        pair.second.started = true;
+    }
+    m_pendingStart = false;
+
+    m_startTimestamp = sample.timestamp;
+    m_lastTimestamp = sample.timestamp;
+    m_scans = 0;
+}
+
+void QuadratureDecoder::onSample(const DioSample &sample)
+{
+    ++m_scans;
+    m_lastTimestamp = sample.timestamp;
+    if (!(sample.changed & m_rawMask) && !m_pendingStart) return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto &pair : m_encoders) {
+        Encoder &encoder = pair.second;
+        uint8_t state = readState(encoder, sample.raw);
+        if (!encoder.started) {
+            encoder.state = state;
+            encoder.started = true;
+            continue;
+        }
+
+        int8_t step = kSteps[encoder.state << 2 | state];
+        encoder.state = state;
+        if (step == kMissed) {
+            ++encoder.errors;
+        }
+        else if (step != 0) {
+            encoder.position += step;
+            encoder.direction = step;
+        }
+    }
+    m_pendingStart = false;
+}
+
+uint8_t QuadratureDecoder::readState(const Encoder &encoder, uint64_t raw)
+    const
+{
+    uint8_t a = ((raw >> encoder.bitA) & 1) ^ encoder.invertA;
+    uint8_t b = ((raw >> encoder.bitB) & 1) ^ encoder.invertB;
+    return a << 1 | b;
+}
+
+// Called with m_mutex held.
+void QuadratureDecoder::updateMask()
+{
+    uint64_t mask = 0;
+    for (const auto &pair : m_encoders)
+        mask |= 1ULL << pair.second.bitA | 1ULL << pair.second.bitB;
+
+    m_rawMask = mask;
+}
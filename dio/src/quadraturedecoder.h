@@ -0,0 +1,61 @@
+#ifndef QUADRATUREDECODER_H
+#define QUADRATUREDECODER_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "../include/rsdio.h"
+#include "diosampler.h"
+
+// Decodes quadrature encoders wired to pairs of input pins from the
+// sampler's register snapshots.
+//
+// Every change of either pin is looked up in a 16 entry table indexed by the
+// previous and current state of the pair, which gives the step (+1, -1 or 0)
+// or flags a missed step when both pins changed between two samples. Scans
+// that don't touch any encoder pin cost a single AND.
+class QuadratureDecoder : public SampleListener {
+   public:
+    QuadratureDecoder();
+
+    // Replaces any encoder with the same name and starts it at position 0.
+    void add(const std::string &name, const PinConfig &a, const PinConfig &b);
+    bool remove(const std::string &name);
+    bool reset(const std::string &name);
+    bool stats(const std::string &name, rs::EncoderStats &stats);
+    void clear();
+
+    void onSamplingStarted(const DioSample &sample) override;
+    void onSample(const DioSample &sample) override;
+
+   private:
+    struct Encoder {
+        uint8_t bitA;
+        uint8_t bitB;
+        bool invertA;
+        bool invertB;
+        bool started;   // state holds a sampled value
+        uint8_t state;  // A << 1 | B
+        int64_t position;
+        int direction;
+        uint64_t errors;
+    };
+
+    uint8_t readState(const Encoder &encoder, uint64_t raw) const;
+    void updateMask();
+
+    std::mutex m_mutex;
+    std::map<std::string, Encoder> m_encoders;
+    std::atomic<uint64_t> m_rawMask;
+    std::atomic<bool> m_pendingStart;
+
+    std::atomic<uint64_t> m_startTimestamp;
+    std::atomic<uint64_t> m_lastTimestamp;
+    std::atomic<uint64_t> m_scans;
+};
+
+#endif  // QUADRATUREDECODER_H
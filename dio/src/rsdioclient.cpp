@@ -0,0 +1,567 @@
+#include "rsdioclient.h"
+
+#include <string.h>
+
+#include "../../error/include/rserrors.h"
+#include "../../utils/errorcapture.h"
+
+static_assert(
+    rs::kMaxDios == kIodMaxDios,
+    "A DioSnapshot has to fit in the shared memory"
+);
+
+RsDioClient *RsDioClient::connect(const std::string &socketPath)
+{
+    IodConnection *connection = IodConnection::open(socketPath);
+    if (!connection) return nullptr;
+
+    if (!connection->state().layout.hasDio) {
+        delete connection;
+        return nullptr;
+    }
+
+    return new RsDioClient(connection);
+}
+
+RsDioClient::RsDioClient(IodConnection *connection)
+    : m_connection(connection), m_lastError(), m_lastErrorString()
+{
+}
+
+void RsDioClient::destroy() { delete this; }
+
+void RsDioClient::setXmlFile(const char *fileName, bool)
+{
+    m_lastError = iodCheckXmlFile(
+        fileName,
+        m_connection->state().layout.dioFile,
+        &m_lastErrorString.get()
+    );
+}
+
+rs::diomap_t RsDioClient::getPinList() const
+{
+    const IodLayout &layout = m_connection->state().layout;
+    rs::diomap_t dios;
+    for (int dio = 0; dio < kIodMaxDios; ++dio) {
+        uint64_t pins = layout.inputs[dio] | layout.outputs[dio];
+        if (!pins) continue;
+
+        rs::pinmap_t &pinMap = dios[dio];
+        for (int pin = 0; pin < 64; ++pin) {
+            if (!(pins & (1ULL << pin))) continue;
+            pinMap[pin] = rs::PinInfo(
+                (layout.inputs[dio] >> pin) & 1,
+                (layout.outputs[dio] >> pin) & 1
+            );
+        }
+    }
+
+    return dios;
+}
+
+bool RsDioClient::canSetOutputMode(int dio)
+{
+    const IodLayout &layout = m_connection->state().layout;
+    if (dio < 0 || dio >= kIodMaxDios ||
+        !(layout.inputs[dio] | layout.outputs[dio])) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid DIO";
+        return false;
+    }
+
+    m_lastError = std::error_code();
+    return (layout.outputModes >> dio) & 1;
+}
+
+void RsDioClient::setOutputMode(int dio, rs::OutputMode mode)
+{
+    IodRequest request = {};
+    request.target = dio;
+    request.arg = static_cast<int32_t>(mode);
+    int64_t value;
+    m_lastError = call(
+        IodCommand::SetOutputMode, request, value, &m_lastErrorString.get()
+    );
+}
+
+rs::OutputMode RsDioClient::getOutputMode(int dio)
+{
+    IodRequest request = {};
+    request.target = dio;
+    int64_t value = static_cast<int64_t>(rs::OutputMode::Sink);
+    m_lastError = call(
+        IodCommand::GetOutputMode, request, value, &m_lastErrorString.get()
+    );
+    return static_cast<rs::OutputMode>(value);
+}
+
+bool RsDioClient::digitalRead(int dio, int pin, bool bypassCache)
+{
+    bool state = false;
+    m_lastError =
+        readPin(dio, pin, bypassCache, state, &m_lastErrorString.get());
+    return state;
+}
+
+rs::Result<bool> RsDioClient::digitalReadEx(int dio, int pin, bool bypassCache)
+{
+    bool state = false;
+    std::error_code error = readPin(dio, pin, bypassCache, state, nullptr);
+    if (error) return error;
+    return state;
+}
+
+void RsDioClient::digitalWrite(int dio, int pin, bool state)
+{
+    m_lastError = writePin(dio, pin, state, &m_lastErrorString.get());
+}
+
+rs::Result<void> RsDioClient::digitalWriteEx(int dio, int pin, bool state)
+{
+    return writePin(dio, pin, state, nullptr);
+}
+
+void RsDioClient::setPinDirection(int dio, int pin, rs::PinDirection dir)
+{
+    m_lastError = writePinDirection(dio, pin, dir, &m_lastErrorString.get());
+}
+
+rs::Result<void>
+RsDioClient::setPinDirectionEx(int dio, int pin, rs::PinDirection dir)
+{
+    return writePinDirection(dio, pin, dir, nullptr);
+}
+
+rs::PinDirection RsDioClient::getPinDirection(int dio, int pin)
+{
+    rs::PinDirection dir = rs::PinDirection::Input;
+    m_lastError = readPinDirection(dio, pin, dir, &m_lastErrorString.get());
+    return dir;
+}
+
+rs::Result<rs::PinDirection> RsDioClient::getPinDirectionEx(int dio, int pin)
+{
+    rs::PinDirection dir = rs::PinDirection::Input;
+    std::error_code error = readPinDirection(dio, pin, dir, nullptr);
+    if (error) return error;
+    return dir;
+}
+
+std::map<int, bool> RsDioClient::readAll(int dio)
+{
+    std::map<int, bool> values;
+    if (dio < 0 || dio >= kIodMaxDios) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid DIO";
+        return values;
+    }
+
+    rs::DioSnapshot snapshot;
+    m_lastError = readSnapshot(snapshot, &m_lastErrorString.get());
+    if (m_lastError.get()) return values;
+
+    if (!snapshot.valid[dio]) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid DIO";
+        return values;
+    }
+
+    for (int pin = 0; pin < 64; ++pin) {
+        if (snapshot.valid[dio] & (1ULL << pin))
+            values[pin] = (snapshot.states[dio] >> pin) & 1;
+    }
+
+    return values;
+}
+
+rs::DioSnapshot RsDioClient::readAllPacked()
+{
+    rs::DioSnapshot snapshot = {};
+    m_lastError = readSnapshot(snapshot, &m_lastErrorString.get());
+    return snapshot;
+}
+
+rs::Result<rs::DioSnapshot> RsDioClient::readAllPackedEx()
+{
+    rs::DioSnapshot snapshot = {};
+    std::error_code error = readSnapshot(snapshot, nullptr);
+    if (error) return error;
+    return snapshot;
+}
+
+uint64_t RsDioClient::readGroup(const char *name)
+{
+    uint64_t value = 0;
+    m_lastError = readGroupValue(name, value, &m_lastErrorString.get());
+    return value;
+}
+
+rs::Result<uint64_t> RsDioClient::readGroupEx(const char *name)
+{
+    uint64_t value = 0;
+    std::error_code error = readGroupValue(name, value, nullptr);
+    if (error) return error;
+    return value;
+}
+
+void RsDioClient::writeGroup(const char *name, uint64_t value)
+{
+    m_lastError = writeGroupValue(name, value, &m_lastErrorString.get());
+}
+
+rs::Result<void> RsDioClient::writeGroupEx(const char *name, uint64_t value)
+{
+    return writeGroupValue(name, value, nullptr);
+}
+
+void RsDioClient::startSampling(int) { notSupported(); }
+
+void RsDioClient::stopSampling() { notSupported(); }
+
+int RsDioClient::attachCallback(int, int, rs::Edge, rs::DioCallback)
+{
+    notSupported();
+    return -1;
+}
+
+int RsDioClient::attachConnectorCallback(
+    int,
+    uint64_t,
+    rs::Edge,
+    rs::DioCallback
+)
+{
+    notSupported();
+    return -1;
+}
+
+void RsDioClient::detachCallback(int) { notSupported(); }
+
+void RsDioClient::setDebounce(int, int, rs::DebounceMode, int)
+{
+    notSupported();
+}
+
+void RsDioClient::startCapture(int, int, rs::DioRecord *, size_t)
+{
+    notSupported();
+}
+
+void RsDioClient::stopCapture() { notSupported(); }
+
+size_t RsDioClient::readCapture(rs::DioRecord *, size_t)
+{
+    notSupported();
+    return 0;
+}
+
+rs::DioCaptureStats RsDioClient::getCaptureStats()
+{
+    notSupported();
+    return rs::DioCaptureStats();
+}
+
+void RsDioClient::startPwm(int, int, int, float) { notSupported(); }
+
+void RsDioClient::stopPwm(int, int) { notSupported(); }
+
+void RsDioClient::pulse(int, int, int) { notSupported(); }
+
+rs::PwmStats RsDioClient::getPwmStats()
+{
+    notSupported();
+    return rs::PwmStats();
+}
+
+void RsDioClient::startPlayback(int, const rs::PlaybackStep *, size_t, float *)
+{
+    notSupported();
+}
+
+void RsDioClient::startPlaybackFile(int, const char *, float *)
+{
+    notSupported();
+}
+
+void RsDioClient::stopPlayback() { notSupported(); }
+
+rs::PlaybackStats RsDioClient::getPlaybackStats()
+{
+    notSupported();
+    return rs::PlaybackStats();
+}
+
+void RsDioClient::setWriteCombining(bool, int) { notSupported(); }
+
+void RsDioClient::flush() { notSupported(); }
+
+void RsDioClient::startCounter(int, int, rs::Edge) { notSupported(); }
+
+void RsDioClient::stopCounter(int, int) { notSupported(); }
+
+rs::CounterStats RsDioClient::getCounterStats(int, int)
+{
+    notSupported();
+    return rs::CounterStats();
+}
+
+void RsDioClient::setCounterWindow(int) { notSupported(); }
+
+void RsDioClient::addEncoder(const char *, int, int, int) { notSupported(); }
+
+void RsDioClient::removeEncoder(const char *) { notSupported(); }
+
+void RsDioClient::resetEncoder(const char *) { notSupported(); }
+
+rs::EncoderStats RsDioClient::getEncoderStats(const char *)
+{
+    notSupported();
+    return rs::EncoderStats();
+}
+
+rs::PinStats RsDioClient::getPinStats(int, int)
+{
+    notSupported();
+    return rs::PinStats();
+}
+
+std::map<int, rs::PinStats> RsDioClient::getAllPinStats(int)
+{
+    notSupported();
+    return std::map<int, rs::PinStats>();
+}
+
+void RsDioClient::resetPinStats() { notSupported(); }
+
+void RsDioClient::setThreadConfig(const rs::ThreadConfig &) { notSupported(); }
+
+rs::JitterReport RsDioClient::getJitterReport()
+{
+    notSupported();
+    return rs::JitterReport();
+}
+
+int RsDioClient::getPinHandle(int, int)
+{
+    notSupported();
+    return -1;
+}
+
+std::error_code RsDioClient::rtAttachThread(bool) noexcept
+{
+    return std::make_error_code(std::errc::function_not_supported);
+}
+
+void RsDioClient::rtDetachThread() noexcept {}
+
+std::error_code RsDioClient::rtReadPin(int, bool &) noexcept
+{
+    return std::make_error_code(std::errc::function_not_supported);
+}
+
+std::error_code RsDioClient::rtWritePin(int, bool) noexcept
+{
+    return std::make_error_code(std::errc::function_not_supported);
+}
+
+std::error_code RsDioClient::rtReadPacked(int, uint64_t &) noexcept
+{
+    return std::make_error_code(std::errc::function_not_supported);
+}
+
+std::error_code RsDioClient::rtWritePacked(int, uint64_t, uint64_t) noexcept
+{
+    return std::make_error_code(std::errc::function_not_supported);
+}
+
+void RsDioClient::setReadCacheMaxAge(int) { notSupported(); }
+
+rs::ReadCacheStats RsDioClient::getReadCacheStats()
+{
+    notSupported();
+    return rs::ReadCacheStats();
+}
+
+std::error_code RsDioClient::getLastError() const { return m_lastError; }
+
+std::string RsDioClient::getLastErrorString() const
+{
+    const std::error_code &error = m_lastError;
+    if (error) return m_lastErrorString;
+    return std::string();
+}
+
+std::error_code RsDioClient::call(
+    IodCommand command,
+    IodRequest &request,
+    int64_t &value,
+    std::string *what
+)
+{
+    IodResponse response;
+    std::error_code error = m_connection->call(command, request, response);
+    if (error) return failWith(error, "Lost the connection to rsiod", what);
+
+    error = iodDecodeError(response);
+    if (error) {
+        if (what) *what = response.message;
+        return error;
+    }
+
+    value = response.value;
+    return std::error_code();
+}
+
+// Pins that aren't published, such as the output mode pins, and reads that
+// bypass the cache are left to the daemon, as is reporting invalid pins.
+std::error_code RsDioClient::readPin(
+    int dio,
+    int pin,
+    bool bypassCache,
+    bool &state,
+    std::string *what
+)
+{
+    if (!bypassCache && isPublished(dio, pin)) {
+        IodDioData data;
+        if (iodRead(m_connection->state().dio, data) && data.timestamp) {
+            state = (data.states[dio] >> pin) & 1;
+            return std::error_code();
+        }
+    }
+
+    IodRequest request = {};
+    request.target = dio;
+    request.pin = pin;
+    request.arg = bypassCache;
+    int64_t value = 0;
+    std::error_code error = call(IodCommand::DigitalRead, request, value, what);
+    if (!error) state = value != 0;
+    return error;
+}
+
+std::error_code
+RsDioClient::writePin(int dio, int pin, bool state, std::string *what)
+{
+    IodRequest request = {};
+    request.target = dio;
+    request.pin = pin;
+    request.arg = state;
+    int64_t value;
+    return call(IodCommand::DigitalWrite, request, value, what);
+}
+
+std::error_code RsDioClient::readPinDirection(
+    int dio,
+    int pin,
+    rs::PinDirection &dir,
+    std::string *what
+)
+{
+    IodRequest request = {};
+    request.target = dio;
+    request.pin = pin;
+    int64_t value = 0;
+    std::error_code error =
+        call(IodCommand::GetPinDirection, request, value, what);
+    if (!error) dir = static_cast<rs::PinDirection>(value);
+    return error;
+}
+
+std::error_code RsDioClient::writePinDirection(
+    int dio,
+    int pin,
+    rs::PinDirection dir,
+    std::string *what
+)
+{
+    IodRequest request = {};
+    request.target = dio;
+    request.pin = pin;
+    request.arg = static_cast<int32_t>(dir);
+    int64_t value;
+    return call(IodCommand::SetPinDirection, request, value, what);
+}
+
+std::error_code
+RsDioClient::readSnapshot(rs::DioSnapshot &snapshot, std::string *what)
+{
+    IodDioData data;
+    if (!iodRead(m_connection->state().dio, data)) {
+        return failWith(
+            std::make_error_code(std::errc::resource_unavailable_try_again),
+            "rsiod stopped publishing the pin states",
+            what
+        );
+    }
+
+    if (!data.timestamp) {
+        return failWith(
+            std::make_error_code(std::errc::resource_unavailable_try_again),
+            "rsiod hasn't scanned the pins yet",
+            what
+        );
+    }
+
+    memcpy(snapshot.states, data.states, sizeof(snapshot.states));
+    memcpy(snapshot.valid, data.valid, sizeof(snapshot.valid));
+    return std::error_code();
+}
+
+std::error_code RsDioClient::readGroupValue(
+    const char *name,
+    uint64_t &value,
+    std::string *what
+)
+{
+    IodRequest request = {};
+    if (!name || strlen(name) >= sizeof(request.name)) {
+        return failWith(
+            std::make_error_code(std::errc::invalid_argument),
+            "Invalid group",
+            what
+        );
+    }
+
+    iodCopyString(request.name, sizeof(request.name), name);
+    int64_t result = 0;
+    std::error_code error = call(IodCommand::ReadGroup, request, result, what);
+    if (!error) value = (uint64_t)result;
+    return error;
+}
+
+std::error_code RsDioClient::writeGroupValue(
+    const char *name,
+    uint64_t value,
+    std::string *what
+)
+{
+    IodRequest request = {};
+    if (!name || strlen(name) >= sizeof(request.name)) {
+        return failWith(
+            std::make_error_code(std::errc::invalid_argument),
+            "Invalid group",
+            what
+        );
+    }
+
+    iodCopyString(request.name, sizeof(request.name), name);
+    request.value = value;
+    int64_t result;
+    return call(IodCommand::WriteGroup, request, result, what);
+}
+
+bool RsDioClient::isPublished(int dio, int pin) const
+{
+    if (dio < 0 || dio >= kIodMaxDios || pin < 0 || pin > 63) return false;
+
+    const IodLayout &layout = m_connection->state().layout;
+    return ((layout.inputs[dio] | layout.outputs[dio]) >> pin) & 1;
+}
+
+void RsDioClient::notSupported()
+{
+    m_lastError = std::make_error_code(std::errc::function_not_supported);
+    m_lastErrorString = "Not available through rsiod";
+}
@@ -0,0 +1,199 @@
+#ifndef RSDIOCLIENT_H
+#define RSDIOCLIENT_H
+
+#include <memory>
+#include <string>
+
+#include "../../utils/iodprotocol.h"
+#include "../../utils/perthread.h"
+#include "../include/rsdio.h"
+
+// RsDio on top of a running rsiod, which owns the controller.
+//
+// Pin states come from the shared memory the daemon publishes every scan
+// in, so a read is a memory copy instead of bus I/O and reflects the last
+// scan. Everything that changes the hardware goes over the daemon's socket.
+// Functions that need a thread or a buffer in the calling process, such as
+// callbacks, captures, PWM and the rt functions, fail with
+// function_not_supported.
+class RsDioClient : public rs::RsDio {
+   public:
+    // Returns null if there's no daemon with DIO on socketPath.
+    static RsDioClient *connect(const std::string &socketPath);
+
+    void destroy() override;
+    // Nothing is loaded, the daemon's configuration is used. Fails with
+    // invalid_argument if fileName isn't the file the daemon serves.
+    void setXmlFile(const char *fileName, bool debug = false) override;
+
+    rs::diomap_t getPinList() const override;
+
+    bool canSetOutputMode(int dio) override;
+    void setOutputMode(int dio, rs::OutputMode mode) override;
+    rs::OutputMode getOutputMode(int dio) override;
+
+    bool digitalRead(int dio, int pin, bool bypassCache = false) override;
+    void digitalWrite(int dio, int pin, bool state) override;
+
+    void setPinDirection(int dio, int pin, rs::PinDirection dir) override;
+    rs::PinDirection getPinDirection(int dio, int pin) override;
+
+    std::map<int, bool> readAll(int dio) override;
+    rs::DioSnapshot readAllPacked() override;
+
+    uint64_t readGroup(const char *name) override;
+    void writeGroup(const char *name, uint64_t value) override;
+
+    void startSampling(int intervalUs) override;
+    void stopSampling() override;
+
+    int attachCallback(
+        int dio,
+        int pin,
+        rs::Edge edge,
+        rs::DioCallback callback
+    ) override;
+    int attachConnectorCallback(
+        int dio,
+        uint64_t pinMask,
+        rs::Edge edge,
+        rs::DioCallback callback
+    ) override;
+    void detachCallback(int handle) override;
+
+    void setDebounce(
+        int dio,
+        int pin,
+        rs::DebounceMode mode,
+        int samples
+    ) override;
+
+    void startCapture(
+        int dio,
+        int intervalUs,
+        rs::DioRecord *buffer,
+        size_t size
+    ) override;
+    void stopCapture() override;
+    size_t readCapture(rs::DioRecord *records, size_t count) override;
+    rs::DioCaptureStats getCaptureStats() override;
+
+    void startPwm(int dio, int pin, int periodUs, float duty) override;
+    void stopPwm(int dio, int pin) override;
+    void pulse(int dio, int pin, int widthUs) override;
+    rs::PwmStats getPwmStats() override;
+
+    void startPlayback(
+        int dio,
+        const rs::PlaybackStep *steps,
+        size_t count,
+        float *latenessUs
+    ) override;
+    void startPlaybackFile(
+        int dio,
+        const char *fileName,
+        float *latenessUs
+    ) override;
+    void stopPlayback() override;
+    rs::PlaybackStats getPlaybackStats() override;
+
+    void setWriteCombining(bool enabled, int windowUs) override;
+    void flush() override;
+
+    void startCounter(int dio, int pin, rs::Edge edge) override;
+    void stopCounter(int dio, int pin) override;
+    rs::CounterStats getCounterStats(int dio, int pin) override;
+    void setCounterWindow(int windowMs) override;
+
+    void addEncoder(const char *name, int dio, int pinA, int pinB) override;
+    void removeEncoder(const char *name) override;
+    void resetEncoder(const char *name) override;
+    rs::EncoderStats getEncoderStats(const char *name) override;
+
+    rs::PinStats getPinStats(int dio, int pin) override;
+    std::map<int, rs::PinStats> getAllPinStats(int dio) override;
+    void resetPinStats() override;
+
+    void setThreadConfig(const rs::ThreadConfig &config) override;
+    rs::JitterReport getJitterReport() override;
+
+    int getPinHandle(int dio, int pin) override;
+    std::error_code rtAttachThread(bool lockMemory) noexcept override;
+    void rtDetachThread() noexcept override;
+    std::error_code rtReadPin(int handle, bool &state) noexcept override;
+    std::error_code rtWritePin(int handle, bool state) noexcept override;
+    std::error_code rtReadPacked(int dio, uint64_t &states) noexcept override;
+    std::error_code rtWritePacked(
+        int dio,
+        uint64_t mask,
+        uint64_t states
+    ) noexcept override;
+
+    void setReadCacheMaxAge(int maxAgeUs) override;
+    rs::ReadCacheStats getReadCacheStats() override;
+
+    rs::Result<bool> digitalReadEx(
+        int dio,
+        int pin,
+        bool bypassCache = false
+    ) override;
+    rs::Result<void> digitalWriteEx(int dio, int pin, bool state) override;
+    rs::Result<rs::PinDirection> getPinDirectionEx(int dio, int pin) override;
+    rs::Result<void> setPinDirectionEx(
+        int dio,
+        int pin,
+        rs::PinDirection dir
+    ) override;
+    rs::Result<rs::DioSnapshot> readAllPackedEx() override;
+    rs::Result<uint64_t> readGroupEx(const char *name) override;
+    rs::Result<void> writeGroupEx(const char *name, uint64_t value) override;
+
+    std::error_code getLastError() const override;
+    std::string getLastErrorString() const override;
+
+   private:
+    explicit RsDioClient(IodConnection *connection);
+
+    // Like the cores of RsDioImpl, these return their error and only fill in
+    // what if it isn't null.
+    std::error_code call(
+        IodCommand command,
+        IodRequest &request,
+        int64_t &value,
+        std::string *what
+    );
+    std::error_code readPin(
+        int dio,
+        int pin,
+        bool bypassCache,
+        bool &state,
+        std::string *what
+    );
+    std::error_code
+    writePin(int dio, int pin, bool state, std::string *what);
+    std::error_code readPinDirection(
+        int dio,
+        int pin,
+        rs::PinDirection &dir,
+        std::string *what
+    );
+    std::error_code writePinDirection(
+        int dio,
+        int pin,
+        rs::PinDirection dir,
+        std::string *what
+    );
+    std::error_code readSnapshot(rs::DioSnapshot &snapshot, std::string *what);
+    std::error_code
+    readGroupValue(const char *name, uint64_t &value, std::string *what);
+    std::error_code
+    writeGroupValue(const char *name, uint64_t value, std::string *what);
+    bool isPublished(int dio, int pin) const;
+    void notSupported();
+
+    std::unique_ptr<IodConnection> m_connection;
+    PerThread<std::error_code> m_lastError;
+    PerThread<std::string> m_lastErrorString;
+};
+
+#endif  // RSDIOCLIENT_H
@@ -1,13 +1,22 @@
 #include "rsdioimpl.h"
 
 #include <assert.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <sys/mman.h>
 
+#include <chrono>
 #include <iostream>
+#include <limits>
+#include <thread>
 
 #include "../../error/include/rserrors.h"
+#include "../../utils/errorcapture.h"
 #include "../../utils/tinyxml2.h"
+#include "controllers/controllerregistry.h"
 #include "controllers/ite8783.h"
 #include "controllers/ite8786.h"
+#include "rsdioclient.h"
 
 #ifndef RSSDK_VERSION_STRING
 #define RSSDK_VERSION_STRING "beta"
@@ -61,6 +70,68 @@ getExternalPinInfo(const tinyxml2::XMLElement *pin, int &pinId, PinConfig &info)
     return XML_SUCCESS;
 }
 
+static tinyxml2::XMLError getDebounceInfo(
+    const tinyxml2::XMLElement *pin,
+    rs::DebounceMode &mode,
+    int &samples
+)
+{
+    using namespace tinyxml2;
+
+    mode = rs::DebounceMode::None;
+    samples = 0;
+    XMLError e = pin->QueryAttribute("debounce", &samples);
+    if (e == XML_NO_ATTRIBUTE) return XML_SUCCESS;
+    if (e != XML_SUCCESS) return e;
+    if (samples < 1 || samples > DebounceFilter::kMaxSamples)
+        return XML_WRONG_ATTRIBUTE_TYPE;
+
+    mode = rs::DebounceMode::Consecutive;
+    const char *tmp = pin->Attribute("debounce_mode");
+    if (tmp) {
+        std::string name(tmp);
+        if (name == "integrator")
+            mode = rs::DebounceMode::Integrator;
+        else if (name != "consecutive")
+            return XML_WRONG_ATTRIBUTE_TYPE;
+    }
+
+    return XML_SUCCESS;
+}
+
+// <group name="selector" pins="1,2,3,4"/> where the first pin is bit 0.
+static tinyxml2::XMLError getGroupInfo(
+    const tinyxml2::XMLElement *group,
+    int dio,
+    std::string &name,
+    GroupConfig &config
+)
+{
+    using namespace tinyxml2;
+
+    const char *tmp = group->Attribute("name");
+    if (!tmp || !*tmp) return XML_NO_ATTRIBUTE;
+    name = tmp;
+
+    tmp = group->Attribute("pins");
+    if (!tmp) return XML_NO_ATTRIBUTE;
+
+    config.dio = dio;
+    config.pins.clear();
+    while (*tmp) {
+        char *end;
+        long pin = strtol(tmp, &end, 10);
+        if (end == tmp || pin < 0 || pin > 63) return XML_WRONG_ATTRIBUTE_TYPE;
+
+        config.pins.push_back((int)pin);
+        tmp = end;
+        while (*tmp == ',' || isspace((unsigned char)*tmp)) ++tmp;
+    }
+
+    if (config.pins.empty()) return XML_WRONG_ATTRIBUTE_TYPE;
+    return XML_SUCCESS;
+}
+
 static tinyxml2::XMLError
 get8786RegData(const tinyxml2::XMLElement *reg, Ite8786::RegisterData &data)
 {
@@ -103,35 +174,114 @@ static PinMode directionToMode(rs::PinDirection dir)
                                           : PinMode::ModeOutput;
 }
 
+// Masks of GPIO registers for RegisterLock and invalidateReadCache.
+static uint8_t registerOf(const PinConfig &config)
+{
+    return config.offset < kMaxGpioSets ? 1 << config.offset : 0;
+}
+
+static uint8_t registersOf(uint64_t rawMask)
+{
+    uint8_t offsets = 0;
+    for (uint8_t offset = 0; offset < kMaxGpioSets; ++offset) {
+        if ((rawMask >> (offset * 8)) & 0xff) offsets |= 1 << offset;
+    }
+
+    return offsets;
+}
+
 RsDioImpl::RsDioImpl()
-    : m_lastError(), m_lastErrorString(), mp_controller(nullptr)
+    : m_lastError(),
+      m_lastErrorString(),
+      m_handleCount(0),
+      mp_controller(nullptr),
+      mp_sampler(nullptr),
+      m_samplerRefs(0),
+      m_samplingInterval(0),
+      m_samplingRequest(0),
+      m_captureInterval(0),
+      m_snapshots(m_packers),
+      mp_pwm(nullptr),
+      mp_writes(nullptr),
+      mp_playback(nullptr),
+      m_cacheMaxAge(0),
+      m_cacheHits(0),
+      m_cacheMisses(0)
 {
+    invalidateReadCache();
 }
 
-RsDioImpl::RsDioImpl(AbstractDioController *controller, dioconfigmap_t dioMap)
+RsDioImpl::RsDioImpl(
+    AbstractDioController *controller,
+    dioconfigmap_t dioMap,
+    groupconfigmap_t groupMap
+)
     : m_lastError(),
       m_lastErrorString(),
       m_dioMap(dioMap),
-      mp_controller(controller)
+      m_handleCount(0),
+      m_groupMap(groupMap),
+      m_controllerRef(controller),
+      mp_controller(controller),
+      mp_sampler(nullptr),
+      m_samplerRefs(0),
+      m_samplingInterval(0),
+      m_samplingRequest(0),
+      m_captureInterval(0),
+      m_snapshots(m_packers),
+      mp_pwm(nullptr),
+      mp_writes(nullptr),
+      mp_playback(nullptr),
+      m_cacheMaxAge(0),
+      m_cacheHits(0),
+      m_cacheMisses(0)
 {
+    invalidateReadCache();
     for (auto &dio : m_dioMap) {
         auto pinMap = dio.second;
         for (auto &pin : pinMap) {
             controller->initPin(pin.second);
         }
     }
+
+    compileDioMap();
 }
 
-RsDioImpl::~RsDioImpl() { delete mp_controller; }
+RsDioImpl::~RsDioImpl()
+{
+    stopSampler();
+    flushWrites();
+    delete mp_playback;
+    delete mp_pwm;
+}
 
 void RsDioImpl::destroy() { delete this; }
 
 void RsDioImpl::setXmlFile(const char *fileName, bool debug)
 {
     using namespace tinyxml2;
+    std::lock_guard<std::mutex> samplerLock(m_samplerMutex);
+    stopSampler();
+    m_samplingRequest = 0;
+    m_captureInterval = 0;
+
+    std::lock_guard<SharedMutex> lock(m_configMutex);
+    flushWrites();
+    invalidateReadCache();
+    delete mp_playback;
+    mp_playback = nullptr;
+    delete mp_pwm;
+    mp_pwm = nullptr;
+    m_edges.clear();
+    m_capture.stop();
+    m_counters.clear();
+    m_encoders.clear();
+    m_pinStats.clear();
+    m_debounce.clear();
     m_dioMap.clear();
-    if (mp_controller) delete mp_controller;
-    mp_controller = nullptr;
+    m_groupMap.clear();
+    compileDioMap();
+    releaseController();
 
     XMLDocument doc;
     if (doc.LoadFile(fileName) != XML_SUCCESS) {
@@ -168,24 +318,38 @@ void RsDioImpl::setXmlFile(const char *fileName, bool debug)
             std::cout << "XML DIO Controller ID: " << id << std::endl;
         }
 
+        // Both chips are set up through the configuration port at 0x2E.
         if (id == "ite8783") {
-            mp_controller = new Ite8783(debug);
+            m_controllerRef = ControllerRegistry::acquire(
+                "ite8783@0x2e", "", [debug]() { return new Ite8783(debug); }
+            );
         }
         else if (id == "ite8786") {
             Ite8786::RegisterList_t list;
+            std::string registers;
             XMLElement *reg = dio->FirstChildElement("register");
             for (; reg; reg = reg->NextSiblingElement("register")) {
                 Ite8786::RegisterData data;
-                if (get8786RegData(reg, data) == XML_SUCCESS)
+                if (get8786RegData(reg, data) == XML_SUCCESS) {
                     list.emplace_back(data);
+                    registers += std::to_string(data.addr) + ":" +
+                                 std::to_string(data.ldn) + ":" +
+                                 std::to_string(data.onBits) + ":" +
+                                 std::to_string(data.offBits) + ";";
+                }
             }
-            mp_controller = new Ite8786(list, debug);
+            m_controllerRef = ControllerRegistry::acquire(
+                "ite8786@0x2e",
+                registers,
+                [list, debug]() { return new Ite8786(list, debug); }
+            );
         }
         else {
             m_lastError = RsErrorCode::XmlParseError;
             m_lastErrorString = "Invalid DIO controller ID";
             return;
         }
+        mp_controller = m_controllerRef.get();
     }
     catch (const std::system_error &ex) {
         m_lastError = ex.code();
@@ -213,8 +377,7 @@ void RsDioImpl::setXmlFile(const char *fileName, bool debug)
     // Assuming it's a legit XML file...
     if (!con) {
         m_dioMap.clear();
-        delete mp_controller;
-        mp_controller = nullptr;
+        releaseController();
 
         m_lastError = std::make_error_code(std::errc::function_not_supported);
         m_lastErrorString = "DIO function not supported";
@@ -241,8 +404,42 @@ void RsDioImpl::setXmlFile(const char *fileName, bool debug)
                 if (getExternalPinInfo(ep, pinId, info) == XML_SUCCESS) {
                     mp_controller->initPin(info);
                     m_dioMap[conId][pinId] = info;
+
+                    rs::DebounceMode mode;
+                    int samples;
+                    if (getDebounceInfo(ep, mode, samples) == XML_SUCCESS &&
+                        mode != rs::DebounceMode::None &&
+                        info.offset < kMaxGpioSets)
+                        m_debounce.configure(rawBit(info), mode, samples);
                 }
             }
+
+            XMLElement *group = con->FirstChildElement("group");
+            for (; group; group = group->NextSiblingElement("group")) {
+                std::string name;
+                GroupConfig config;
+                if (getGroupInfo(group, conId, name, config) == XML_SUCCESS)
+                    m_groupMap[name] = config;
+            }
+
+            // <encoder name="conveyor" a="5" b="6"/>, after the pins it uses.
+            XMLElement *enc = con->FirstChildElement("encoder");
+            for (; enc; enc = enc->NextSiblingElement("encoder")) {
+                const char *name = enc->Attribute("name");
+                int a, b;
+                if (!name || enc->QueryAttribute("a", &a) != XML_SUCCESS ||
+                    enc->QueryAttribute("b", &b) != XML_SUCCESS ||
+                    m_dioMap.find(conId) == m_dioMap.end())
+                    continue;
+
+                const pinconfigmap_t &pins = m_dioMap.at(conId);
+                auto pinA = pins.find(a);
+                auto pinB = pins.find(b);
+                if (a >= 0 && b >= 0 && a != b && pinA != pins.end() &&
+                    pinB != pins.end() && pinA->second.offset < kMaxGpioSets &&
+                    pinB->second.offset < kMaxGpioSets)
+                    m_encoders.add(name, pinA->second, pinB->second);
+            }
         }
     }
 
@@ -251,8 +448,7 @@ void RsDioImpl::setXmlFile(const char *fileName, bool debug)
 
     if (m_dioMap.size() <= 0) {
         m_dioMap.clear();
-        delete mp_controller;
-        mp_controller = nullptr;
+        releaseController();
 
         m_lastError = RsErrorCode::XmlParseError;
         m_lastErrorString = "Found DIO connector node but no pins";
@@ -284,8 +480,7 @@ void RsDioImpl::setXmlFile(const char *fileName, bool debug)
             }
             catch (const std::system_error &ex) {
                 m_dioMap.clear();
-                delete mp_controller;
-                mp_controller = nullptr;
+                releaseController();
 
                 m_lastError = ex.code();
                 m_lastErrorString = ex.what();
@@ -293,14 +488,14 @@ void RsDioImpl::setXmlFile(const char *fileName, bool debug)
             }
             catch (const std::exception &ex) {
                 m_dioMap.clear();
-                delete mp_controller;
+                releaseController();
                 m_lastError = RsErrorCode::UnknownError;
                 m_lastErrorString = ex.what();
                 return;
             }
             catch (...) {
                 m_dioMap.clear();
-                delete mp_controller;
+                releaseController();
                 m_lastError = RsErrorCode::UnknownError;
                 m_lastErrorString = "Unknown exception occurred";
                 return;
@@ -308,11 +503,13 @@ void RsDioImpl::setXmlFile(const char *fileName, bool debug)
         }
     }
 
+    compileDioMap();
     m_lastError = std::error_code();
 }
 
 rs::diomap_t RsDioImpl::getPinList() const
 {
+    SharedLock lock(m_configMutex);
     rs::diomap_t dios;
     dioconfigmap_t::const_iterator dioIt;
     for (dioIt = m_dioMap.begin(); dioIt != m_dioMap.end(); ++dioIt) {
@@ -335,6 +532,7 @@ rs::diomap_t RsDioImpl::getPinList() const
 
 bool RsDioImpl::canSetOutputMode(int dio)
 {
+    SharedLock lock(m_configMutex);
     bool supported = false;
 
     if (m_dioMap.find(dio) == m_dioMap.end()) {
@@ -358,6 +556,7 @@ bool RsDioImpl::canSetOutputMode(int dio)
 
 void RsDioImpl::setOutputMode(int dio, rs::OutputMode mode)
 {
+    SharedLock lock(m_configMutex);
     if (mp_controller == nullptr) {
         m_lastError = RsErrorCode::NotInitialized;
         m_lastErrorString = "XML file never set";
@@ -380,13 +579,17 @@ void RsDioImpl::setOutputMode(int dio, rs::OutputMode mode)
         return;
     }
 
+    uint8_t registers =
+        registerOf(pinMap.at(modeSink)) | registerOf(pinMap.at(modeSource));
     try {
+        RegisterLock lock(this, registers);
         mp_controller->setPinState(
             pinMap.at(modeSink), (mode == rs::OutputMode::Sink)
         );
         mp_controller->setPinState(
             pinMap.at(modeSource), (mode == rs::OutputMode::Source)
         );
+        invalidateReadCache(registers);
         m_lastError = std::error_code();
     }
     catch (const std::system_error &ex) {
@@ -405,6 +608,7 @@ void RsDioImpl::setOutputMode(int dio, rs::OutputMode mode)
 
 rs::OutputMode RsDioImpl::getOutputMode(int dio)
 {
+    SharedLock lock(m_configMutex);
     rs::OutputMode mode = rs::OutputMode::Sink;
     if (mp_controller == nullptr) {
         m_lastError = RsErrorCode::NotInitialized;
@@ -466,33 +670,86 @@ rs::OutputMode RsDioImpl::getOutputMode(int dio)
     return mode;
 }
 
-bool RsDioImpl::digitalRead(int dio, int pin)
+bool RsDioImpl::digitalRead(int dio, int pin, bool bypassCache)
+{
+    bool state = false;
+    m_lastError =
+        readPin(dio, pin, bypassCache, state, &m_lastErrorString.get());
+    return state;
+}
+
+rs::Result<bool> RsDioImpl::digitalReadEx(int dio, int pin, bool bypassCache)
 {
     bool state = false;
+    std::error_code error = readPin(dio, pin, bypassCache, state, nullptr);
+    if (error) return error;
+    return state;
+}
+
+void RsDioImpl::digitalWrite(int dio, int pin, bool state)
+{
+    m_lastError = writePin(dio, pin, state, &m_lastErrorString.get());
+}
+
+rs::Result<void> RsDioImpl::digitalWriteEx(int dio, int pin, bool state)
+{
+    return writePin(dio, pin, state, nullptr);
+}
+
+void RsDioImpl::setPinDirection(int dio, int pin, rs::PinDirection dir)
+{
+    m_lastError = writePinDirection(dio, pin, dir, &m_lastErrorString.get());
+}
+
+rs::Result<void>
+RsDioImpl::setPinDirectionEx(int dio, int pin, rs::PinDirection dir)
+{
+    return writePinDirection(dio, pin, dir, nullptr);
+}
+
+rs::PinDirection RsDioImpl::getPinDirection(int dio, int pin)
+{
+    rs::PinDirection dir = rs::PinDirection::Input;
+    m_lastError = readPinDirection(dio, pin, dir, &m_lastErrorString.get());
+    return dir;
+}
+
+rs::Result<rs::PinDirection> RsDioImpl::getPinDirectionEx(int dio, int pin)
+{
+    rs::PinDirection dir = rs::PinDirection::Input;
+    std::error_code error = readPinDirection(dio, pin, dir, nullptr);
+    if (error) return error;
+    return dir;
+}
+
+std::map<int, bool> RsDioImpl::readAll(int dio)
+{
+    SharedLock lock(m_configMutex);
+    std::map<int, bool> values;
 
     if (mp_controller == nullptr) {
         m_lastError = RsErrorCode::NotInitialized;
         m_lastErrorString = "XML file never set";
-        return state;
+        return values;
     }
 
     if (m_dioMap.find(dio) == m_dioMap.end()) {
         m_lastError = std::make_error_code(std::errc::invalid_argument);
         m_lastErrorString = "Invalid DIO";
-        return state;
+        return values;
     }
 
     pinconfigmap_t pinMap = m_dioMap.at(dio);
-    if (pinMap.find(pin) == pinMap.end()) {
-        m_lastError = std::make_error_code(std::errc::invalid_argument);
-        m_lastErrorString = "Invalid pin";
-        return state;
-    }
-
-    PinConfig config = pinMap.at(pin);
 
     try {
-        state = mp_controller->getPinState(config);
+        for (const auto &pin : pinMap) {
+            if (pin.first < 0) continue;
+
+            bool state;
+            if (!getFilteredState(pin.second, state))
+                state = mp_controller->getPinState(pin.second);
+            values[pin.first] = state;
+        }
         m_lastError = std::error_code();
     }
     catch (const std::system_error &ex) {
@@ -508,11 +765,86 @@ bool RsDioImpl::digitalRead(int dio, int pin)
         m_lastErrorString = "unknown exception occured";
     }
 
-    return state;
+    return values;
 }
 
-void RsDioImpl::digitalWrite(int dio, int pin, bool state)
+rs::DioSnapshot RsDioImpl::readAllPacked()
+{
+    rs::DioSnapshot snapshot = {};
+    m_lastError = readSnapshot(snapshot, &m_lastErrorString.get());
+    return snapshot;
+}
+
+rs::Result<rs::DioSnapshot> RsDioImpl::readAllPackedEx()
+{
+    rs::DioSnapshot snapshot = {};
+    std::error_code error = readSnapshot(snapshot, nullptr);
+    if (error) return error;
+    return snapshot;
+}
+
+uint64_t RsDioImpl::readGroup(const char *name)
 {
+    uint64_t value = 0;
+    m_lastError = readGroupValue(name, value, &m_lastErrorString.get());
+    return value;
+}
+
+rs::Result<uint64_t> RsDioImpl::readGroupEx(const char *name)
+{
+    uint64_t value = 0;
+    std::error_code error = readGroupValue(name, value, nullptr);
+    if (error) return error;
+    return value;
+}
+
+void RsDioImpl::writeGroup(const char *name, uint64_t value)
+{
+    m_lastError = writeGroupValue(name, value, &m_lastErrorString.get());
+}
+
+rs::Result<void> RsDioImpl::writeGroupEx(const char *name, uint64_t value)
+{
+    return writeGroupValue(name, value, nullptr);
+}
+
+void RsDioImpl::startSampling(int intervalUs)
+{
+    std::lock_guard<std::mutex> samplerLock(m_samplerMutex);
+    if (mp_controller == nullptr) {
+        m_lastError = RsErrorCode::NotInitialized;
+        m_lastErrorString = "XML file never set";
+        return;
+    }
+
+    if (intervalUs <= 0) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid sampling interval";
+        return;
+    }
+
+    int previous = m_samplingRequest;
+    m_samplingRequest = intervalUs;
+    updateSampler();
+    if (m_lastError.get()) m_samplingRequest = previous;
+}
+
+// A running capture keeps the sampler going at its own interval.
+void RsDioImpl::stopSampling()
+{
+    std::lock_guard<std::mutex> samplerLock(m_samplerMutex);
+    m_samplingRequest = 0;
+    updateSampler();
+}
+
+void RsDioImpl::setDebounce(
+    int dio,
+    int pin,
+    rs::DebounceMode mode,
+    int samples
+)
+{
+    std::lock_guard<std::mutex> samplerLock(m_samplerMutex);
     if (mp_controller == nullptr) {
         m_lastError = RsErrorCode::NotInitialized;
         m_lastErrorString = "XML file never set";
@@ -525,40 +857,131 @@ void RsDioImpl::digitalWrite(int dio, int pin, bool state)
         return;
     }
 
-    pinconfigmap_t pinMap = m_dioMap.at(dio);
-    if (pin < 0 || pinMap.find(pin) == pinMap.end()) {
+    const pinconfigmap_t &pinMap = m_dioMap.at(dio);
+    auto it = pinMap.find(pin);
+    if (pin < 0 || it == pinMap.end() || it->second.offset >= kMaxGpioSets) {
         m_lastError = std::make_error_code(std::errc::invalid_argument);
         m_lastErrorString = "Invalid pin";
         return;
     }
 
-    PinConfig config = pinMap.at(pin);
-    if (!config.supportsOutput) {
-        m_lastError = std::make_error_code(std::errc::function_not_supported);
-        m_lastErrorString = "Pin does not support output mode";
+    if (mode != rs::DebounceMode::None &&
+        (samples < 1 || samples > DebounceFilter::kMaxSamples)) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid debounce sample count";
         return;
     }
 
-    try {
-        mp_controller->setPinState(config, state);
+    // The sampling thread owns the filter while it runs, so restart it
+    // around the change.
+    bool sampling = mp_sampler.load() != nullptr;
+    stopSampler();
+
+    {
+        std::lock_guard<SharedMutex> lock(m_configMutex);
+        m_debounce.configure(rawBit(it->second), mode, samples);
+    }
+
+    if (sampling)
+        startSampler(m_samplingInterval);
+    else
         m_lastError = std::error_code();
+}
+
+int RsDioImpl::attachCallback(
+    int dio,
+    int pin,
+    rs::Edge edge,
+    rs::DioCallback callback
+)
+{
+    if (pin < 0 || pin > 63) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid pin";
+        return -1;
     }
-    catch (const std::system_error &ex) {
-        m_lastError = ex.code();
-        m_lastErrorString = ex.what();
+
+    return attachConnectorCallback(dio, 1ULL << pin, edge, callback);
+}
+
+int RsDioImpl::attachConnectorCallback(
+    int dio,
+    uint64_t pinMask,
+    rs::Edge edge,
+    rs::DioCallback callback
+)
+{
+    SharedLock lock(m_configMutex);
+    if (mp_controller == nullptr) {
+        m_lastError = RsErrorCode::NotInitialized;
+        m_lastErrorString = "XML file never set";
+        return -1;
     }
-    catch (const std::exception &ex) {
-        m_lastError = RsErrorCode::UnknownError;
-        m_lastErrorString = ex.what();
+
+    if (m_dioMap.find(dio) == m_dioMap.end()) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid DIO";
+        return -1;
     }
-    catch (...) {
-        m_lastError = RsErrorCode::UnknownError;
-        m_lastErrorString = "unknown exception occured";
+
+    if (!callback || ((int)edge & (int)rs::Edge::Both) == 0) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid callback";
+        return -1;
+    }
+
+    const pinconfigmap_t &pinMap = m_dioMap.at(dio);
+    pinconfigmap_t pins;
+    for (int pin = 0; pin < 64; ++pin) {
+        if (!(pinMask & (1ULL << pin))) continue;
+
+        auto it = pinMap.find(pin);
+        if (it == pinMap.end()) {
+            m_lastError = std::make_error_code(std::errc::invalid_argument);
+            m_lastErrorString = "Invalid pin";
+            return -1;
+        }
+
+        if (it->second.offset >= kMaxGpioSets) {
+            m_lastError =
+                std::make_error_code(std::errc::function_not_supported);
+            m_lastErrorString = "Pin can't be sampled";
+            return -1;
+        }
+
+        pins[pin] = it->second;
+    }
+
+    if (pins.empty()) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid pin";
+        return -1;
+    }
+
+    m_lastError = std::error_code();
+    return m_edges.attach(dio, pins, edge, callback);
+}
+
+void RsDioImpl::detachCallback(int handle)
+{
+    SharedLock lock(m_configMutex);
+    if (!m_edges.detach(handle)) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid callback handle";
+        return;
     }
+
+    m_lastError = std::error_code();
 }
 
-void RsDioImpl::setPinDirection(int dio, int pin, rs::PinDirection dir)
+void RsDioImpl::startCapture(
+    int dio,
+    int intervalUs,
+    rs::DioRecord *buffer,
+    size_t size
+)
 {
+    std::lock_guard<std::mutex> samplerLock(m_samplerMutex);
     if (mp_controller == nullptr) {
         m_lastError = RsErrorCode::NotInitialized;
         m_lastErrorString = "XML file never set";
@@ -571,120 +994,900 @@ void RsDioImpl::setPinDirection(int dio, int pin, rs::PinDirection dir)
         return;
     }
 
-    pinconfigmap_t pinMap = m_dioMap.at(dio);
-    if (pin < 0 || pinMap.find(pin) == pinMap.end()) {
+    if (buffer == nullptr || size == 0) {
         m_lastError = std::make_error_code(std::errc::invalid_argument);
-        m_lastErrorString = "Invalid pin";
+        m_lastErrorString = "Invalid capture buffer";
         return;
     }
 
-    PinConfig config = pinMap.at(pin);
-    if (getPinDirection(dio, pin) == dir)
-    {
-        m_lastError = std::error_code();
+    if (intervalUs <= 0) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid sampling interval";
         return;
     }
 
-    if (!config.supportsInput || !config.supportsOutput) {
+    // The capture is fed by the sampler so it has to be stopped while the
+    // capture is reconfigured. updateSampler starts it again, at the shorter
+    // of the capture's and startSampling's intervals.
+    stopSampler();
+
+    {
+        std::lock_guard<SharedMutex> lock(m_configMutex);
+        m_capture.start(PinPacker(m_dioMap.at(dio)), buffer, size);
+    }
+
+    m_captureInterval = intervalUs;
+    updateSampler();
+    if (m_lastError.get()) {
+        {
+            std::lock_guard<SharedMutex> lock(m_configMutex);
+            m_capture.stop();
+        }
+        m_captureInterval = 0;
 
+        // Leaves the error of the capture in place.
+        std::error_code error = m_lastError;
+        std::string errorString = m_lastErrorString;
+        updateSampler();
+        m_lastError = error;
+        m_lastErrorString = errorString;
     }
-    if ((dir == rs::PinDirection::Input && !config.supportsInput) ||
-        (dir == rs::PinDirection::Output && !config.supportsOutput)) {
-        m_lastError = std::make_error_code(std::errc::function_not_supported);
+}
 
-        m_lastErrorString = "Pin does not support direction: ";
-        if (dir == rs::PinDirection::Input)
-            m_lastErrorString += "Input";
-        else
-            m_lastErrorString += "Output";
-        return;
+// Sampling started with startSampling keeps running.
+void RsDioImpl::stopCapture()
+{
+    std::lock_guard<std::mutex> samplerLock(m_samplerMutex);
+    {
+        std::lock_guard<SharedMutex> lock(m_configMutex);
+        m_capture.stop();
     }
 
-    try {
-        mp_controller->setPinMode(config, directionToMode(dir));
-        m_lastError = std::error_code();
+    m_captureInterval = 0;
+    updateSampler();
+}
+
+size_t RsDioImpl::readCapture(rs::DioRecord *records, size_t count)
+{
+    std::lock_guard<SharedMutex> lock(m_configMutex);
+    if (records == nullptr) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid record buffer";
+        return 0;
     }
-    catch (const std::system_error &ex) {
-        m_lastError = ex.code();
-        m_lastErrorString = ex.what();
+
+    m_lastError = std::error_code();
+    return m_capture.read(records, count);
+}
+
+rs::DioCaptureStats RsDioImpl::getCaptureStats()
+{
+    SharedLock lock(m_configMutex);
+    m_lastError = std::error_code();
+    return m_capture.stats();
+}
+
+// Checks everything needed to drive a pin from the PWM thread up front so
+// the thread itself never has to read the pin configuration.
+bool RsDioImpl::getInputPin(int dio, int pin, PinConfig &config)
+{
+    if (mp_controller == nullptr) {
+        m_lastError = RsErrorCode::NotInitialized;
+        m_lastErrorString = "XML file never set";
+        return false;
     }
-    catch (const std::exception &ex) {
-        m_lastError = RsErrorCode::UnknownError;
-        m_lastErrorString = ex.what();
+
+    if (m_dioMap.find(dio) == m_dioMap.end()) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid DIO";
+        return false;
     }
-    catch (...) {
-        m_lastError = RsErrorCode::UnknownError;
-        m_lastErrorString = "unknown exception occured";
+
+    const pinconfigmap_t &pinMap = m_dioMap.at(dio);
+    auto it = pinMap.find(pin);
+    if (pin < 0 || it == pinMap.end()) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid pin";
+        return false;
     }
+
+    config = it->second;
+    if (!config.supportsInput || config.offset >= kMaxGpioSets) {
+        m_lastError = std::make_error_code(std::errc::function_not_supported);
+        m_lastErrorString = "Pin does not support input mode";
+        return false;
+    }
+
+    return true;
 }
 
-rs::PinDirection RsDioImpl::getPinDirection(int dio, int pin)
+bool RsDioImpl::getOutputPin(int dio, int pin, PinConfig &config)
 {
-    rs::PinDirection dir = rs::PinDirection::Input;
     if (mp_controller == nullptr) {
         m_lastError = RsErrorCode::NotInitialized;
         m_lastErrorString = "XML file never set";
-        return dir;
+        return false;
     }
 
     if (m_dioMap.find(dio) == m_dioMap.end()) {
         m_lastError = std::make_error_code(std::errc::invalid_argument);
         m_lastErrorString = "Invalid DIO";
-        return dir;
+        return false;
     }
 
-    pinconfigmap_t pinMap = m_dioMap.at(dio);
+    const pinconfigmap_t &pinMap = m_dioMap.at(dio);
     if (pin < 0 || pinMap.find(pin) == pinMap.end()) {
         m_lastError = std::make_error_code(std::errc::invalid_argument);
         m_lastErrorString = "Invalid pin";
-        return dir;
+        return false;
     }
 
-    PinConfig config = pinMap.at(pin);
+    config = pinMap.at(pin);
+    if (!config.supportsOutput || config.offset >= kMaxGpioSets) {
+        m_lastError = std::make_error_code(std::errc::function_not_supported);
+        m_lastErrorString = "Pin does not support output mode";
+        return false;
+    }
 
     try {
-        dir = modeToDirection(mp_controller->getPinMode(config));
-        m_lastError = std::error_code();
+        if (mp_controller->getPinMode(config) != ModeOutput) {
+            m_lastError = std::make_error_code(std::errc::invalid_argument);
+            m_lastErrorString = "Can't set state of pin in input mode";
+            return false;
+        }
     }
     catch (const std::system_error &ex) {
         m_lastError = ex.code();
         m_lastErrorString = ex.what();
+        return false;
     }
     catch (const std::exception &ex) {
         m_lastError = RsErrorCode::UnknownError;
         m_lastErrorString = ex.what();
+        return false;
     }
     catch (...) {
         m_lastError = RsErrorCode::UnknownError;
         m_lastErrorString = "unknown exception occured";
+        return false;
     }
 
-    return dir;
+    return true;
 }
 
-std::map<int, bool> RsDioImpl::readAll(int dio)
+bool RsDioImpl::startPwmScheduler()
 {
-    std::map<int, bool> values;
+    if (mp_pwm) return true;
 
-    if (mp_controller == nullptr) {
-        m_lastError = RsErrorCode::NotInitialized;
-        m_lastErrorString = "XML file never set";
-        return values;
+    try {
+        mp_pwm = new PwmScheduler(mp_controller);
+        mp_pwm->configureThread(m_threadConfig);
+    }
+    catch (const std::system_error &ex) {
+        m_lastError = ex.code();
+        m_lastErrorString = ex.what();
+        return false;
+    }
+
+    return true;
+}
+
+void RsDioImpl::startPwm(int dio, int pin, int periodUs, float duty)
+{
+    std::lock_guard<SharedMutex> lock(m_configMutex);
+    if (periodUs <= 0 || duty < 0.0f || duty > 1.0f) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid PWM settings";
+        return;
+    }
+
+    PinConfig config;
+    if (!getOutputPin(dio, pin, config) || !startPwmScheduler()) return;
+
+    mp_pwm->startPwm(config, periodUs * 1000LL, duty);
+    m_lastError = std::error_code();
+}
+
+void RsDioImpl::stopPwm(int dio, int pin)
+{
+    std::lock_guard<SharedMutex> lock(m_configMutex);
+    PinConfig config;
+    if (!getOutputPin(dio, pin, config) || !startPwmScheduler()) return;
+
+    mp_pwm->stop(config);
+    m_lastError = std::error_code();
+}
+
+void RsDioImpl::pulse(int dio, int pin, int widthUs)
+{
+    std::lock_guard<SharedMutex> lock(m_configMutex);
+    if (widthUs <= 0) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid pulse width";
+        return;
+    }
+
+    PinConfig config;
+    if (!getOutputPin(dio, pin, config) || !startPwmScheduler()) return;
+
+    mp_pwm->pulse(config, widthUs * 1000LL);
+    m_lastError = std::error_code();
+}
+
+rs::PwmStats RsDioImpl::getPwmStats()
+{
+    SharedLock lock(m_configMutex);
+    m_lastError = std::error_code();
+    if (mp_pwm) return mp_pwm->stats();
+
+    rs::PwmStats stats = {0, 0.0f, 0.0f};
+    return stats;
+}
+
+void RsDioImpl::startCounter(int dio, int pin, rs::Edge edge)
+{
+    std::lock_guard<SharedMutex> lock(m_configMutex);
+    if (((int)edge & (int)rs::Edge::Both) == 0) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid edge";
+        return;
+    }
+
+    PinConfig config;
+    if (!getInputPin(dio, pin, config)) return;
+
+    m_counters.start(config, edge);
+    m_lastError = std::error_code();
+}
+
+void RsDioImpl::stopCounter(int dio, int pin)
+{
+    std::lock_guard<SharedMutex> lock(m_configMutex);
+    PinConfig config;
+    if (!getInputPin(dio, pin, config)) return;
+
+    m_counters.stop(config);
+    m_lastError = std::error_code();
+}
+
+rs::CounterStats RsDioImpl::getCounterStats(int dio, int pin)
+{
+    SharedLock lock(m_configMutex);
+    rs::CounterStats stats = {0, 0.0f, 0.0f};
+
+    PinConfig config;
+    if (!getInputPin(dio, pin, config)) return stats;
+
+    if (!m_counters.isCounting(config)) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Counter not started on pin";
+        return stats;
+    }
+
+    m_lastError = std::error_code();
+    return m_counters.stats(config);
+}
+
+void RsDioImpl::setCounterWindow(int windowMs)
+{
+    std::lock_guard<SharedMutex> lock(m_configMutex);
+    if (windowMs <= 0) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid counter window";
+        return;
+    }
+
+    m_counters.setWindow(windowMs * 1000000LL);
+    m_lastError = std::error_code();
+}
+
+void RsDioImpl::startPlayback(
+    int dio,
+    const rs::PlaybackStep *steps,
+    size_t count,
+    float *latenessUs
+)
+{
+    std::lock_guard<SharedMutex> lock(m_configMutex);
+    if (!steps || count == 0) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid playback steps";
+        return;
+    }
+
+    PinPacker packer;
+    if (!getPlaybackPacker(dio, packer) || !startPlaybackEngine()) return;
+
+    mp_playback->play(packer, steps, count, latenessUs);
+    m_lastError = std::error_code();
+}
+
+void RsDioImpl::startPlaybackFile(
+    int dio,
+    const char *fileName,
+    float *latenessUs
+)
+{
+    std::lock_guard<SharedMutex> lock(m_configMutex);
+    if (!fileName) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid playback file";
+        return;
+    }
+
+    PinPacker packer;
+    if (!getPlaybackPacker(dio, packer) || !startPlaybackEngine()) return;
+
+    try {
+        mp_playback->playFile(packer, fileName, latenessUs);
+        m_lastError = std::error_code();
+    }
+    catch (const std::system_error &ex) {
+        m_lastError = ex.code();
+        m_lastErrorString = ex.what();
+    }
+    catch (const std::exception &ex) {
+        m_lastError = RsErrorCode::UnknownError;
+        m_lastErrorString = ex.what();
+    }
+    catch (...) {
+        m_lastError = RsErrorCode::UnknownError;
+        m_lastErrorString = "unknown exception occured";
+    }
+}
+
+void RsDioImpl::stopPlayback()
+{
+    std::lock_guard<SharedMutex> lock(m_configMutex);
+    if (mp_playback) mp_playback->stop();
+    m_lastError = std::error_code();
+}
+
+rs::PlaybackStats RsDioImpl::getPlaybackStats()
+{
+    SharedLock lock(m_configMutex);
+    m_lastError = std::error_code();
+    if (mp_playback) return mp_playback->stats();
+
+    rs::PlaybackStats stats = {0, 0, false, 0.0f, 0.0f};
+    return stats;
+}
+
+// Playback only drives the output pins of the connector. Steps that change
+// any other pin leave it alone.
+bool RsDioImpl::getPlaybackPacker(int dio, PinPacker &packer)
+{
+    if (mp_controller == nullptr) {
+        m_lastError = RsErrorCode::NotInitialized;
+        m_lastErrorString = "XML file never set";
+        return false;
+    }
+
+    if (m_dioMap.find(dio) == m_dioMap.end()) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid DIO";
+        return false;
+    }
+
+    pinconfigmap_t outputs;
+    for (const auto &pin : m_dioMap.at(dio)) {
+        if (pin.second.supportsOutput) outputs[pin.first] = pin.second;
+    }
+
+    packer = PinPacker(outputs);
+    return true;
+}
+
+bool RsDioImpl::startPlaybackEngine()
+{
+    if (mp_playback) return true;
+
+    try {
+        mp_playback = new PlaybackEngine(mp_controller);
+        mp_playback->configureThread(m_threadConfig);
+    }
+    catch (const std::system_error &ex) {
+        m_lastError = ex.code();
+        m_lastErrorString = ex.what();
+        return false;
+    }
+
+    return true;
+}
+
+void RsDioImpl::setWriteCombining(bool enabled, int windowUs)
+{
+    std::lock_guard<SharedMutex> lock(m_configMutex);
+    if (mp_controller == nullptr) {
+        m_lastError = RsErrorCode::NotInitialized;
+        m_lastErrorString = "XML file never set";
+        return;
+    }
+
+    if (windowUs < 0) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid write combining window";
+        return;
+    }
+
+    // Whatever was combined so far goes out before the mode changes.
+    flushWrites();
+    if (enabled) {
+        mp_writes = new WriteCombiner(mp_controller, windowUs);
+        mp_writes->configureThread(m_threadConfig);
+    }
+    m_lastError = std::error_code();
+}
+
+void RsDioImpl::flush()
+{
+    std::lock_guard<SharedMutex> lock(m_configMutex);
+    if (mp_controller == nullptr) {
+        m_lastError = RsErrorCode::NotInitialized;
+        m_lastErrorString = "XML file never set";
+        return;
+    }
+
+    if (!mp_writes) {
+        m_lastError = std::error_code();
+        return;
+    }
+
+    try {
+        invalidateReadCache();
+        mp_writes->flush();
+        m_lastError = std::error_code();
+    }
+    catch (const std::system_error &ex) {
+        m_lastError = ex.code();
+        m_lastErrorString = ex.what();
+    }
+    catch (const std::exception &ex) {
+        m_lastError = RsErrorCode::UnknownError;
+        m_lastErrorString = ex.what();
+    }
+    catch (...) {
+        m_lastError = RsErrorCode::UnknownError;
+        m_lastErrorString = "unknown exception occured";
+    }
+}
+
+void RsDioImpl::addEncoder(const char *name, int dio, int pinA, int pinB)
+{
+    std::lock_guard<SharedMutex> lock(m_configMutex);
+    if (!name || pinA == pinB) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid encoder";
+        return;
+    }
+
+    PinConfig configA, configB;
+    if (!getInputPin(dio, pinA, configA) || !getInputPin(dio, pinB, configB))
+        return;
+
+    m_encoders.add(name, configA, configB);
+    m_lastError = std::error_code();
+}
+
+void RsDioImpl::removeEncoder(const char *name)
+{
+    std::lock_guard<SharedMutex> lock(m_configMutex);
+    if (!name || !m_encoders.remove(name)) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid encoder";
+        return;
+    }
+
+    m_lastError = std::error_code();
+}
+
+void RsDioImpl::resetEncoder(const char *name)
+{
+    std::lock_guard<SharedMutex> lock(m_configMutex);
+    if (!name || !m_encoders.reset(name)) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid encoder";
+        return;
+    }
+
+    m_lastError = std::error_code();
+}
+
+rs::EncoderStats RsDioImpl::getEncoderStats(const char *name)
+{
+    SharedLock lock(m_configMutex);
+    rs::EncoderStats stats = {0, 0, 0, 0.0f};
+    if (!name || !m_encoders.stats(name, stats)) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid encoder";
+        return stats;
+    }
+
+    m_lastError = std::error_code();
+    return stats;
+}
+
+rs::PinStats RsDioImpl::getPinStats(int dio, int pin)
+{
+    SharedLock lock(m_configMutex);
+    rs::PinStats stats = {0, 0, 0, 0.0f, 0};
+    if (mp_controller == nullptr) {
+        m_lastError = RsErrorCode::NotInitialized;
+        m_lastErrorString = "XML file never set";
+        return stats;
+    }
+
+    if (m_dioMap.find(dio) == m_dioMap.end()) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid DIO";
+        return stats;
+    }
+
+    const pinconfigmap_t &pinMap = m_dioMap.at(dio);
+    auto it = pinMap.find(pin);
+    if (pin < 0 || it == pinMap.end()) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid pin";
+        return stats;
+    }
+
+    if (it->second.offset >= kMaxGpioSets) {
+        m_lastError = std::make_error_code(std::errc::function_not_supported);
+        m_lastErrorString = "Pin can't be sampled";
+        return stats;
+    }
+
+    m_lastError = std::error_code();
+    return m_pinStats.stats(it->second);
+}
+
+std::map<int, rs::PinStats> RsDioImpl::getAllPinStats(int dio)
+{
+    SharedLock lock(m_configMutex);
+    std::map<int, rs::PinStats> stats;
+    if (mp_controller == nullptr) {
+        m_lastError = RsErrorCode::NotInitialized;
+        m_lastErrorString = "XML file never set";
+        return stats;
+    }
+
+    if (m_dioMap.find(dio) == m_dioMap.end()) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid DIO";
+        return stats;
+    }
+
+    // Pins the sampler can't see are left out.
+    for (const auto &pin : m_dioMap.at(dio)) {
+        if (pin.first < 0 || pin.second.offset >= kMaxGpioSets) continue;
+        stats[pin.first] = m_pinStats.stats(pin.second);
+    }
+
+    m_lastError = std::error_code();
+    return stats;
+}
+
+void RsDioImpl::resetPinStats()
+{
+    std::lock_guard<SharedMutex> lock(m_configMutex);
+    m_pinStats.clear();
+    m_lastError = std::error_code();
+}
+
+// The config is tried up front so errors show up here. Threads that are
+// started later apply it without checking again.
+void RsDioImpl::setThreadConfig(const rs::ThreadConfig &config)
+{
+    std::lock_guard<std::mutex> samplerLock(m_samplerMutex);
+    std::lock_guard<SharedMutex> lock(m_configMutex);
+    std::error_code error = testThreadConfig(config);
+    DioSampler *sampler = mp_sampler.load();
+    if (!error && sampler) error = sampler->configureThread(config);
+    if (!error && mp_pwm) error = mp_pwm->configureThread(config);
+    if (!error && mp_playback) error = mp_playback->configureThread(config);
+    if (!error && mp_writes) error = mp_writes->configureThread(config);
+
+    if (error) {
+        m_lastError = error;
+        m_lastErrorString = "Failed to apply the thread config";
+        return;
+    }
+
+    m_threadConfig = config;
+    m_lastError = std::error_code();
+}
+
+rs::JitterReport RsDioImpl::getJitterReport()
+{
+    SharedLock lock(m_configMutex);
+    m_lastError = std::error_code();
+    return m_samplerJitter.report();
+}
+
+int RsDioImpl::getPinHandle(int dio, int pin)
+{
+    std::lock_guard<SharedMutex> lock(m_configMutex);
+    if (mp_controller == nullptr) {
+        m_lastError = RsErrorCode::NotInitialized;
+        m_lastErrorString = "XML file never set";
+        return -1;
+    }
+
+    if (m_dioMap.find(dio) == m_dioMap.end()) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid DIO";
+        return -1;
+    }
+
+    const pinconfigmap_t &pinMap = m_dioMap.at(dio);
+    auto it = pinMap.find(pin);
+    if (pin < 0 || it == pinMap.end()) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid pin";
+        return -1;
+    }
+
+    int count = m_handleCount.load(std::memory_order_relaxed);
+    for (int handle = 0; handle < count; ++handle) {
+        if (m_handles[handle].dio == dio && m_handles[handle].pin == pin) {
+            m_lastError = std::error_code();
+            return handle;
+        }
+    }
+
+    if (count == rs::kMaxPinHandles) {
+        m_lastError = std::make_error_code(std::errc::no_buffer_space);
+        m_lastErrorString = "Too many pin handles";
+        return -1;
+    }
+
+    // The handle is complete before the rt functions can see it.
+    m_handles[count] = {dio, pin, it->second};
+    m_handleCount.store(count + 1, std::memory_order_release);
+    m_lastError = std::error_code();
+    return count;
+}
+
+// The rt functions need the calling thread to have access to the
+// registers already, unlike the rest of the API which acquires and releases
+// it on every call.
+std::error_code RsDioImpl::rtAttachThread(bool lockMemory) noexcept
+{
+    if (mp_controller == nullptr) return RsErrorCode::NotInitialized;
+
+    if (lockMemory && mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+        return std::error_code(errno, std::generic_category());
+
+    try {
+        mp_controller->acquireGpioAccess();
+    }
+    catch (const std::system_error &ex) {
+        return ex.code();
+    }
+    catch (...) {
+        return RsErrorCode::UnknownError;
+    }
+
+    return std::error_code();
+}
+
+void RsDioImpl::rtDetachThread() noexcept
+{
+    if (mp_controller == nullptr) return;
+
+    try {
+        mp_controller->releaseGpioAccess();
+    }
+    catch (...) {
+    }
+}
+
+std::error_code RsDioImpl::rtReadPin(int handle, bool &state) noexcept
+{
+    if (handle < 0 || handle >= m_handleCount.load(std::memory_order_acquire))
+        return std::make_error_code(std::errc::invalid_argument);
+
+    const PinConfig &config = m_handles[handle].config;
+    if (getFilteredState(config, state)) return std::error_code();
+
+    try {
+        uint8_t data = mp_controller->getGpioRegister(config.offset);
+        state = ((data & config.bitmask) != 0) != config.invert;
+    }
+    catch (const std::system_error &ex) {
+        return ex.code();
+    }
+    catch (...) {
+        return RsErrorCode::UnknownError;
+    }
+
+    return std::error_code();
+}
+
+std::error_code RsDioImpl::rtWritePin(int handle, bool state) noexcept
+{
+    if (handle < 0 || handle >= m_handleCount.load(std::memory_order_acquire))
+        return std::make_error_code(std::errc::invalid_argument);
+
+    const PinConfig &config = m_handles[handle].config;
+    if (!config.supportsOutput)
+        return std::make_error_code(std::errc::function_not_supported);
+
+    try {
+        mp_controller->modifyGpioRegister(
+            config.offset,
+            config.bitmask,
+            state != config.invert ? config.bitmask : 0
+        );
+    }
+    catch (const std::system_error &ex) {
+        return ex.code();
+    }
+    catch (...) {
+        return RsErrorCode::UnknownError;
     }
 
-    if (m_dioMap.find(dio) == m_dioMap.end()) {
-        m_lastError = std::make_error_code(std::errc::invalid_argument);
-        m_lastErrorString = "Invalid DIO";
-        return values;
+    invalidateReadCache();
+    return std::error_code();
+}
+
+std::error_code RsDioImpl::rtReadPacked(int dio, uint64_t &states) noexcept
+{
+    if (mp_controller == nullptr) return RsErrorCode::NotInitialized;
+
+    if (dio < 0 || dio >= rs::kMaxDios || !m_packers[dio].pinMask())
+        return std::make_error_code(std::errc::invalid_argument);
+
+    try {
+        uint64_t raw = m_dioSets[dio].read(mp_controller);
+        states = m_packers[dio].pack(applyDebounce(raw));
+    }
+    catch (const std::system_error &ex) {
+        return ex.code();
+    }
+    catch (...) {
+        return RsErrorCode::UnknownError;
     }
 
-    pinconfigmap_t pinMap = m_dioMap.at(dio);
+    return std::error_code();
+}
+
+std::error_code RsDioImpl::rtWritePacked(
+    int dio,
+    uint64_t mask,
+    uint64_t states
+) noexcept
+{
+    if (mp_controller == nullptr) return RsErrorCode::NotInitialized;
+
+    if (dio < 0 || dio >= rs::kMaxDios || (mask & ~m_packers[dio].pinMask()))
+        return std::make_error_code(std::errc::invalid_argument);
+
+    if (mask & ~m_outputPins[dio])
+        return std::make_error_code(std::errc::function_not_supported);
 
     try {
-        for (const auto &pin : pinMap) {
-            if (pin.first >= 0)
-                values[pin.first] = mp_controller->getPinState(pin.second);
+        const PinPacker &packer = m_packers[dio];
+        m_dioSets[dio].write(
+            mp_controller, packer.toRawMask(mask), packer.unpack(states)
+        );
+    }
+    catch (const std::system_error &ex) {
+        return ex.code();
+    }
+    catch (...) {
+        return RsErrorCode::UnknownError;
+    }
+
+    invalidateReadCache();
+    return std::error_code();
+}
+
+void RsDioImpl::setReadCacheMaxAge(int maxAgeUs)
+{
+    std::lock_guard<SharedMutex> lock(m_configMutex);
+    if (maxAgeUs < 0) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid read cache age";
+        return;
+    }
+
+    m_cacheMaxAge = (int64_t)maxAgeUs * 1000;
+    m_cacheHits = 0;
+    m_cacheMisses = 0;
+    invalidateReadCache();
+    m_lastError = std::error_code();
+}
+
+rs::ReadCacheStats RsDioImpl::getReadCacheStats()
+{
+    SharedLock lock(m_configMutex);
+    rs::ReadCacheStats stats;
+    stats.hits = m_cacheHits;
+    stats.misses = m_cacheMisses;
+    m_lastError = std::error_code();
+    return stats;
+}
+
+// A miss reads the whole register, which refreshes every pin in it.
+bool RsDioImpl::getCachedState(const PinConfig &config)
+{
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch()
+    )
+                      .count();
+
+    RegisterLock lock(this, registerOf(config));
+    if (now - m_cacheTime[config.offset].load(std::memory_order_relaxed) <=
+        m_cacheMaxAge) {
+        ++m_cacheHits;
+    }
+    else {
+        mp_controller->acquireGpioAccess();
+        try {
+            m_cacheData[config.offset] =
+                mp_controller->getGpioRegister(config.offset);
+        }
+        catch (...) {
+            mp_controller->releaseGpioAccess();
+            throw;
         }
+        mp_controller->releaseGpioAccess();
+
+        m_cacheTime[config.offset].store(now, std::memory_order_relaxed);
+        ++m_cacheMisses;
+    }
+
+    bool state =
+        (m_cacheData[config.offset] & config.bitmask) == config.bitmask;
+    return state != config.invert;
+}
+
+// Call after the write, so a read that misses in the meantime can't cache
+// the old value as fresh.
+void RsDioImpl::invalidateReadCache(uint8_t offsets)
+{
+    for (uint8_t offset = 0; offset < kMaxGpioSets; ++offset) {
+        if (offsets & (1 << offset))
+            m_cacheTime[offset].store(
+                std::numeric_limits<int64_t>::min() / 2,
+                std::memory_order_relaxed
+            );
+    }
+}
+
+// Commits any combined writes and turns write combining off.
+void RsDioImpl::flushWrites()
+{
+    delete mp_writes;
+    mp_writes = nullptr;
+}
+
+// Called with m_samplerMutex held and m_configMutex not held. The sampler
+// is only published under m_configMutex, since a callback on the sampling
+// thread may be waiting for it.
+void RsDioImpl::startSampler(int intervalUs)
+{
+    stopSampler();
+
+    std::vector<SampleListener *> listeners = {
+        &m_edges,    &m_capture,  &m_counters,
+        &m_encoders, &m_pinStats, &m_snapshots
+    };
+
+    std::lock_guard<SharedMutex> lock(m_configMutex);
+    try {
+        DioSampler *sampler = new DioSampler(
+            mp_controller,
+            m_dioMap,
+            listeners,
+            intervalUs,
+            &m_debounce,
+            &m_samplerJitter
+        );
+        sampler->configureThread(m_threadConfig);
+        mp_sampler = sampler;
+        m_samplingInterval = intervalUs;
         m_lastError = std::error_code();
     }
     catch (const std::system_error &ex) {
@@ -699,8 +1902,510 @@ std::map<int, bool> RsDioImpl::readAll(int dio)
         m_lastError = RsErrorCode::UnknownError;
         m_lastErrorString = "unknown exception occured";
     }
+}
 
-    return values;
+// Called with m_samplerMutex held and m_configMutex not held. Waiting for
+// the sampling thread to finish with m_configMutex held would deadlock with
+// a callback that's waiting for it.
+void RsDioImpl::stopSampler()
+{
+    DioSampler *sampler;
+    {
+        std::lock_guard<SharedMutex> lock(m_configMutex);
+        sampler = mp_sampler.exchange(nullptr);
+    }
+
+    // An rt function that got the sampler before it was unpublished only
+    // holds on to it for a couple of loads.
+    while (m_samplerRefs.load() != 0) std::this_thread::yield();
+    delete sampler;
+}
+
+// Called with m_samplerMutex held and m_configMutex not held. Runs the
+// sampler for everything that needs it: at the shortest interval any of
+// them asked for, with the capture only recording the scans it needs.
+// Sampling that already runs at the right interval is left alone.
+void RsDioImpl::updateSampler()
+{
+    int interval = m_samplingRequest;
+    if (m_captureInterval && (!interval || m_captureInterval < interval))
+        interval = m_captureInterval;
+
+    if (!interval) {
+        stopSampler();
+        m_lastError = std::error_code();
+        return;
+    }
+
+    if (mp_sampler.load() && interval == m_samplingInterval) {
+        m_lastError = std::error_code();
+        return;
+    }
+
+    stopSampler();
+    {
+        std::lock_guard<SharedMutex> lock(m_configMutex);
+        m_capture.setDecimation(
+            m_captureInterval ? (m_captureInterval + interval / 2) / interval
+                              : 1
+        );
+    }
+    startSampler(interval);
+}
+
+// The count goes up before the pointer is loaded, so stopSampler either
+// sees the reference or this sees the null pointer.
+RsDioImpl::SamplerRef::SamplerRef(const RsDioImpl *dio) : mp_dio(dio)
+{
+    ++mp_dio->m_samplerRefs;
+    mp_sampler = mp_dio->mp_sampler.load();
+}
+
+RsDioImpl::SamplerRef::~SamplerRef() { --mp_dio->m_samplerRefs; }
+
+RsDioImpl::RegisterLock::RegisterLock(RsDioImpl *dio, uint8_t offsets)
+    : mp_dio(dio), m_offsets(offsets)
+{
+    for (uint8_t offset = 0; offset < kMaxGpioSets; ++offset) {
+        if (m_offsets & (1 << offset)) mp_dio->m_registerMutex[offset].lock();
+    }
+}
+
+RsDioImpl::RegisterLock::~RegisterLock()
+{
+    for (uint8_t offset = 0; offset < kMaxGpioSets; ++offset) {
+        if (m_offsets & (1 << offset))
+            mp_dio->m_registerMutex[offset].unlock();
+    }
+}
+
+// Drops this instance's handle. The chip is only closed once no other
+// instance uses it.
+void RsDioImpl::releaseController()
+{
+    m_controllerRef.reset();
+    mp_controller = nullptr;
+}
+
+// Works out which registers hold connector pins and how each connector's and
+// group's pins map to them, so readAllPacked and the group functions don't
+// have to walk the pin maps.
+void RsDioImpl::compileDioMap()
+{
+    m_gpioSets = GpioSetList(m_dioMap);
+    for (int dio = 0; dio < rs::kMaxDios; ++dio) {
+        auto it = m_dioMap.find(dio);
+        m_outputPins[dio] = 0;
+        if (it != m_dioMap.end()) {
+            m_packers[dio] = PinPacker(it->second);
+            for (const auto &pin : it->second) {
+                if (pin.first >= 0 && pin.first < 64 &&
+                    pin.second.supportsOutput)
+                    m_outputPins[dio] |= 1ULL << pin.first;
+            }
+        }
+        else
+            m_packers[dio] = PinPacker();
+        m_dioSets[dio] = GpioSetList(m_packers[dio].rawMask());
+    }
+    m_handleCount = 0;
+
+    // Groups with pins that don't exist are dropped.
+    m_groups.clear();
+    for (const auto &pair : m_groupMap) {
+        const GroupConfig &config = pair.second;
+        auto dioIt = m_dioMap.find(config.dio);
+        if (dioIt == m_dioMap.end() || config.pins.size() > 64) continue;
+
+        pinconfigmap_t bits;
+        bool writable = true;
+        for (size_t bit = 0; bit < config.pins.size(); ++bit) {
+            auto pinIt = dioIt->second.find(config.pins[bit]);
+            if (config.pins[bit] < 0 || pinIt == dioIt->second.end() ||
+                pinIt->second.offset >= kMaxGpioSets)
+                break;
+
+            bits[bit] = pinIt->second;
+            writable = writable && pinIt->second.supportsOutput;
+        }
+        if (bits.size() != config.pins.size()) continue;
+
+        Group group;
+        group.packer = PinPacker(bits);
+        group.gpioSets = GpioSetList(group.packer.rawMask());
+        group.writable = writable;
+        m_groups[pair.first] = group;
+    }
+}
+
+// Reads the registers in one go, with debounced pins replaced by their
+// filtered state like digitalRead does.
+uint64_t RsDioImpl::readGpioSets(const GpioSetList &sets)
+{
+    uint64_t raw;
+    mp_controller->acquireGpioAccess();
+    try {
+        raw = sets.read(mp_controller);
+    }
+    catch (...) {
+        mp_controller->releaseGpioAccess();
+        throw;
+    }
+    mp_controller->releaseGpioAccess();
+
+    return applyDebounce(raw);
+}
+
+uint64_t RsDioImpl::applyDebounce(uint64_t raw) const
+{
+    SamplerRef sampler(this);
+    if (sampler && sampler->hasState()) {
+        uint64_t filtered = m_debounce.filteredMask();
+        raw = (raw & ~filtered) | (sampler->state() & filtered);
+    }
+
+    return raw;
+}
+
+void RsDioImpl::writeGpioSets(
+    const GpioSetList &sets,
+    uint64_t rawMask,
+    uint64_t raw
+)
+{
+    mp_controller->acquireGpioAccess();
+    try {
+        sets.write(mp_controller, rawMask, raw);
+    }
+    catch (...) {
+        mp_controller->releaseGpioAccess();
+        throw;
+    }
+    mp_controller->releaseGpioAccess();
+}
+
+std::error_code RsDioImpl::readPin(
+    int dio,
+    int pin,
+    bool bypassCache,
+    bool &state,
+    std::string *what
+)
+{
+    SharedLock lock(m_configMutex);
+    const PinConfig *config = nullptr;
+    std::error_code error = findPin(dio, pin, config, what);
+    if (error) return error;
+
+    if (getFilteredState(*config, state)) return std::error_code();
+
+    try {
+        if (m_cacheMaxAge > 0 && !bypassCache &&
+            config->offset < kMaxGpioSets)
+            state = getCachedState(*config);
+        else
+            state = mp_controller->getPinState(*config);
+        return std::error_code();
+    }
+    catch (...) {
+        return currentError(what);
+    }
+}
+
+std::error_code
+RsDioImpl::writePin(int dio, int pin, bool state, std::string *what)
+{
+    SharedLock lock(m_configMutex);
+    const PinConfig *config = nullptr;
+    std::error_code error = findPin(dio, pin, config, what);
+    if (error) return error;
+
+    if (pin < 0) {
+        return failWith(
+            std::make_error_code(std::errc::invalid_argument),
+            "Invalid pin",
+            what
+        );
+    }
+
+    if (!config->supportsOutput) {
+        return failWith(
+            std::make_error_code(std::errc::function_not_supported),
+            "Pin does not support output mode",
+            what
+        );
+    }
+
+    try {
+        if (mp_writes && config->offset < kMaxGpioSets) {
+            // The same check setPinState makes, since the combined write
+            // goes straight to the register.
+            if (mp_controller->getPinMode(*config) != ModeOutput) {
+                return failWith(
+                    std::make_error_code(std::errc::invalid_argument),
+                    "Can't set state of pin in input mode",
+                    what
+                );
+            }
+
+            uint64_t bit = 1ULL << rawBit(*config);
+            mp_writes->write(bit, state != config->invert ? bit : 0);
+        }
+        else {
+            RegisterLock lock(this, registerOf(*config));
+            mp_controller->setPinState(*config, state);
+        }
+        invalidateReadCache(registerOf(*config));
+        return std::error_code();
+    }
+    catch (...) {
+        return currentError(what);
+    }
+}
+
+std::error_code RsDioImpl::readPinDirection(
+    int dio,
+    int pin,
+    rs::PinDirection &dir,
+    std::string *what
+)
+{
+    SharedLock lock(m_configMutex);
+    const PinConfig *config = nullptr;
+    std::error_code error = findPin(dio, pin, config, what);
+    if (error) return error;
+
+    if (pin < 0) {
+        return failWith(
+            std::make_error_code(std::errc::invalid_argument),
+            "Invalid pin",
+            what
+        );
+    }
+
+    try {
+        dir = modeToDirection(mp_controller->getPinMode(*config));
+        return std::error_code();
+    }
+    catch (...) {
+        return currentError(what);
+    }
+}
+
+std::error_code RsDioImpl::writePinDirection(
+    int dio,
+    int pin,
+    rs::PinDirection dir,
+    std::string *what
+)
+{
+    SharedLock lock(m_configMutex);
+    const PinConfig *config = nullptr;
+    std::error_code error = findPin(dio, pin, config, what);
+    if (error) return error;
+
+    if (pin < 0) {
+        return failWith(
+            std::make_error_code(std::errc::invalid_argument),
+            "Invalid pin",
+            what
+        );
+    }
+
+    try {
+        if (modeToDirection(mp_controller->getPinMode(*config)) == dir)
+            return std::error_code();
+    }
+    catch (...) {
+        return currentError(what);
+    }
+
+    if ((dir == rs::PinDirection::Input && !config->supportsInput) ||
+        (dir == rs::PinDirection::Output && !config->supportsOutput)) {
+        return failWith(
+            std::make_error_code(std::errc::function_not_supported),
+            dir == rs::PinDirection::Input
+                ? "Pin does not support direction: Input"
+                : "Pin does not support direction: Output",
+            what
+        );
+    }
+
+    try {
+        mp_controller->setPinMode(*config, directionToMode(dir));
+        invalidateReadCache(registerOf(*config));
+        return std::error_code();
+    }
+    catch (...) {
+        return currentError(what);
+    }
+}
+
+std::error_code
+RsDioImpl::readSnapshot(rs::DioSnapshot &snapshot, std::string *what)
+{
+    SharedLock lock(m_configMutex);
+    if (mp_controller == nullptr) {
+        return failWith(RsErrorCode::NotInitialized, "XML file never set", what);
+    }
+
+    try {
+        uint64_t raw = readGpioSets(m_gpioSets);
+        for (int dio = 0; dio < rs::kMaxDios; ++dio) {
+            snapshot.valid[dio] = m_packers[dio].pinMask();
+            if (snapshot.valid[dio])
+                snapshot.states[dio] = m_packers[dio].pack(raw);
+        }
+        return std::error_code();
+    }
+    catch (...) {
+        return currentError(what);
+    }
+}
+
+std::error_code RsDioImpl::readGroupValue(
+    const char *name,
+    uint64_t &value,
+    std::string *what
+)
+{
+    SharedLock lock(m_configMutex);
+    const Group *group = nullptr;
+    std::error_code error = findGroup(name, group, what);
+    if (error) return error;
+
+    try {
+        value = group->packer.pack(readGpioSets(group->gpioSets));
+        return std::error_code();
+    }
+    catch (...) {
+        return currentError(what);
+    }
+}
+
+std::error_code RsDioImpl::writeGroupValue(
+    const char *name,
+    uint64_t value,
+    std::string *what
+)
+{
+    SharedLock lock(m_configMutex);
+    const Group *group = nullptr;
+    std::error_code error = findGroup(name, group, what);
+    if (error) return error;
+
+    if (!group->writable) {
+        return failWith(
+            std::make_error_code(std::errc::function_not_supported),
+            "Group has pins that don't support output mode",
+            what
+        );
+    }
+
+    if (value & ~group->packer.pinMask()) {
+        return failWith(
+            std::make_error_code(std::errc::invalid_argument),
+            "Value doesn't fit in group",
+            what
+        );
+    }
+
+    uint8_t registers = registersOf(group->packer.rawMask());
+    try {
+        if (mp_writes) {
+            mp_writes->write(
+                group->packer.rawMask(), group->packer.unpack(value)
+            );
+        }
+        else {
+            RegisterLock lock(this, registers);
+            writeGpioSets(
+                group->gpioSets,
+                group->packer.rawMask(),
+                group->packer.unpack(value)
+            );
+        }
+        invalidateReadCache(registers);
+        return std::error_code();
+    }
+    catch (...) {
+        return currentError(what);
+    }
+}
+
+std::error_code RsDioImpl::findPin(
+    int dio,
+    int pin,
+    const PinConfig *&config,
+    std::string *what
+) const
+{
+    if (mp_controller == nullptr) {
+        return failWith(RsErrorCode::NotInitialized, "XML file never set", what);
+    }
+
+    auto dioIt = m_dioMap.find(dio);
+    if (dioIt == m_dioMap.end()) {
+        return failWith(
+            std::make_error_code(std::errc::invalid_argument),
+            "Invalid DIO",
+            what
+        );
+    }
+
+    auto pinIt = dioIt->second.find(pin);
+    if (pinIt == dioIt->second.end()) {
+        return failWith(
+            std::make_error_code(std::errc::invalid_argument),
+            "Invalid pin",
+            what
+        );
+    }
+
+    config = &pinIt->second;
+    return std::error_code();
+}
+
+std::error_code RsDioImpl::findGroup(
+    const char *name,
+    const Group *&group,
+    std::string *what
+) const
+{
+    if (mp_controller == nullptr) {
+        return failWith(RsErrorCode::NotInitialized, "XML file never set", what);
+    }
+
+    auto it = name ? m_groups.find(name) : m_groups.end();
+    if (it == m_groups.end()) {
+        return failWith(
+            std::make_error_code(std::errc::invalid_argument),
+            "Invalid group",
+            what
+        );
+    }
+
+    group = &it->second;
+    return std::error_code();
+}
+
+// Debounced pins read the filtered state from the sampler while it runs.
+bool RsDioImpl::getFilteredState(const PinConfig &config, bool &state) const
+{
+    SamplerRef sampler(this);
+    if (!sampler || !sampler->hasState() || config.offset >= kMaxGpioSets)
+        return false;
+
+    uint8_t bit = rawBit(config);
+    if (!(m_debounce.filteredMask() & (1ULL << bit))) return false;
+
+    state = ((sampler->state() >> bit) & 1) != config.invert;
+    return true;
+}
+
+void RsDioImpl::setSnapshotCallback(snapshotcallback_t callback)
+{
+    m_snapshots.setCallback(callback);
 }
 
 std::error_code RsDioImpl::getLastError() const { return m_lastError; }
@@ -709,15 +2414,25 @@ std::string RsDioImpl::getLastErrorString() const
 {
     std::string lastError;
 
-    if (m_lastError) {
-        lastError += m_lastError.message();
-        if (!m_lastErrorString.empty()) {
-            lastError += ": " + m_lastErrorString;
+    const std::error_code &error = m_lastError;
+    if (error) {
+        lastError += error.message();
+        const std::string &errorString = m_lastErrorString;
+        if (!errorString.empty()) {
+            lastError += ": " + errorString;
         }
     }
     return lastError;
 }
 
-rs::RsDio *rs::createRsDio() { return new RsDioImpl; }
+rs::RsDio *rs::createRsDio()
+{
+    // Hand out a client if the process asked for rsiod, so it doesn't fight
+    // the daemon over the index ports.
+    RsDioClient *client = RsDioClient::connect(iodClientSocketPath());
+    if (client) return client;
+
+    return new RsDioImpl;
+}
 
 const char *rs::rsDioVersion() { return RSSDK_VERSION_STRING; }
@@ -1,18 +1,58 @@
 #ifndef RSDIOIMPL_H
 #define RSDIOIMPL_H
 
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
+#include "../../utils/perthread.h"
+#include "../../utils/sharedmutex.h"
 #include "../include/rsdio.h"
 #include "controllers/abstractdiocontroller.h"
+#include "debouncefilter.h"
+#include "diocapture.h"
+#include "diosampler.h"
+#include "edgedispatcher.h"
+#include "pinpacker.h"
+#include "pinstatstracker.h"
+#include "playbackengine.h"
+#include "pulsecounter.h"
+#include "pwmscheduler.h"
+#include "quadraturedecoder.h"
+#include "snapshotpublisher.h"
+#include "writecombiner.h"
 
-typedef std::map<int, PinConfig> pinconfigmap_t;
-typedef std::map<int, pinconfigmap_t> dioconfigmap_t;
+// A named set of pins on one connector that's read and written as one
+// integer. Bit n of the value is pins[n].
+struct GroupConfig {
+    int dio;
+    std::vector<int> pins;
+};
+
+typedef std::map<std::string, GroupConfig> groupconfigmap_t;
 
+// Every function can be called from any thread. Errors are kept per thread,
+// so getLastError reports the last call the calling thread made.
+//
+// m_configMutex guards the pin map, the controller and the workers. Pin
+// functions only hold it shared, plus the lock of each GPIO register they
+// read-modify-write or cache, so calls on different registers run side by
+// side. Everything that reconfigures the instance holds it exclusively.
+//
+// Edge callbacks run on the sampling thread and may call the pin functions,
+// so the sampler is never stopped with m_configMutex held. Starting and
+// stopping it is serialized by m_samplerMutex instead, which means a
+// callback must not start or stop sampling or captures itself.
 class RsDioImpl : public rs::RsDio {
    public:
     RsDioImpl();
-    RsDioImpl(AbstractDioController *controller, dioconfigmap_t dioMap);
+    RsDioImpl(
+        AbstractDioController *controller,
+        dioconfigmap_t dioMap,
+        groupconfigmap_t groupMap = groupconfigmap_t()
+    );
     ~RsDioImpl();
 
     void destroy() override;
@@ -24,22 +64,280 @@ class RsDioImpl : public rs::RsDio {
     void setOutputMode(int dio, rs::OutputMode mode) override;
     rs::OutputMode getOutputMode(int dio) override;
 
-    bool digitalRead(int dio, int pin) override;
+    bool digitalRead(int dio, int pin, bool bypassCache = false) override;
     void digitalWrite(int dio, int pin, bool state) override;
 
     void setPinDirection(int dio, int pin, rs::PinDirection dir) override;
     rs::PinDirection getPinDirection(int dio, int pin) override;
 
     std::map<int, bool> readAll(int dio) override;
+    rs::DioSnapshot readAllPacked() override;
+
+    uint64_t readGroup(const char *name) override;
+    void writeGroup(const char *name, uint64_t value) override;
+
+    void startSampling(int intervalUs) override;
+    void stopSampling() override;
+
+    int attachCallback(
+        int dio,
+        int pin,
+        rs::Edge edge,
+        rs::DioCallback callback
+    ) override;
+    int attachConnectorCallback(
+        int dio,
+        uint64_t pinMask,
+        rs::Edge edge,
+        rs::DioCallback callback
+    ) override;
+    void detachCallback(int handle) override;
+
+    void setDebounce(
+        int dio,
+        int pin,
+        rs::DebounceMode mode,
+        int samples
+    ) override;
+
+    void startCapture(
+        int dio,
+        int intervalUs,
+        rs::DioRecord *buffer,
+        size_t size
+    ) override;
+    void stopCapture() override;
+    size_t readCapture(rs::DioRecord *records, size_t count) override;
+    rs::DioCaptureStats getCaptureStats() override;
+
+    void startPwm(int dio, int pin, int periodUs, float duty) override;
+    void stopPwm(int dio, int pin) override;
+    void pulse(int dio, int pin, int widthUs) override;
+    rs::PwmStats getPwmStats() override;
+
+    void startPlayback(
+        int dio,
+        const rs::PlaybackStep *steps,
+        size_t count,
+        float *latenessUs
+    ) override;
+    void startPlaybackFile(
+        int dio,
+        const char *fileName,
+        float *latenessUs
+    ) override;
+    void stopPlayback() override;
+    rs::PlaybackStats getPlaybackStats() override;
+
+    void setWriteCombining(bool enabled, int windowUs) override;
+    void flush() override;
+
+    void startCounter(int dio, int pin, rs::Edge edge) override;
+    void stopCounter(int dio, int pin) override;
+    rs::CounterStats getCounterStats(int dio, int pin) override;
+    void setCounterWindow(int windowMs) override;
+
+    void addEncoder(const char *name, int dio, int pinA, int pinB) override;
+    void removeEncoder(const char *name) override;
+    void resetEncoder(const char *name) override;
+    rs::EncoderStats getEncoderStats(const char *name) override;
+
+    rs::PinStats getPinStats(int dio, int pin) override;
+    std::map<int, rs::PinStats> getAllPinStats(int dio) override;
+    void resetPinStats() override;
+
+    void setThreadConfig(const rs::ThreadConfig &config) override;
+    rs::JitterReport getJitterReport() override;
+
+    int getPinHandle(int dio, int pin) override;
+    std::error_code rtAttachThread(bool lockMemory) noexcept override;
+    void rtDetachThread() noexcept override;
+    std::error_code rtReadPin(int handle, bool &state) noexcept override;
+    std::error_code rtWritePin(int handle, bool state) noexcept override;
+    std::error_code rtReadPacked(int dio, uint64_t &states) noexcept override;
+    std::error_code rtWritePacked(
+        int dio,
+        uint64_t mask,
+        uint64_t states
+    ) noexcept override;
+
+    void setReadCacheMaxAge(int maxAgeUs) override;
+    rs::ReadCacheStats getReadCacheStats() override;
+
+    rs::Result<bool> digitalReadEx(
+        int dio,
+        int pin,
+        bool bypassCache = false
+    ) override;
+    rs::Result<void> digitalWriteEx(int dio, int pin, bool state) override;
+    rs::Result<rs::PinDirection> getPinDirectionEx(int dio, int pin) override;
+    rs::Result<void> setPinDirectionEx(
+        int dio,
+        int pin,
+        rs::PinDirection dir
+    ) override;
+    rs::Result<rs::DioSnapshot> readAllPackedEx() override;
+    rs::Result<uint64_t> readGroupEx(const char *name) override;
+    rs::Result<void> writeGroupEx(const char *name, uint64_t value) override;
+
+    // Not part of RsDio. Calls callback from the sampling thread with the
+    // state of every connector after each scan, for rsiod to publish.
+    void setSnapshotCallback(snapshotcallback_t callback);
 
     std::error_code getLastError() const;
     std::string getLastErrorString() const;
 
    private:
-    std::error_code m_lastError;
-    std::string m_lastErrorString;
+    struct Group {
+        PinPacker packer;
+        GpioSetList gpioSets;
+        bool writable;
+    };
+
+    struct PinHandle {
+        int dio;
+        int pin;
+        PinConfig config;
+    };
+
+    // Keeps the sampler alive while the rt functions, which don't take
+    // m_configMutex, use it. stopSampler waits for every reference to go
+    // away before it deletes the sampler.
+    class SamplerRef {
+       public:
+        explicit SamplerRef(const RsDioImpl *dio);
+        ~SamplerRef();
+
+        SamplerRef(const SamplerRef &) = delete;
+        SamplerRef &operator=(const SamplerRef &) = delete;
+
+        DioSampler *operator->() const { return mp_sampler; }
+        explicit operator bool() const { return mp_sampler != nullptr; }
+
+       private:
+        const RsDioImpl *mp_dio;
+        std::atomic<DioSampler *> mp_sampler;
+    };
+
+    // Holds the locks of the GPIO registers in the offsets mask, lowest
+    // first so callers that lock several registers can't deadlock.
+    class RegisterLock {
+       public:
+        RegisterLock(RsDioImpl *dio, uint8_t offsets);
+        ~RegisterLock();
+
+        RegisterLock(const RegisterLock &) = delete;
+        RegisterLock &operator=(const RegisterLock &) = delete;
+
+       private:
+        RsDioImpl *mp_dio;
+        uint8_t m_offsets;
+    };
+
+    void startSampler(int intervalUs);
+    void stopSampler();
+    void updateSampler();
+    void compileDioMap();
+    uint64_t readGpioSets(const GpioSetList &sets);
+    uint64_t applyDebounce(uint64_t raw) const;
+    void writeGpioSets(const GpioSetList &sets, uint64_t rawMask, uint64_t raw);
+    void flushWrites();
+    void releaseController();
+    bool getCachedState(const PinConfig &config);
+    void invalidateReadCache(uint8_t offsets = 0xff);
+    // The pin functions return their error for both the last error and the
+    // ...Ex variants. what receives the message and may be null.
+    std::error_code readPin(
+        int dio,
+        int pin,
+        bool bypassCache,
+        bool &state,
+        std::string *what
+    );
+    std::error_code writePin(int dio, int pin, bool state, std::string *what);
+    std::error_code readPinDirection(
+        int dio,
+        int pin,
+        rs::PinDirection &dir,
+        std::string *what
+    );
+    std::error_code writePinDirection(
+        int dio,
+        int pin,
+        rs::PinDirection dir,
+        std::string *what
+    );
+    std::error_code readSnapshot(rs::DioSnapshot &snapshot, std::string *what);
+    std::error_code
+    readGroupValue(const char *name, uint64_t &value, std::string *what);
+    std::error_code
+    writeGroupValue(const char *name, uint64_t value, std::string *what);
+    // Also finds the negative output mode pins, which only digitalRead takes.
+    std::error_code findPin(
+        int dio,
+        int pin,
+        const PinConfig *&config,
+        std::string *what
+    ) const;
+    std::error_code
+    findGroup(const char *name, const Group *&group, std::string *what) const;
+    bool getInputPin(int dio, int pin, PinConfig &config);
+    bool getOutputPin(int dio, int pin, PinConfig &config);
+    bool getPlaybackPacker(int dio, PinPacker &packer);
+    // Create the PWM and playback threads on first use.
+    bool startPwmScheduler();
+    bool startPlaybackEngine();
+    bool getFilteredState(const PinConfig &config, bool &state) const;
+
+    PerThread<std::error_code> m_lastError;
+    PerThread<std::string> m_lastErrorString;
+    mutable SharedMutex m_configMutex;
+    std::mutex m_samplerMutex;
     dioconfigmap_t m_dioMap;
+    GpioSetList m_gpioSets;
+    PinPacker m_packers[rs::kMaxDios];
+    // Registers and output bits of each connector for the rt functions.
+    GpioSetList m_dioSets[rs::kMaxDios];
+    uint64_t m_outputPins[rs::kMaxDios];
+    // Handles never move once they're handed out, so the rt functions can
+    // read the first m_handleCount of them without a lock.
+    PinHandle m_handles[rs::kMaxPinHandles];
+    std::atomic<int> m_handleCount;
+    groupconfigmap_t m_groupMap;
+    std::map<std::string, Group> m_groups;
+    // Shared with every other instance using the same chip unless the
+    // controller was passed in. mp_controller is m_controllerRef.get().
+    std::shared_ptr<AbstractDioController> m_controllerRef;
     AbstractDioController *mp_controller;
+    std::atomic<DioSampler *> mp_sampler;
+    mutable std::atomic<int> m_samplerRefs;
+    // The interval the sampler runs at, and the ones startSampling and
+    // startCapture asked for. 0 means that user doesn't need the sampler.
+    int m_samplingInterval;
+    int m_samplingRequest;
+    int m_captureInterval;
+    DebounceFilter m_debounce;
+    EdgeDispatcher m_edges;
+    DioCapture m_capture;
+    PulseCounter m_counters;
+    QuadratureDecoder m_encoders;
+    PinStatsTracker m_pinStats;
+    SnapshotPublisher m_snapshots;
+    rs::ThreadConfig m_threadConfig;
+    JitterHistogram m_samplerJitter;
+    PwmScheduler *mp_pwm;
+    WriteCombiner *mp_writes;
+    PlaybackEngine *mp_playback;
+
+    // Last value read from each GPIO register and when, in nanoseconds.
+    // m_cacheData is guarded by m_registerMutex. m_cacheTime is atomic so
+    // the rt functions can invalidate it without taking the lock.
+    int64_t m_cacheMaxAge;
+    uint8_t m_cacheData[kMaxGpioSets];
+    std::atomic<int64_t> m_cacheTime[kMaxGpioSets];
+    std::atomic<uint64_t> m_cacheHits;
+    std::atomic<uint64_t> m_cacheMisses;
+    std::mutex m_registerMutex[kMaxGpioSets];
 };
 
 #endif  // RSDIOIMPL_H
\ No newline at end of file
@@ -0,0 +1,32 @@
+#include "snapshotpublisher.h"
+
+SnapshotPublisher::SnapshotPublisher(const PinPacker *packers)
+    : mp_packers(packers)
+{
+}
+
+void SnapshotPublisher::setCallback(snapshotcallback_t callback)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_callback = callback;
+}
+
+void SnapshotPublisher::onSamplingStarted(const DioSample &sample)
+{
+    onSample(sample);
+}
+
+void SnapshotPublisher::onSample(const DioSample &sample)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_callback) return;
+
+    rs::DioSnapshot snapshot;
+    for (int dio = 0; dio < rs::kMaxDios; ++dio) {
+        snapshot.valid[dio] = mp_packers[dio].pinMask();
+        snapshot.states[dio] =
+            snapshot.valid[dio] ? mp_packers[dio].pack(sample.raw) : 0;
+    }
+
+    m_callback(sample.timestamp, snapshot);
+}
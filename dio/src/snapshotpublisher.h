@@ -0,0 +1,35 @@
+#ifndef SNAPSHOTPUBLISHER_H
+#define SNAPSHOTPUBLISHER_H
+
+#include <stdint.h>
+
+#include <functional>
+#include <mutex>
+
+#include "../include/rsdio.h"
+#include "diosampler.h"
+#include "pinpacker.h"
+
+typedef std::function<void(uint64_t timestamp, const rs::DioSnapshot &)>
+    snapshotcallback_t;
+
+// Packs every scan into the state of each connector and hands it to a
+// callback, for consumers outside the library such as rsiod. The packers
+// must not change while sampling.
+class SnapshotPublisher : public SampleListener {
+   public:
+    explicit SnapshotPublisher(const PinPacker *packers);
+
+    void setCallback(snapshotcallback_t callback);
+
+    void onSamplingStarted(const DioSample &sample) override;
+    void onSample(const DioSample &sample) override;
+
+   private:
+    const PinPacker *mp_packers;  // rs::kMaxDios of them
+
+    std::mutex m_mutex;
+    snapshotcallback_t m_callback;
+};
+
+#endif  // SNAPSHOTPUBLISHER_H
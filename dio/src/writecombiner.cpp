@@ -0,0 +1,122 @@
+#include "writecombiner.h"
+
+WriteCombiner::WriteCombiner(AbstractDioController *controller, int windowUs)
+    : mp_controller(controller),
+      m_window(windowUs),
+      m_running(true),
+      m_pendingMask(0),
+      m_pendingBits(0),
+      m_orderCount(0)
+{
+    if (windowUs > 0) m_thread = std::thread(&WriteCombiner::run, this);
+}
+
+WriteCombiner::~WriteCombiner()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_wakeCondition.notify_all();
+
+    if (m_thread.joinable()) m_thread.join();
+
+    try {
+        flush();
+    }
+    catch (...) {
+    }
+}
+
+std::error_code WriteCombiner::configureThread(const rs::ThreadConfig &config)
+{
+    return applyThreadConfig(m_thread, config);
+}
+
+void WriteCombiner::write(uint64_t rawMask, uint64_t raw)
+{
+    bool first;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        first = m_pendingMask == 0;
+        if (first) m_deadline = std::chrono::steady_clock::now() + m_window;
+
+        for (uint8_t offset = 0; offset < kMaxGpioSets; ++offset) {
+            uint64_t registerMask = 0xffULL << (offset * 8);
+            if ((rawMask & registerMask) && !(m_pendingMask & registerMask))
+                m_order[m_orderCount++] = offset;
+        }
+
+        // A later write to the same pin replaces the earlier one.
+        m_pendingMask |= rawMask;
+        m_pendingBits = (m_pendingBits & ~rawMask) | (raw & rawMask);
+    }
+
+    if (first) m_wakeCondition.notify_all();
+}
+
+void WriteCombiner::flush()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_pendingMask) return;
+
+    mp_controller->acquireGpioAccess();
+    try {
+        commit();
+    }
+    catch (...) {
+        mp_controller->releaseGpioAccess();
+        throw;
+    }
+    mp_controller->releaseGpioAccess();
+}
+
+void WriteCombiner::run()
+{
+    try {
+        mp_controller->acquireGpioAccess();
+    }
+    catch (...) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_running) {
+        if (!m_pendingMask) {
+            m_wakeCondition.wait(lock);
+            continue;
+        }
+
+        if (m_wakeCondition.wait_until(lock, m_deadline) ==
+            std::cv_status::timeout) {
+            try {
+                if (m_pendingMask) commit();
+            }
+            catch (...) {
+            }
+        }
+    }
+
+    lock.unlock();
+    mp_controller->releaseGpioAccess();
+}
+
+// Called with m_mutex held. Pending writes are dropped even if a register
+// write fails, the same as a failed digitalWrite.
+void WriteCombiner::commit()
+{
+    uint64_t mask = m_pendingMask;
+    uint64_t bits = m_pendingBits;
+    size_t count = m_orderCount;
+    m_pendingMask = 0;
+    m_pendingBits = 0;
+    m_orderCount = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        uint8_t offset = m_order[i];
+        uint8_t registerMask = (mask >> (offset * 8)) & 0xff;
+        mp_controller->modifyGpioRegister(
+            offset, registerMask, (bits >> (offset * 8)) & registerMask
+        );
+    }
+}
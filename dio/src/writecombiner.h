@@ -0,0 +1,54 @@
+#ifndef WRITECOMBINER_H
+#define WRITECOMBINER_H
+
+#include <stdint.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "../../utils/threadconfig.h"
+#include "controllers/abstractdiocontroller.h"
+#include "diosampler.h"
+
+// Collects pin writes (as DioSample::raw bits) and commits them with one
+// modifyGpioRegister per GPIO register, so bits nobody wrote to keep their
+// current state. Registers are committed in the order they were first
+// written to.
+//
+// With a window the pending writes are committed that long after the first
+// one by a background thread. Without one they wait for flush().
+class WriteCombiner {
+   public:
+    WriteCombiner(AbstractDioController *controller, int windowUs);
+    // Commits whatever is still pending.
+    ~WriteCombiner();
+
+    void write(uint64_t rawMask, uint64_t raw);
+    void flush();
+
+    // Applies config to the background thread, if there is one.
+    std::error_code configureThread(const rs::ThreadConfig &config);
+
+   private:
+    void run();
+    void commit();
+
+    AbstractDioController *mp_controller;
+    std::chrono::microseconds m_window;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wakeCondition;
+    bool m_running;
+
+    uint64_t m_pendingMask;
+    uint64_t m_pendingBits;
+    uint8_t m_order[kMaxGpioSets];
+    size_t m_orderCount;
+    std::chrono::steady_clock::time_point m_deadline;
+
+    std::thread m_thread;
+};
+
+#endif  // WRITECOMBINER_H
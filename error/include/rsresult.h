@@ -0,0 +1,55 @@
+#ifndef RSRESULT_H
+#define RSRESULT_H
+
+#include <system_error>
+
+namespace rs {
+
+// The value a call produced or the error that kept it from producing one.
+//
+// Returned by the ...Ex functions, which report errors here instead of
+// through getLastError. That takes one call per operation and leaves no
+// state behind, so any number of threads can use them side by side.
+template <typename T>
+class Result {
+   public:
+    Result(const T &value) : m_value(value), m_error() {}
+    Result(std::error_code error) : m_value(), m_error(error) {}
+
+    bool ok() const { return !m_error; }
+    explicit operator bool() const { return ok(); }
+
+    std::error_code error() const { return m_error; }
+
+    // Throws std::system_error if the call failed.
+    const T &value() const
+    {
+        if (m_error) throw std::system_error(m_error);
+        return m_value;
+    }
+
+    T valueOr(const T &fallback) const { return m_error ? fallback : m_value; }
+
+   private:
+    T m_value;
+    std::error_code m_error;
+};
+
+template <>
+class Result<void> {
+   public:
+    Result() : m_error() {}
+    Result(std::error_code error) : m_error(error) {}
+
+    bool ok() const { return !m_error; }
+    explicit operator bool() const { return ok(); }
+
+    std::error_code error() const { return m_error; }
+
+   private:
+    std::error_code m_error;
+};
+
+}  // namespace rs
+
+#endif  // RSRESULT_H
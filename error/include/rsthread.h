@@ -0,0 +1,36 @@
+#ifndef RSTHREAD_H
+#define RSTHREAD_H
+
+#include <stdint.h>
+
+namespace rs {
+
+enum class SchedPolicy { Default, Fifo, RoundRobin };
+
+// Settings for the background threads of the SDK.
+struct ThreadConfig {
+    uint64_t cpuMask;    // Bit n allows CPU n. 0 leaves the affinity alone.
+    SchedPolicy policy;  // Scheduling policy of the threads.
+    int priority;        // Real-time priority for Fifo and RoundRobin.
+    bool lockMemory;     // Lock every page of the process in memory.
+
+    ThreadConfig()
+        : cpuMask(0), policy(SchedPolicy::Default), priority(0),
+          lockMemory(false)
+    {
+    }
+};
+
+// Achieved periods of a periodic background thread.
+struct JitterReport {
+    uint64_t periods;  // Periods measured.
+    float targetUs;    // Requested period.
+    float minUs;
+    float avgUs;
+    float p99Us;  // 99% of the periods were this long or shorter.
+    float maxUs;
+};
+
+}  // namespace rs
+
+#endif  // RSTHREAD_H
@@ -41,9 +41,9 @@ class PyRsDio {
         return mode;
     }
 
-    bool digitalRead(int dio, int pin)
+    bool digitalRead(int dio, int pin, bool bypassCache)
     {
-        bool state = m_rsdio->digitalRead(dio, pin);
+        bool state = m_rsdio->digitalRead(dio, pin, bypassCache);
         this->throwLastError();
         return state;
     }
@@ -74,6 +74,59 @@ class PyRsDio {
         return states;
     }
 
+    // Connectors without pins are left out.
+    std::map<int, std::pair<uint64_t, uint64_t>> readAllPacked()
+    {
+        rs::DioSnapshot snapshot = m_rsdio->readAllPacked();
+        this->throwLastError();
+
+        std::map<int, std::pair<uint64_t, uint64_t>> states;
+        for (int dio = 0; dio < rs::kMaxDios; ++dio) {
+            if (snapshot.valid[dio])
+                states[dio] = {snapshot.states[dio], snapshot.valid[dio]};
+        }
+        return states;
+    }
+
+    uint64_t readGroup(const std::string &name)
+    {
+        uint64_t value = m_rsdio->readGroup(name.c_str());
+        this->throwLastError();
+        return value;
+    }
+
+    void writeGroup(const std::string &name, uint64_t value)
+    {
+        m_rsdio->writeGroup(name.c_str(), value);
+        this->throwLastError();
+    }
+
+    void setWriteCombining(bool enabled, int windowUs)
+    {
+        m_rsdio->setWriteCombining(enabled, windowUs);
+        this->throwLastError();
+    }
+
+    void flush()
+    {
+        m_rsdio->flush();
+        this->throwLastError();
+    }
+
+    void setReadCacheMaxAge(int maxAgeUs)
+    {
+        m_rsdio->setReadCacheMaxAge(maxAgeUs);
+        this->throwLastError();
+    }
+
+    // (hits, misses)
+    std::pair<uint64_t, uint64_t> getReadCacheStats()
+    {
+        rs::ReadCacheStats stats = m_rsdio->getReadCacheStats();
+        this->throwLastError();
+        return {stats.hits, stats.misses};
+    }
+
     rs::diomap_t getPinList() const
     {
         rs::diomap_t map = m_rsdio->getPinList();
@@ -36,6 +36,18 @@ class PyRsPoe {
         this->throwLastError();
     }
 
+    void setPortStates(const std::map<int, rs::PoeState> &states)
+    {
+        m_rspoe->setPortStates(states);
+        this->throwLastError();
+    }
+
+    void resync()
+    {
+        m_rspoe->resync();
+        this->throwLastError();
+    }
+
     float getPortVoltage(int port)
     {
         float ret = m_rspoe->getPortVoltage(port);
@@ -57,6 +69,62 @@ class PyRsPoe {
         return ret;
     }
 
+    void startTelemetry(int intervalMs)
+    {
+        m_rspoe->startTelemetry(intervalMs);
+        this->throwLastError();
+    }
+
+    void stopTelemetry()
+    {
+        m_rspoe->stopTelemetry();
+        this->throwLastError();
+    }
+
+    double getPortEnergy(int port)
+    {
+        double ret = m_rspoe->getPortEnergy(port);
+        this->throwLastError();
+        return ret;
+    }
+
+    void resetPortEnergy(int port)
+    {
+        m_rspoe->resetPortEnergy(port);
+        this->throwLastError();
+    }
+
+    void setEnergyCheckpoint(const char *fileName, int intervalSec)
+    {
+        m_rspoe->setEnergyCheckpoint(fileName, intervalSec);
+        this->throwLastError();
+    }
+
+    void setBudgetLimit(float watts)
+    {
+        m_rspoe->setBudgetLimit(watts);
+        this->throwLastError();
+    }
+
+    void setPortPriority(int port, int priority)
+    {
+        m_rspoe->setPortPriority(port, priority);
+        this->throwLastError();
+    }
+
+    void setPortPowerLimit(int port, float watts)
+    {
+        m_rspoe->setPortPowerLimit(port, watts);
+        this->throwLastError();
+    }
+
+    std::vector<int> getShedPorts()
+    {
+        std::vector<int> ret = m_rspoe->getShedPorts();
+        this->throwLastError();
+        return ret;
+    }
+
     int getBudgetConsumed()
     {
         int ret = m_rspoe->getBudgetConsumed();
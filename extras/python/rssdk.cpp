@@ -53,7 +53,8 @@ PYBIND11_MODULE(rssdk, module)
             &PyRsDio::digitalRead,
             "Read the state of a single DIO pin",
             py::arg("dio"),
-            py::arg("pin")
+            py::arg("pin"),
+            py::arg("bypassCache") = false
         )
         .def(
             "digitalWrite",
@@ -84,6 +85,47 @@ PYBIND11_MODULE(rssdk, module)
             "Read the state of all pins on the specified DIO bank",
             py::arg("dio")
         )
+        .def(
+            "readAllPacked",
+            &PyRsDio::readAllPacked,
+            "Read every DIO bank at once as (states, valid) bitmasks"
+        )
+        .def(
+            "readGroup",
+            &PyRsDio::readGroup,
+            "Read a pin group from the XML file as an integer",
+            py::arg("name")
+        )
+        .def(
+            "writeGroup",
+            &PyRsDio::writeGroup,
+            "Write an integer to a pin group from the XML file",
+            py::arg("name"),
+            py::arg("value")
+        )
+        .def(
+            "setWriteCombining",
+            &PyRsDio::setWriteCombining,
+            "Merge pin writes into one write per register",
+            py::arg("enabled"),
+            py::arg("windowUs") = 0
+        )
+        .def(
+            "flush",
+            &PyRsDio::flush,
+            "Commit every combined write right away"
+        )
+        .def(
+            "setReadCacheMaxAge",
+            &PyRsDio::setReadCacheMaxAge,
+            "Serve digitalRead from register values up to maxAgeUs old",
+            py::arg("maxAgeUs")
+        )
+        .def(
+            "getReadCacheStats",
+            &PyRsDio::getReadCacheStats,
+            "Get the (hits, misses) of the read cache"
+        )
         .def(
             "getPinList",
             &PyRsDio::getPinList,
@@ -126,6 +168,17 @@ PYBIND11_MODULE(rssdk, module)
             py::arg("port"),
             py::arg("state")
         )
+        .def(
+            "setPortStates",
+            &PyRsPoe::setPortStates,
+            "Set the state of several ports at once",
+            py::arg("states")
+        )
+        .def(
+            "resync",
+            &PyRsPoe::resync,
+            "Re-read the port configuration from the controller"
+        )
         .def(
             "getPortVoltage",
             &PyRsPoe::getPortVoltage,
@@ -144,6 +197,61 @@ PYBIND11_MODULE(rssdk, module)
             "Get the power output of port in watts",
             py::arg("port")
         )
+        .def(
+            "startTelemetry",
+            &PyRsPoe::startTelemetry,
+            "Start sampling every port for the energy counters",
+            py::arg("intervalMs")
+        )
+        .def(
+            "stopTelemetry",
+            &PyRsPoe::stopTelemetry,
+            "Stop sampling the ports"
+        )
+        .def(
+            "getPortEnergy",
+            &PyRsPoe::getPortEnergy,
+            "Get the energy delivered on port in watt-hours",
+            py::arg("port")
+        )
+        .def(
+            "resetPortEnergy",
+            &PyRsPoe::resetPortEnergy,
+            "Reset the energy counter of port",
+            py::arg("port")
+        )
+        .def(
+            "setEnergyCheckpoint",
+            &PyRsPoe::setEnergyCheckpoint,
+            "Periodically save the energy counters to a file",
+            py::arg("fileName"),
+            py::arg("intervalSec")
+        )
+        .def(
+            "setBudgetLimit",
+            &PyRsPoe::setBudgetLimit,
+            "Shed low priority ports when the total power goes over watts",
+            py::arg("watts")
+        )
+        .def(
+            "setPortPriority",
+            &PyRsPoe::setPortPriority,
+            "Set the priority used to pick which ports to shed",
+            py::arg("port"),
+            py::arg("priority")
+        )
+        .def(
+            "setPortPowerLimit",
+            &PyRsPoe::setPortPowerLimit,
+            "Shed port when it draws more than watts",
+            py::arg("port"),
+            py::arg("watts")
+        )
+        .def(
+            "getShedPorts",
+            &PyRsPoe::getShedPorts,
+            "Get the ports turned off by the budget manager"
+        )
         .def(
             "getBudgetConsumed",
             &PyRsPoe::getBudgetConsumed,
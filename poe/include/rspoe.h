@@ -1,6 +1,10 @@
 #ifndef RSPOE_H
 #define RSPOE_H
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
 #include <string>
 #include <system_error>
 #include <vector>
@@ -11,6 +15,9 @@
 #include "rspoe_export.h"
 #endif
 
+#include "rsresult.h"
+#include "rsthread.h"
+
 namespace rs {
 
 enum class PoeState {
@@ -21,6 +28,23 @@ enum class PoeState {
            // for more details.
 };
 
+struct PoeSample {
+    uint64_t timestamp;  // Monotonic time in nanoseconds.
+    float voltage;       // Volts
+    float current;       // Amps
+};
+
+struct PoeCaptureStats {
+    uint64_t captured;  // Samples written to the capture buffer.
+    uint64_t dropped;   // Samples lost because the capture buffer was full.
+    uint64_t missed;    // Sample periods skipped because the bus fell behind.
+    uint64_t errors;    // Readings that failed on the bus.
+    uint64_t buffered;  // Samples waiting to be read from the buffer.
+    float rate;         // Achieved sample rate in Hz.
+};
+
+enum class CaptureFormat { Csv, Binary };
+
 class RsPoe {
    public:
     virtual ~RsPoe(){};
@@ -32,15 +56,53 @@ class RsPoe {
 
     virtual PoeState getPortState(int port) = 0;
     virtual void setPortState(int port, PoeState state) = 0;
+    virtual void setPortStates(const std::map<int, PoeState> &states) = 0;
+
+    virtual void resync() = 0;
 
     virtual float getPortVoltage(int port) = 0;
     virtual float getPortCurrent(int port) = 0;
     virtual float getPortPower(int port) = 0;
 
+    virtual void startCapture(
+        int port,
+        float rate,
+        PoeSample *buffer,
+        size_t size
+    ) = 0;
+    virtual void stopCapture() = 0;
+    virtual size_t readCapture(PoeSample *samples, size_t count) = 0;
+    virtual PoeCaptureStats getCaptureStats() = 0;
+    virtual void exportCapture(const char *fileName, CaptureFormat format) = 0;
+
+    virtual void startTelemetry(int intervalMs) = 0;
+    virtual void stopTelemetry() = 0;
+
+    virtual double getPortEnergy(int port) = 0;
+    virtual void resetPortEnergy(int port) = 0;
+    virtual void setEnergyCheckpoint(const char *fileName, int intervalSec) = 0;
+
+    virtual void setBudgetLimit(float watts) = 0;
+    virtual void setPortPriority(int port, int priority) = 0;
+    virtual void setPortPowerLimit(int port, float watts) = 0;
+    virtual std::vector<int> getShedPorts() = 0;
+
     virtual int getBudgetConsumed() = 0;
     virtual int getBudgetAvailable() = 0;
     virtual int getBudgetTotal() = 0;
 
+    virtual void setThreadConfig(const ThreadConfig &config) = 0;
+    virtual JitterReport getJitterReport() = 0;
+
+    // Variants of the port functions that return their error along with the
+    // value instead of setting the last error.
+    virtual Result<PoeState> getPortStateEx(int port) = 0;
+    virtual Result<void> setPortStateEx(int port, PoeState state) = 0;
+    virtual Result<float> getPortVoltageEx(int port) = 0;
+    virtual Result<float> getPortCurrentEx(int port) = 0;
+    virtual Result<float> getPortPowerEx(int port) = 0;
+    virtual Result<double> getPortEnergyEx(int port) = 0;
+
     virtual std::error_code getLastError() const = 0;
     virtual std::string getLastErrorString() const = 0;
 };
@@ -0,0 +1,231 @@
+#include "budgetmanager.h"
+
+#include <algorithm>
+
+constexpr float BudgetManager::kShedMargin;
+constexpr float BudgetManager::kRestoreHysteresis;
+constexpr int BudgetManager::kRestoreSweeps;
+
+BudgetManager::BudgetManager()
+    : mp_controller(nullptr),
+      m_budget(0),
+      m_budgetKnown(false),
+      m_enforced(false),
+      m_restoreCount(0),
+      m_errors(0)
+{
+}
+
+void BudgetManager::setController(
+    AbstractPoeController *controller,
+    const portmap_t &portMap
+)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    mp_controller = controller;
+    m_budget = 0;
+    m_budgetKnown = false;
+    m_enforced = false;
+
+    m_ports.clear();
+    for (const auto &pair : portMap) {
+        PortBudget budget;
+        budget.port = pair.first;
+        budget.internalPort = pair.second;
+        budget.priority = 0;
+        budget.powerLimit = 0;
+        budget.shed = false;
+        budget.shedPower = 0;
+        budget.restoreState = rs::PoeState::Auto;
+        m_ports.push_back(budget);
+    }
+
+    updateOrder();
+}
+
+void BudgetManager::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    mp_controller = nullptr;
+    m_budget = 0;
+    m_budgetKnown = false;
+    m_enforced = false;
+    m_ports.clear();
+    m_shedOrder.clear();
+}
+
+void BudgetManager::setBudget(float watts)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_budget = watts > 0 ? watts : 0;
+    m_budgetKnown = true;
+    m_enforced = true;
+}
+
+void BudgetManager::setPriority(int port, int priority)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    PortBudget *budget = find(port);
+    if (!budget) return;
+
+    budget->priority = priority;
+    m_enforced = true;
+    updateOrder();
+}
+
+void BudgetManager::setPowerLimit(int port, float watts)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    PortBudget *budget = find(port);
+    if (budget) budget->powerLimit = watts > 0 ? watts : 0;
+}
+
+void BudgetManager::release(int port)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    PortBudget *budget = find(port);
+    if (budget) budget->shed = false;
+}
+
+std::vector<int> BudgetManager::shedPorts() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<int> ports;
+    for (const PortBudget &budget : m_ports) {
+        if (budget.shed) ports.push_back(budget.port);
+    }
+
+    return ports;
+}
+
+void BudgetManager::onTelemetryStarted()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_restoreCount = 0;
+}
+
+void BudgetManager::onSweep(const TelemetrySweep &sweep)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!mp_controller || !sweep.valid) return;
+    if (sweep.readings.size() != m_ports.size()) return;
+
+    float total = 0;
+    for (size_t i = 0; i < m_ports.size(); ++i) {
+        PortBudget &budget = m_ports[i];
+        float power = sweep.readings[i].power;
+        total += power;
+
+        if (!budget.shed && budget.powerLimit > 0 &&
+            power > budget.powerLimit && shed(budget, power))
+            total -= power;
+    }
+
+    // The controller's total is only asked for once a budget is actually
+    // wanted, and asked again next sweep if that fails.
+    if (m_enforced && !m_budgetKnown) {
+        try {
+            float watts = mp_controller->getBudgetTotal();
+            m_budget = watts > 0 ? watts : 0;
+            m_budgetKnown = true;
+        }
+        catch (...) {
+            ++m_errors;
+        }
+    }
+
+    float limit = m_budget * (1.0f - kShedMargin);
+    if (m_budget > 0 && total > limit) {
+        m_restoreCount = 0;
+        for (size_t index : m_shedOrder) {
+            if (total <= limit) break;
+
+            PortBudget &budget = m_ports[index];
+            float power = sweep.readings[index].power;
+            // Turning off a port that isn't drawing anything won't help.
+            if (budget.shed || power <= 0) continue;
+
+            if (shed(budget, power)) total -= power;
+        }
+
+        return;
+    }
+
+    if (++m_restoreCount < kRestoreSweeps) return;
+
+    // Only restore one port per sweep so its draw shows up in the next
+    // sweep before anything else is turned back on.
+    for (auto it = m_shedOrder.rbegin(); it != m_shedOrder.rend(); ++it) {
+        PortBudget &budget = m_ports[*it];
+        if (!budget.shed) continue;
+        // Turning it back on would only shed it again in the next sweep.
+        if (budget.powerLimit > 0 && budget.shedPower > budget.powerLimit)
+            continue;
+
+        float headroom = m_budget * (1.0f - kRestoreHysteresis) - total;
+        if (m_budget > 0 && budget.shedPower > headroom) break;
+
+        restore(budget);
+        m_restoreCount = 0;
+        break;
+    }
+}
+
+// Shed order is lowest priority first. Ports with the same priority are shed
+// from the highest port number down. This only runs when the configuration
+// changes so the sweep itself stays linear in the number of ports.
+void BudgetManager::updateOrder()
+{
+    m_shedOrder.resize(m_ports.size());
+    for (size_t i = 0; i < m_shedOrder.size(); ++i) m_shedOrder[i] = i;
+
+    std::stable_sort(
+        m_shedOrder.begin(),
+        m_shedOrder.end(),
+        [this](size_t a, size_t b) {
+            if (m_ports[a].priority != m_ports[b].priority)
+                return m_ports[a].priority < m_ports[b].priority;
+            return m_ports[a].port > m_ports[b].port;
+        }
+    );
+}
+
+bool BudgetManager::shed(PortBudget &budget, float power)
+{
+    try {
+        rs::PoeState state = mp_controller->getPortState(budget.internalPort);
+        if (state == rs::PoeState::Disabled) return false;
+
+        mp_controller->setPortState(budget.internalPort, rs::PoeState::Disabled);
+        budget.shed = true;
+        budget.shedPower = power;
+        budget.restoreState = state;
+        return true;
+    }
+    catch (...) {
+        ++m_errors;
+        return false;
+    }
+}
+
+bool BudgetManager::restore(PortBudget &budget)
+{
+    try {
+        mp_controller->setPortState(budget.internalPort, budget.restoreState);
+        budget.shed = false;
+        return true;
+    }
+    catch (...) {
+        ++m_errors;
+        return false;
+    }
+}
+
+BudgetManager::PortBudget *BudgetManager::find(int port)
+{
+    for (PortBudget &budget : m_ports) {
+        if (budget.port == port) return &budget;
+    }
+
+    return nullptr;
+}
@@ -0,0 +1,97 @@
+#ifndef BUDGETMANAGER_H
+#define BUDGETMANAGER_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "controllers/abstractpoecontroller.h"
+#include "poetelemetry.h"
+
+// Enforces an SDK side power budget using the telemetry sweep. Nothing is
+// shed for the budget until a budget or a port priority is set, so starting
+// the telemetry for something else never turns ports off. Setting only
+// priorities makes the budget the controller's own budget total.
+//
+// When the total power of all ports comes within kShedMargin of the budget,
+// ports are turned off starting with the lowest priority until the total is
+// below that again, so the SDK acts before the controller starts shutting
+// down ports on its own. All the ports needed are shed in the same sweep so
+// the reaction time is bounded by one telemetry interval plus the time it
+// takes to write the port states. Ports that draw more than their own power
+// limit are shed regardless of the budget.
+//
+// Shed ports are restored one at a time, highest priority first, once the
+// total has stayed far enough below the budget to fit the power the port was
+// drawing when it was shed. A port shed for going over its own limit stays
+// off until that limit is raised or cleared.
+//
+// Port states are written from the telemetry thread, which relies on the
+// controllers serializing access to their register shadows.
+class BudgetManager : public TelemetryListener {
+   public:
+    // Fraction of the budget that is kept free by shedding.
+    static constexpr float kShedMargin = 0.05f;
+    // Fraction of the budget that has to stay free before a port is
+    // restored. Larger than kShedMargin, so restoring a port never pushes
+    // the total straight back into shedding.
+    static constexpr float kRestoreHysteresis = 0.1f;
+    // Number of consecutive sweeps under budget before a port is restored.
+    static constexpr int kRestoreSweeps = 5;
+
+    BudgetManager();
+
+    void setController(
+        AbstractPoeController *controller,
+        const portmap_t &portMap
+    );
+    void clear();
+
+    void setBudget(float watts);
+    void setPriority(int port, int priority);
+    void setPowerLimit(int port, float watts);
+
+    // Called when the user sets the state of a port so it's no longer
+    // restored behind their back.
+    void release(int port);
+
+    std::vector<int> shedPorts() const;
+    uint64_t errorCount() const { return m_errors; }
+
+    void onTelemetryStarted() override;
+    void onSweep(const TelemetrySweep &sweep) override;
+
+   private:
+    struct PortBudget {
+        int port;
+        uint8_t internalPort;
+        int priority;
+        float powerLimit;  // 0 means no limit
+        bool shed;
+        float shedPower;  // Power drawn when the port was shed
+        rs::PoeState restoreState;
+    };
+
+    void updateOrder();
+    bool shed(PortBudget &budget, float power);
+    bool restore(PortBudget &budget);
+    PortBudget *find(int port);
+
+    mutable std::mutex m_mutex;
+    AbstractPoeController *mp_controller;
+    float m_budget;  // 0 means no budget
+    bool m_budgetKnown;  // m_budget was set or read from the controller
+    bool m_enforced;  // A budget or a priority was set
+
+    // Indexed like the telemetry sweep, i.e. in port order.
+    std::vector<PortBudget> m_ports;
+    // Indices into m_ports from the first port to shed to the last.
+    std::vector<size_t> m_shedOrder;
+
+    int m_restoreCount;
+    std::atomic<uint64_t> m_errors;
+};
+
+#endif  // BUDGETMANAGER_H
@@ -5,6 +5,19 @@
 
 #include <stdint.h>
 
+#include <map>
+#include <vector>
+
+// Maps the port numbers printed on the unit to the controller's port numbers.
+typedef std::map<int, uint8_t> portmap_t;
+typedef std::map<uint8_t, rs::PoeState> portstatemap_t;
+
+struct PortReading
+{
+    float voltage;
+    float current;
+    float power;
+};
 
 class AbstractPoeController
 {
@@ -14,6 +27,17 @@ public:
 	virtual rs::PoeState getPortState(uint8_t port) = 0;
 	virtual void setPortState(uint8_t port, rs::PoeState state) = 0;
 
+    // Applies the state of several ports at once. Controllers override this to
+    // merge the changes into as few bus operations as possible.
+    virtual void setPortStates(const portstatemap_t &states)
+    {
+        for (const auto &pair : states)
+            setPortState(pair.first, pair.second);
+    }
+
+    // Re-reads any register state the controller caches.
+    virtual void resync() {}
+
     virtual float getPortVoltage(uint8_t port) { throw std::system_error(std::make_error_code(std::errc::function_not_supported)); }
 	virtual float getPortCurrent(uint8_t port) { throw std::system_error(std::make_error_code(std::errc::function_not_supported)); }
 	virtual float getPortPower(uint8_t port)
@@ -21,6 +45,28 @@ public:
         return getPortVoltage(port) * getPortCurrent(port);
     };
 
+    // Reads the voltage and current of a port together. Controllers override
+    // this when both values can be fetched in a single bus operation.
+    virtual PortReading getPortReading(uint8_t port)
+    {
+        PortReading reading;
+        reading.voltage = getPortVoltage(port);
+        reading.current = getPortCurrent(port);
+        reading.power = reading.voltage * reading.current;
+        return reading;
+    }
+
+    // Reads several ports in one sweep. readings is resized to match ports.
+    virtual void getPortReadings(
+        const std::vector<uint8_t> &ports,
+        std::vector<PortReading> &readings
+    )
+    {
+        readings.resize(ports.size());
+        for (size_t i = 0; i < ports.size(); ++i)
+            readings[i] = getPortReading(ports[i]);
+    }
+
     virtual int getBudgetConsumed()     { throw std::system_error(std::make_error_code(std::errc::function_not_supported)); }
     virtual int getBudgetAvailable()    { throw std::system_error(std::make_error_code(std::errc::function_not_supported)); }
     virtual int getBudgetTotal()        { throw std::system_error(std::make_error_code(std::errc::function_not_supported)); }
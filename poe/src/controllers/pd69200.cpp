@@ -25,6 +25,8 @@
 #define MSG_CHKSUM_L(msg) msg[MSG_LEN - 1]
 #define MSG_CHKSUM_H(msg) msg[MSG_LEN - 2]
 
+#define ALL_PORTS 0x80
+
 #define PD69200_ID 0x16
 #define PD69220_ID 0x1C
 
@@ -185,10 +187,16 @@ static uint16_t calcCheckSum(const uint8_t *msg, size_t size)
     return sum;
 }
 
-Pd69200::Pd69200(uint16_t bus, uint8_t dev, uint16_t totalBudget)
+Pd69200::Pd69200(
+    uint16_t bus,
+    uint8_t dev,
+    uint16_t totalBudget,
+    uint8_t channelCount
+)
     : AbstractPoeController(),
       m_busAddr(bus),
       m_devAddr(dev),
+      m_channelCount(channelCount),
       m_lastEcho(0),
       m_lastCommandTime()
 {
@@ -219,7 +227,7 @@ Pd69200::~Pd69200() {}
 
 rs::PoeState Pd69200::getPortState(uint8_t port)
 {
-    if (port == 0x80)
+    if (port == ALL_PORTS)
         throw std::system_error(
             std::make_error_code(std::errc::invalid_argument), "Invalid port"
         );
@@ -257,9 +265,47 @@ void Pd69200::setPortState(uint8_t port, rs::PoeState state)
     }
 }
 
+void Pd69200::setPortStates(const portstatemap_t &states)
+{
+    for (const auto &pair : states) {
+        if (pair.second == rs::PoeState::Error)
+            throw std::system_error(
+                std::make_error_code(std::errc::invalid_argument),
+                "Invalid PoE state"
+            );
+    }
+
+    // Every command costs at least 30ms so the only way to speed this up is to
+    // send fewer of them. When every channel is being set we can apply the
+    // most common state to all of them with a single broadcast and then only
+    // touch the ports that differ from it. The broadcast reaches every channel
+    // of the chip, so it's only used when states covers all of them; a channel
+    // without a port in the XML file must not be switched on behind the
+    // user's back. The keys are unique, so states covers every channel if it
+    // has channelCount entries that are all below it.
+    bool allChannels = m_channelCount > 0 && states.size() == m_channelCount &&
+                       states.rbegin()->first < m_channelCount;
+    if (!allChannels || states.size() < 2) {
+        for (const auto &pair : states) setPortState(pair.first, pair.second);
+        return;
+    }
+
+    std::map<rs::PoeState, size_t> counts;
+    rs::PoeState common = states.begin()->second;
+    for (const auto &pair : states) {
+        if (++counts[pair.second] > counts[common]) common = pair.second;
+    }
+
+    setPortState(ALL_PORTS, common);
+
+    for (const auto &pair : states) {
+        changePortState(pair.first, common, pair.second);
+    }
+}
+
 float Pd69200::getPortVoltage(uint8_t port)
 {
-    if (port == 0x80)
+    if (port == ALL_PORTS)
         throw std::system_error(
             std::make_error_code(std::errc::invalid_argument), "Invalid port"
         );
@@ -269,7 +315,7 @@ float Pd69200::getPortVoltage(uint8_t port)
 
 float Pd69200::getPortCurrent(uint8_t port)
 {
-    if (port == 0x80)
+    if (port == ALL_PORTS)
         throw std::system_error(
             std::make_error_code(std::errc::invalid_argument), "Invalid port"
         );
@@ -279,7 +325,7 @@ float Pd69200::getPortCurrent(uint8_t port)
 
 float Pd69200::getPortPower(uint8_t port)
 {
-    if (port == 0x80)
+    if (port == ALL_PORTS)
         throw std::system_error(
             std::make_error_code(std::errc::invalid_argument), "Invalid port"
         );
@@ -287,6 +333,22 @@ float Pd69200::getPortPower(uint8_t port)
     return getPortMeasurements(port).wattage;
 }
 
+PortReading Pd69200::getPortReading(uint8_t port)
+{
+    if (port == ALL_PORTS)
+        throw std::system_error(
+            std::make_error_code(std::errc::invalid_argument), "Invalid port"
+        );
+
+    PortMeasurements m = getPortMeasurements(port);
+
+    PortReading reading;
+    reading.voltage = m.voltage;
+    reading.current = m.current;
+    reading.power = m.wattage;
+    return reading;
+}
+
 int Pd69200::getBudgetConsumed()
 {
     return getSystemMeasuerments().calculatedWatts;
@@ -301,6 +363,8 @@ int Pd69200::getBudgetTotal() { return getSystemMeasuerments().budgetedWatts; }
 
 msg_t Pd69200::sendMsgToController(msg_t &msg)
 {
+    std::lock_guard<std::mutex> lock(m_msgMutex);
+
     msg[1] = m_lastEcho++;
     if (m_lastEcho > 0xFE)
         m_lastEcho = 0;  // According to docs echo shouldn't exceed 0xFE.
@@ -448,6 +512,21 @@ void Pd69200::setPortForce(uint8_t port, bool force)
     sendMsgToController(msg);
 }
 
+// Sends only the commands needed to move a port between two known states.
+// Follows the same ordering as setPortState: enable before forcing power on and
+// remove the force before disabling.
+void Pd69200::changePortState(uint8_t port, rs::PoeState from, rs::PoeState to)
+{
+    bool wasEnabled = (from != rs::PoeState::Disabled);
+    bool wasForced = (from == rs::PoeState::Enabled);
+    bool enable = (to != rs::PoeState::Disabled);
+    bool force = (to == rs::PoeState::Enabled);
+
+    if (enable && !wasEnabled) setPortEnabled(port, true);
+    if (force != wasForced) setPortForce(port, force);
+    if (!enable && wasEnabled) setPortEnabled(port, false);
+}
+
 Pd69200::PortMeasurements Pd69200::getPortMeasurements(uint8_t port)
 {
     msg_t response, msg = getMeasurementsCmd;
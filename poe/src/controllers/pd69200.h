@@ -3,6 +3,7 @@
 
 #include <array>
 #include <chrono>
+#include <mutex>
 
 #include "abstractpoecontroller.h"
 
@@ -13,15 +14,19 @@ typedef std::chrono::high_resolution_clock clock_timer_t;
 class Pd69200 : public AbstractPoeController
 {
 public:
-	Pd69200(uint16_t bus, uint8_t dev, uint16_t totalBudget=170);
+	// channelCount is the number of channels behind the controller, 0 if it
+	// isn't known.
+	Pd69200(uint16_t bus, uint8_t dev, uint16_t totalBudget=170, uint8_t channelCount=0);
 	~Pd69200() override;
 
 	rs::PoeState getPortState(uint8_t port) override;
 	void setPortState(uint8_t port, rs::PoeState state) override;
+	void setPortStates(const portstatemap_t &states) override;
 
 	float getPortVoltage(uint8_t port) override;
 	float getPortCurrent(uint8_t port) override;
 	float getPortPower(uint8_t port) override;
+	PortReading getPortReading(uint8_t port) override;
 
 	int getBudgetConsumed() override;
 	int getBudgetAvailable() override;
@@ -30,9 +35,13 @@ public:
 private:
 	uint16_t m_busAddr;
 	uint8_t m_devAddr;
+	uint8_t m_channelCount;
 	uint8_t m_lastEcho;
     uint8_t m_devId;
     clock_timer_t::time_point m_lastCommandTime;
+    // A message is a write followed by a read of the response so it has to be
+    // atomic when the controller is shared with a background thread.
+    std::mutex m_msgMutex;
 
     msg_t sendMsgToController(msg_t& msg);
 
@@ -51,6 +60,7 @@ private:
 	PortStatus getPortStatus(uint8_t port);
 	void setPortEnabled(uint8_t port, bool enable);
 	void setPortForce(uint8_t port, bool force);
+	void changePortState(uint8_t port, rs::PoeState from, rs::PoeState to);
 
 	struct PortMeasurements
 	{
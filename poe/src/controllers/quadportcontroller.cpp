@@ -0,0 +1,336 @@
+#include "quadportcontroller.h"
+#include "../../../utils/i801_smbus.h"
+
+#include <system_error>
+
+//Registers shared by the PD69104 and the LTC4266.
+static const uint8_t kSataPwrReg = 0x10;	//Power Status register
+static const uint8_t kOpmdReg = 0x12;		//Operating Mode register
+static const uint8_t kDisenaReg = 0x13;     //Disconnect Sensing Enable register
+static const uint8_t kDetenaReg = 0x14;     //Detection and Classification Enable register
+static const uint8_t kPwrpbReg = 0x19;		//Power On/Off Pushbutton register
+
+static const float kVoltsCoef = 5.835f;
+static const uint8_t kPort1VoltReg = 0x32;
+static const uint8_t kPort2VoltReg = 0x36;
+static const uint8_t kPort3VoltReg = 0x3A;
+static const uint8_t kPort4VoltReg = 0x3E;
+
+static const float kCurCoef = 122.07f;
+static const uint8_t kPort1CurReg = 0x30;
+static const uint8_t kPort2CurReg = 0x34;
+static const uint8_t kPort3CurReg = 0x38;
+static const uint8_t kPort4CurReg = 0x3C;
+
+//How long the shadow of the configuration registers is trusted before it's re-read.
+static const std::chrono::milliseconds kShadowMaxAge(1000);
+
+static const uint8_t kShutdownMode = 0;
+static const uint8_t kManualMode =	1;
+static const uint8_t kSemiAutoMode = 2;
+static const uint8_t kAutoMode = 3;
+
+QuadPortController::QuadPortController(uint16_t bus, uint8_t dev) :
+	AbstractPoeController(),
+	m_busAddr(bus),
+	m_devAddr(dev),
+	m_shadow(),
+	m_shadowValid(false),
+	m_shadowTime()
+{
+}
+
+rs::PoeState QuadPortController::getPortState(uint8_t port)
+{
+	std::lock_guard<std::mutex> lock(m_shadowMutex);
+	uint8_t mode = getPortMode(port);
+	if (mode == kManualMode)
+		return rs::PoeState::Enabled;
+	else if (mode == kShutdownMode)
+		return rs::PoeState::Disabled;
+	else if (mode == kAutoMode)
+		return rs::PoeState::Auto;
+	else
+		throw std::system_error(std::make_error_code(std::errc::protocol_error), "Received invalid data from controller");
+}
+
+void QuadPortController::setPortState(uint8_t port, rs::PoeState state)
+{
+	std::lock_guard<std::mutex> lock(m_shadowMutex);
+	switch (state)
+	{
+		case rs::PoeState::Enabled:
+			setPortMode(port, kManualMode);
+			setPortDetection(port, false);
+			setPortClassification(port, false);
+			setPortSensing(port, false);
+			setPortEnabled(port, true);
+			break;
+		case rs::PoeState::Disabled:
+			setPortMode(port, kShutdownMode);
+			break;
+		case rs::PoeState::Auto:
+			setPortMode(port, kAutoMode);
+			setPortDetection(port, true);
+			setPortClassification(port, true);
+			setPortSensing(port, true);
+			break;
+		case rs::PoeState::Error:
+			throw std::system_error(std::make_error_code(std::errc::invalid_argument), "Invalid PoE state");
+	}
+}
+
+void QuadPortController::setPortStates(const portstatemap_t &states)
+{
+	std::lock_guard<std::mutex> lock(m_shadowMutex);
+	//Same sequence as setPortState but every register is written at most once
+	//no matter how many ports are being changed.
+	uint8_t mode = readConfigRegister(kOpmdReg);
+	uint8_t detectMask = 0;
+	uint8_t powerOn = 0;
+
+	for (const auto &pair : states)
+	{
+		uint8_t port = pair.first;
+		mode &= ~(0b11 << (port * 2));
+		switch (pair.second)
+		{
+			case rs::PoeState::Enabled:
+				mode |= (kManualMode << (port * 2));
+				detectMask |= (1 << port);
+				powerOn |= (1 << port);
+				break;
+			case rs::PoeState::Disabled:
+				mode |= (kShutdownMode << (port * 2));
+				break;
+			case rs::PoeState::Auto:
+				mode |= (kAutoMode << (port * 2));
+				detectMask |= (1 << port);
+				break;
+			case rs::PoeState::Error:
+				throw std::system_error(std::make_error_code(std::errc::invalid_argument), "Invalid PoE state");
+		}
+	}
+
+	writeConfigRegister(kOpmdReg, mode);
+
+	//Disabled ports leave detection, classification and sensing untouched.
+	if (detectMask == 0)
+		return;
+
+	//Ports in detectMask that aren't powered on manually are in auto mode.
+	uint8_t autoMask = detectMask & ~powerOn;
+
+	//Detection is in the 4 LSBs and classification in the 4 MSBs.
+	uint8_t data = readConfigRegister(kDetenaReg);
+	data &= ~(detectMask | (detectMask << 4));
+	data |= autoMask | (autoMask << 4);
+	writeConfigRegister(kDetenaReg, data);
+
+	data = readConfigRegister(kDisenaReg);
+	data &= 0x0F;
+	data &= ~detectMask;
+	data |= autoMask;
+	writeConfigRegister(kDisenaReg, data);
+
+	if (powerOn)
+		smbus_write_register(m_busAddr, m_devAddr, kPwrpbReg, powerOn);
+}
+
+float QuadPortController::getPortVoltage(uint8_t port)
+{
+	uint8_t reg = 0;
+	if (port == 0) reg = kPort1VoltReg;
+	else if (port == 1) reg = kPort2VoltReg;
+	else if (port == 2) reg = kPort3VoltReg;
+	else if (port == 3) reg = kPort4VoltReg;
+
+	if (reg == 0)
+		throw std::system_error(std::make_error_code(std::errc::invalid_argument), "Invalid port");
+
+	uint8_t data = smbus_read_register(m_busAddr, m_devAddr, reg);
+	uint16_t volts = 0x00FF & data;
+	data = smbus_read_register(m_busAddr, m_devAddr, reg+1);
+	volts |= data << 8;
+	return (volts * kVoltsCoef) / 1000.0f; // Convert from mV to V
+}
+
+float QuadPortController::getPortCurrent(uint8_t port)
+{
+	uint8_t reg = 0;
+	if (port == 0) reg = kPort1CurReg;
+	else if (port == 1) reg = kPort2CurReg;
+	else if (port == 2) reg = kPort3CurReg;
+	else if (port == 3) reg = kPort4CurReg;
+
+	if (reg == 0)
+		throw std::system_error(std::make_error_code(std::errc::invalid_argument), "Invalid port");
+
+	uint8_t data = smbus_read_register(m_busAddr, m_devAddr, reg);
+	uint16_t cur = 0x00FF & data;
+	data = smbus_read_register(m_busAddr, m_devAddr, reg+1);
+	cur |= data << 8;
+
+	return (cur * kCurCoef) / 1000000.0f; // Convert from uA to A
+}
+
+//Converts the raw current and voltage registers of a port into a reading.
+static PortReading toPortReading(const uint8_t *data)
+{
+	uint16_t cur = data[0] | (data[1] << 8);
+	uint16_t volts = data[2] | (data[3] << 8);
+
+	PortReading reading;
+	reading.current = (cur * kCurCoef) / 1000000.0f; // Convert from uA to A
+	reading.voltage = (volts * kVoltsCoef) / 1000.0f; // Convert from mV to V
+	reading.power = reading.voltage * reading.current;
+	return reading;
+}
+
+PortReading QuadPortController::getPortReading(uint8_t port)
+{
+	if (port > 3)
+		throw std::system_error(std::make_error_code(std::errc::invalid_argument), "Invalid port");
+
+	//Each port's current and voltage registers are next to each other
+	//so both can be fetched with a single block read.
+	uint8_t data[4];
+	i2c_read_block(m_busAddr, m_devAddr, kPort1CurReg + (port * 4), data, sizeof(data));
+	return toPortReading(data);
+}
+
+void QuadPortController::getPortReadings(const std::vector<uint8_t> &ports, std::vector<PortReading> &readings)
+{
+	for (uint8_t port : ports)
+	{
+		if (port > 3)
+			throw std::system_error(std::make_error_code(std::errc::invalid_argument), "Invalid port");
+	}
+
+	//All four ports' measurements live in 0x30 - 0x3F so a single
+	//block read covers the whole sweep.
+	uint8_t data[16];
+	i2c_read_block(m_busAddr, m_devAddr, kPort1CurReg, data, sizeof(data));
+
+	readings.resize(ports.size());
+	for (size_t i = 0; i < ports.size(); ++i)
+		readings[i] = toPortReading(&data[ports[i] * 4]);
+}
+
+void QuadPortController::resync()
+{
+	std::lock_guard<std::mutex> lock(m_shadowMutex);
+	syncShadow();
+}
+
+void QuadPortController::syncShadow()
+{
+	m_shadowValid = false;
+	for (uint8_t i = 0; i < sizeof(m_shadow); ++i)
+		m_shadow[i] = smbus_read_register(m_busAddr, m_devAddr, kOpmdReg + i);
+	m_shadowValid = true;
+	m_shadowTime = std::chrono::steady_clock::now();
+}
+
+bool QuadPortController::isShadowFresh() const
+{
+	return m_shadowValid && std::chrono::steady_clock::now() - m_shadowTime < kShadowMaxAge;
+}
+
+//kOpmdReg, kDisenaReg and kDetenaReg are consecutive so the shadow is indexed from kOpmdReg.
+uint8_t QuadPortController::readConfigRegister(uint8_t reg)
+{
+	if (!isShadowFresh())
+		syncShadow();
+
+	return m_shadow[reg - kOpmdReg];
+}
+
+void QuadPortController::writeConfigRegister(uint8_t reg, uint8_t data)
+{
+	//Only skip the write while the shadow is fresh, an old one may no longer match the chip.
+	if (isShadowFresh() && m_shadow[reg - kOpmdReg] == data)
+		return;
+
+	//If the write fails we no longer know what the chip holds so force a resync on the next access.
+	m_shadowValid = false;
+	smbus_write_register(m_busAddr, m_devAddr, reg, data);
+	m_shadow[reg - kOpmdReg] = data;
+	m_shadowValid = true;
+}
+
+void QuadPortController::setPortEnabled(uint8_t port, bool enabled)
+{
+	uint8_t data = 0;
+	if (enabled) data = (1 << port);
+	else data = (1 << (port + 4));
+
+	smbus_write_register(m_busAddr, m_devAddr, kPwrpbReg, data);
+}
+
+uint8_t QuadPortController::getPortMode(uint8_t port)
+{
+	uint8_t data = readConfigRegister(kOpmdReg);
+	//The mode is stored in two bits so lets shift it over until the two bits for our port are the LSBs.
+	return ((data >> (port * 2)) & 0b11);
+}
+
+void QuadPortController::setPortMode(uint8_t port, uint8_t mode)
+{
+	uint8_t data = readConfigRegister(kOpmdReg);
+	data &= ~(0b11 << (port * 2));			//Make sure both bits for this port are low.
+	data |= (mode << (port * 2));			//Then just OR the desired mode (shifted to the correct position) and we are good.
+	writeConfigRegister(kOpmdReg, data);
+}
+
+bool QuadPortController::getPortSensing(uint8_t port)
+{
+	uint8_t data = readConfigRegister(kDisenaReg);
+	//Sensing is enabled if the ports bit is set in the 4 MSBs or 4 LSBs so we check both.
+	//We always only set the 4 LSBs but lets be safe in case someone else has been messing around in the registers.
+	return (data & ((1 << (port + 4)) | (1 << port))) != 0;
+}
+
+void QuadPortController::setPortSensing(uint8_t port, bool sense)
+{
+	uint8_t data = readConfigRegister(kDisenaReg);
+	//Bits 4-7 do the same thing as 0-3 on this chip (PD69104).
+	//To avoid confusion, let's only work with bits 0-3 and always keeps bits 4-7 low.
+	data &= 0x0F;
+	if (sense) data |= (1 << port);
+	else data &= ~(1 << port);
+
+	writeConfigRegister(kDisenaReg, data);
+}
+
+bool QuadPortController::getPortDetection(uint8_t port)
+{
+	uint8_t data = readConfigRegister(kDetenaReg);
+	return (data & (1 << port)) != 0;
+}
+
+void QuadPortController::setPortDetection(uint8_t port, bool detect)
+{
+	uint8_t data = readConfigRegister(kDetenaReg);
+	if (detect) data |= (1 << port);
+	else data &= ~(1 << port);
+	writeConfigRegister(kDetenaReg, data);
+}
+
+bool QuadPortController::getPortClassification(uint8_t port)
+{
+	uint8_t data = readConfigRegister(kDetenaReg);
+	//Left shift by 4 since Classification is stored in the 4 MSBs
+	return (data & (1 << (port + 4))) != 0;
+}
+
+void QuadPortController::setPortClassification(uint8_t port, bool classify)
+{
+	uint8_t data = readConfigRegister(kDetenaReg);
+	//Classification and Detection are in the same register. 
+	//4 MSBs are for Classification so we need to shift our bitmask.
+	if (classify) data |= (1 << (port + 4));
+	else data &= ~(1 << (port + 4));
+
+	writeConfigRegister(kDetenaReg, data);
+}
@@ -0,0 +1,64 @@
+#ifndef QUADPORTCONTROLLER_H
+#define QUADPORTCONTROLLER_H
+
+#include "abstractpoecontroller.h"
+
+#include <chrono>
+#include <mutex>
+
+// The PD69104 and the LTC4266 share the register map of their four ports,
+// so everything but the device ID and the budget lives here. Subclasses
+// check the device ID and then call resync to load the shadow.
+class QuadPortController : public AbstractPoeController
+{
+public:
+	rs::PoeState getPortState(uint8_t port) override;
+	void setPortState(uint8_t port, rs::PoeState state) override;
+	void setPortStates(const portstatemap_t &states) override;
+	void resync() override;
+
+	float getPortVoltage(uint8_t port) override;
+	float getPortCurrent(uint8_t port) override;
+	PortReading getPortReading(uint8_t port) override;
+	void getPortReadings(const std::vector<uint8_t> &ports, std::vector<PortReading> &readings) override;
+
+protected:
+	QuadPortController(uint16_t bus, uint8_t dev);
+
+	uint16_t m_busAddr;
+	uint8_t m_devAddr;
+
+private:
+	// Write-through copies of the mode, disconnect sensing and detect/classify
+	// registers so state changes don't have to read them back. They're re-read
+	// once they're older than kShadowMaxAge, so a change made outside of the
+	// SDK can't turn state changes into no-ops for long.
+	uint8_t m_shadow[3];
+	bool m_shadowValid;
+	std::chrono::steady_clock::time_point m_shadowTime;
+	// Guards the shadow, since both the caller and the telemetry thread
+	// change port states. Readings don't need it.
+	std::mutex m_shadowMutex;
+
+	void syncShadow();
+	bool isShadowFresh() const;
+
+	uint8_t readConfigRegister(uint8_t reg);
+	void writeConfigRegister(uint8_t reg, uint8_t data);
+
+	void setPortEnabled(uint8_t port, bool enabled);
+
+	uint8_t getPortMode(uint8_t port);
+	void setPortMode(uint8_t port, uint8_t mode);
+
+	bool getPortSensing(uint8_t port);
+	void setPortSensing(uint8_t port, bool sense);
+
+	bool getPortDetection(uint8_t port);
+	void setPortDetection(uint8_t port, bool detect);
+
+	bool getPortClassification(uint8_t port);
+	void setPortClassification(uint8_t port, bool classify);
+};
+
+#endif
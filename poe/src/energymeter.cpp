@@ -0,0 +1,182 @@
+#include "energymeter.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <system_error>
+
+static const double kNsPerHour = 3600.0 * 1e9;
+
+EnergyMeter::EnergyMeter()
+    : m_checkpointInterval(0), m_lastCheckpoint(0)
+{
+}
+
+void EnergyMeter::onTelemetryStarted()
+{
+    // We have no idea what was drawn while the telemetry wasn't running so
+    // don't integrate across the gap.
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto &pair : m_ports) pair.second.hasLast = false;
+}
+
+void EnergyMeter::onSweep(const TelemetrySweep &sweep)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    for (size_t i = 0; i < sweep.ports.size(); ++i) {
+        PortEnergy &energy = m_ports[sweep.ports[i]];
+        if (!sweep.valid) {
+            energy.hasLast = false;
+            continue;
+        }
+
+        float power = sweep.readings[i].power;
+        if (energy.hasLast && sweep.timestamp > energy.lastTimestamp) {
+            uint64_t dt = sweep.timestamp - energy.lastTimestamp;
+            energy.wattHours +=
+                ((energy.lastPower + power) / 2.0) * (dt / kNsPerHour);
+        }
+
+        energy.lastPower = power;
+        energy.lastTimestamp = sweep.timestamp;
+        energy.hasLast = true;
+    }
+
+    if (m_checkpointFile.empty() || m_checkpointInterval == 0) return;
+
+    if (sweep.timestamp - m_lastCheckpoint < m_checkpointInterval) return;
+
+    m_lastCheckpoint = sweep.timestamp;
+    lock.unlock();
+    // A failed checkpoint is retried on the next interval. There's no caller
+    // to report it to from the telemetry thread.
+    try {
+        save();
+    }
+    catch (...) {
+    }
+}
+
+double EnergyMeter::getEnergy(int port) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_ports.find(port);
+    return it == m_ports.end() ? 0.0 : it->second.wattHours;
+}
+
+void EnergyMeter::reset(int port)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_ports[port].wattHours = 0;
+}
+
+void EnergyMeter::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_ports.clear();
+    m_checkpointFile.clear();
+    m_loadedFile.clear();
+    m_checkpointInterval = 0;
+}
+
+void EnergyMeter::setCheckpoint(const char *fileName, int intervalSec)
+{
+    std::string checkpointFile = fileName ? fileName : "";
+    counters_t saved;
+    if (!checkpointFile.empty()) saved = load(checkpointFile);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_checkpointFile = checkpointFile;
+        m_checkpointInterval =
+            intervalSec > 0 ? intervalSec * 1000000000ULL : 0;
+        if (m_checkpointFile.empty()) return;
+
+        // Pick up where the last run left off. The saved counters are added
+        // rather than assigned so energy integrated since the telemetry was
+        // started isn't lost, and a file is only added once so setting it
+        // again doesn't count the last run twice.
+        if (m_loadedFile != m_checkpointFile) {
+            for (const auto &pair : saved)
+                m_ports[pair.first].wattHours += pair.second;
+            m_loadedFile = m_checkpointFile;
+        }
+    }
+
+    // Write the file straight away so a bad path is reported to the caller
+    // instead of failing silently in the background.
+    save();
+}
+
+void EnergyMeter::checkpoint() { save(); }
+
+EnergyMeter::counters_t EnergyMeter::load(const std::string &fileName)
+{
+    counters_t counters;
+    std::ifstream file(fileName);
+    if (!file) return counters;  // First run
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+
+        std::istringstream stream(line);
+        int port;
+        double wattHours;
+        if (stream >> port >> wattHours) counters[port] = wattHours;
+    }
+
+    return counters;
+}
+
+// The counters are copied while holding m_saveMutex, so a checkpoint never
+// overwrites a newer one.
+void EnergyMeter::save()
+{
+    std::lock_guard<std::mutex> saveLock(m_saveMutex);
+    std::string checkpointFile;
+    counters_t counters;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        checkpointFile = m_checkpointFile;
+        for (const auto &pair : m_ports)
+            counters[pair.first] = pair.second.wattHours;
+    }
+
+    if (!checkpointFile.empty()) write(checkpointFile, counters);
+}
+
+// The file is written next to the old one and renamed over it so a crash
+// mid-write never leaves a truncated checkpoint behind.
+void EnergyMeter::write(const std::string &fileName, const counters_t &counters)
+{
+    std::string tmpFile = fileName + ".tmp";
+    {
+        std::ofstream file(tmpFile, std::ios::out | std::ios::trunc);
+        if (!file)
+            throw std::system_error(
+                errno, std::generic_category(), "Failed to open checkpoint file"
+            );
+
+        file.precision(17);
+        file << "# port watt-hours\n";
+        for (const auto &pair : counters)
+            file << pair.first << ' ' << pair.second << '\n';
+
+        if (!file)
+            throw std::system_error(
+                std::make_error_code(std::errc::io_error),
+                "Failed to write checkpoint file"
+            );
+    }
+
+#ifdef _WIN32
+    std::remove(fileName.c_str());
+#endif
+    if (std::rename(tmpFile.c_str(), fileName.c_str()) != 0)
+        throw std::system_error(
+            errno, std::generic_category(), "Failed to replace checkpoint file"
+        );
+}
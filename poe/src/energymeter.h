@@ -0,0 +1,61 @@
+#ifndef ENERGYMETER_H
+#define ENERGYMETER_H
+
+#include <stdint.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "poetelemetry.h"
+
+// Keeps a cumulative energy counter for every port by integrating the power
+// readings of the telemetry sweep with the trapezoidal rule. Counters can be
+// checkpointed to a file so they survive restarts.
+class EnergyMeter : public TelemetryListener {
+   public:
+    EnergyMeter();
+
+    void onTelemetryStarted() override;
+    void onSweep(const TelemetrySweep &sweep) override;
+
+    double getEnergy(int port) const;
+    void reset(int port);
+    void clear();
+
+    void setCheckpoint(const char *fileName, int intervalSec);
+    void checkpoint();
+
+   private:
+    struct PortEnergy {
+        double wattHours;
+        float lastPower;
+        uint64_t lastTimestamp;
+        bool hasLast;
+
+        PortEnergy()
+            : wattHours(0), lastPower(0), lastTimestamp(0), hasLast(false)
+        {
+        }
+    };
+
+    typedef std::map<int, double> counters_t;
+
+    static counters_t load(const std::string &fileName);
+    static void write(const std::string &fileName, const counters_t &counters);
+    void save();
+
+    mutable std::mutex m_mutex;
+    std::map<int, PortEnergy> m_ports;
+
+    // Serializes the checkpoint writes, which happen outside m_mutex so the
+    // sweeps don't wait for the disk.
+    std::mutex m_saveMutex;
+
+    std::string m_checkpointFile;
+    std::string m_loadedFile;  // Checkpoint already added to the counters
+    uint64_t m_checkpointInterval;  // Nanoseconds
+    uint64_t m_lastCheckpoint;      // Nanoseconds
+};
+
+#endif  // ENERGYMETER_H
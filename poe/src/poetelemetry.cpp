@@ -0,0 +1,98 @@
+#include "poetelemetry.h"
+
+PoeTelemetry::PoeTelemetry(
+    AbstractPoeController *controller,
+    const portmap_t &portMap,
+    const std::vector<TelemetryListener *> &listeners,
+    int intervalMs,
+    JitterHistogram *jitter
+)
+    : mp_controller(controller),
+      m_listeners(listeners),
+      m_interval(intervalMs),
+      mp_jitter(jitter),
+      m_sweeps(0),
+      m_errors(0),
+      m_running(true)
+{
+    // Everything a sweep needs is allocated up front so the telemetry thread
+    // only ever reuses the same buffers.
+    for (const auto &pair : portMap) {
+        m_sweep.ports.push_back(pair.first);
+        m_internalPorts.push_back(pair.second);
+    }
+    m_sweep.readings.resize(m_internalPorts.size());
+
+    for (TelemetryListener *listener : m_listeners)
+        listener->onTelemetryStarted();
+
+    if (mp_jitter) mp_jitter->clear(intervalMs * 1000000LL);
+    m_thread = std::thread(&PoeTelemetry::run, this);
+}
+
+PoeTelemetry::~PoeTelemetry() { stop(); }
+
+std::error_code PoeTelemetry::configureThread(const rs::ThreadConfig &config)
+{
+    return applyThreadConfig(m_thread, config);
+}
+
+void PoeTelemetry::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_stopCondition.notify_all();
+
+    if (m_thread.joinable()) m_thread.join();
+}
+
+void PoeTelemetry::run()
+{
+    telemetry_clock_t::time_point next = telemetry_clock_t::now();
+    telemetry_clock_t::time_point last;
+    bool started = false;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_stopCondition.wait_until(lock, next, [this] {
+                    return !m_running;
+                }))
+                break;
+        }
+
+        // Don't try to catch up on sweeps that were missed, just keep the
+        // interval from now on.
+        next += m_interval;
+        telemetry_clock_t::time_point now = telemetry_clock_t::now();
+        if (next < now) next = now + m_interval;
+        if (mp_jitter && started)
+            mp_jitter->add(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    now - last
+                )
+                    .count()
+            );
+        last = now;
+        started = true;
+
+        m_sweep.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                now.time_since_epoch()
+        )
+                                .count();
+        try {
+            mp_controller->getPortReadings(m_internalPorts, m_sweep.readings);
+            m_sweep.valid = true;
+            ++m_sweeps;
+        }
+        catch (...) {
+            m_sweep.valid = false;
+            ++m_errors;
+        }
+
+        for (TelemetryListener *listener : m_listeners)
+            listener->onSweep(m_sweep);
+    }
+}
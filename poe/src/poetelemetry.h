@@ -0,0 +1,77 @@
+#ifndef POETELEMETRY_H
+#define POETELEMETRY_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../../utils/threadconfig.h"
+#include "controllers/abstractpoecontroller.h"
+
+typedef std::chrono::steady_clock telemetry_clock_t;
+
+struct TelemetrySweep {
+    uint64_t timestamp;  // Monotonic time in nanoseconds.
+    bool valid;          // False if the controller failed to answer.
+    std::vector<int> ports;
+    std::vector<PortReading> readings;
+};
+
+// Anything that wants to consume telemetry implements this interface instead
+// of polling the controller itself, so every consumer shares one sweep.
+// Listeners are called from the telemetry thread.
+class TelemetryListener {
+   public:
+    virtual ~TelemetryListener() {}
+
+    // Called before the first sweep after the telemetry (re)starts.
+    virtual void onTelemetryStarted() {}
+    virtual void onSweep(const TelemetrySweep &sweep) = 0;
+};
+
+// Periodically reads every port of a controller in a single sweep and hands the
+// readings to each listener. If a histogram is given, it's cleared and then
+// gets the time between the starts of consecutive sweeps.
+class PoeTelemetry {
+   public:
+    PoeTelemetry(
+        AbstractPoeController *controller,
+        const portmap_t &portMap,
+        const std::vector<TelemetryListener *> &listeners,
+        int intervalMs,
+        JitterHistogram *jitter = nullptr
+    );
+    ~PoeTelemetry();
+
+    void stop();
+    // Applies config to the background thread.
+    std::error_code configureThread(const rs::ThreadConfig &config);
+
+    uint64_t sweepCount() const { return m_sweeps; }
+    uint64_t errorCount() const { return m_errors; }
+
+   private:
+    void run();
+
+    AbstractPoeController *mp_controller;
+    std::vector<uint8_t> m_internalPorts;
+    std::vector<TelemetryListener *> m_listeners;
+    std::chrono::milliseconds m_interval;
+    JitterHistogram *mp_jitter;
+    TelemetrySweep m_sweep;
+
+    std::atomic<uint64_t> m_sweeps;
+    std::atomic<uint64_t> m_errors;
+
+    bool m_running;
+    std::mutex m_mutex;
+    std::condition_variable m_stopCondition;
+    std::thread m_thread;
+};
+
+#endif  // POETELEMETRY_H
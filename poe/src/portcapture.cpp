@@ -0,0 +1,216 @@
+#include "portcapture.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+#include <system_error>
+
+typedef std::chrono::nanoseconds ns_t;
+
+// Header written at the start of binary capture files.
+// See librspoe.md for the full file layout.
+static const char kBinaryMagic[8] = {'R', 'S', 'P', 'O', 'E', 'C', 'A', 'P'};
+static const uint32_t kBinaryVersion = 1;
+
+// How long the capture waits after a failed reading, doubling while they
+// keep failing, so a dead bus doesn't turn an unpaced capture into a busy
+// loop.
+static const std::chrono::milliseconds kMinErrorBackoff(1);
+static const std::chrono::milliseconds kMaxErrorBackoff(100);
+
+static uint64_t timestampNow()
+{
+    return std::chrono::duration_cast<ns_t>(
+               capture_clock_t::now().time_since_epoch()
+    )
+        .count();
+}
+
+PortCapture::PortCapture(
+    AbstractPoeController *controller,
+    uint8_t port,
+    float rate,
+    rs::PoeSample *buffer,
+    size_t size
+)
+    : mp_controller(controller),
+      m_port(port),
+      m_period(0),
+      mp_buffer(buffer),
+      m_size(size),
+      m_head(0),
+      m_tail(0),
+      m_captured(0),
+      m_dropped(0),
+      m_missed(0),
+      m_errors(0),
+      m_startTime(capture_clock_t::now()),
+      m_elapsedNs(0),
+      m_running(true)
+{
+    // A rate of zero means sample as fast as the bus allows.
+    if (rate > 0) m_period = ns_t((int64_t)(1000000000.0 / rate));
+
+    m_thread = std::thread(&PortCapture::run, this);
+}
+
+PortCapture::~PortCapture() { stop(); }
+
+std::error_code PortCapture::configureThread(const rs::ThreadConfig &config)
+{
+    return applyThreadConfig(m_thread, config);
+}
+
+void PortCapture::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_stopCondition.notify_all();
+
+    if (m_thread.joinable()) m_thread.join();
+}
+
+size_t PortCapture::read(rs::PoeSample *samples, size_t count)
+{
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    size_t available = m_head.load(std::memory_order_acquire) - tail;
+    if (count > available) count = available;
+
+    for (size_t i = 0; i < count; ++i) {
+        samples[i] = mp_buffer[(tail + i) % m_size];
+    }
+
+    m_tail.store(tail + count, std::memory_order_release);
+    return count;
+}
+
+rs::PoeCaptureStats PortCapture::stats() const
+{
+    rs::PoeCaptureStats s;
+    s.captured = m_captured.load();
+    s.dropped = m_dropped.load();
+    s.missed = m_missed.load();
+    s.errors = m_errors.load();
+    s.buffered = m_head.load() - m_tail.load();
+
+    int64_t elapsed = m_elapsedNs.load();
+    uint64_t reads = s.captured + s.dropped;
+    s.rate = (elapsed > 0) ? (float)(reads * 1e9 / elapsed) : 0.0f;
+    return s;
+}
+
+void PortCapture::exportTo(const char *fileName, rs::CaptureFormat format)
+{
+    std::ios::openmode mode = std::ios::out | std::ios::trunc;
+    if (format == rs::CaptureFormat::Binary) mode |= std::ios::binary;
+
+    std::ofstream file(fileName, mode);
+    if (!file)
+        throw std::system_error(
+            errno, std::generic_category(), "Failed to open capture file"
+        );
+
+    if (format == rs::CaptureFormat::Csv) {
+        file << "timestamp,voltage,current\n";
+    }
+    else {
+        uint32_t recordSize = sizeof(rs::PoeSample);
+        file.write(kBinaryMagic, sizeof(kBinaryMagic));
+        file.write((const char *)&kBinaryVersion, sizeof(kBinaryVersion));
+        file.write((const char *)&recordSize, sizeof(recordSize));
+    }
+
+    // Drain in small chunks so exporting doesn't need to allocate
+    // anything the size of the capture buffer.
+    rs::PoeSample chunk[256];
+    size_t count;
+    while ((count = read(chunk, 256)) > 0) {
+        if (format == rs::CaptureFormat::Csv) {
+            for (size_t i = 0; i < count; ++i) {
+                file << chunk[i].timestamp << ',' << chunk[i].voltage << ','
+                     << chunk[i].current << '\n';
+            }
+        }
+        else {
+            file.write((const char *)chunk, count * sizeof(rs::PoeSample));
+        }
+    }
+
+    if (!file)
+        throw std::system_error(
+            std::make_error_code(std::errc::io_error),
+            "Failed to write capture file"
+        );
+}
+
+void PortCapture::run()
+{
+    capture_clock_t::time_point next = capture_clock_t::now();
+    std::chrono::milliseconds backoff = kMinErrorBackoff;
+
+    while (true) {
+        if (m_period.count() > 0) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_stopCondition.wait_until(lock, next, [this] {
+                    return !m_running;
+                }))
+                break;
+
+            // If the bus was busy long enough that whole sample periods went
+            // by, account for them instead of silently stretching the period.
+            ns_t late = capture_clock_t::now() - next;
+            if (late >= m_period) {
+                int64_t missed = late.count() / m_period.count();
+                m_missed += missed;
+                next += m_period * missed;
+            }
+            next += m_period;
+        }
+        else {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_running) break;
+        }
+
+        rs::PoeSample sample;
+        sample.timestamp = timestampNow();
+        try {
+            PortReading reading = mp_controller->getPortReading(m_port);
+            sample.voltage = reading.voltage;
+            sample.current = reading.current;
+        }
+        catch (...) {
+            ++m_errors;
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_stopCondition.wait_for(lock, backoff, [this] {
+                    return !m_running;
+                }))
+                break;
+
+            backoff = std::min(backoff * 2, kMaxErrorBackoff);
+            continue;
+        }
+
+        backoff = kMinErrorBackoff;
+
+        if (push(sample))
+            ++m_captured;
+        else
+            ++m_dropped;
+
+        m_elapsedNs =
+            std::chrono::duration_cast<ns_t>(capture_clock_t::now() - m_startTime)
+                .count();
+    }
+}
+
+bool PortCapture::push(const rs::PoeSample &sample)
+{
+    size_t head = m_head.load(std::memory_order_relaxed);
+    if (head - m_tail.load(std::memory_order_acquire) >= m_size) return false;
+
+    mp_buffer[head % m_size] = sample;
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+}
@@ -0,0 +1,68 @@
+#ifndef PORTCAPTURE_H
+#define PORTCAPTURE_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "../../utils/threadconfig.h"
+#include "../include/rspoe.h"
+#include "controllers/abstractpoecontroller.h"
+
+typedef std::chrono::steady_clock capture_clock_t;
+
+// Samples the voltage and current of a single port on a dedicated thread and
+// streams the samples into a caller supplied ring buffer. The capture thread is
+// the only producer and whoever calls read() is the only consumer, so the ring
+// itself doesn't need a lock.
+class PortCapture {
+   public:
+    PortCapture(
+        AbstractPoeController *controller,
+        uint8_t port,
+        float rate,
+        rs::PoeSample *buffer,
+        size_t size
+    );
+    ~PortCapture();
+
+    void stop();
+    // Applies config to the background thread.
+    std::error_code configureThread(const rs::ThreadConfig &config);
+
+    size_t read(rs::PoeSample *samples, size_t count);
+    rs::PoeCaptureStats stats() const;
+    void exportTo(const char *fileName, rs::CaptureFormat format);
+
+   private:
+    void run();
+    bool push(const rs::PoeSample &sample);
+
+    AbstractPoeController *mp_controller;
+    uint8_t m_port;
+    std::chrono::nanoseconds m_period;
+
+    rs::PoeSample *mp_buffer;
+    size_t m_size;
+    // Free running counters. The slot is the counter modulo m_size.
+    std::atomic<size_t> m_head;
+    std::atomic<size_t> m_tail;
+
+    std::atomic<uint64_t> m_captured;
+    std::atomic<uint64_t> m_dropped;
+    std::atomic<uint64_t> m_missed;
+    std::atomic<uint64_t> m_errors;
+    capture_clock_t::time_point m_startTime;
+    std::atomic<int64_t> m_elapsedNs;
+
+    bool m_running;
+    std::mutex m_mutex;
+    std::condition_variable m_stopCondition;
+    std::thread m_thread;
+};
+
+#endif  // PORTCAPTURE_H
@@ -0,0 +1,352 @@
+#include "rspoeclient.h"
+
+#include "../../error/include/rserrors.h"
+#include "../../utils/errorcapture.h"
+
+RsPoeClient *RsPoeClient::connect(const std::string &socketPath)
+{
+    IodConnection *connection = IodConnection::open(socketPath);
+    if (!connection) return nullptr;
+
+    if (!connection->state().layout.hasPoe) {
+        delete connection;
+        return nullptr;
+    }
+
+    return new RsPoeClient(connection);
+}
+
+RsPoeClient::RsPoeClient(IodConnection *connection)
+    : m_connection(connection), m_lastError(), m_lastErrorString()
+{
+}
+
+void RsPoeClient::destroy() { delete this; }
+
+void RsPoeClient::setXmlFile(const char *fileName)
+{
+    m_lastError = iodCheckXmlFile(
+        fileName,
+        m_connection->state().layout.poeFile,
+        &m_lastErrorString.get()
+    );
+}
+
+std::vector<int> RsPoeClient::getPortList() const
+{
+    const IodLayout &layout = m_connection->state().layout;
+    return std::vector<int>(layout.ports, layout.ports + layout.portCount);
+}
+
+rs::PoeState RsPoeClient::getPortState(int port)
+{
+    IodPortData data;
+    m_lastError = readPort(port, false, data, &m_lastErrorString.get());
+    if (m_lastError.get()) return rs::PoeState::Error;
+    return static_cast<rs::PoeState>(data.state);
+}
+
+rs::Result<rs::PoeState> RsPoeClient::getPortStateEx(int port)
+{
+    IodPortData data;
+    std::error_code error = readPort(port, false, data, nullptr);
+    if (error) return error;
+    return static_cast<rs::PoeState>(data.state);
+}
+
+void RsPoeClient::setPortState(int port, rs::PoeState state)
+{
+    m_lastError = writePortState(port, state, &m_lastErrorString.get());
+}
+
+rs::Result<void> RsPoeClient::setPortStateEx(int port, rs::PoeState state)
+{
+    return writePortState(port, state, nullptr);
+}
+
+void RsPoeClient::setPortStates(const std::map<int, rs::PoeState> &states)
+{
+    IodRequest request = {};
+    if (states.size() > kIodMaxPorts) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid port";
+        return;
+    }
+
+    for (const auto &pair : states) {
+        request.ports[request.count] = pair.first;
+        request.states[request.count] = static_cast<int32_t>(pair.second);
+        ++request.count;
+    }
+
+    callCommand(IodCommand::SetPortStates, request);
+}
+
+void RsPoeClient::resync()
+{
+    IodRequest request = {};
+    callCommand(IodCommand::Resync, request);
+}
+
+float RsPoeClient::getPortVoltage(int port)
+{
+    IodPortData data;
+    m_lastError = readPort(port, true, data, &m_lastErrorString.get());
+    return m_lastError.get() ? 0 : data.voltage;
+}
+
+rs::Result<float> RsPoeClient::getPortVoltageEx(int port)
+{
+    IodPortData data;
+    std::error_code error = readPort(port, true, data, nullptr);
+    if (error) return error;
+    return data.voltage;
+}
+
+float RsPoeClient::getPortCurrent(int port)
+{
+    IodPortData data;
+    m_lastError = readPort(port, true, data, &m_lastErrorString.get());
+    return m_lastError.get() ? 0 : data.current;
+}
+
+rs::Result<float> RsPoeClient::getPortCurrentEx(int port)
+{
+    IodPortData data;
+    std::error_code error = readPort(port, true, data, nullptr);
+    if (error) return error;
+    return data.current;
+}
+
+float RsPoeClient::getPortPower(int port)
+{
+    IodPortData data;
+    m_lastError = readPort(port, true, data, &m_lastErrorString.get());
+    return m_lastError.get() ? 0 : data.power;
+}
+
+rs::Result<float> RsPoeClient::getPortPowerEx(int port)
+{
+    IodPortData data;
+    std::error_code error = readPort(port, true, data, nullptr);
+    if (error) return error;
+    return data.power;
+}
+
+void RsPoeClient::startCapture(int, float, rs::PoeSample *, size_t)
+{
+    notSupported();
+}
+
+void RsPoeClient::stopCapture() { notSupported(); }
+
+size_t RsPoeClient::readCapture(rs::PoeSample *, size_t)
+{
+    notSupported();
+    return 0;
+}
+
+rs::PoeCaptureStats RsPoeClient::getCaptureStats()
+{
+    notSupported();
+    return rs::PoeCaptureStats();
+}
+
+void RsPoeClient::exportCapture(const char *, rs::CaptureFormat)
+{
+    notSupported();
+}
+
+void RsPoeClient::startTelemetry(int) { notSupported(); }
+
+void RsPoeClient::stopTelemetry() { notSupported(); }
+
+double RsPoeClient::getPortEnergy(int port)
+{
+    IodPortData data;
+    m_lastError = readPort(port, false, data, &m_lastErrorString.get());
+    return m_lastError.get() ? 0 : data.energy;
+}
+
+rs::Result<double> RsPoeClient::getPortEnergyEx(int port)
+{
+    IodPortData data;
+    std::error_code error = readPort(port, false, data, nullptr);
+    if (error) return error;
+    return data.energy;
+}
+
+void RsPoeClient::resetPortEnergy(int port)
+{
+    IodRequest request = {};
+    request.target = port;
+    callCommand(IodCommand::ResetPortEnergy, request);
+}
+
+void RsPoeClient::setEnergyCheckpoint(const char *, int) { notSupported(); }
+
+void RsPoeClient::setBudgetLimit(float watts)
+{
+    IodRequest request = {};
+    request.watts = watts;
+    callCommand(IodCommand::SetBudgetLimit, request);
+}
+
+void RsPoeClient::setPortPriority(int port, int priority)
+{
+    IodRequest request = {};
+    request.target = port;
+    request.arg = priority;
+    callCommand(IodCommand::SetPortPriority, request);
+}
+
+void RsPoeClient::setPortPowerLimit(int port, float watts)
+{
+    IodRequest request = {};
+    request.target = port;
+    request.watts = watts;
+    callCommand(IodCommand::SetPortPowerLimit, request);
+}
+
+// The daemon reports the shed ports as a mask of indices into the port list.
+std::vector<int> RsPoeClient::getShedPorts()
+{
+    const IodLayout &layout = m_connection->state().layout;
+    std::vector<int> ports;
+    IodRequest request = {};
+    int64_t value = 0;
+    m_lastError = call(
+        IodCommand::GetShedPorts, request, value, &m_lastErrorString.get()
+    );
+    for (uint32_t index = 0; index < layout.portCount; ++index) {
+        if (value & (1LL << index)) ports.push_back(layout.ports[index]);
+    }
+
+    return ports;
+}
+
+int RsPoeClient::getBudgetConsumed()
+{
+    return callBudget(IodCommand::GetBudgetConsumed);
+}
+
+int RsPoeClient::getBudgetAvailable()
+{
+    return callBudget(IodCommand::GetBudgetAvailable);
+}
+
+int RsPoeClient::getBudgetTotal()
+{
+    return callBudget(IodCommand::GetBudgetTotal);
+}
+
+void RsPoeClient::setThreadConfig(const rs::ThreadConfig &) { notSupported(); }
+
+rs::JitterReport RsPoeClient::getJitterReport()
+{
+    notSupported();
+    return rs::JitterReport();
+}
+
+std::error_code RsPoeClient::getLastError() const { return m_lastError; }
+
+std::string RsPoeClient::getLastErrorString() const
+{
+    const std::error_code &error = m_lastError;
+    if (error) return m_lastErrorString;
+    return std::string();
+}
+
+std::error_code RsPoeClient::call(
+    IodCommand command,
+    IodRequest &request,
+    int64_t &value,
+    std::string *what
+)
+{
+    IodResponse response;
+    std::error_code error = m_connection->call(command, request, response);
+    if (error) return failWith(error, "Lost the connection to rsiod", what);
+
+    error = iodDecodeError(response);
+    if (error) {
+        if (what) *what = response.message;
+        return error;
+    }
+
+    value = response.value;
+    return std::error_code();
+}
+
+// The readings are only there once the daemon finished its first sweep; the
+// state and energy are published from the start.
+std::error_code RsPoeClient::readPort(
+    int port,
+    bool readings,
+    IodPortData &data,
+    std::string *what
+)
+{
+    const IodSharedState &state = m_connection->state();
+    uint32_t index = 0;
+    while (index < state.layout.portCount && state.layout.ports[index] != port)
+        ++index;
+
+    if (index == state.layout.portCount) {
+        return failWith(
+            std::make_error_code(std::errc::invalid_argument),
+            "Invalid port",
+            what
+        );
+    }
+
+    IodPoeData poe;
+    if (!iodRead(state.poe, poe)) {
+        return failWith(
+            std::make_error_code(std::errc::resource_unavailable_try_again),
+            "rsiod stopped publishing the port states",
+            what
+        );
+    }
+
+    if (readings && !poe.timestamp) {
+        return failWith(
+            std::make_error_code(std::errc::resource_unavailable_try_again),
+            "rsiod hasn't read the ports yet",
+            what
+        );
+    }
+
+    data = poe.ports[index];
+    return std::error_code();
+}
+
+std::error_code
+RsPoeClient::writePortState(int port, rs::PoeState state, std::string *what)
+{
+    IodRequest request = {};
+    request.target = port;
+    request.arg = static_cast<int32_t>(state);
+    int64_t value;
+    return call(IodCommand::SetPortState, request, value, what);
+}
+
+void RsPoeClient::callCommand(IodCommand command, IodRequest &request)
+{
+    int64_t value;
+    m_lastError = call(command, request, value, &m_lastErrorString.get());
+}
+
+int RsPoeClient::callBudget(IodCommand command)
+{
+    IodRequest request = {};
+    int64_t value = 0;
+    m_lastError = call(command, request, value, &m_lastErrorString.get());
+    return (int)value;
+}
+
+void RsPoeClient::notSupported()
+{
+    m_lastError = std::make_error_code(std::errc::function_not_supported);
+    m_lastErrorString = "Not available through rsiod";
+}
@@ -0,0 +1,109 @@
+#ifndef RSPOECLIENT_H
+#define RSPOECLIENT_H
+
+#include <memory>
+#include <string>
+
+#include "../../utils/iodprotocol.h"
+#include "../../utils/perthread.h"
+#include "../include/rspoe.h"
+
+// RsPoe on top of a running rsiod, which owns the controller and runs the
+// telemetry.
+//
+// Port states, readings and energy come from the shared memory the daemon
+// publishes after every telemetry sweep, so they cost no bus I/O and are as
+// old as the last sweep. Everything that changes the hardware or the budget
+// goes over the daemon's socket. Captures, checkpoints and the telemetry
+// settings belong to the daemon and fail with function_not_supported.
+class RsPoeClient : public rs::RsPoe {
+   public:
+    // Returns null if there's no daemon with PoE on socketPath.
+    static RsPoeClient *connect(const std::string &socketPath);
+
+    void destroy() override;
+    // Nothing is loaded, the daemon's configuration is used. Fails with
+    // invalid_argument if fileName isn't the file the daemon serves.
+    void setXmlFile(const char *fileName) override;
+
+    std::vector<int> getPortList() const override;
+
+    rs::PoeState getPortState(int port) override;
+    void setPortState(int port, rs::PoeState state) override;
+    void setPortStates(const std::map<int, rs::PoeState> &states) override;
+
+    void resync() override;
+
+    float getPortVoltage(int port) override;
+    float getPortCurrent(int port) override;
+    float getPortPower(int port) override;
+
+    void startCapture(
+        int port,
+        float rate,
+        rs::PoeSample *buffer,
+        size_t size
+    ) override;
+    void stopCapture() override;
+    size_t readCapture(rs::PoeSample *samples, size_t count) override;
+    rs::PoeCaptureStats getCaptureStats() override;
+    void exportCapture(const char *fileName, rs::CaptureFormat format) override;
+
+    void startTelemetry(int intervalMs) override;
+    void stopTelemetry() override;
+
+    double getPortEnergy(int port) override;
+    void resetPortEnergy(int port) override;
+    void setEnergyCheckpoint(const char *fileName, int intervalSec) override;
+
+    void setBudgetLimit(float watts) override;
+    void setPortPriority(int port, int priority) override;
+    void setPortPowerLimit(int port, float watts) override;
+    std::vector<int> getShedPorts() override;
+
+    int getBudgetConsumed() override;
+    int getBudgetAvailable() override;
+    int getBudgetTotal() override;
+
+    void setThreadConfig(const rs::ThreadConfig &config) override;
+    rs::JitterReport getJitterReport() override;
+
+    rs::Result<rs::PoeState> getPortStateEx(int port) override;
+    rs::Result<void> setPortStateEx(int port, rs::PoeState state) override;
+    rs::Result<float> getPortVoltageEx(int port) override;
+    rs::Result<float> getPortCurrentEx(int port) override;
+    rs::Result<float> getPortPowerEx(int port) override;
+    rs::Result<double> getPortEnergyEx(int port) override;
+
+    std::error_code getLastError() const override;
+    std::string getLastErrorString() const override;
+
+   private:
+    explicit RsPoeClient(IodConnection *connection);
+
+    // Like the cores of RsPoeImpl, these return their error and only fill in
+    // what if it isn't null.
+    std::error_code call(
+        IodCommand command,
+        IodRequest &request,
+        int64_t &value,
+        std::string *what
+    );
+    std::error_code readPort(
+        int port,
+        bool readings,
+        IodPortData &data,
+        std::string *what
+    );
+    std::error_code
+    writePortState(int port, rs::PoeState state, std::string *what);
+    void callCommand(IodCommand command, IodRequest &request);
+    int callBudget(IodCommand command);
+    void notSupported();
+
+    std::unique_ptr<IodConnection> m_connection;
+    PerThread<std::error_code> m_lastError;
+    PerThread<std::string> m_lastErrorString;
+};
+
+#endif  // RSPOECLIENT_H
@@ -1,17 +1,24 @@
 #include "rspoeimpl.h"
 
 #include "../../error/include/rserrors.h"
+#include "../../utils/errorcapture.h"
 #include "../../utils/tinyxml2.h"
 #include "controllers/ltc4266.h"
 #include "controllers/pd69104.h"
 #include "controllers/pd69200.h"
+#include "rspoeclient.h"
 
 #ifndef RSSDK_VERSION_STRING
 #define RSSDK_VERSION_STRING "beta"
 #endif
 
 RsPoeImpl::RsPoeImpl()
-    : m_lastError(), m_lastErrorString(), mp_controller(nullptr)
+    : m_lastError(),
+      m_lastErrorString(),
+      mp_controller(nullptr),
+      mp_capture(nullptr),
+      mp_telemetry(nullptr),
+      mp_listener(nullptr)
 {
 }
 
@@ -19,17 +26,49 @@ RsPoeImpl::RsPoeImpl(AbstractPoeController *controller, portmap_t portMap)
     : m_lastError(),
       m_lastErrorString(),
       m_portMap(portMap),
-      mp_controller(controller)
+      mp_controller(controller),
+      mp_capture(nullptr),
+      mp_telemetry(nullptr),
+      mp_listener(nullptr)
 {
+    m_budgetManager.setController(mp_controller, m_portMap);
 }
 
-RsPoeImpl::~RsPoeImpl() { delete mp_controller; }
+RsPoeImpl::~RsPoeImpl()
+{
+    delete mp_telemetry;
+    delete mp_capture;
+    delete mp_controller;
+
+    // Save the counters one last time so nothing since the last periodic
+    // checkpoint is lost.
+    try {
+        m_energy.checkpoint();
+    }
+    catch (...) {
+    }
+}
 
 void RsPoeImpl::destroy() { delete this; }
 
 void RsPoeImpl::setXmlFile(const char *fileName)
 {
+    std::lock_guard<SharedMutex> lock(m_configMutex);
     using namespace tinyxml2;
+    delete mp_telemetry;
+    mp_telemetry = nullptr;
+    delete mp_capture;
+    mp_capture = nullptr;
+    // Save the counters of the old configuration before they're cleared,
+    // like the destructor does.
+    try {
+        m_energy.checkpoint();
+    }
+    catch (...) {
+    }
+    m_energy.clear();
+    m_budgetManager.clear();
+    clearStates();
     m_portMap.clear();
     delete mp_controller;
     mp_controller = nullptr;
@@ -90,8 +129,20 @@ void RsPoeImpl::setXmlFile(const char *fileName)
     try {
         if (id == "pd69104")
             mp_controller = new Pd69104(busAddress, chipAddress);
-        else if (id == "pd69200")
-            mp_controller = new Pd69200(busAddress, chipAddress);
+        else if (id == "pd69200") {
+            // Without the number of channels the controller can't tell if a
+            // change covers all of them, so it never broadcasts.
+            unsigned channels = 0;
+            poe->QueryUnsignedAttribute("channels", &channels);
+            if (channels > 0xff) {
+                m_lastError = RsErrorCode::XmlParseError;
+                m_lastErrorString = "Invalid channels attribute for poe_controller";
+                return;
+            }
+
+            mp_controller =
+                new Pd69200(busAddress, chipAddress, 170, (uint8_t)channels);
+        }
         else if (id == "ltc4266")
             mp_controller = new Ltc4266(busAddress, chipAddress);
         else {
@@ -116,6 +167,9 @@ void RsPoeImpl::setXmlFile(const char *fileName)
         return;
     }
 
+    // Budget settings are optional and applied once the port map is known.
+    std::map<int, int> priorities;
+    std::map<int, float> powerLimits;
     XMLElement *port = poe->FirstChildElement("port");
     for (; port; port = port->NextSiblingElement("port")) {
         int id, bit;
@@ -124,6 +178,14 @@ void RsPoeImpl::setXmlFile(const char *fileName)
         if (port->QueryAttribute("bit", &bit) != XML_SUCCESS) continue;
 
         m_portMap[id] = bit;
+
+        int priority;
+        if (port->QueryAttribute("priority", &priority) == XML_SUCCESS)
+            priorities[id] = priority;
+
+        float maxPower;
+        if (port->QueryAttribute("max_power", &maxPower) == XML_SUCCESS)
+            powerLimits[id] = maxPower;
     }
 
     if (m_portMap.size() <= 0) {
@@ -136,11 +198,21 @@ void RsPoeImpl::setXmlFile(const char *fileName)
         return;
     }
 
+    m_budgetManager.setController(mp_controller, m_portMap);
+    float budget;
+    if (poe->QueryAttribute("budget", &budget) == XML_SUCCESS)
+        m_budgetManager.setBudget(budget);
+    for (const auto &pair : priorities)
+        m_budgetManager.setPriority(pair.first, pair.second);
+    for (const auto &pair : powerLimits)
+        m_budgetManager.setPowerLimit(pair.first, pair.second);
+
     m_lastError = std::error_code();
 }
 
 std::vector<int> RsPoeImpl::getPortList() const
 {
+    SharedLock lock(m_configMutex);
     std::vector<int> keys;
     for (const auto &pair : m_portMap) {
         keys.push_back(pair.first);
@@ -151,21 +223,67 @@ std::vector<int> RsPoeImpl::getPortList() const
 rs::PoeState RsPoeImpl::getPortState(int port)
 {
     rs::PoeState state = rs::PoeState::Error;
+    m_lastError = readPortState(port, state, &m_lastErrorString.get());
+    return state;
+}
+
+rs::Result<rs::PoeState> RsPoeImpl::getPortStateEx(int port)
+{
+    rs::PoeState state = rs::PoeState::Error;
+    std::error_code error = readPortState(port, state, nullptr);
+    if (error) return error;
+    return state;
+}
+
+void RsPoeImpl::setPortState(int port, rs::PoeState state)
+{
+    m_lastError = writePortState(port, state, &m_lastErrorString.get());
+}
 
+rs::Result<void> RsPoeImpl::setPortStateEx(int port, rs::PoeState state)
+{
+    return writePortState(port, state, nullptr);
+}
+
+void RsPoeImpl::setPortStates(const std::map<int, rs::PoeState> &states)
+{
+    SharedLock lock(m_configMutex);
     if (mp_controller == nullptr) {
         m_lastError = RsErrorCode::NotInitialized;
         m_lastErrorString = "XML file never set";
-        return state;
+        return;
     }
 
-    if (m_portMap.find(port) == m_portMap.end()) {
-        m_lastError = std::make_error_code(std::errc::invalid_argument);
-        m_lastErrorString = "Invalid port";
-        return state;
+    // Validate everything before touching the hardware so a bad entry
+    // doesn't leave the ports half configured.
+    portstatemap_t internalStates;
+    for (const auto &pair : states) {
+        if (pair.second == rs::PoeState::Error) {
+            m_lastError = std::make_error_code(std::errc::invalid_argument);
+            m_lastErrorString = "Invalid state";
+            return;
+        }
+
+        if (m_portMap.find(pair.first) == m_portMap.end()) {
+            m_lastError = std::make_error_code(std::errc::invalid_argument);
+            m_lastErrorString = "Invalid port";
+            return;
+        }
+
+        internalStates[m_portMap.at(pair.first)] = pair.second;
+    }
+
+    if (internalStates.empty()) {
+        m_lastError = std::error_code();
+        return;
     }
 
     try {
-        state = mp_controller->getPortState(m_portMap[port]);
+        mp_controller->setPortStates(internalStates);
+        for (const auto &pair : states) {
+            m_budgetManager.release(pair.first);
+            cacheState(pair.first, pair.second);
+        }
         m_lastError = std::error_code();
     }
     catch (const std::system_error &ex) {
@@ -181,20 +299,117 @@ rs::PoeState RsPoeImpl::getPortState(int port)
         m_lastErrorString = "Unknown exception occurred";
     }
 
-    return state;
+    // Some of the ports may have changed before the controller failed.
+    if (m_lastError.get()) {
+        for (const auto &pair : states)
+            cacheState(pair.first, rs::PoeState::Error);
+    }
 }
 
-void RsPoeImpl::setPortState(int port, rs::PoeState state)
+void RsPoeImpl::resync()
 {
+    SharedLock lock(m_configMutex);
     if (mp_controller == nullptr) {
         m_lastError = RsErrorCode::NotInitialized;
         m_lastErrorString = "XML file never set";
         return;
     }
 
-    if (state == rs::PoeState::Error) {
-        m_lastError = std::make_error_code(std::errc::invalid_argument);
-        m_lastErrorString = "Invalid state";
+    clearStates();
+    try {
+        mp_controller->resync();
+        m_lastError = std::error_code();
+    }
+    catch (const std::system_error &ex) {
+        m_lastError = ex.code();
+        m_lastErrorString = ex.what();
+    }
+    catch (const std::exception &ex) {
+        m_lastError = RsErrorCode::UnknownError;
+        m_lastErrorString = ex.what();
+    }
+    catch (...) {
+        m_lastError = RsErrorCode::UnknownError;
+        m_lastErrorString = "Unknown exception occurred";
+    }
+}
+
+float RsPoeImpl::getPortVoltage(int port)
+{
+    float voltage = 0;
+    m_lastError = readPort(
+        port,
+        &AbstractPoeController::getPortVoltage,
+        voltage,
+        &m_lastErrorString.get()
+    );
+    return voltage;
+}
+
+rs::Result<float> RsPoeImpl::getPortVoltageEx(int port)
+{
+    float voltage = 0;
+    std::error_code error = readPort(
+        port, &AbstractPoeController::getPortVoltage, voltage, nullptr
+    );
+    if (error) return error;
+    return voltage;
+}
+
+float RsPoeImpl::getPortCurrent(int port)
+{
+    float current = 0;
+    m_lastError = readPort(
+        port,
+        &AbstractPoeController::getPortCurrent,
+        current,
+        &m_lastErrorString.get()
+    );
+    return current;
+}
+
+rs::Result<float> RsPoeImpl::getPortCurrentEx(int port)
+{
+    float current = 0;
+    std::error_code error = readPort(
+        port, &AbstractPoeController::getPortCurrent, current, nullptr
+    );
+    if (error) return error;
+    return current;
+}
+
+float RsPoeImpl::getPortPower(int port)
+{
+    float power = 0;
+    m_lastError = readPort(
+        port,
+        &AbstractPoeController::getPortPower,
+        power,
+        &m_lastErrorString.get()
+    );
+    return power;
+}
+
+rs::Result<float> RsPoeImpl::getPortPowerEx(int port)
+{
+    float power = 0;
+    std::error_code error =
+        readPort(port, &AbstractPoeController::getPortPower, power, nullptr);
+    if (error) return error;
+    return power;
+}
+
+void RsPoeImpl::startCapture(
+    int port,
+    float rate,
+    rs::PoeSample *buffer,
+    size_t size
+)
+{
+    std::lock_guard<SharedMutex> lock(m_configMutex);
+    if (mp_controller == nullptr) {
+        m_lastError = RsErrorCode::NotInitialized;
+        m_lastErrorString = "XML file never set";
         return;
     }
 
@@ -204,8 +419,20 @@ void RsPoeImpl::setPortState(int port, rs::PoeState state)
         return;
     }
 
+    if (buffer == nullptr || size == 0 || rate < 0) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid capture buffer or rate";
+        return;
+    }
+
+    // Starting a new capture throws away whatever is left of the last one.
+    delete mp_capture;
+    mp_capture = nullptr;
+
     try {
-        mp_controller->setPortState(m_portMap[port], state);
+        mp_capture =
+            new PortCapture(mp_controller, m_portMap.at(port), rate, buffer, size);
+        mp_capture->configureThread(m_threadConfig);
         m_lastError = std::error_code();
     }
     catch (const std::system_error &ex) {
@@ -222,24 +449,64 @@ void RsPoeImpl::setPortState(int port, rs::PoeState state)
     }
 }
 
-float RsPoeImpl::getPortVoltage(int port)
+void RsPoeImpl::stopCapture()
 {
-    float voltage = 0;
+    std::lock_guard<SharedMutex> lock(m_configMutex);
+    if (mp_capture == nullptr) {
+        m_lastError = RsErrorCode::NotInitialized;
+        m_lastErrorString = "Capture never started";
+        return;
+    }
 
-    if (mp_controller == nullptr) {
+    mp_capture->stop();
+    m_lastError = std::error_code();
+}
+
+size_t RsPoeImpl::readCapture(rs::PoeSample *samples, size_t count)
+{
+    std::lock_guard<SharedMutex> lock(m_configMutex);
+    if (mp_capture == nullptr) {
         m_lastError = RsErrorCode::NotInitialized;
-        m_lastErrorString = "XML file never set";
-        return voltage;
+        m_lastErrorString = "Capture never started";
+        return 0;
     }
 
-    if (m_portMap.find(port) == m_portMap.end()) {
+    if (samples == nullptr) {
         m_lastError = std::make_error_code(std::errc::invalid_argument);
-        m_lastErrorString = "Invalid port";
-        return voltage;
+        m_lastErrorString = "Invalid sample buffer";
+        return 0;
+    }
+
+    m_lastError = std::error_code();
+    return mp_capture->read(samples, count);
+}
+
+rs::PoeCaptureStats RsPoeImpl::getCaptureStats()
+{
+    SharedLock lock(m_configMutex);
+    rs::PoeCaptureStats stats = {};
+
+    if (mp_capture == nullptr) {
+        m_lastError = RsErrorCode::NotInitialized;
+        m_lastErrorString = "Capture never started";
+        return stats;
+    }
+
+    m_lastError = std::error_code();
+    return mp_capture->stats();
+}
+
+void RsPoeImpl::exportCapture(const char *fileName, rs::CaptureFormat format)
+{
+    std::lock_guard<SharedMutex> lock(m_configMutex);
+    if (mp_capture == nullptr) {
+        m_lastError = RsErrorCode::NotInitialized;
+        m_lastErrorString = "Capture never started";
+        return;
     }
 
     try {
-        voltage = mp_controller->getPortVoltage(m_portMap[port]);
+        mp_capture->exportTo(fileName, format);
         m_lastError = std::error_code();
     }
     catch (const std::system_error &ex) {
@@ -254,28 +521,37 @@ float RsPoeImpl::getPortVoltage(int port)
         m_lastError = RsErrorCode::UnknownError;
         m_lastErrorString = "Unknown exception occurred";
     }
-
-    return voltage;
 }
 
-float RsPoeImpl::getPortCurrent(int port)
+void RsPoeImpl::startTelemetry(int intervalMs)
 {
-    float current = 0;
-
+    std::lock_guard<SharedMutex> lock(m_configMutex);
     if (mp_controller == nullptr) {
         m_lastError = RsErrorCode::NotInitialized;
         m_lastErrorString = "XML file never set";
-        return current;
+        return;
     }
 
-    if (m_portMap.find(port) == m_portMap.end()) {
+    if (intervalMs <= 0) {
         m_lastError = std::make_error_code(std::errc::invalid_argument);
-        m_lastErrorString = "Invalid port";
-        return current;
+        m_lastErrorString = "Invalid telemetry interval";
+        return;
     }
 
+    delete mp_telemetry;
+    mp_telemetry = nullptr;
+
+    std::vector<TelemetryListener *> listeners = {
+        &m_energy,
+        &m_budgetManager,
+    };
+    if (mp_listener) listeners.push_back(mp_listener);
+
     try {
-        current = mp_controller->getPortCurrent(m_portMap[port]);
+        mp_telemetry = new PoeTelemetry(
+            mp_controller, m_portMap, listeners, intervalMs, &m_telemetryJitter
+        );
+        mp_telemetry->configureThread(m_threadConfig);
         m_lastError = std::error_code();
     }
     catch (const std::system_error &ex) {
@@ -290,28 +566,55 @@ float RsPoeImpl::getPortCurrent(int port)
         m_lastError = RsErrorCode::UnknownError;
         m_lastErrorString = "Unknown exception occurred";
     }
+}
 
-    return current;
+void RsPoeImpl::stopTelemetry()
+{
+    std::lock_guard<SharedMutex> lock(m_configMutex);
+    delete mp_telemetry;
+    mp_telemetry = nullptr;
+    m_lastError = std::error_code();
 }
 
-float RsPoeImpl::getPortPower(int port)
+double RsPoeImpl::getPortEnergy(int port)
 {
-    float power = 0;
+    double energy = 0;
+    m_lastError = readPortEnergy(port, energy, &m_lastErrorString.get());
+    return energy;
+}
 
-    if (mp_controller == nullptr) {
-        m_lastError = RsErrorCode::NotInitialized;
-        m_lastErrorString = "XML file never set";
-        return power;
-    }
+rs::Result<double> RsPoeImpl::getPortEnergyEx(int port)
+{
+    double energy = 0;
+    std::error_code error = readPortEnergy(port, energy, nullptr);
+    if (error) return error;
+    return energy;
+}
 
+void RsPoeImpl::resetPortEnergy(int port)
+{
+    SharedLock lock(m_configMutex);
     if (m_portMap.find(port) == m_portMap.end()) {
         m_lastError = std::make_error_code(std::errc::invalid_argument);
         m_lastErrorString = "Invalid port";
-        return power;
+        return;
+    }
+
+    m_energy.reset(port);
+    m_lastError = std::error_code();
+}
+
+void RsPoeImpl::setEnergyCheckpoint(const char *fileName, int intervalSec)
+{
+    std::lock_guard<SharedMutex> lock(m_configMutex);
+    if (mp_controller == nullptr) {
+        m_lastError = RsErrorCode::NotInitialized;
+        m_lastErrorString = "XML file never set";
+        return;
     }
 
     try {
-        power = mp_controller->getPortPower(m_portMap[port]);
+        m_energy.setCheckpoint(fileName, intervalSec);
         m_lastError = std::error_code();
     }
     catch (const std::system_error &ex) {
@@ -326,12 +629,69 @@ float RsPoeImpl::getPortPower(int port)
         m_lastError = RsErrorCode::UnknownError;
         m_lastErrorString = "Unknown exception occurred";
     }
+}
 
-    return power;
+void RsPoeImpl::setBudgetLimit(float watts)
+{
+    SharedLock lock(m_configMutex);
+    if (mp_controller == nullptr) {
+        m_lastError = RsErrorCode::NotInitialized;
+        m_lastErrorString = "XML file never set";
+        return;
+    }
+
+    if (watts < 0) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid budget";
+        return;
+    }
+
+    m_budgetManager.setBudget(watts);
+    m_lastError = std::error_code();
+}
+
+void RsPoeImpl::setPortPriority(int port, int priority)
+{
+    SharedLock lock(m_configMutex);
+    if (m_portMap.find(port) == m_portMap.end()) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid port";
+        return;
+    }
+
+    m_budgetManager.setPriority(port, priority);
+    m_lastError = std::error_code();
+}
+
+void RsPoeImpl::setPortPowerLimit(int port, float watts)
+{
+    SharedLock lock(m_configMutex);
+    if (m_portMap.find(port) == m_portMap.end()) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid port";
+        return;
+    }
+
+    if (watts < 0) {
+        m_lastError = std::make_error_code(std::errc::invalid_argument);
+        m_lastErrorString = "Invalid power limit";
+        return;
+    }
+
+    m_budgetManager.setPowerLimit(port, watts);
+    m_lastError = std::error_code();
+}
+
+std::vector<int> RsPoeImpl::getShedPorts()
+{
+    SharedLock lock(m_configMutex);
+    m_lastError = std::error_code();
+    return m_budgetManager.shedPorts();
 }
 
 int RsPoeImpl::getBudgetConsumed()
 {
+    SharedLock lock(m_configMutex);
     int consumed = 0;
     if (mp_controller == nullptr) {
         m_lastError = RsErrorCode::NotInitialized;
@@ -361,6 +721,7 @@ int RsPoeImpl::getBudgetConsumed()
 
 int RsPoeImpl::getBudgetAvailable()
 {
+    SharedLock lock(m_configMutex);
     int available = 0;
 
     if (mp_controller == nullptr) {
@@ -391,6 +752,7 @@ int RsPoeImpl::getBudgetAvailable()
 
 int RsPoeImpl::getBudgetTotal()
 {
+    SharedLock lock(m_configMutex);
     int total = 0;
 
     if (mp_controller == nullptr) {
@@ -419,21 +781,216 @@ int RsPoeImpl::getBudgetTotal()
     return total;
 }
 
+// The config is tried up front so errors show up here. Threads that are
+// started later apply it without checking again.
+void RsPoeImpl::setThreadConfig(const rs::ThreadConfig &config)
+{
+    std::lock_guard<SharedMutex> lock(m_configMutex);
+    std::error_code error = testThreadConfig(config);
+    if (!error && mp_telemetry) error = mp_telemetry->configureThread(config);
+    if (!error && mp_capture) error = mp_capture->configureThread(config);
+
+    if (error) {
+        m_lastError = error;
+        m_lastErrorString = "Failed to apply the thread config";
+        return;
+    }
+
+    m_threadConfig = config;
+    m_lastError = std::error_code();
+}
+
+rs::JitterReport RsPoeImpl::getJitterReport()
+{
+    SharedLock lock(m_configMutex);
+    m_lastError = std::error_code();
+    return m_telemetryJitter.report();
+}
+
+std::error_code RsPoeImpl::readPortState(
+    int port,
+    rs::PoeState &state,
+    std::string *what
+)
+{
+    SharedLock lock(m_configMutex);
+    uint8_t index = 0;
+    std::error_code error = findPort(port, index, what);
+    if (error) return error;
+
+    try {
+        state = mp_controller->getPortState(index);
+        cacheState(port, state);
+        return std::error_code();
+    }
+    catch (...) {
+        return currentError(what);
+    }
+}
+
+std::error_code
+RsPoeImpl::writePortState(int port, rs::PoeState state, std::string *what)
+{
+    SharedLock lock(m_configMutex);
+    if (mp_controller == nullptr) {
+        return failWith(RsErrorCode::NotInitialized, "XML file never set", what);
+    }
+
+    if (state == rs::PoeState::Error) {
+        return failWith(
+            std::make_error_code(std::errc::invalid_argument),
+            "Invalid state",
+            what
+        );
+    }
+
+    uint8_t index = 0;
+    std::error_code error = findPort(port, index, what);
+    if (error) return error;
+
+    try {
+        mp_controller->setPortState(index, state);
+        m_budgetManager.release(port);
+        cacheState(port, state);
+        return std::error_code();
+    }
+    catch (...) {
+        cacheState(port, rs::PoeState::Error);
+        return currentError(what);
+    }
+}
+
+std::error_code RsPoeImpl::readPort(
+    int port,
+    float (AbstractPoeController::*read)(uint8_t),
+    float &value,
+    std::string *what
+)
+{
+    SharedLock lock(m_configMutex);
+    uint8_t index = 0;
+    std::error_code error = findPort(port, index, what);
+    if (error) return error;
+
+    try {
+        value = (mp_controller->*read)(index);
+        return std::error_code();
+    }
+    catch (...) {
+        return currentError(what);
+    }
+}
+
+std::error_code
+RsPoeImpl::readPortEnergy(int port, double &energy, std::string *what)
+{
+    SharedLock lock(m_configMutex);
+    if (m_portMap.find(port) == m_portMap.end()) {
+        return failWith(
+            std::make_error_code(std::errc::invalid_argument),
+            "Invalid port",
+            what
+        );
+    }
+
+    energy = m_energy.getEnergy(port);
+    return std::error_code();
+}
+
+std::error_code
+RsPoeImpl::findPort(int port, uint8_t &index, std::string *what) const
+{
+    if (mp_controller == nullptr) {
+        return failWith(RsErrorCode::NotInitialized, "XML file never set", what);
+    }
+
+    auto it = m_portMap.find(port);
+    if (it == m_portMap.end()) {
+        return failWith(
+            std::make_error_code(std::errc::invalid_argument),
+            "Invalid port",
+            what
+        );
+    }
+
+    index = it->second;
+    return std::error_code();
+}
+
+void RsPoeImpl::cacheState(int port, rs::PoeState state)
+{
+    std::lock_guard<std::mutex> lock(m_stateMutex);
+    m_states[port] = state;
+}
+
+void RsPoeImpl::clearStates()
+{
+    std::lock_guard<std::mutex> lock(m_stateMutex);
+    m_states.clear();
+}
+
+void RsPoeImpl::setTelemetryListener(TelemetryListener *listener)
+{
+    std::lock_guard<SharedMutex> lock(m_configMutex);
+    mp_listener = listener;
+}
+
+std::map<int, rs::PoeState> RsPoeImpl::getCachedPortStates()
+{
+    SharedLock lock(m_configMutex);
+    std::map<int, rs::PoeState> states;
+    if (mp_controller == nullptr) return states;
+
+    {
+        std::lock_guard<std::mutex> stateLock(m_stateMutex);
+        states = m_states;
+    }
+
+    for (const auto &pair : m_portMap) {
+        auto it = states.find(pair.first);
+        if (it != states.end() && it->second != rs::PoeState::Error) continue;
+
+        rs::PoeState state = rs::PoeState::Error;
+        try {
+            state = mp_controller->getPortState(pair.second);
+            cacheState(pair.first, state);
+        }
+        catch (...) {
+        }
+        states[pair.first] = state;
+    }
+
+    for (int port : m_budgetManager.shedPorts())
+        states[port] = rs::PoeState::Disabled;
+
+    return states;
+}
+
 std::error_code RsPoeImpl::getLastError() const { return m_lastError; }
 
 std::string RsPoeImpl::getLastErrorString() const
 {
     std::string lastError;
 
-    if (m_lastError.value() != 0) {
-        lastError += m_lastError.message();
-        if (!m_lastErrorString.empty()) {
-            lastError += ": " + m_lastErrorString;
+    const std::error_code &error = m_lastError;
+    if (error.value() != 0) {
+        lastError += error.message();
+        const std::string &errorString = m_lastErrorString;
+        if (!errorString.empty()) {
+            lastError += ": " + errorString;
         }
     }
     return lastError;
 }
 
-rs::RsPoe *rs::createRsPoe() { return new RsPoeImpl; }
+rs::RsPoe *rs::createRsPoe()
+{
+    // Hand out a client if the process asked for rsiod, so it doesn't fight
+    // the daemon over the SMBus.
+    RsPoeClient *client = RsPoeClient::connect(iodClientSocketPath());
+    if (client) return client;
+
+    return new RsPoeImpl;
+}
 
 const char *rs::rsPoeVersion() { return RSSDK_VERSION_STRING; }
@@ -4,14 +4,26 @@
 #include <stdint.h>
 
 #include <map>
+#include <mutex>
 #include <string>
 #include <vector>
 
+#include "../../utils/perthread.h"
+#include "../../utils/sharedmutex.h"
 #include "../include/rspoe.h"
 #include "controllers/abstractpoecontroller.h"
+#include "budgetmanager.h"
+#include "energymeter.h"
+#include "poetelemetry.h"
+#include "portcapture.h"
 
-typedef std::map<int, uint8_t> portmap_t;
-
+// Every function can be called from any thread. Errors are kept per thread,
+// so getLastError reports the last call the calling thread made.
+//
+// Port functions hold m_configMutex shared and rely on the controller and
+// the SMBus code to serialize access to the chip and the bus. Everything
+// that reconfigures the instance or starts and stops a worker holds it
+// exclusively. Nothing is shared with RsDio, so the two never contend.
 class RsPoeImpl : public rs::RsPoe {
    public:
     RsPoeImpl();
@@ -26,23 +38,98 @@ class RsPoeImpl : public rs::RsPoe {
 
     rs::PoeState getPortState(int port) override;
     void setPortState(int port, rs::PoeState state) override;
+    void setPortStates(const std::map<int, rs::PoeState> &states) override;
+
+    void resync() override;
 
     float getPortVoltage(int port) override;
     float getPortCurrent(int port) override;
     float getPortPower(int port) override;
 
+    void startCapture(
+        int port,
+        float rate,
+        rs::PoeSample *buffer,
+        size_t size
+    ) override;
+    void stopCapture() override;
+    size_t readCapture(rs::PoeSample *samples, size_t count) override;
+    rs::PoeCaptureStats getCaptureStats() override;
+    void exportCapture(const char *fileName, rs::CaptureFormat format) override;
+
+    void startTelemetry(int intervalMs) override;
+    void stopTelemetry() override;
+
+    double getPortEnergy(int port) override;
+    void resetPortEnergy(int port) override;
+    void setEnergyCheckpoint(const char *fileName, int intervalSec) override;
+
+    void setBudgetLimit(float watts) override;
+    void setPortPriority(int port, int priority) override;
+    void setPortPowerLimit(int port, float watts) override;
+    std::vector<int> getShedPorts() override;
+
     int getBudgetConsumed() override;
     int getBudgetAvailable() override;
     int getBudgetTotal() override;
 
+    void setThreadConfig(const rs::ThreadConfig &config) override;
+    rs::JitterReport getJitterReport() override;
+
+    rs::Result<rs::PoeState> getPortStateEx(int port) override;
+    rs::Result<void> setPortStateEx(int port, rs::PoeState state) override;
+    rs::Result<float> getPortVoltageEx(int port) override;
+    rs::Result<float> getPortCurrentEx(int port) override;
+    rs::Result<float> getPortPowerEx(int port) override;
+    rs::Result<double> getPortEnergyEx(int port) override;
+
+    // Not part of RsPoe. Adds listener to the telemetry from the next
+    // startTelemetry on, for rsiod to publish the readings.
+    void setTelemetryListener(TelemetryListener *listener);
+    // Not part of RsPoe. The state of every port as last read or set, so
+    // rsiod can publish them without going to the bus. Ports that weren't
+    // read since the XML file was set or resync was called are read from the
+    // controller, and shed ports are Disabled. Ports that can't be read are
+    // Error.
+    std::map<int, rs::PoeState> getCachedPortStates();
+
     std::error_code getLastError() const override;
     std::string getLastErrorString() const override;
 
    private:
-    std::error_code m_lastError;
-    std::string m_lastErrorString;
+    // The port functions return their error for both the last error and the
+    // ...Ex variants. what receives the message and may be null.
+    std::error_code
+    readPortState(int port, rs::PoeState &state, std::string *what);
+    std::error_code
+    writePortState(int port, rs::PoeState state, std::string *what);
+    std::error_code readPort(
+        int port,
+        float (AbstractPoeController::*read)(uint8_t),
+        float &value,
+        std::string *what
+    );
+    std::error_code readPortEnergy(int port, double &energy, std::string *what);
+    std::error_code findPort(int port, uint8_t &index, std::string *what) const;
+    void cacheState(int port, rs::PoeState state);
+    void clearStates();
+
+    PerThread<std::error_code> m_lastError;
+    PerThread<std::string> m_lastErrorString;
+    mutable SharedMutex m_configMutex;
     portmap_t m_portMap;
     AbstractPoeController *mp_controller;
+    PortCapture *mp_capture;
+    PoeTelemetry *mp_telemetry;
+    TelemetryListener *mp_listener;
+    rs::ThreadConfig m_threadConfig;
+    JitterHistogram m_telemetryJitter;
+    EnergyMeter m_energy;
+    BudgetManager m_budgetManager;
+
+    // Error marks a port whose state isn't known.
+    std::mutex m_stateMutex;
+    std::map<int, rs::PoeState> m_states;
 };
 
 #endif  // RSPOEIMPL_H
\ No newline at end of file
@@ -1,11 +1,19 @@
 #include <rsdio.h>
 
 #include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <functional>
 #include <iostream>
+#include <map>
 #include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
 static bool stringToState(std::string str)
@@ -64,6 +72,371 @@ static const char* directionToString(rs::PinDirection dir)
     return dir == rs::PinDirection::Input ? "input" : "output";
 }
 
+static volatile sig_atomic_t interrupted = 0;
+
+static void onInterrupt(int) { interrupted = 1; }
+
+static uint64_t timestampNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()
+    )
+        .count();
+}
+
+struct CaptureOptions {
+    std::vector<int> dios;
+    int rateHz = 1000;
+    int durationMs = 0;  // 0 runs until the trigger or Ctrl-C
+    std::string format = "vcd";
+    int triggerPin = -1;
+    bool triggerState = true;
+};
+
+struct CaptureChannel {
+    int dio;
+    int pin;
+    bool state;
+};
+
+// Single producer / single consumer queue between the sampling thread, which
+// runs the edge callbacks, and the thread writing the capture file. Pushing
+// never blocks, events that don't fit are counted instead.
+class CaptureQueue {
+   public:
+    explicit CaptureQueue(size_t size)
+        : m_events(size), m_head(0), m_tail(0), m_overruns(0)
+    {
+    }
+
+    void push(const rs::DioEvent& event)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) >= m_events.size()) {
+            m_overruns.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        m_events[head % m_events.size()] = event;
+        m_head.store(head + 1, std::memory_order_release);
+    }
+
+    bool pop(rs::DioEvent& event)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail == m_head.load(std::memory_order_acquire)) return false;
+
+        event = m_events[tail % m_events.size()];
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    uint64_t overruns() const { return m_overruns; }
+
+   private:
+    std::vector<rs::DioEvent> m_events;
+    std::atomic<size_t> m_head;
+    std::atomic<size_t> m_tail;
+    std::atomic<uint64_t> m_overruns;
+};
+
+class CaptureWriter {
+   public:
+    explicit CaptureWriter(FILE* file) : mp_file(file) {}
+    virtual ~CaptureWriter() {}
+
+    virtual void begin(
+        const std::vector<CaptureChannel>& channels,
+        int intervalUs
+    ) = 0;
+    // time is in nanoseconds since the start of the capture.
+    virtual void change(uint64_t time, size_t channel, bool state) = 0;
+    virtual void end(uint64_t time) = 0;
+
+   protected:
+    FILE* mp_file;
+};
+
+// Value Change Dump as read by GTKWave. Every pin is a one bit wire in a
+// scope named after its connector.
+class VcdWriter : public CaptureWriter {
+   public:
+    explicit VcdWriter(FILE* file) : CaptureWriter(file), m_time(0) {}
+
+    void begin(const std::vector<CaptureChannel>& channels, int intervalUs)
+        override
+    {
+        fprintf(mp_file, "$version rsdioctl %s $end\n", rs::rsDioVersion());
+        fprintf(mp_file, "$comment sampled every %i us $end\n", intervalUs);
+        fprintf(mp_file, "$timescale 1 ns $end\n");
+
+        int dio = -1;
+        for (size_t i = 0; i < channels.size(); ++i) {
+            m_ids.emplace_back(identifier(i));
+            if (channels[i].dio != dio) {
+                if (dio >= 0) fprintf(mp_file, "$upscope $end\n");
+                dio = channels[i].dio;
+                fprintf(mp_file, "$scope module dio%i $end\n", dio);
+            }
+            fprintf(
+                mp_file,
+                "$var wire 1 %s pin%i $end\n",
+                m_ids[i].c_str(),
+                channels[i].pin
+            );
+        }
+        if (dio >= 0) fprintf(mp_file, "$upscope $end\n");
+        fprintf(mp_file, "$enddefinitions $end\n#0\n$dumpvars\n");
+
+        for (size_t i = 0; i < channels.size(); ++i)
+            fprintf(mp_file, "%i%s\n", channels[i].state, m_ids[i].c_str());
+        fprintf(mp_file, "$end\n");
+    }
+
+    void change(uint64_t time, size_t channel, bool state) override
+    {
+        if (time != m_time) {
+            fprintf(mp_file, "#%llu\n", (unsigned long long)time);
+            m_time = time;
+        }
+        fprintf(mp_file, "%i%s\n", state, m_ids[channel].c_str());
+    }
+
+    void end(uint64_t time) override
+    {
+        if (time > m_time) fprintf(mp_file, "#%llu\n", (unsigned long long)time);
+    }
+
+   private:
+    // Identifiers are base 94 numbers made of the printable characters.
+    static std::string identifier(size_t index)
+    {
+        std::string id;
+        do {
+            id += (char)('!' + index % 94);
+            index /= 94;
+        } while (index > 0);
+        return id;
+    }
+
+    std::vector<std::string> m_ids;
+    uint64_t m_time;
+};
+
+// Compact binary format, see rsdioctl.md. All values are in host byte order.
+class BinaryWriter : public CaptureWriter {
+   public:
+    explicit BinaryWriter(FILE* file) : CaptureWriter(file) {}
+
+    void begin(const std::vector<CaptureChannel>& channels, int intervalUs)
+        override
+    {
+        uint32_t version = 1;
+        uint32_t interval = intervalUs;
+        uint32_t count = channels.size();
+        fwrite("RSDIOCAP", 1, 8, mp_file);
+        fwrite(&version, sizeof(version), 1, mp_file);
+        fwrite(&interval, sizeof(interval), 1, mp_file);
+        fwrite(&count, sizeof(count), 1, mp_file);
+
+        for (const CaptureChannel& channel : channels) {
+            uint8_t data[3] = {
+                (uint8_t)channel.dio, (uint8_t)channel.pin, channel.state
+            };
+            fwrite(data, 1, sizeof(data), mp_file);
+        }
+    }
+
+    void change(uint64_t time, size_t channel, bool state) override
+    {
+        uint16_t index = channel;
+        uint8_t value = state;
+        fwrite(&time, sizeof(time), 1, mp_file);
+        fwrite(&index, sizeof(index), 1, mp_file);
+        fwrite(&value, sizeof(value), 1, mp_file);
+    }
+
+    void end(uint64_t) override {}
+};
+
+// Samples every pin of the requested connectors and streams the changes to
+// fileName. The edge callbacks only queue the changes, the file is written
+// by a separate thread so a slow disk never delays the sampler.
+static std::string runCapture(
+    rs::RsDio& rsdio,
+    const std::string& fileName,
+    CaptureOptions options,
+    bool& userError
+)
+{
+    if (options.dios.empty()) options.dios.push_back(1);
+    std::sort(options.dios.begin(), options.dios.end());
+    options.dios.erase(
+        std::unique(options.dios.begin(), options.dios.end()),
+        options.dios.end()
+    );
+
+    if (fileName.empty()) {
+        userError = true;
+        return "Missing capture file";
+    }
+
+    if (options.rateHz <= 0 || options.rateHz > 1000000) {
+        userError = true;
+        return "Invalid sample rate";
+    }
+
+    if (options.format != "vcd" && options.format != "bin") {
+        userError = true;
+        return "Invalid capture format";
+    }
+
+    rs::DioSnapshot snapshot = rsdio.readAllPacked();
+    if (rsdio.getLastError()) return rsdio.getLastErrorString();
+
+    // Channel n of the file is the n-th pin of the sorted connectors.
+    std::vector<CaptureChannel> channels;
+    std::map<std::pair<int, int>, size_t> channelIndex;
+    for (int dio : options.dios) {
+        if (dio < 0 || dio >= rs::kMaxDios || !snapshot.valid[dio]) {
+            userError = true;
+            return "Invalid DIO";
+        }
+
+        for (int pin = 0; pin < 64; ++pin) {
+            if (!(snapshot.valid[dio] & (1ULL << pin))) continue;
+            channelIndex[std::make_pair(dio, pin)] = channels.size();
+            channels.push_back({dio, pin, false});
+        }
+    }
+
+    int triggerDio = options.dios.front();
+    if (options.triggerPin >= 0 &&
+        !channelIndex.count(std::make_pair(triggerDio, options.triggerPin))) {
+        userError = true;
+        return "Invalid trigger pin";
+    }
+
+    std::unique_ptr<FILE, int (*)(FILE*)> file(
+        fopen(fileName.c_str(), "wb"), fclose
+    );
+    if (!file) return "Failed to open " + fileName + ": " + strerror(errno);
+    setvbuf(file.get(), nullptr, _IOFBF, 1 << 20);
+
+    std::unique_ptr<CaptureWriter> writer;
+    if (options.format == "vcd")
+        writer.reset(new VcdWriter(file.get()));
+    else
+        writer.reset(new BinaryWriter(file.get()));
+
+    int intervalUs = std::max(1, 1000000 / options.rateHz);
+
+    // Events from before the initial states were read are already part of
+    // them. Until then start is in the future, so nothing triggers either.
+    CaptureQueue queue(1 << 16);
+    std::atomic<uint64_t> start(UINT64_MAX);
+    std::atomic<bool> triggered(false);
+    std::vector<int> handles;
+    for (int dio : options.dios) {
+        int handle = rsdio.attachConnectorCallback(
+            dio,
+            snapshot.valid[dio],
+            rs::Edge::Both,
+            [&](const rs::DioEvent& event) {
+                queue.push(event);
+                if (event.dio == triggerDio &&
+                    event.pin == options.triggerPin &&
+                    event.state == options.triggerState &&
+                    event.timestamp >= start.load(std::memory_order_relaxed))
+                    triggered.store(true, std::memory_order_relaxed);
+            }
+        );
+        if (rsdio.getLastError()) {
+            for (int h : handles) rsdio.detachCallback(h);
+            return rsdio.getLastErrorString();
+        }
+        handles.push_back(handle);
+    }
+
+    // The first scan doesn't report any edges, so the initial states are
+    // read once startSampling has taken it. Reading them any earlier would
+    // miss a pin that changes before the first scan.
+    signal(SIGINT, onInterrupt);
+    rsdio.startSampling(intervalUs);
+    std::string errorString;
+    if (!rsdio.getLastError()) {
+        start = timestampNow();
+        snapshot = rsdio.readAllPacked();
+    }
+    if (rsdio.getLastError()) {
+        errorString = rsdio.getLastErrorString();
+        rsdio.stopSampling();
+        signal(SIGINT, SIG_DFL);
+        for (int handle : handles) rsdio.detachCallback(handle);
+        return errorString;
+    }
+
+    for (CaptureChannel& channel : channels)
+        channel.state = (snapshot.states[channel.dio] >> channel.pin) & 1;
+    writer->begin(channels, intervalUs);
+
+    uint64_t last = 0;
+    uint64_t changes = 0;
+    std::atomic<bool> done(false);
+    std::thread writerThread([&] {
+        std::vector<bool> states;
+        for (const CaptureChannel& channel : channels)
+            states.push_back(channel.state);
+
+        rs::DioEvent event;
+        for (;;) {
+            bool finished = done.load(std::memory_order_acquire);
+            bool idle = true;
+            while (queue.pop(event)) {
+                idle = false;
+                if (event.timestamp < start) continue;
+
+                size_t index =
+                    channelIndex[std::make_pair(event.dio, event.pin)];
+                if (states[index] == event.state) continue;
+
+                states[index] = event.state;
+                last = event.timestamp - start;
+                writer->change(last, index, event.state);
+                ++changes;
+            }
+
+            if (finished) break;
+            if (idle) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+
+    uint64_t end = start + (uint64_t)options.durationMs * 1000000;
+    while (!interrupted && !triggered) {
+        if (options.durationMs > 0 && timestampNow() >= end) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    rsdio.stopSampling();
+    signal(SIGINT, SIG_DFL);
+    for (int handle : handles) rsdio.detachCallback(handle);
+
+    done.store(true, std::memory_order_release);
+    writerThread.join();
+    writer->end(std::max(last, timestampNow() - start));
+
+    if (fflush(file.get()) != 0 && errorString.empty())
+        errorString = "Failed to write " + fileName + ": " + strerror(errno);
+
+    std::cerr << "Captured " << changes << " changes on " << channels.size()
+              << " pins";
+    if (queue.overruns() > 0)
+        std::cerr << ", " << queue.overruns() << " lost to overruns";
+    std::cerr << std::endl;
+
+    return errorString;
+}
+
 static void showUsage()
 {
     std::cout
@@ -86,6 +459,11 @@ static void showUsage()
         << "\t\t\trequires DIO and PIN to be defined\n"
         << "\t\t\tpin must support the mode\n"
         << "\n"
+        << "c=FILE, capture=FILE\tsamples every pin of the dio ports and\n"
+        << "\t\t\twrites the changes to FILE until the duration\n"
+        << "\t\t\tor trigger is reached, or Ctrl-C is pressed\n"
+        << "\t\t\t-d can be given more than once\n"
+        << "\n"
         << "m, mode\t\tOutput the current output mode of a specific dio port\n"
         << "m=MODE, mode=MODE\tsets the output mode of a specific dio port\n"
         << "\t\t\tModes:\n"
@@ -98,6 +476,19 @@ static void showUsage()
         << "-d NUM, --dio NUM \tthe dio number to be used by COMMAND\n"
         << "\t\t\tdefaults to 1 if not supplied\n"
         << "\n"
+        << "-r HZ, --rate HZ \tsample rate used by capture\n"
+        << "\t\t\tdefaults to 1000 if not supplied\n"
+        << "\n"
+        << "-t MS, --duration MS \thow long capture runs in milliseconds\n"
+        << "\n"
+        << "-f FORMAT, --format FORMAT\tfile format used by capture\n"
+        << "\t\t\tFormats:\n"
+        << "\t\t\tvcd, Value Change Dump (default)\n"
+        << "\t\t\tbin, compact binary\n"
+        << "\n"
+        << "--trigger PIN=STATE \tstops capture once PIN of the first dio\n"
+        << "\t\t\tchanges to STATE\n"
+        << "\n"
         << "-h, --human-readable \toutput data in a human readable format\n"
         << "\n"
         << "--help \t\t\tdisplay this help text and exit\n"
@@ -112,6 +503,7 @@ int main(int argc, char* argv[])
     bool human = false;
     bool debug = false;
     int dio = 1, pin = -1;
+    CaptureOptions capture;
     std::vector<std::string> argList;
     std::vector<std::string> ignoredArgs;
     for (int i = 1; i < argc; ++i) {
@@ -145,6 +537,7 @@ int main(int argc, char* argv[])
             if (i < argc - 1) {
                 try {
                     dio = std::stoi(std::string(argv[++i]));
+                    capture.dios.push_back(dio);
                 }
                 catch (...) {
                     std::cerr << "Invalid dio number" << std::endl;
@@ -158,6 +551,74 @@ int main(int argc, char* argv[])
                 return 1;
             }
         }
+        else if (arg == "-r" || arg == "--rate") {
+            if (i < argc - 1) {
+                try {
+                    capture.rateHz = std::stoi(std::string(argv[++i]));
+                }
+                catch (...) {
+                    std::cerr << "Invalid sample rate" << std::endl;
+                    showUsage();
+                    return 1;
+                }
+            }
+            else {
+                std::cerr << "Missing sample rate" << std::endl;
+                showUsage();
+                return 1;
+            }
+        }
+        else if (arg == "-t" || arg == "--duration") {
+            if (i < argc - 1) {
+                try {
+                    capture.durationMs = std::stoi(std::string(argv[++i]));
+                }
+                catch (...) {
+                    std::cerr << "Invalid duration" << std::endl;
+                    showUsage();
+                    return 1;
+                }
+            }
+            else {
+                std::cerr << "Missing duration" << std::endl;
+                showUsage();
+                return 1;
+            }
+        }
+        else if (arg == "-f" || arg == "--format") {
+            if (i < argc - 1) {
+                capture.format = argv[++i];
+                std::transform(
+                    capture.format.begin(),
+                    capture.format.end(),
+                    capture.format.begin(),
+                    tolower
+                );
+            }
+            else {
+                std::cerr << "Missing capture format" << std::endl;
+                showUsage();
+                return 1;
+            }
+        }
+        else if (arg == "--trigger") {
+            std::string trigger = i < argc - 1 ? argv[++i] : "";
+            size_t split = trigger.find("=");
+            try {
+                capture.triggerPin = std::stoi(trigger.substr(0, split));
+                capture.triggerState = stringToState(trigger.substr(split + 1));
+            }
+            catch (...) {
+                std::cerr << "Invalid trigger" << std::endl;
+                showUsage();
+                return 1;
+            }
+            if (split == trigger.npos || capture.triggerPin < 0) {
+                std::cerr << "Invalid trigger" << std::endl;
+                showUsage();
+                return 1;
+            }
+        }
         else if (arg == "-h" || arg == "--human-readable")
             human = true;
         else if (arg == "--debug")
@@ -269,6 +730,9 @@ int main(int argc, char* argv[])
                     printf("%i", dir);
             }
         }
+        else if (cmd == "c=" || cmd == "capture=") {
+            errorString = runCapture(*rsdio, val, capture, userError);
+        }
         else if (cmd == "m=" || cmd == "mode=") {
             rs::OutputMode mode = stringToMode(val);
             rsdio->setOutputMode(dio, mode);
@@ -0,0 +1,180 @@
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "daemon/iodserver.h"
+
+static IodServer* server = nullptr;
+
+static void onSignal(int)
+{
+    if (server) server->stop();
+}
+
+static void showUsage()
+{
+    std::cout
+        << "Usage: rsiod [OPTIONS]\n"
+        << "\n"
+        << "Owns the DIO and PoE hardware and shares it with every process\n"
+        << "using librsdio or librspoe on this machine.\n"
+        << "\n"
+        << "Options:\n"
+        << "--dio FILE \t\tthe DIO configuration file to serve\n"
+        << "\n"
+        << "--poe FILE \t\tthe PoE configuration file to serve\n"
+        << "\n"
+        << "--socket PATH \t\tthe socket clients connect to\n"
+        << "\t\t\tdefaults to $RSIOD_SOCKET or /run/rsiod.sock\n"
+        << "\n"
+        << "--socket-mode MODE \tthe octal permissions of the socket\n"
+        << "\t\t\tdefaults to 660\n"
+        << "\n"
+        << "--socket-group GROUP \tthe group that owns the socket\n"
+        << "\t\t\tdefaults to the group of the daemon\n"
+        << "\n"
+        << "--shm NAME \t\tthe shared memory the state is published in\n"
+        << "\t\t\tdefaults to /rsiod\n"
+        << "\n"
+        << "--interval-us US \thow often the pins are scanned\n"
+        << "\t\t\tdefaults to 1000\n"
+        << "\n"
+        << "--telemetry-ms MS \thow often the ports are read\n"
+        << "\t\t\tdefaults to 100\n"
+        << "\n"
+        << "--help \t\t\tdisplay this help text and exit\n"
+        << "--version \t\tdisplay library version information\n";
+}
+
+static bool parseNumber(const char* text, int& value)
+{
+    try {
+        value = std::stoi(std::string(text));
+    }
+    catch (...) {
+        return false;
+    }
+
+    return value > 0;
+}
+
+static bool parseMode(const char* text, int& mode)
+{
+    try {
+        size_t end = 0;
+        mode = std::stoi(std::string(text), &end, 8);
+        if (text[end] != '\0') return false;
+    }
+    catch (...) {
+        return false;
+    }
+
+    return mode >= 0 && mode <= 0777;
+}
+
+int main(int argc, char* argv[])
+{
+    IodServerConfig config;
+    config.socketPath = iodSocketPath();
+    config.socketMode = 0660;
+    config.shmName = "/rsiod";
+    config.samplingIntervalUs = 1000;
+    config.telemetryIntervalMs = 100;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i < argc - 1;
+        if (arg == "--help") {
+            showUsage();
+            return 0;
+        }
+        else if (arg == "--version") {
+            std::cout << rs::rsDioVersion() << std::endl;
+            return 0;
+        }
+        else if (arg == "--dio" && hasValue)
+            config.dioFile = argv[++i];
+        else if (arg == "--poe" && hasValue)
+            config.poeFile = argv[++i];
+        else if (arg == "--socket" && hasValue)
+            config.socketPath = argv[++i];
+        else if (arg == "--socket-mode" && hasValue) {
+            if (!parseMode(argv[++i], config.socketMode)) {
+                std::cerr << "Invalid socket mode" << std::endl;
+                showUsage();
+                return 1;
+            }
+        }
+        else if (arg == "--socket-group" && hasValue)
+            config.socketGroup = argv[++i];
+        else if (arg == "--shm" && hasValue)
+            config.shmName = argv[++i];
+        else if (arg == "--interval-us" && hasValue) {
+            if (!parseNumber(argv[++i], config.samplingIntervalUs)) {
+                std::cerr << "Invalid scan interval" << std::endl;
+                showUsage();
+                return 1;
+            }
+        }
+        else if (arg == "--telemetry-ms" && hasValue) {
+            if (!parseNumber(argv[++i], config.telemetryIntervalMs)) {
+                std::cerr << "Invalid telemetry interval" << std::endl;
+                showUsage();
+                return 1;
+            }
+        }
+        else {
+            std::cerr << "Invalid argument: " << arg << std::endl;
+            showUsage();
+            return 1;
+        }
+    }
+
+    if (config.dioFile.empty() && config.poeFile.empty()) {
+        std::cerr << "Nothing to serve, give --dio, --poe or both" << std::endl;
+        showUsage();
+        return 1;
+    }
+
+    // The daemon talks to the hardware itself, never to another rsiod.
+    std::unique_ptr<RsDioImpl> dio;
+    if (!config.dioFile.empty()) {
+        dio.reset(new RsDioImpl);
+        dio->setXmlFile(config.dioFile.c_str());
+        if (dio->getLastError()) {
+            std::cerr << dio->getLastErrorString() << std::endl;
+            return 1;
+        }
+    }
+
+    std::unique_ptr<RsPoeImpl> poe;
+    if (!config.poeFile.empty()) {
+        poe.reset(new RsPoeImpl);
+        poe->setXmlFile(config.poeFile.c_str());
+        if (poe->getLastError()) {
+            std::cerr << poe->getLastErrorString() << std::endl;
+            return 1;
+        }
+    }
+
+    try {
+        IodServer iodServer(dio.get(), poe.get(), config);
+        server = &iodServer;
+        signal(SIGINT, onSignal);
+        signal(SIGTERM, onSignal);
+
+        iodServer.run();
+
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        server = nullptr;
+    }
+    catch (const std::system_error& error) {
+        server = nullptr;
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,187 @@
+// Simulator driven benchmark for the PoE budget manager.
+//
+// Measures the cost of a single budget decision for growing port counts and
+// the worst-case time from a port going over budget until it's shed when
+// running through the telemetry thread.
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../poe/src/budgetmanager.h"
+#include "../poe/src/rspoeimpl.h"
+
+typedef std::chrono::steady_clock bench_clock_t;
+
+// Simulates ports with a resistive load that draws nothing while disabled.
+// Unlike TestPoeController it's safe to change the load while the telemetry
+// thread is reading it.
+class SimPoeController : public AbstractPoeController {
+   public:
+    SimPoeController(const std::vector<uint8_t> &ports)
+    {
+        for (uint8_t port : ports) {
+            m_states[port] = rs::PoeState::Auto;
+            m_loads[port] = 0;
+        }
+    }
+
+    rs::PoeState getPortState(uint8_t port) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_states.at(port);
+    }
+
+    void setPortState(uint8_t port, rs::PoeState state) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_states.at(port) = state;
+        if (state == rs::PoeState::Disabled) m_lastShed = bench_clock_t::now();
+    }
+
+    float getPortVoltage(uint8_t) override { return kVoltage; }
+
+    float getPortCurrent(uint8_t port) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_states.at(port) == rs::PoeState::Disabled) return 0;
+        return m_loads.at(port) / kVoltage;
+    }
+
+    void setLoad(uint8_t port, float watts)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_loads.at(port) = watts;
+    }
+
+    bench_clock_t::time_point lastShed()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_lastShed;
+    }
+
+   private:
+    static constexpr float kVoltage = 48.0f;
+
+    std::mutex m_mutex;
+    std::map<uint8_t, rs::PoeState> m_states;
+    std::map<uint8_t, float> m_loads;
+    bench_clock_t::time_point m_lastShed;
+};
+
+constexpr float SimPoeController::kVoltage;
+
+static double toMs(bench_clock_t::duration d)
+{
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+// Cost of one sweep that doesn't need to shed or restore anything, which is
+// what the manager does almost all of the time.
+static void benchDecision(int portCount)
+{
+    const int kIterations = 20000;
+
+    std::vector<uint8_t> internalPorts;
+    portmap_t portMap;
+    for (int i = 0; i < portCount; ++i) {
+        internalPorts.push_back(i);
+        portMap[i + 1] = i;
+    }
+
+    SimPoeController controller(internalPorts);
+    BudgetManager manager;
+    manager.setController(&controller, portMap);
+    manager.setBudget(portCount * 10.0f);
+    for (int i = 0; i < portCount; ++i) manager.setPriority(i + 1, i % 4);
+
+    TelemetrySweep sweep;
+    sweep.valid = true;
+    for (const auto &pair : portMap) {
+        sweep.ports.push_back(pair.first);
+        PortReading reading = {48.0f, 0.1f, 4.8f};
+        sweep.readings.push_back(reading);
+    }
+
+    manager.onTelemetryStarted();
+    bench_clock_t::time_point start = bench_clock_t::now();
+    for (int i = 0; i < kIterations; ++i) {
+        sweep.timestamp = i;
+        manager.onSweep(sweep);
+    }
+    double ns = std::chrono::duration<double, std::nano>(
+                    bench_clock_t::now() - start
+                )
+                    .count() /
+                kIterations;
+
+    std::cout << "  " << portCount << " ports: " << ns << " ns per sweep"
+              << std::endl;
+}
+
+int main()
+{
+    std::cout << "Budget decision cost" << std::endl;
+    for (int ports : {4, 16, 64, 240}) benchDecision(ports);
+
+    const int kIntervalMs = 5;
+    const int kTrials = 20;
+    const std::vector<uint8_t> internalPorts = {0, 1, 2, 3, 4, 5, 6, 7};
+    portmap_t portMap;
+    for (uint8_t port : internalPorts) portMap[port + 1] = port;
+
+    SimPoeController *controller = new SimPoeController(internalPorts);
+    RsPoeImpl poe(controller, portMap);
+    for (uint8_t port : internalPorts) controller->setLoad(port, 10);
+    for (const auto &pair : portMap)
+        poe.setPortPriority(pair.first, pair.first);
+    poe.setBudgetLimit(90);
+    poe.startTelemetry(kIntervalMs);
+
+    std::vector<double> latencies;
+    for (int trial = 0; trial < kTrials; ++trial) {
+        // Let the previous trial's ports come back before overloading again.
+        std::this_thread::sleep_for(
+            std::chrono::milliseconds(kIntervalMs * (trial % 3 + 1))
+        );
+        while (!poe.getShedPorts().empty())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        // An extra 25W on the highest priority port pushes the total to
+        // 105W, which forces the two lowest priority ports off.
+        bench_clock_t::time_point overload = bench_clock_t::now();
+        controller->setLoad(internalPorts.back(), 35);
+        while (poe.getShedPorts().empty())
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+
+        latencies.push_back(toMs(controller->lastShed() - overload));
+        controller->setLoad(internalPorts.back(), 10);
+    }
+    poe.stopTelemetry();
+
+    double total = 0;
+    for (double latency : latencies) total += latency;
+    double worst = *std::max_element(latencies.begin(), latencies.end());
+
+    std::cout << "Reaction latency with a " << kIntervalMs
+              << " ms telemetry interval over " << kTrials << " trials"
+              << std::endl;
+    std::cout << "  min "
+              << *std::min_element(latencies.begin(), latencies.end())
+              << " ms, avg " << total / latencies.size() << " ms, max "
+              << worst << " ms" << std::endl;
+
+    // A port should be shed by the first sweep after the overload. Allow a
+    // generous margin for scheduling on a loaded machine.
+    if (worst > kIntervalMs * 2 + 50) {
+        std::cerr << "Worst-case reaction latency of " << worst
+                  << " ms is over the bound" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,199 @@
+// Multi-threaded scaling benchmark for RsDio and RsPoe.
+//
+// Every thread hammers its own pin, each on a different GPIO register, or
+// its own PoE port. The simulated controllers spend about as long per access
+// as the real hardware does, so the numbers show how much of that time the
+// library lets overlap. Each run is done twice: through one global mutex, the
+// way callers had to serialize the libraries before, and calling straight in.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../dio/src/rsdioimpl.h"
+#include "../poe/src/rspoeimpl.h"
+
+typedef std::chrono::steady_clock bench_clock_t;
+
+static void busyWait(std::chrono::nanoseconds duration)
+{
+    bench_clock_t::time_point end = bench_clock_t::now() + duration;
+    while (bench_clock_t::now() < end) {
+    }
+}
+
+// An LPC port access takes about a microsecond. Registers are atomics so
+// the controller itself never serializes anything.
+class SimDioController : public AbstractDioController {
+   public:
+    static constexpr std::chrono::nanoseconds kAccessTime{1000};
+
+    SimDioController()
+    {
+        for (auto &reg : m_registers) reg = 0;
+    }
+
+    void initPin(const PinConfig &) override {}
+    PinMode getPinMode(const PinConfig &config) override
+    {
+        return config.supportsOutput ? ModeOutput : ModeInput;
+    }
+    void setPinMode(const PinConfig &, PinMode) override {}
+
+    bool getPinState(const PinConfig &config) override
+    {
+        busyWait(kAccessTime);
+        return (getGpioRegister(config.offset) & config.bitmask) != 0;
+    }
+
+    void setPinState(const PinConfig &config, bool state) override
+    {
+        busyWait(kAccessTime);
+        if (state)
+            m_registers[config.offset] |= config.bitmask;
+        else
+            m_registers[config.offset] &= ~config.bitmask;
+    }
+
+    void printRegs() override {}
+
+    uint8_t getGpioRegister(uint8_t offset) override
+    {
+        return m_registers[offset];
+    }
+
+    void setGpioRegister(uint8_t offset, uint8_t data) override
+    {
+        m_registers[offset] = data;
+    }
+
+   private:
+    std::atomic<uint8_t> m_registers[kMaxGpioSets];
+};
+
+constexpr std::chrono::nanoseconds SimDioController::kAccessTime;
+
+// An SMBus word read takes a few hundred microseconds; this is shortened to
+// keep the run quick. Each port sits on its own bus.
+class SimPoeController : public AbstractPoeController {
+   public:
+    static constexpr std::chrono::nanoseconds kAccessTime{20000};
+
+    rs::PoeState getPortState(uint8_t) override { return rs::PoeState::Auto; }
+    void setPortState(uint8_t, rs::PoeState) override {}
+
+    float getPortVoltage(uint8_t) override
+    {
+        busyWait(kAccessTime);
+        return 48.0f;
+    }
+
+    float getPortCurrent(uint8_t) override
+    {
+        busyWait(kAccessTime);
+        return 0.1f;
+    }
+};
+
+constexpr std::chrono::nanoseconds SimPoeController::kAccessTime;
+
+static const std::chrono::milliseconds kRunTime(100);
+
+// Runs work on threads threads for kRunTime and returns the calls per second
+// made by the threads that passed true.
+template <typename Work>
+static double run(int threads, Work work)
+{
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> calls(0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([t, &stop, &calls, &work]() {
+            uint64_t count = 0;
+            bool counted = true;
+            while (!stop) {
+                counted = work(t);
+                ++count;
+            }
+            if (counted) calls += count;
+        });
+    }
+
+    std::this_thread::sleep_for(kRunTime);
+    stop = true;
+    for (std::thread &worker : workers) worker.join();
+
+    return calls / std::chrono::duration<double>(kRunTime).count();
+}
+
+int main()
+{
+    pinconfigmap_t pins;
+    for (int pin = 0; pin < kMaxGpioSets; ++pin)
+        pins[pin] = PinConfig(0, pin + 1, false, false, true, true);
+    RsDioImpl dio(new SimDioController, {{1, pins}});
+
+    portmap_t ports;
+    for (int port = 0; port < 8; ++port) ports[port + 1] = port;
+    RsPoeImpl poe(new SimPoeController, ports);
+
+    std::mutex global;
+    std::atomic<bool> failed(false);
+
+    std::cout << "digitalRead on one register per thread (calls/s)"
+              << std::endl;
+    for (int threads : {1, 2, 4, 8}) {
+        double serialized = run(threads, [&](int t) {
+            std::lock_guard<std::mutex> lock(global);
+            dio.digitalRead(1, t % kMaxGpioSets);
+            return true;
+        });
+        double direct = run(threads, [&](int t) {
+            dio.digitalRead(1, t % kMaxGpioSets);
+            if (dio.getLastError()) failed = true;
+            return true;
+        });
+        std::cout << "  " << threads << " threads: global mutex "
+                  << (int)serialized << ", fine-grained " << (int)direct
+                  << std::endl;
+    }
+
+    // Half the threads read DIO pins and half PoE ports. Only the DIO calls
+    // are counted, to show how much the slow PoE calls hold them up.
+    std::cout << "digitalRead next to getPortVoltage (DIO calls/s)"
+              << std::endl;
+    for (int threads : {2, 4, 8}) {
+        double serialized = run(threads, [&](int t) {
+            std::lock_guard<std::mutex> lock(global);
+            if (t % 2) {
+                poe.getPortVoltage(t / 2 % 8 + 1);
+                return false;
+            }
+            dio.digitalRead(1, t / 2 % kMaxGpioSets);
+            return true;
+        });
+        double direct = run(threads, [&](int t) {
+            if (t % 2) {
+                poe.getPortVoltage(t / 2 % 8 + 1);
+                if (poe.getLastError()) failed = true;
+                return false;
+            }
+            dio.digitalRead(1, t / 2 % kMaxGpioSets);
+            return true;
+        });
+        std::cout << "  " << threads << " threads: global mutex "
+                  << (int)serialized << ", fine-grained " << (int)direct
+                  << std::endl;
+    }
+
+    if (failed) {
+        std::cerr << "A call failed while running concurrently" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -1,24 +1,34 @@
 #include <map>
+#include <mutex>
+#include <thread>
 
 #include "../dio/src/controllers/abstractdiocontroller.h"
 
 struct PinStatus
 {
-    bool state;
     PinMode mode;
     PinConfig config;
 };
 
+// Pin states live in emulated GPIO data registers like they do on the real
+// SuperIO chips, so the raw register access used by the sampler sees the
+// same state as getPinState.
+//
+// Register access grants are counted per thread like the ioperm grants of
+// the real chips. A release without a matching acquire, or raw register
+// access from a thread without a grant (which would crash on the real
+// hardware), is counted so the tests can check for it.
 class TestDioController : public AbstractDioController
 {
 public:
-    TestDioController() {}
+    TestDioController()
+        : m_registerWrites(0), m_unpairedReleases(0), m_ungrantedAccesses(0)
+    {}
 
     void initPin(const PinConfig &config) override final
     {
         uint16_t id = idFromConfig(config);
         PinStatus status;
-        status.state = 0;
         status.config = config;
         if (config.supportsInput)
             status.mode = PinMode::ModeInput;
@@ -26,6 +36,7 @@ public:
             status.mode = PinMode::ModeOutput;
         
         m_pins[id] = status;
+        setRegisterBits(config.offset, config.bitmask, false);
     }
 
     PinMode getPinMode(const PinConfig &config) override final
@@ -40,17 +51,115 @@ public:
 
     bool getPinState(const PinConfig &config) override final
     {
-        return getOrThrow(config).state;
+        getOrThrow(config);
+        return (registerValue(config.offset) & config.bitmask) != 0;
     }
 
+    // Like the real chips, a pin has to be in output mode to be written.
     void setPinState(const PinConfig &config, bool state) override final
     {
-        getOrThrow(config).state = state;
+        if (getOrThrow(config).mode != PinMode::ModeOutput)
+        {
+            throw std::system_error(
+                std::make_error_code(std::errc::invalid_argument),
+                "Can't set state of pin in input mode"
+            );
+        }
+        setRegisterBits(config.offset, config.bitmask, state);
     }
 
     void printRegs() override final {}
 
+    void acquireGpioAccess() override final
+    {
+        std::lock_guard<std::mutex> lock(m_registerMutex);
+        ++m_grants[std::this_thread::get_id()];
+    }
+
+    void releaseGpioAccess() override final
+    {
+        std::lock_guard<std::mutex> lock(m_registerMutex);
+        int &grants = m_grants[std::this_thread::get_id()];
+        if (grants > 0)
+            --grants;
+        else
+            ++m_unpairedReleases;
+    }
+
+    uint8_t getGpioRegister(uint8_t offset) override final
+    {
+        std::lock_guard<std::mutex> lock(m_registerMutex);
+        checkGrant();
+        return m_registers[offset];
+    }
+
+    void setGpioRegister(uint8_t offset, uint8_t data) override final
+    {
+        std::lock_guard<std::mutex> lock(m_registerMutex);
+        checkGrant();
+        m_registers[offset] = data;
+        ++m_registerWrites;
+    }
+
+    void modifyGpioRegister(
+        uint8_t offset,
+        uint8_t clearMask,
+        uint8_t setMask
+    ) override final
+    {
+        std::lock_guard<std::mutex> lock(m_registerMutex);
+        checkGrant();
+        m_registers[offset] = (m_registers[offset] & ~clearMask) | setMask;
+        ++m_registerWrites;
+    }
+
+    int registerWrites()
+    {
+        std::lock_guard<std::mutex> lock(m_registerMutex);
+        return m_registerWrites;
+    }
+
+    int unpairedReleases()
+    {
+        std::lock_guard<std::mutex> lock(m_registerMutex);
+        return m_unpairedReleases;
+    }
+
+    int ungrantedAccesses()
+    {
+        std::lock_guard<std::mutex> lock(m_registerMutex);
+        return m_ungrantedAccesses;
+    }
+
+    // Simulates a change on the input side of the connector.
+    void setRegisterBits(uint8_t offset, uint8_t mask, bool state)
+    {
+        std::lock_guard<std::mutex> lock(m_registerMutex);
+        if (state)
+            m_registers[offset] |= mask;
+        else
+            m_registers[offset] &= ~mask;
+    }
+
+    void setRegister(uint8_t offset, uint8_t data)
+    {
+        std::lock_guard<std::mutex> lock(m_registerMutex);
+        m_registers[offset] = data;
+    }
+
+    uint8_t registerValue(uint8_t offset)
+    {
+        std::lock_guard<std::mutex> lock(m_registerMutex);
+        return m_registers[offset];
+    }
+
 private:
+    // Called with m_registerMutex held.
+    void checkGrant()
+    {
+        if (m_grants[std::this_thread::get_id()] == 0) ++m_ungrantedAccesses;
+    }
+
     uint16_t idFromConfig(const PinConfig &config) const
     {
         return config.bitmask << 8 | config.offset;
@@ -71,4 +180,11 @@ private:
     }
 
     std::map<uint16_t, PinStatus> m_pins;
-};
\ No newline at end of file
+
+    std::mutex m_registerMutex;
+    std::map<uint8_t, uint8_t> m_registers;
+    int m_registerWrites;
+    std::map<std::thread::id, int> m_grants;
+    int m_unpairedReleases;
+    int m_ungrantedAccesses;
+};
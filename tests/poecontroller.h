@@ -46,7 +46,9 @@ class TestPoeController : public AbstractPoeController {
 
     float getPortCurrent(uint8_t port) override final
     {
-        return getOrThrow(port).current;
+        // A disabled port can't deliver any current.
+        PortStatus &status = getOrThrow(port);
+        return status.state == rs::PoeState::Disabled ? 0 : status.current;
     }
 
     float setPortCurrent(uint8_t port, float current)
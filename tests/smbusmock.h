@@ -0,0 +1,203 @@
+#include <stdint.h>
+
+#include <array>
+#include <deque>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "../utils/i801_smbus.h"
+
+typedef std::array<uint8_t, 15> smbusmsg_t;
+
+// Register-level stand-in for the SMBus so the PoE controllers can be tested
+// without the hardware. It defines the functions of utils/i801_smbus.h, so
+// tests using it compile the controllers without i801_smbus.cpp.
+//
+// Register accesses go to a plain register file, like on the PD69104 and the
+// LTC4266. Byte reads and writes speak enough of the PD692x0 message
+// protocol for the Pd69200 to start up and change port states, and keep the
+// enabled and forced flags of setChannelCount channels.
+class SmbusMock {
+   public:
+    SmbusMock()
+        : m_registers(),
+          m_failWrites(false),
+          m_channelCount(0),
+          m_enabled(),
+          m_forced()
+    {
+    }
+
+    uint8_t registerValue(uint8_t reg) const { return m_registers[reg]; }
+
+    // Changes a register behind the controller's back, like another program
+    // on the bus would.
+    void setRegister(uint8_t reg, uint8_t value) { m_registers[reg] = value; }
+
+    // Register writes in the order they were made.
+    const std::vector<std::pair<uint8_t, uint8_t>> &writes() const
+    {
+        return m_writes;
+    }
+
+    // Commands sent to the PD692x0 in the order they were sent.
+    const std::vector<smbusmsg_t> &commands() const { return m_commands; }
+
+    void clearWrites()
+    {
+        m_writes.clear();
+        m_commands.clear();
+    }
+
+    // Number of writes made to reg since the last clearWrites.
+    int writeCount(uint8_t reg) const
+    {
+        int count = 0;
+        for (const auto &write : m_writes) {
+            if (write.first == reg) ++count;
+        }
+
+        return count;
+    }
+
+    // While set, every write fails like a transaction the chip didn't
+    // acknowledge.
+    void setFailWrites(bool fail) { m_failWrites = fail; }
+
+    void write(uint8_t reg, uint8_t value)
+    {
+        if (m_failWrites) {
+            throw std::system_error(
+                std::make_error_code(std::errc::no_such_device_or_address)
+            );
+        }
+
+        m_registers[reg] = value;
+        m_writes.push_back(std::make_pair(reg, value));
+    }
+
+    void setChannelCount(uint8_t count) { m_channelCount = count; }
+    bool isChannelEnabled(uint8_t channel) const { return m_enabled[channel]; }
+    bool isChannelForced(uint8_t channel) const { return m_forced[channel]; }
+
+    void writeByte(uint8_t byte)
+    {
+        m_message.push_back(byte);
+        if (m_message.size() < smbusmsg_t().size()) return;
+
+        smbusmsg_t message;
+        for (size_t i = 0; i < message.size(); ++i) message[i] = m_message[i];
+        m_message.clear();
+        respond(message);
+    }
+
+    // Empty once the response has been read, like the chip.
+    uint8_t readByte()
+    {
+        if (m_response.empty()) return 0;
+
+        uint8_t byte = m_response.front();
+        m_response.pop_front();
+        return byte;
+    }
+
+   private:
+    void respond(const smbusmsg_t &message)
+    {
+        smbusmsg_t response;
+        response.fill(0x4e);
+        response[1] = message[1];
+
+        if (message[0] == 0x00) {
+            // Commands are acknowledged with a report of success.
+            m_commands.push_back(message);
+            response[0] = 0x52;
+            response[2] = 0;
+            response[3] = 0;
+
+            uint8_t channel = message[4];
+            if (message[3] == 0x0c)
+                setChannels(m_enabled, channel, message[5] == 0x01);
+            else if (message[3] == 0x51)
+                setChannels(m_forced, channel, message[5] == 0x01);
+        }
+        else {
+            response[0] = 0x03;
+            if (message[3] == 0x1e) {
+                // Software version: the device ID is the PD69200's.
+                response[4] = 0x16;
+            }
+            else if (message[3] == 0x0b && message[4] == 0x57) {
+                // Power bank: the 170W the controller asks for by default.
+                response[2] = 0;
+                response[3] = 170;
+            }
+            else if (message[3] == 0x0e) {
+                // Port status
+                uint8_t channel = message[4];
+                response[2] = m_enabled[channel] ? 0x01 : 0x00;
+                response[4] = m_forced[channel] ? 0x01 : 0x00;
+            }
+        }
+
+        uint16_t sum = 0;
+        for (size_t i = 0; i < response.size() - 2; ++i) sum += response[i];
+        response[response.size() - 2] = sum >> 8;
+        response[response.size() - 1] = sum & 0xff;
+        m_response.insert(m_response.end(), response.begin(), response.end());
+    }
+
+    // Channel 0x80 is a broadcast to every channel of the chip.
+    void setChannels(bool *flags, uint8_t channel, bool value)
+    {
+        if (channel == 0x80) {
+            for (uint8_t i = 0; i < m_channelCount; ++i) flags[i] = value;
+        }
+        else {
+            flags[channel] = value;
+        }
+    }
+
+    uint8_t m_registers[256];
+    std::vector<std::pair<uint8_t, uint8_t>> m_writes;
+    bool m_failWrites;
+
+    uint8_t m_channelCount;
+    bool m_enabled[256];
+    bool m_forced[256];
+    std::vector<uint8_t> m_message;
+    std::deque<uint8_t> m_response;
+    std::vector<smbusmsg_t> m_commands;
+};
+
+SmbusMock smbusMock;
+
+uint8_t smbus_read(uint16_t, uint8_t) { return smbusMock.readByte(); }
+
+void smbus_write(uint16_t, uint8_t, uint8_t command)
+{
+    smbusMock.writeByte(command);
+}
+
+uint8_t smbus_read_register(uint16_t, uint8_t, uint8_t command)
+{
+    return smbusMock.registerValue(command);
+}
+
+void smbus_write_register(uint16_t, uint8_t, uint8_t command, uint8_t value)
+{
+    smbusMock.write(command, value);
+}
+
+void i2c_read_block(
+    uint16_t,
+    uint8_t,
+    uint8_t command,
+    uint8_t *buf,
+    uint8_t size
+)
+{
+    for (uint8_t i = 0; i < size; ++i)
+        buf[i] = smbusMock.registerValue((uint8_t)(command + i));
+}
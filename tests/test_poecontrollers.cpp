@@ -0,0 +1,271 @@
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include "../poe/src/controllers/ltc4266.h"
+#include "../poe/src/controllers/pd69104.h"
+#include "../poe/src/controllers/pd69200.h"
+#include "smbusmock.h"
+#include "utils.h"
+
+// Registers shared by the PD69104 and the LTC4266.
+static const uint8_t kOpmdReg = 0x12;
+static const uint8_t kDisenaReg = 0x13;
+static const uint8_t kDetenaReg = 0x14;
+static const uint8_t kPwrpbReg = 0x19;
+
+static int configWrites()
+{
+    return smbusMock.writeCount(kOpmdReg) + smbusMock.writeCount(kDisenaReg) +
+           smbusMock.writeCount(kDetenaReg);
+}
+
+// Checks that the shadowed configuration registers skip redundant writes
+// without ever hiding what the chip actually holds.
+template <typename Controller>
+static int checkShadow(const char *name, uint8_t devIdReg, uint8_t devId)
+{
+    smbusMock = SmbusMock();
+    smbusMock.setRegister(devIdReg, devId);
+    Controller controller(0, 0);
+
+    controller.setPortState(0, rs::PoeState::Enabled);
+    if (smbusMock.registerValue(kOpmdReg) != 0x01 ||
+        smbusMock.writeCount(kPwrpbReg) != 1) {
+        std::cerr << name << ": setPortState didn't enable port 0"
+                  << std::endl;
+        return 1;
+    }
+
+    // Nothing changes, so only the power on push button is written.
+    smbusMock.clearWrites();
+    controller.setPortState(0, rs::PoeState::Enabled);
+    if (configWrites() != 0 || smbusMock.writeCount(kPwrpbReg) != 1) {
+        std::cerr << name << ": setPortState rewrote unchanged registers"
+                  << std::endl;
+        return 1;
+    }
+
+    // Another program shuts the port down. resync makes the next state
+    // change write the register again instead of trusting the shadow.
+    smbusMock.setRegister(kOpmdReg, 0x00);
+    controller.resync();
+    smbusMock.clearWrites();
+    controller.setPortState(0, rs::PoeState::Enabled);
+    if (smbusMock.writeCount(kOpmdReg) != 1 ||
+        smbusMock.registerValue(kOpmdReg) != 0x01) {
+        std::cerr << name << ": setPortState didn't write after resync"
+                  << std::endl;
+        return 1;
+    }
+
+    // A failed write leaves the shadow unknown, so the next access reads
+    // the chip.
+    smbusMock.setFailWrites(true);
+    try {
+        controller.setPortState(1, rs::PoeState::Auto);
+        std::cerr << name << ": setPortState ignored a failed write"
+                  << std::endl;
+        return 1;
+    }
+    catch (const std::system_error &error) {
+        verifyError(
+            "setPortState (failed write)",
+            error.code(),
+            std::errc::no_such_device_or_address
+        );
+    }
+    smbusMock.setFailWrites(false);
+
+    smbusMock.setRegister(kOpmdReg, 0x0d);
+    if (controller.getPortState(1) != rs::PoeState::Auto) {
+        std::cerr << name << ": getPortState trusted the shadow after a "
+                     "failed write"
+                  << std::endl;
+        return 1;
+    }
+
+    // Without a resync the shadow is trusted for a second at most.
+    smbusMock.setRegister(kOpmdReg, 0x0c);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    smbusMock.clearWrites();
+    controller.setPortState(0, rs::PoeState::Enabled);
+    if (smbusMock.writeCount(kOpmdReg) != 1 ||
+        smbusMock.registerValue(kOpmdReg) != 0x0d) {
+        std::cerr << name << ": setPortState trusted an old shadow"
+                  << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+// Starts the register file with every port in auto mode, so every state
+// in the tests below is a change.
+static void resetRegisters(uint8_t devIdReg, uint8_t devId)
+{
+    smbusMock = SmbusMock();
+    smbusMock.setRegister(devIdReg, devId);
+    smbusMock.setRegister(kOpmdReg, 0xff);
+    smbusMock.setRegister(kDisenaReg, 0x0f);
+    smbusMock.setRegister(kDetenaReg, 0xff);
+}
+
+// Checks that setPortStates leaves the registers as calling setPortState
+// for every port would, but writes each of them only once.
+template <typename Controller>
+static int checkCoalescing(const char *name, uint8_t devIdReg, uint8_t devId)
+{
+    portstatemap_t states = {
+        {0, rs::PoeState::Enabled},
+        {1, rs::PoeState::Auto},
+        {2, rs::PoeState::Disabled},
+        {3, rs::PoeState::Enabled},
+    };
+
+    resetRegisters(devIdReg, devId);
+    {
+        Controller controller(0, 0);
+        for (const auto &pair : states)
+            controller.setPortState(pair.first, pair.second);
+    }
+    uint8_t expected[] = {
+        smbusMock.registerValue(kOpmdReg),
+        smbusMock.registerValue(kDisenaReg),
+        smbusMock.registerValue(kDetenaReg),
+    };
+
+    resetRegisters(devIdReg, devId);
+    Controller controller(0, 0);
+    controller.setPortStates(states);
+    uint8_t actual[] = {
+        smbusMock.registerValue(kOpmdReg),
+        smbusMock.registerValue(kDisenaReg),
+        smbusMock.registerValue(kDetenaReg),
+    };
+    for (int i = 0; i < 3; ++i) {
+        if (actual[i] != expected[i]) {
+            std::cerr << name << ": setPortStates left register 0x" << std::hex
+                      << kOpmdReg + i << " at 0x" << (int)actual[i]
+                      << " instead of 0x" << (int)expected[i] << std::dec
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    // Both enabled ports are pushed on in one go.
+    if (smbusMock.writeCount(kOpmdReg) != 1 ||
+        smbusMock.writeCount(kDisenaReg) != 1 ||
+        smbusMock.writeCount(kDetenaReg) != 1 ||
+        smbusMock.writeCount(kPwrpbReg) != 1 ||
+        smbusMock.registerValue(kPwrpbReg) != 0x09) {
+        std::cerr << name << ": setPortStates made " << smbusMock.writes().size()
+                  << " writes instead of one per register" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+static bool channelsMatch(const portstatemap_t &states)
+{
+    for (const auto &pair : states) {
+        bool enabled = pair.second != rs::PoeState::Disabled;
+        bool forced = pair.second == rs::PoeState::Enabled;
+        if (smbusMock.isChannelEnabled(pair.first) != enabled ||
+            smbusMock.isChannelForced(pair.first) != forced)
+            return false;
+    }
+
+    return true;
+}
+
+static bool broadcasted()
+{
+    for (const auto &command : smbusMock.commands()) {
+        if (command[4] == 0x80) return true;
+    }
+
+    return false;
+}
+
+// Checks that the Pd69200 only broadcasts to all channels when every one of
+// them is being changed.
+static int checkBroadcast()
+{
+    portstatemap_t states = {
+        {0, rs::PoeState::Enabled},
+        {1, rs::PoeState::Enabled},
+        {2, rs::PoeState::Enabled},
+        {3, rs::PoeState::Disabled},
+    };
+
+    // Every channel has a port: one broadcast turns all of them on, then
+    // only channel 3 is turned back off.
+    smbusMock = SmbusMock();
+    smbusMock.setChannelCount(4);
+    {
+        Pd69200 controller(0, 0, 170, 4);
+        smbusMock.clearWrites();
+        controller.setPortStates(states);
+    }
+    if (smbusMock.commands().size() != 4 || smbusMock.commands()[0][4] != 0x80 ||
+        !channelsMatch(states)) {
+        std::cerr << "Pd69200: setPortStates didn't broadcast to all channels "
+                     "with "
+                  << smbusMock.commands().size() << " commands" << std::endl;
+        return 1;
+    }
+
+    // Channels 4 to 7 have no port, so they must be left alone.
+    smbusMock = SmbusMock();
+    smbusMock.setChannelCount(8);
+    {
+        Pd69200 controller(0, 0, 170, 8);
+        smbusMock.clearWrites();
+        controller.setPortStates(states);
+    }
+    if (broadcasted() || !channelsMatch(states)) {
+        std::cerr << "Pd69200: setPortStates broadcast to channels without "
+                     "a port"
+                  << std::endl;
+        return 1;
+    }
+
+    for (uint8_t channel = 4; channel < 8; ++channel) {
+        if (smbusMock.isChannelEnabled(channel)) {
+            std::cerr << "Pd69200: setPortStates enabled channel "
+                      << (int)channel << std::endl;
+            return 1;
+        }
+    }
+
+    // Without the channel count the controller can't know, so it never
+    // broadcasts.
+    smbusMock = SmbusMock();
+    smbusMock.setChannelCount(4);
+    {
+        Pd69200 controller(0, 0);
+        smbusMock.clearWrites();
+        controller.setPortStates(states);
+    }
+    if (broadcasted() || !channelsMatch(states)) {
+        std::cerr << "Pd69200: setPortStates broadcast without a channel "
+                     "count"
+                  << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+int main()
+{
+    if (checkShadow<Pd69104>("Pd69104", 0x43, 0x44)) return 1;
+    if (checkShadow<Ltc4266>("Ltc4266", 0x1b, 0x64)) return 1;
+    if (checkCoalescing<Pd69104>("Pd69104", 0x43, 0x44)) return 1;
+    if (checkCoalescing<Ltc4266>("Ltc4266", 0x1b, 0x64)) return 1;
+    if (checkBroadcast()) return 1;
+
+    return 0;
+}
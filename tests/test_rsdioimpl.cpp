@@ -1,5 +1,11 @@
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
 
+#include "../dio/src/controllers/controllerregistry.h"
 #include "../dio/src/rsdioimpl.h"
 #include "diocontroller.h"
 #include "utils.h"
@@ -16,15 +22,129 @@ std::string modeToString(rs::OutputMode mode)
     }
 }
 
+// Polls cond until it's true or timeoutMs expires. Used for anything that
+// depends on the sampling thread.
+template <typename Condition>
+static bool waitFor(Condition cond, int timeoutMs = 2000)
+{
+    auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (!cond()) {
+        if (std::chrono::steady_clock::now() > deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    return true;
+}
+
+// Compares both PinPacker paths with a plain per-pin loop on a pin map that's
+// scattered across registers in no particular order, like most XML files.
+static bool checkPinPacker()
+{
+    pinconfigmap_t pins = {
+        {1, PinConfig(7, 1, false, false, true, true)},
+        {2, PinConfig(0, 2, true, false, true, true)},
+        {3, PinConfig(5, 1, false, false, true, true)},
+        {4, PinConfig(6, 1, true, false, true, true)},
+        {5, PinConfig(2, 4, false, false, true, true)},
+        {6, PinConfig(0, 1, false, false, true, true)},
+        {7, PinConfig(3, 2, true, false, true, true)},
+        {8, PinConfig(1, 4, false, false, true, true)},
+        {-1, PinConfig(4, 1, false, false, false, true)}
+    };
+
+    PinPacker packers[2] = {PinPacker(pins, true), PinPacker(pins, false)};
+    uint64_t word = 0x9e3779b97f4a7c15ULL;
+    for (int i = 0; i < 1000; ++i) {
+        word ^= word << 13;
+        word ^= word >> 7;
+        word ^= word << 17;
+
+        uint64_t states = 0, raw = 0;
+        for (const auto &pin : pins) {
+            if (pin.first < 0) continue;
+
+            uint8_t bit = rawBit(pin.second);
+            uint64_t state = ((word >> bit) & 1) ^ pin.second.invert;
+            states |= state << pin.first;
+            raw |= (((word >> pin.first) & 1) ^ pin.second.invert) << bit;
+        }
+
+        for (const PinPacker &packer : packers) {
+            if (packer.pack(word) != states ||
+                packer.unpack(word & packer.pinMask()) != raw) {
+                std::cerr << "PinPacker: Mismatch for 0x" << std::hex << word
+                          << std::dec << std::endl;
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// Two handles to the same key share one controller, which is only created
+// and has each pin initialized once, and is closed with the last handle.
+static bool checkControllerRegistry()
+{
+    int created = 0;
+    auto create = [&created]() {
+        ++created;
+        return new TestDioController();
+    };
+
+    PinConfig pin(3, 1, false, false, true, true);
+    auto first = ControllerRegistry::acquire("test@0x2e", "a", create);
+    first->initPin(pin);
+    first->setPinMode(pin, ModeOutput);
+    auto second = ControllerRegistry::acquire("test@0x2e", "a", create);
+    second->initPin(pin);
+    if (created != 1 || first != second ||
+        ControllerRegistry::useCount("test@0x2e") != 2 ||
+        second->getPinMode(pin) != ModeOutput) {
+        std::cerr << "ControllerRegistry: Expected one shared controller"
+                  << std::endl;
+        return false;
+    }
+
+    try {
+        ControllerRegistry::acquire("test@0x2e", "b", create);
+        std::cerr << "ControllerRegistry: Expected a different config to fail"
+                  << std::endl;
+        return false;
+    }
+    catch (const std::system_error &ex) {
+        verifyError(
+            "ControllerRegistry::acquire (different config)",
+            ex.code(),
+            std::errc::device_or_resource_busy
+        );
+    }
+
+    first.reset();
+    second.reset();
+    ControllerRegistry::acquire("test@0x2e", "b", create);
+    if (created != 2 || ControllerRegistry::useCount("test@0x2e") != 0) {
+        std::cerr << "ControllerRegistry: Expected the last handle to close "
+                  << "the controller" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
 int main()
 {
+    if (!checkPinPacker()) return 1;
+    if (!checkControllerRegistry()) return 1;
+
     TestDioController *controller = new TestDioController();
 
-    PinConfig sourcePin(0, 0, false, false, false, true);
-    PinConfig sinkPin(1, 0, false, false, false, true);
-    PinConfig outputPin(2, 0, false, false, false, true);
-    PinConfig inputPin(3, 0, false, false, true, false);
-    PinConfig dualPin(4, 0, false, false, true, true);
+    PinConfig sourcePin(0, 1, false, false, false, true);
+    PinConfig sinkPin(1, 1, false, false, false, true);
+    PinConfig outputPin(2, 1, false, false, false, true);
+    PinConfig inputPin(3, 1, false, false, true, false);
+    PinConfig dualPin(4, 1, false, false, true, true);
 
     pinconfigmap_t pinMap = {
         {-1, sourcePin},
@@ -35,7 +155,12 @@ int main()
     };
 
     dioconfigmap_t dioMap = {{1, pinMap}, {2, {}}};
-    RsDioImpl dio(controller, dioMap);
+    groupconfigmap_t groupMap = {
+        {"bus", {1, {3, 1}}},
+        {"inputs", {1, {2, 3}}},
+        {"missing", {1, {1, 9}}}
+    };
+    RsDioImpl dio(controller, dioMap, groupMap);
 
     dio.setOutputMode(0, rs::OutputMode::Sink);
     verifyError(
@@ -178,5 +303,790 @@ int main()
                   << states[2] << std::endl;
     }
 
+    rs::DioSnapshot snapshot = dio.readAllPacked();
+    verifyError("readAllPacked", dio.getLastError());
+
+    uint64_t expected = 0;
+    for (const auto &state : states) {
+        if (state.second) expected |= 1ULL << state.first;
+    }
+
+    if (snapshot.valid[1] != ((1 << 1) | (1 << 2) | (1 << 3)) ||
+        snapshot.valid[0] != 0 || snapshot.valid[2] != 0 ||
+        snapshot.states[1] != expected) {
+        std::cerr << "readAllPacked: Snapshot doesn't match readAll"
+                  << std::endl;
+        return 1;
+    }
+
+    dio.startSampling(0);
+    verifyError(
+        "startSampling (invalid interval)",
+        dio.getLastError(),
+        std::errc::invalid_argument
+    );
+
+    dio.attachCallback(1, 4, rs::Edge::Rising, [](const rs::DioEvent &) {});
+    verifyError(
+        "attachCallback (invalid pin)",
+        dio.getLastError(),
+        std::errc::invalid_argument
+    );
+
+    std::mutex eventMutex;
+    std::vector<rs::DioEvent> pinEvents;
+    std::vector<rs::DioEvent> connectorEvents;
+    int pinHandle = dio.attachCallback(
+        1,
+        2,
+        rs::Edge::Rising,
+        [&](const rs::DioEvent &event) {
+            // The pin functions take their own register access on the
+            // sampling thread and must leave the sampler's in place.
+            dio.digitalRead(1, 1, true);
+            dio.readAllPacked();
+            std::lock_guard<std::mutex> lock(eventMutex);
+            pinEvents.push_back(event);
+        }
+    );
+    verifyError("attachCallback (valid)", dio.getLastError());
+
+    int connectorHandle = dio.attachConnectorCallback(
+        1,
+        (1 << 2) | (1 << 3),
+        rs::Edge::Both,
+        [&](const rs::DioEvent &event) {
+            std::lock_guard<std::mutex> lock(eventMutex);
+            connectorEvents.push_back(event);
+        }
+    );
+    verifyError("attachConnectorCallback", dio.getLastError());
+
+    dio.startSampling(100);
+    verifyError("startSampling (valid)", dio.getLastError());
+
+    auto eventCount = [&](std::vector<rs::DioEvent> &events) {
+        std::lock_guard<std::mutex> lock(eventMutex);
+        return events.size();
+    };
+
+    // Let the sampler take its baseline before anything changes.
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    controller->setRegisterBits(inputPin.offset, inputPin.bitmask, true);
+    if (!waitFor([&] { return eventCount(pinEvents) == 1; }) ||
+        pinEvents[0].dio != 1 || pinEvents[0].pin != 2 ||
+        !pinEvents[0].state) {
+        std::cerr << "attachCallback: Expected a rising edge on pin 2"
+                  << std::endl;
+        return 1;
+    }
+
+    controller->setRegisterBits(inputPin.offset, inputPin.bitmask, false);
+    if (!waitFor([&] { return eventCount(connectorEvents) == 2; }) ||
+        connectorEvents[1].pin != 2 || connectorEvents[1].state ||
+        connectorEvents[1].timestamp <= connectorEvents[0].timestamp) {
+        std::cerr << "attachConnectorCallback: Expected a falling edge on pin 2"
+                  << std::endl;
+        return 1;
+    }
+
+    dio.detachCallback(pinHandle);
+    verifyError("detachCallback (valid)", dio.getLastError());
+
+    dio.detachCallback(pinHandle);
+    verifyError(
+        "detachCallback (invalid handle)",
+        dio.getLastError(),
+        std::errc::invalid_argument
+    );
+
+    controller->setRegisterBits(dualPin.offset, dualPin.bitmask, true);
+    if (!waitFor([&] { return eventCount(connectorEvents) == 3; }) ||
+        connectorEvents[2].pin != 3 || eventCount(pinEvents) != 1) {
+        std::cerr << "attachConnectorCallback: Expected a rising edge on pin 3"
+                  << std::endl;
+        return 1;
+    }
+
+    if (controller->unpairedReleases() || controller->ungrantedAccesses()) {
+        std::cerr << "Callbacks: The sampler lost its register access"
+                  << std::endl;
+        return 1;
+    }
+
+    dio.stopSampling();
+    verifyError("stopSampling", dio.getLastError());
+    dio.detachCallback(connectorHandle);
+
+    rs::DioRecord buffer[32];
+    dio.startCapture(1, 100, buffer, 0);
+    verifyError(
+        "startCapture (invalid buffer)",
+        dio.getLastError(),
+        std::errc::invalid_argument
+    );
+
+    dio.startCapture(1, 100, buffer, 32);
+    verifyError("startCapture (valid)", dio.getLastError());
+
+    if (!waitFor([&] { return dio.getCaptureStats().overruns > 0; })) {
+        std::cerr << "getCaptureStats: Expected overruns with a full buffer"
+                  << std::endl;
+        return 1;
+    }
+
+    dio.stopCapture();
+    verifyError("stopCapture", dio.getLastError());
+
+    rs::DioCaptureStats captureStats = dio.getCaptureStats();
+    if (captureStats.captured != 32 || captureStats.buffered != 32) {
+        std::cerr << "getCaptureStats: Expected 32 buffered records but got "
+                  << captureStats.buffered << std::endl;
+        return 1;
+    }
+
+    // Pin 1 was written high and pin 3 was raised above, pin 2 is low.
+    rs::DioRecord records[8];
+    size_t count = dio.readCapture(records, 8);
+    if (count != 8 || records[0].states != ((1 << 1) | (1 << 3)) ||
+        records[1].timestamp <= records[0].timestamp) {
+        std::cerr << "readCapture returned invalid records" << std::endl;
+        return 1;
+    }
+
+    if (dio.getCaptureStats().buffered != 24) {
+        std::cerr << "readCapture didn't consume the records" << std::endl;
+        return 1;
+    }
+
+    dio.readCapture(nullptr, 8);
+    verifyError(
+        "readCapture (no buffer)",
+        dio.getLastError(),
+        std::errc::invalid_argument
+    );
+
+    // A capture at a longer interval only records the scans it needs, and
+    // neither stops nor retunes sampling that was started on its own.
+    std::atomic<int> risingEdges(0);
+    int edgeHandle = dio.attachCallback(
+        1, 2, rs::Edge::Rising, [&](const rs::DioEvent &) { ++risingEdges; }
+    );
+    dio.startSampling(200);
+    dio.startCapture(1, 1000, buffer, 32);
+    verifyError("startCapture (while sampling)", dio.getLastError());
+    if (!waitFor([&] { return dio.getCaptureStats().buffered >= 2; })) {
+        std::cerr << "startCapture: Nothing captured while sampling"
+                  << std::endl;
+        return 1;
+    }
+
+    dio.stopCapture();
+    count = dio.readCapture(records, 2);
+    if (count != 2 || records[1].timestamp - records[0].timestamp < 800000) {
+        std::cerr << "startCapture: Expected records 1ms apart" << std::endl;
+        return 1;
+    }
+
+    controller->setRegisterBits(inputPin.offset, inputPin.bitmask, true);
+    if (!waitFor([&] { return risingEdges > 0; })) {
+        std::cerr << "stopCapture: Stopped the sampling callbacks"
+                  << std::endl;
+        return 1;
+    }
+    controller->setRegisterBits(inputPin.offset, inputPin.bitmask, false);
+    dio.stopSampling();
+    dio.detachCallback(edgeHandle);
+
+    dio.startPwm(1, 2, 1000, 0.5f);
+    verifyError(
+        "startPwm (input pin)",
+        dio.getLastError(),
+        std::errc::function_not_supported
+    );
+
+    dio.startPwm(1, 1, 1000, 1.5f);
+    verifyError(
+        "startPwm (invalid duty)",
+        dio.getLastError(),
+        std::errc::invalid_argument
+    );
+
+    dio.startPwm(1, 1, 2000, 0.5f);
+    verifyError("startPwm (valid)", dio.getLastError());
+
+    bool sawHigh = false, sawLow = false;
+    waitFor([&] {
+        if (dio.digitalRead(1, 1))
+            sawHigh = true;
+        else
+            sawLow = true;
+        return sawHigh && sawLow;
+    });
+    if (!sawHigh || !sawLow) {
+        std::cerr << "startPwm: Pin never toggled" << std::endl;
+        return 1;
+    }
+
+    // The PWM edges must not undo writes to the other pins of the register.
+    dio.setPinDirection(1, 3, rs::PinDirection::Output);
+    for (int i = 0; i < 200; ++i) {
+        bool state = (i & 1) != 0;
+        dio.digitalWrite(1, 3, state);
+        if (dio.digitalRead(1, 3, true) != state) {
+            std::cerr << "startPwm: Lost a write to another pin" << std::endl;
+            return 1;
+        }
+    }
+    dio.digitalWrite(1, 3, false);
+
+    dio.stopPwm(1, 1);
+    verifyError("stopPwm", dio.getLastError());
+    if (!waitFor([&] { return !dio.digitalRead(1, 1); })) {
+        std::cerr << "stopPwm: Pin wasn't left low" << std::endl;
+        return 1;
+    }
+
+    dio.pulse(1, 1, 20000);
+    verifyError("pulse", dio.getLastError());
+    if (!waitFor([&] { return dio.digitalRead(1, 1); }) ||
+        !waitFor([&] { return !dio.digitalRead(1, 1); })) {
+        std::cerr << "pulse: Expected the pin to go high then low"
+                  << std::endl;
+        return 1;
+    }
+
+    rs::PwmStats pwmStats = dio.getPwmStats();
+    if (pwmStats.edges < 4 || pwmStats.jitterMaxUs < pwmStats.jitterAvgUs) {
+        std::cerr << "getPwmStats returned invalid statistics" << std::endl;
+        return 1;
+    }
+
+    dio.setDebounce(1, 2, rs::DebounceMode::Consecutive, 0);
+    verifyError(
+        "setDebounce (invalid samples)",
+        dio.getLastError(),
+        std::errc::invalid_argument
+    );
+
+    dio.setDebounce(1, 0, rs::DebounceMode::Consecutive, 4);
+    verifyError(
+        "setDebounce (invalid pin)",
+        dio.getLastError(),
+        std::errc::invalid_argument
+    );
+
+    dio.setDebounce(1, 2, rs::DebounceMode::Consecutive, 15);
+    verifyError("setDebounce (valid)", dio.getLastError());
+
+    dio.startSampling(1000);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    // A glitch much shorter than 15 samples never makes it through.
+    controller->setRegisterBits(inputPin.offset, inputPin.bitmask, true);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    controller->setRegisterBits(inputPin.offset, inputPin.bitmask, false);
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    if (dio.digitalRead(1, 2)) {
+        std::cerr << "setDebounce: Glitch passed through the filter"
+                  << std::endl;
+        return 1;
+    }
+
+    controller->setRegisterBits(inputPin.offset, inputPin.bitmask, true);
+    if (dio.digitalRead(1, 2) ||
+        !waitFor([&] { return dio.digitalRead(1, 2); })) {
+        std::cerr << "setDebounce: Expected the filtered pin to follow a "
+                     "stable input"
+                  << std::endl;
+        return 1;
+    }
+
+    dio.setDebounce(1, 2, rs::DebounceMode::None, 0);
+    verifyError("setDebounce (None)", dio.getLastError());
+    dio.stopSampling();
+
+    dio.readGroup("missing");
+    verifyError(
+        "readGroup (invalid group)",
+        dio.getLastError(),
+        std::errc::invalid_argument
+    );
+
+    dio.writeGroup("inputs", 0);
+    verifyError(
+        "writeGroup (input pins)",
+        dio.getLastError(),
+        std::errc::function_not_supported
+    );
+
+    dio.writeGroup("bus", 4);
+    verifyError(
+        "writeGroup (value too large)",
+        dio.getLastError(),
+        std::errc::invalid_argument
+    );
+
+    dio.writeGroup("bus", 1);
+    verifyError("writeGroup (valid)", dio.getLastError());
+    if (!dio.digitalRead(1, 3) || dio.digitalRead(1, 1)) {
+        std::cerr << "writeGroup: Expected pin 3 high and pin 1 low"
+                  << std::endl;
+        return 1;
+    }
+
+    dio.digitalWrite(1, 1, true);
+    uint64_t groupValue = dio.readGroup("bus");
+    verifyError("readGroup (valid)", dio.getLastError());
+    if (groupValue != 3) {
+        std::cerr << "readGroup: Expected 3 but got " << groupValue
+                  << std::endl;
+        return 1;
+    }
+
+    // The Ex variants report their errors in the result and leave the last
+    // error alone.
+    dio.readGroup("missing");
+    rs::Result<uint64_t> groupResult = dio.readGroupEx("bus");
+    verifyError("readGroupEx", groupResult.error());
+    if (groupResult.value() != 3) {
+        std::cerr << "readGroupEx: Expected 3 but got "
+                  << groupResult.valueOr(0) << std::endl;
+        return 1;
+    }
+
+    verifyError(
+        "readGroup (last error after Ex)",
+        dio.getLastError(),
+        std::errc::invalid_argument
+    );
+
+    verifyError(
+        "writeGroupEx (value too large)",
+        dio.writeGroupEx("bus", 4).error(),
+        std::errc::invalid_argument
+    );
+    verifyError("writeGroupEx", dio.writeGroupEx("bus", 2).error());
+    if (!dio.digitalReadEx(1, 1).valueOr(false) ||
+        dio.digitalReadEx(1, 3).valueOr(true)) {
+        std::cerr << "digitalReadEx: Expected pin 1 high and pin 3 low"
+                  << std::endl;
+        return 1;
+    }
+
+    verifyError("digitalWriteEx", dio.digitalWriteEx(1, 3, true).error());
+    verifyError(
+        "digitalWriteEx (input pin)",
+        dio.digitalWriteEx(1, 2, true).error(),
+        std::errc::function_not_supported
+    );
+
+    rs::Result<bool> pinResult = dio.digitalReadEx(1, 9);
+    verifyError(
+        "digitalReadEx (invalid pin)",
+        pinResult.error(),
+        std::errc::invalid_argument
+    );
+    if (pinResult) {
+        std::cerr << "digitalReadEx succeeded on an invalid pin" << std::endl;
+        return 1;
+    }
+
+    verifyError(
+        "setPinDirectionEx (input pin)",
+        dio.setPinDirectionEx(1, 2, rs::PinDirection::Output).error(),
+        std::errc::function_not_supported
+    );
+    if (dio.getPinDirectionEx(1, 2).valueOr(rs::PinDirection::Output) !=
+        rs::PinDirection::Input) {
+        std::cerr << "getPinDirectionEx: Expected pin 2 to be an input"
+                  << std::endl;
+        return 1;
+    }
+
+    rs::Result<rs::DioSnapshot> snapshotResult = dio.readAllPackedEx();
+    verifyError("readAllPackedEx", snapshotResult.error());
+    if (snapshotResult.value().states[1] != dio.readAllPacked().states[1]) {
+        std::cerr << "readAllPackedEx: Snapshot doesn't match readAllPacked"
+                  << std::endl;
+        return 1;
+    }
+
+    dio.setWriteCombining(true, -1);
+    verifyError(
+        "setWriteCombining (invalid window)",
+        dio.getLastError(),
+        std::errc::invalid_argument
+    );
+
+    dio.setWriteCombining(true, 0);
+    verifyError("setWriteCombining (flush only)", dio.getLastError());
+
+    int writes = controller->registerWrites();
+    dio.digitalWrite(1, 1, false);
+    dio.digitalWrite(1, 3, false);
+    dio.digitalWrite(1, 1, true);
+    if (!dio.digitalRead(1, 3) || controller->registerWrites() != writes) {
+        std::cerr << "setWriteCombining: Writes weren't held back"
+                  << std::endl;
+        return 1;
+    }
+
+    dio.flush();
+    verifyError("flush", dio.getLastError());
+    if (dio.digitalRead(1, 3) || !dio.digitalRead(1, 1) ||
+        controller->registerWrites() != writes + 1) {
+        std::cerr << "flush: Expected one register write with both pins"
+                  << std::endl;
+        return 1;
+    }
+
+    dio.setPinDirection(1, 3, rs::PinDirection::Input);
+    dio.digitalWrite(1, 3, true);
+    verifyError(
+        "digitalWrite (combined, input mode)",
+        dio.getLastError(),
+        std::errc::invalid_argument
+    );
+    dio.setPinDirection(1, 3, rs::PinDirection::Output);
+
+    dio.setWriteCombining(true, 1000);
+    dio.digitalWrite(1, 3, true);
+    if (!waitFor([&] { return dio.digitalRead(1, 3); })) {
+        std::cerr << "setWriteCombining: Window never committed the write"
+                  << std::endl;
+        return 1;
+    }
+
+    dio.digitalWrite(1, 1, false);
+    dio.setWriteCombining(false, 0);
+    if (dio.digitalRead(1, 1)) {
+        std::cerr << "setWriteCombining: Disabling didn't commit the write"
+                  << std::endl;
+        return 1;
+    }
+
+    dio.setReadCacheMaxAge(-1);
+    verifyError(
+        "setReadCacheMaxAge (invalid age)",
+        dio.getLastError(),
+        std::errc::invalid_argument
+    );
+
+    // Long enough that nothing in between can expire it.
+    dio.setReadCacheMaxAge(10000000);
+    verifyError("setReadCacheMaxAge (valid)", dio.getLastError());
+
+    controller->setRegisterBits(inputPin.offset, inputPin.bitmask, false);
+    dio.digitalRead(1, 2);
+    controller->setRegisterBits(inputPin.offset, inputPin.bitmask, true);
+    if (dio.digitalRead(1, 2) || !dio.digitalRead(1, 2, true) ||
+        !dio.digitalRead(1, 3)) {
+        std::cerr << "setReadCacheMaxAge: Expected cached reads of the "
+                     "register"
+                  << std::endl;
+        return 1;
+    }
+
+    rs::ReadCacheStats cacheStats = dio.getReadCacheStats();
+    if (cacheStats.misses != 1 || cacheStats.hits != 2) {
+        std::cerr << "getReadCacheStats: Expected 2 hits and 1 miss but got "
+                  << cacheStats.hits << " and " << cacheStats.misses
+                  << std::endl;
+        return 1;
+    }
+
+    dio.digitalWrite(1, 3, false);
+    if (dio.digitalRead(1, 3) || !dio.digitalRead(1, 2)) {
+        std::cerr << "digitalWrite: Didn't invalidate the read cache"
+                  << std::endl;
+        return 1;
+    }
+
+    dio.setReadCacheMaxAge(0);
+
+    dio.startCounter(1, 1, rs::Edge::Rising);
+    verifyError(
+        "startCounter (output pin)",
+        dio.getLastError(),
+        std::errc::function_not_supported
+    );
+
+    dio.getCounterStats(1, 2);
+    verifyError(
+        "getCounterStats (not counting)",
+        dio.getLastError(),
+        std::errc::invalid_argument
+    );
+
+    controller->setRegisterBits(inputPin.offset, inputPin.bitmask, false);
+    dio.setCounterWindow(100);
+    verifyError("setCounterWindow", dio.getLastError());
+    dio.startCounter(1, 2, rs::Edge::Rising);
+    verifyError("startCounter (valid)", dio.getLastError());
+    dio.startSampling(200);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    // Every level lasts many sample periods so no edge can be missed.
+    for (int i = 0; i < 40; ++i) {
+        controller->setRegisterBits(inputPin.offset, inputPin.bitmask, true);
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        controller->setRegisterBits(inputPin.offset, inputPin.bitmask, false);
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+
+    rs::CounterStats counterStats = dio.getCounterStats(1, 2);
+    verifyError("getCounterStats (valid)", dio.getLastError());
+    if (counterStats.count != 40 || counterStats.frequencyHz <= 0.0f ||
+        counterStats.frequencyHz > 300.0f ||
+        counterStats.maxFrequencyHz <= 0.0f) {
+        std::cerr << "getCounterStats: Expected 40 edges below 300 Hz but "
+                     "got "
+                  << counterStats.count << " at " << counterStats.frequencyHz
+                  << " Hz" << std::endl;
+        return 1;
+    }
+
+    dio.stopCounter(1, 2);
+    verifyError("stopCounter", dio.getLastError());
+    dio.stopSampling();
+
+    dio.addEncoder("conveyor", 1, 2, 1);
+    verifyError(
+        "addEncoder (output pin)",
+        dio.getLastError(),
+        std::errc::function_not_supported
+    );
+
+    dio.getEncoderStats("missing");
+    verifyError(
+        "getEncoderStats (invalid encoder)",
+        dio.getLastError(),
+        std::errc::invalid_argument
+    );
+
+    controller->setRegisterBits(inputPin.offset, inputPin.bitmask, false);
+    controller->setRegisterBits(dualPin.offset, dualPin.bitmask, false);
+    dio.setPinDirection(1, 3, rs::PinDirection::Input);
+    dio.addEncoder("conveyor", 1, 2, 3);
+    verifyError("addEncoder (valid)", dio.getLastError());
+    dio.startSampling(200);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    // Two full cycles forward, then one step back and a jump of two steps.
+    const bool steps[][2] = {
+        {true, false},
+        {true, true},
+        {false, true},
+        {false, false},
+        {true, false},
+        {true, true},
+        {false, true},
+        {false, false},
+        {false, true},
+        {true, false}
+    };
+    for (const auto &step : steps) {
+        // Both pins share a register, so change them with one write.
+        uint8_t data = controller->registerValue(inputPin.offset);
+        data &= ~(inputPin.bitmask | dualPin.bitmask);
+        if (step[0]) data |= inputPin.bitmask;
+        if (step[1]) data |= dualPin.bitmask;
+        controller->setRegister(inputPin.offset, data);
+        std::this_thread::sleep_for(std::chrono::milliseconds(3));
+    }
+
+    rs::EncoderStats encoderStats = dio.getEncoderStats("conveyor");
+    verifyError("getEncoderStats (valid)", dio.getLastError());
+    if (encoderStats.position != 7 || encoderStats.direction != -1 ||
+        encoderStats.errors != 1 || encoderStats.maxCountRate <= 0.0f) {
+        std::cerr << "getEncoderStats: Expected position 7 with 1 error but "
+                     "got "
+                  << encoderStats.position << " with " << encoderStats.errors
+                  << std::endl;
+        return 1;
+    }
+
+    dio.removeEncoder("conveyor");
+    verifyError("removeEncoder", dio.getLastError());
+    dio.stopSampling();
+
+    dio.startPlayback(1, nullptr, 1, nullptr);
+    verifyError(
+        "startPlayback (no steps)",
+        dio.getLastError(),
+        std::errc::invalid_argument
+    );
+
+    const rs::PlaybackStep playbackSteps[] = {
+        {0, 0x0a, 0x0a},
+        {2000, 0x02, 0x00},
+        {2000, 0x0a, 0x02},
+        {2000, 0x04, 0x04}  // Pin 2 is an input and is left alone.
+    };
+    dio.startPlayback(0, playbackSteps, 4, nullptr);
+    verifyError(
+        "startPlayback (invalid dio)",
+        dio.getLastError(),
+        std::errc::invalid_argument
+    );
+
+    dio.startPlaybackFile(1, "/nonexistent/playback.bin", nullptr);
+    verifyError(
+        "startPlaybackFile (missing file)",
+        dio.getLastError(),
+        std::errc::no_such_file_or_directory
+    );
+
+    controller->setRegisterBits(outputPin.offset, outputPin.bitmask, false);
+    controller->setRegisterBits(inputPin.offset, inputPin.bitmask, false);
+    controller->setRegisterBits(dualPin.offset, dualPin.bitmask, false);
+    float lateness[4] = {-1.0f, -1.0f, -1.0f, -1.0f};
+    dio.startPlayback(1, playbackSteps, 4, lateness);
+    verifyError("startPlayback (valid)", dio.getLastError());
+    // A change to another pin of the register while playback runs is kept.
+    controller->setRegisterBits(inputPin.offset, inputPin.bitmask, true);
+    waitFor([&] { return !dio.getPlaybackStats().running; });
+
+    rs::PlaybackStats playbackStats = dio.getPlaybackStats();
+    verifyError("getPlaybackStats", dio.getLastError());
+    uint8_t data = controller->registerValue(outputPin.offset);
+    bool outputHigh = (data & outputPin.bitmask) != 0;
+    bool inputHigh = (data & inputPin.bitmask) != 0;
+    bool dualHigh = (data & dualPin.bitmask) != 0;
+    if (playbackStats.played != 4 || playbackStats.total != 4 ||
+        !outputHigh || !inputHigh || dualHigh) {
+        std::cerr << "Playback: Expected 4 steps ending with pins 1 and 2 "
+                     "high but got "
+                  << playbackStats.played << " steps and register "
+                  << (int)data << std::endl;
+        return 1;
+    }
+
+    for (float stepLateness : lateness) {
+        if (stepLateness < 0.0f) {
+            std::cerr << "Playback: Lateness of a step was never recorded"
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    dio.stopPlayback();
+    verifyError("stopPlayback", dio.getLastError());
+
+    dio.getPinStats(1, 9);
+    verifyError(
+        "getPinStats (invalid pin)",
+        dio.getLastError(),
+        std::errc::invalid_argument
+    );
+
+    controller->setRegisterBits(inputPin.offset, inputPin.bitmask, false);
+    dio.startSampling(200);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    dio.resetPinStats();
+    verifyError("resetPinStats", dio.getLastError());
+
+    // Three short high pulses and long low gaps.
+    for (int i = 0; i < 3; ++i) {
+        controller->setRegisterBits(inputPin.offset, inputPin.bitmask, true);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        controller->setRegisterBits(inputPin.offset, inputPin.bitmask, false);
+        std::this_thread::sleep_for(std::chrono::milliseconds(15));
+    }
+    dio.stopSampling();
+
+    rs::PinStats pinStats = dio.getPinStats(1, 2);
+    verifyError("getPinStats (valid)", dio.getLastError());
+    if (pinStats.transitions != 6 || pinStats.highTimeUs == 0 ||
+        pinStats.lowTimeUs <= pinStats.highTimeUs ||
+        pinStats.dutyCycle <= 0.0f || pinStats.dutyCycle >= 0.5f ||
+        pinStats.lastChange == 0) {
+        std::cerr << "getPinStats: Expected 6 transitions below 50% duty but "
+                     "got "
+                  << pinStats.transitions << " at " << pinStats.dutyCycle
+                  << std::endl;
+        return 1;
+    }
+
+    std::map<int, rs::PinStats> allPinStats = dio.getAllPinStats(1);
+    verifyError("getAllPinStats", dio.getLastError());
+    if (allPinStats.size() != 3 || allPinStats[2].transitions != 6 ||
+        allPinStats[1].transitions != 0) {
+        std::cerr << "getAllPinStats: Expected stats for pins 1 through 3"
+                  << std::endl;
+        return 1;
+    }
+
+    rs::JitterReport jitter = dio.getJitterReport();
+    verifyError("getJitterReport", dio.getLastError());
+    if (jitter.periods == 0 || jitter.targetUs != 200.0f ||
+        jitter.minUs > jitter.avgUs || jitter.avgUs > jitter.maxUs ||
+        jitter.minUs > jitter.p99Us || jitter.p99Us > jitter.maxUs) {
+        std::cerr << "getJitterReport: Expected scans every 200 us but got "
+                  << jitter.periods << " averaging " << jitter.avgUs << " us"
+                  << std::endl;
+        return 1;
+    }
+
+    rs::ThreadConfig threadConfig;
+    threadConfig.policy = rs::SchedPolicy::Fifo;
+    threadConfig.priority = 1000;
+    dio.setThreadConfig(threadConfig);
+    verifyError(
+        "setThreadConfig (invalid priority)",
+        dio.getLastError(),
+        std::errc::invalid_argument
+    );
+
+    dio.setThreadConfig(rs::ThreadConfig());
+    verifyError("setThreadConfig (default)", dio.getLastError());
+
+    // Errors are per thread, and writes to pins that share a register from
+    // different threads don't undo each other.
+    dio.setPinDirection(1, 3, rs::PinDirection::Output);
+    verifyError("setPinDirection (Output)", dio.getLastError());
+
+    // Each thread is the only one writing its pins, so it must always read
+    // back what it wrote.
+    std::error_code threadError;
+    int lostGroupWrites = 0;
+    std::thread groupWriter([&dio, &threadError, &lostGroupWrites]() {
+        for (int i = 0; i < 2000; ++i) {
+            dio.writeGroup("bus", i & 3);
+            if (dio.readGroup("bus") != (uint64_t)(i & 3)) ++lostGroupWrites;
+        }
+        dio.digitalWrite(9, 1, true);
+        threadError = dio.getLastError();
+    });
+
+    int lostModeWrites = 0;
+    for (int i = 0; i < 2000; ++i) {
+        rs::OutputMode mode =
+            i & 1 ? rs::OutputMode::Sink : rs::OutputMode::Source;
+        dio.setOutputMode(1, mode);
+        if (dio.getOutputMode(1) != mode) ++lostModeWrites;
+    }
+    verifyError("setOutputMode (concurrent)", dio.getLastError());
+    groupWriter.join();
+
+    verifyError(
+        "digitalWrite (other thread)", threadError, std::errc::invalid_argument
+    );
+    if (lostGroupWrites || lostModeWrites) {
+        std::cerr << "Concurrent writes: " << lostGroupWrites
+                  << " group and " << lostModeWrites
+                  << " output mode writes were lost" << std::endl;
+        return 1;
+    }
+
+    if (controller->unpairedReleases() || controller->ungrantedAccesses()) {
+        std::cerr << "Register access: " << controller->unpairedReleases()
+                  << " unpaired releases and "
+                  << controller->ungrantedAccesses()
+                  << " accesses without a grant" << std::endl;
+        return 1;
+    }
+
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,346 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "../daemon/iodserver.h"
+#include "../dio/src/rsdioclient.h"
+#include "../poe/src/rspoeclient.h"
+#include "diocontroller.h"
+#include "poecontroller.h"
+#include "utils.h"
+
+// Polls cond until it's true or timeoutMs expires. Used for anything that
+// depends on the daemon's sampling or telemetry thread.
+template <typename Condition>
+static bool waitFor(Condition cond, int timeoutMs = 2000)
+{
+    auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (!cond()) {
+        if (std::chrono::steady_clock::now() > deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    return true;
+}
+
+static int checkDio(
+    RsDioImpl &dio,
+    TestDioController *controller,
+    const PinConfig &inputPin,
+    const std::string &xmlFile
+)
+{
+    rs::RsDio *client = rs::createRsDio();
+    if (!dynamic_cast<RsDioClient *>(client)) {
+        std::cerr << "createRsDio didn't connect to the daemon" << std::endl;
+        return 1;
+    }
+
+    // The same file by another path is fine, any other file isn't.
+    client->setXmlFile(("/tmp/." + xmlFile.substr(4)).c_str());
+    verifyError("setXmlFile", client->getLastError());
+    client->setXmlFile("/tmp/rsiod_test_other.xml");
+    verifyError(
+        "setXmlFile (other file)",
+        client->getLastError(),
+        std::errc::invalid_argument
+    );
+
+    if (client->getPinList().at(1).size() != 3 ||
+        !client->getPinList().at(1).at(3).supportsInput ||
+        !client->getPinList().at(1).at(3).supportsOutput) {
+        std::cerr << "getPinList returned the wrong pins" << std::endl;
+        return 1;
+    }
+
+    if (!client->canSetOutputMode(1)) {
+        std::cerr << "canSetOutputMode returned false" << std::endl;
+        return 1;
+    }
+
+    // Reads come from the shared memory once the first scan is published.
+    controller->setRegisterBits(inputPin.offset, inputPin.bitmask, true);
+    if (!waitFor([&] {
+            return client->digitalRead(1, 2) && !client->getLastError();
+        })) {
+        std::cerr << "digitalRead didn't pick up the input" << std::endl;
+        return 1;
+    }
+
+    rs::DioSnapshot snapshot = client->readAllPacked();
+    verifyError("readAllPacked", client->getLastError());
+    if (snapshot.valid[1] != 0xe || !(snapshot.states[1] & 0x4)) {
+        std::cerr << "readAllPacked returned the wrong snapshot" << std::endl;
+        return 1;
+    }
+
+    client->digitalRead(1, 9);
+    verifyError(
+        "digitalRead (invalid pin)",
+        client->getLastError(),
+        std::errc::invalid_argument
+    );
+    if (client->getLastErrorString().empty()) {
+        std::cerr << "The daemon's error string got lost" << std::endl;
+        return 1;
+    }
+
+    // Writes go through the daemon.
+    client->digitalWrite(1, 1, true);
+    verifyError("digitalWrite", client->getLastError());
+    if (!dio.digitalRead(1, 1, true)) {
+        std::cerr << "digitalWrite didn't reach the daemon" << std::endl;
+        return 1;
+    }
+
+    // The write is published before the response, so a read right after it
+    // doesn't wait for the next scan.
+    if (!client->digitalRead(1, 1)) {
+        std::cerr << "digitalRead missed the write before it" << std::endl;
+        return 1;
+    }
+
+    client->setOutputMode(1, rs::OutputMode::Sink);
+    verifyError("setOutputMode", client->getLastError());
+    if (client->getOutputMode(1) != rs::OutputMode::Sink) {
+        std::cerr << "getOutputMode returned the wrong mode" << std::endl;
+        return 1;
+    }
+
+    client->setPinDirection(1, 3, rs::PinDirection::Output);
+    verifyError("setPinDirection", client->getLastError());
+    if (client->getPinDirection(1, 3) != rs::PinDirection::Output) {
+        std::cerr << "getPinDirection returned the wrong direction"
+                  << std::endl;
+        return 1;
+    }
+
+    client->writeGroup("bus", 0x3);
+    verifyError("writeGroup", client->getLastError());
+    rs::Result<uint64_t> group = client->readGroupEx("bus");
+    verifyError("readGroupEx", group.error());
+    if (group.value() != 0x3) {
+        std::cerr << "readGroupEx returned " << group.value() << " instead of 3"
+                  << std::endl;
+        return 1;
+    }
+
+    client->writeGroup("unknown", 1);
+    verifyError(
+        "writeGroup (unknown group)",
+        client->getLastError(),
+        std::errc::invalid_argument
+    );
+
+    client->startSampling(1000);
+    verifyError(
+        "startSampling",
+        client->getLastError(),
+        std::errc::function_not_supported
+    );
+
+    client->destroy();
+    return 0;
+}
+
+static int checkPoe(TestPoeController *controller, const std::string &xmlFile)
+{
+    rs::RsPoe *client = rs::createRsPoe();
+    if (!dynamic_cast<RsPoeClient *>(client)) {
+        std::cerr << "createRsPoe didn't connect to the daemon" << std::endl;
+        return 1;
+    }
+
+    client->setXmlFile(xmlFile.c_str());
+    verifyError("setXmlFile", client->getLastError());
+    client->setXmlFile(nullptr);
+    verifyError(
+        "setXmlFile (no file)",
+        client->getLastError(),
+        std::errc::invalid_argument
+    );
+
+    if (client->getPortList() != std::vector<int>({1, 2, 3, 4})) {
+        std::cerr << "getPortList returned invalid ports" << std::endl;
+        return 1;
+    }
+
+    client->getPortState(5);
+    verifyError(
+        "getPortState (invalid port)",
+        client->getLastError(),
+        std::errc::invalid_argument
+    );
+
+    // The daemon publishes the new state before it responds.
+    client->setPortState(1, rs::PoeState::Disabled);
+    verifyError("setPortState", client->getLastError());
+    if (client->getPortState(1) != rs::PoeState::Disabled) {
+        std::cerr << "getPortState didn't see the new state" << std::endl;
+        return 1;
+    }
+
+    std::map<int, rs::PoeState> states = {
+        {1, rs::PoeState::Enabled},
+        {5, rs::PoeState::Disabled},
+    };
+    client->setPortStates(states);
+    verifyError(
+        "setPortStates (invalid port)",
+        client->getLastError(),
+        std::errc::invalid_argument
+    );
+
+    controller->setPortVoltage(1, 48.0f);
+    controller->setPortCurrent(1, 0.5f);
+    if (!waitFor([&] { return client->getPortVoltageEx(2).valueOr(0) == 48; })) {
+        std::cerr << "getPortVoltage didn't pick up the sweep" << std::endl;
+        return 1;
+    }
+
+    if (client->getPortPower(2) != 24.0f) {
+        std::cerr << "getPortPower returned " << client->getPortPower(2)
+                  << " instead of 24" << std::endl;
+        return 1;
+    }
+
+    if (client->getBudgetTotal() != 100) {
+        std::cerr << "getBudgetTotal returned the wrong budget" << std::endl;
+        return 1;
+    }
+
+    client->setPortPriority(5, 1);
+    verifyError(
+        "setPortPriority (invalid port)",
+        client->getLastError(),
+        std::errc::invalid_argument
+    );
+
+    client->startTelemetry(10);
+    verifyError(
+        "startTelemetry",
+        client->getLastError(),
+        std::errc::function_not_supported
+    );
+
+    client->destroy();
+    return 0;
+}
+
+int main()
+{
+    std::string name = "rsiod_test_" + std::to_string(getpid());
+    IodServerConfig config;
+    config.socketPath = "/tmp/" + name + ".sock";
+    config.socketMode = 0600;
+    config.shmName = "/" + name;
+    // Slow enough that a read right after a write can't be saved by a scan.
+    config.samplingIntervalUs = 50000;
+    config.telemetryIntervalMs = 5;
+    config.dioFile = "/tmp/" + name + ".xml";
+    config.poeFile = config.dioFile;
+
+    // The daemon only publishes the path, so the file can be empty.
+    FILE *xml = fopen(config.dioFile.c_str(), "w");
+    if (!xml) {
+        std::cerr << "Failed to create " << config.dioFile << std::endl;
+        return 1;
+    }
+    fclose(xml);
+
+    TestDioController *dioController = new TestDioController();
+    PinConfig inputPin(3, 1, false, false, true, false);
+    pinconfigmap_t pinMap = {
+        {-1, PinConfig(0, 1, false, false, false, true)},
+        {-2, PinConfig(1, 1, false, false, false, true)},
+        {1, PinConfig(2, 1, false, false, false, true)},
+        {2, inputPin},
+        {3, PinConfig(4, 1, false, false, true, true)}
+    };
+    dioconfigmap_t dioMap = {{1, pinMap}};
+    groupconfigmap_t groupMap = {{"bus", {1, {3, 1}}}};
+    RsDioImpl dio(dioController, dioMap, groupMap);
+
+    TestPoeController *poeController =
+        new TestPoeController(100, {0, 1, 2, 3});
+    portmap_t portMap = {{1, 0}, {2, 1}, {3, 2}, {4, 3}};
+    RsPoeImpl poe(poeController, portMap);
+
+    if (RsDioClient::connect(config.socketPath)) {
+        std::cerr << "RsDioClient connected without a daemon" << std::endl;
+        return 1;
+    }
+
+    IodServerConfig badGroup = config;
+    badGroup.socketGroup = "rsiod_test_no_such_group";
+    try {
+        IodServer server(&dio, &poe, badGroup);
+        std::cerr << "The daemon started with an unknown group" << std::endl;
+        return 1;
+    }
+    catch (const std::system_error &error) {
+        verifyError(
+            "IodServer (unknown group)",
+            error.code(),
+            std::errc::invalid_argument
+        );
+    }
+
+    RsDioClient *orphan = nullptr;
+    {
+        IodServer server(&dio, &poe, config);
+        std::thread thread([&] { server.run(); });
+
+        struct stat info;
+        if (stat(config.socketPath.c_str(), &info) != 0 ||
+            (info.st_mode & 0777) != 0600) {
+            std::cerr << "The socket didn't get its mode" << std::endl;
+            return 1;
+        }
+
+        // The daemon is only used by processes that ask for it.
+        unsetenv("RSIOD_SOCKET");
+        rs::RsDio *local = rs::createRsDio();
+        if (dynamic_cast<RsDioClient *>(local)) {
+            std::cerr << "createRsDio connected without RSIOD_SOCKET"
+                      << std::endl;
+            return 1;
+        }
+        local->destroy();
+        setenv("RSIOD_SOCKET", config.socketPath.c_str(), 1);
+
+        orphan = RsDioClient::connect(config.socketPath);
+        int result = orphan ? 0 : 1;
+        if (!result)
+            result = checkDio(dio, dioController, inputPin, config.dioFile);
+        if (!result) result = checkPoe(poeController, config.poeFile);
+
+        server.stop();
+        thread.join();
+        if (result) return result;
+    }
+
+    // Clients fail cleanly once the daemon is gone.
+    orphan->digitalWrite(1, 1, false);
+    if (!orphan->getLastError()) {
+        std::cerr << "digitalWrite succeeded without a daemon" << std::endl;
+        return 1;
+    }
+    orphan->destroy();
+
+    if (access(config.socketPath.c_str(), F_OK) == 0) {
+        std::cerr << "The daemon didn't remove its socket" << std::endl;
+        return 1;
+    }
+
+    remove(config.dioFile.c_str());
+
+    return 0;
+}
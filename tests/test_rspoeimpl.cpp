@@ -1,9 +1,27 @@
+#include <chrono>
+#include <cstdio>
 #include <iostream>
+#include <thread>
 
 #include "../poe/src/rspoeimpl.h"
 #include "poecontroller.h"
 #include "utils.h"
 
+// Polls cond until it's true or timeoutMs expires. Used for anything that
+// depends on the telemetry thread.
+template <typename Condition>
+static bool waitFor(Condition cond, int timeoutMs = 2000)
+{
+    auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (!cond()) {
+        if (std::chrono::steady_clock::now() > deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    return true;
+}
+
 int main()
 {
     const std::vector<int> external_ports = {1, 2, 3, 4};
@@ -66,5 +84,377 @@ int main()
                   << std::endl;
     }
 
+    std::map<int, rs::PoeState> states = {
+        {1, rs::PoeState::Enabled},
+        {2, rs::PoeState::Disabled},
+        {5, rs::PoeState::Disabled},
+    };
+    poe.setPortStates(states);
+    verifyError(
+        "setPortStates (invalid port)",
+        poe.getLastError(),
+        std::errc::invalid_argument
+    );
+
+    state = poe.getPortState(2);
+    if (state != rs::PoeState::Auto) {
+        std::cerr << "setPortStates changed port 2 even though port 5 was "
+                     "invalid"
+                  << std::endl;
+        return 1;
+    }
+
+    states.erase(5);
+    poe.setPortStates(states);
+    verifyError("setPortStates (valid)", poe.getLastError());
+
+    if (poe.getPortState(1) != rs::PoeState::Enabled ||
+        poe.getPortState(2) != rs::PoeState::Disabled) {
+        std::cerr << "getPortState returned the wrong state after calling "
+                     "setPortStates"
+                  << std::endl;
+        return 1;
+    }
+
+    poe.resync();
+    verifyError("resync", poe.getLastError());
+
+    rs::PoeSample buffer[16];
+    poe.startCapture(5, 1000, buffer, 16);
+    verifyError(
+        "startCapture (invalid port)",
+        poe.getLastError(),
+        std::errc::invalid_argument
+    );
+
+    controller->setPortVoltage(internal_ports[0], 48.0f);
+    controller->setPortCurrent(internal_ports[0], 0.5f);
+
+    // The Ex variants report their errors in the result and leave the last
+    // error alone.
+    poe.getPortState(5);
+    rs::Result<float> voltage = poe.getPortVoltageEx(1);
+    verifyError("getPortVoltageEx", voltage.error());
+    if (voltage.value() != 48.0f || voltage.valueOr(0) != 48.0f) {
+        std::cerr << "getPortVoltageEx returned " << voltage.valueOr(0)
+                  << " instead of 48" << std::endl;
+        return 1;
+    }
+
+    verifyError(
+        "getPortVoltage (last error after Ex)",
+        poe.getLastError(),
+        std::errc::invalid_argument
+    );
+
+    rs::Result<float> current = poe.getPortCurrentEx(5);
+    verifyError(
+        "getPortCurrentEx (invalid port)",
+        current.error(),
+        std::errc::invalid_argument
+    );
+    if (current || current.valueOr(-1) != -1) {
+        std::cerr << "getPortCurrentEx succeeded on an invalid port"
+                  << std::endl;
+        return 1;
+    }
+
+    verifyError(
+        "setPortStateEx (invalid state)",
+        poe.setPortStateEx(1, rs::PoeState::Error).error(),
+        std::errc::invalid_argument
+    );
+    verifyError(
+        "setPortStateEx", poe.setPortStateEx(2, rs::PoeState::Enabled).error()
+    );
+    if (poe.getPortStateEx(2).valueOr(rs::PoeState::Error) !=
+        rs::PoeState::Enabled) {
+        std::cerr << "getPortStateEx didn't return the state set by "
+                     "setPortStateEx"
+                  << std::endl;
+        return 1;
+    }
+
+    poe.startCapture(1, 1000, buffer, 16);
+    verifyError("startCapture (valid)", poe.getLastError());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    poe.stopCapture();
+    verifyError("stopCapture", poe.getLastError());
+
+    rs::PoeCaptureStats stats = poe.getCaptureStats();
+    if (stats.captured != 16 || stats.dropped == 0 || stats.buffered != 16) {
+        std::cerr << "getCaptureStats: Expected a full buffer with dropped "
+                     "samples but got "
+                  << stats.captured << " captured, " << stats.dropped
+                  << " dropped" << std::endl;
+        return 1;
+    }
+
+    rs::PoeSample samples[4];
+    size_t count = poe.readCapture(samples, 4);
+    if (count != 4 || samples[0].voltage != 48.0f ||
+        samples[0].current != 0.5f ||
+        samples[1].timestamp <= samples[0].timestamp) {
+        std::cerr << "readCapture returned invalid samples" << std::endl;
+        return 1;
+    }
+
+    // Port 2 maps to a channel the controller doesn't have, so every
+    // reading fails. An unpaced capture backs off instead of spinning.
+    RsPoeImpl failing(
+        new TestPoeController(100, {internal_ports[0]}),
+        {{1, internal_ports[0]}, {2, internal_ports[1]}}
+    );
+    rs::PoeSample failed[4];
+    failing.startCapture(2, 0, failed, 4);
+    verifyError("startCapture (failing port)", failing.getLastError());
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    failing.stopCapture();
+    rs::PoeCaptureStats failedStats = failing.getCaptureStats();
+    if (failedStats.errors == 0 || failedStats.errors > 20 ||
+        failedStats.captured != 0) {
+        std::cerr << "getCaptureStats: Expected a few errors but got "
+                  << failedStats.errors << " errors, " << failedStats.captured
+                  << " captured" << std::endl;
+        return 1;
+    }
+
+    poe.exportCapture("capture_test.csv", rs::CaptureFormat::Csv);
+    verifyError("exportCapture", poe.getLastError());
+    std::remove("capture_test.csv");
+
+    if (poe.getCaptureStats().buffered != 0) {
+        std::cerr << "exportCapture didn't drain the capture buffer"
+                  << std::endl;
+        return 1;
+    }
+
+    poe.getPortEnergy(5);
+    verifyError(
+        "getPortEnergy (invalid port)",
+        poe.getLastError(),
+        std::errc::invalid_argument
+    );
+
+    poe.startTelemetry(0);
+    verifyError(
+        "startTelemetry (invalid interval)",
+        poe.getLastError(),
+        std::errc::invalid_argument
+    );
+
+    poe.startTelemetry(5);
+    verifyError("startTelemetry (valid)", poe.getLastError());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    poe.stopTelemetry();
+    verifyError("stopTelemetry", poe.getLastError());
+
+    rs::JitterReport jitter = poe.getJitterReport();
+    verifyError("getJitterReport", poe.getLastError());
+    if (jitter.periods == 0 || jitter.targetUs != 5000.0f ||
+        jitter.minUs > jitter.p99Us || jitter.p99Us > jitter.maxUs) {
+        std::cerr << "getJitterReport: Expected sweeps every 5000 us but got "
+                  << jitter.periods << " averaging " << jitter.avgUs << " us"
+                  << std::endl;
+        return 1;
+    }
+
+    // 24W for roughly 100ms is a bit under a milliwatt-hour.
+    double energy = poe.getPortEnergy(1);
+    verifyError("getPortEnergy", poe.getLastError());
+    if (energy <= 0.0 || energy > 0.002 || poe.getPortEnergy(2) != 0.0) {
+        std::cerr << "getPortEnergy returned " << energy
+                  << " Wh, expected roughly 0.0007 Wh" << std::endl;
+        return 1;
+    }
+
+    poe.resetPortEnergy(1);
+    verifyError("resetPortEnergy", poe.getLastError());
+    if (poe.getPortEnergy(1) != 0.0) {
+        std::cerr << "resetPortEnergy didn't clear the counter" << std::endl;
+        return 1;
+    }
+
+    // Counters are checkpointed on destruction and restored by the next
+    // instance that uses the same file.
+    TestPoeController *meterController =
+        new TestPoeController(100, internal_ports);
+    RsPoeImpl *meter = new RsPoeImpl(meterController, portMap);
+    meterController->setPortVoltage(internal_ports[1], 50.0f);
+    meterController->setPortCurrent(internal_ports[1], 1.0f);
+    meter->setEnergyCheckpoint("energy_test.txt", 60);
+    verifyError("setEnergyCheckpoint", meter->getLastError());
+    meter->startTelemetry(5);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    meter->stopTelemetry();
+    energy = meter->getPortEnergy(2);
+    delete meter;
+
+    meter = new RsPoeImpl(new TestPoeController(100, internal_ports), portMap);
+    meter->setEnergyCheckpoint("energy_test.txt", 60);
+    verifyError("setEnergyCheckpoint (restore)", meter->getLastError());
+    if (energy <= 0.0 || meter->getPortEnergy(2) != energy) {
+        std::cerr << "setEnergyCheckpoint didn't restore the saved counters"
+                  << std::endl;
+        return 1;
+    }
+    delete meter;
+
+    // Energy integrated before the checkpoint is set is kept, and setting
+    // the same file again doesn't add it twice.
+    meterController = new TestPoeController(100, internal_ports);
+    meter = new RsPoeImpl(meterController, portMap);
+    meterController->setPortVoltage(internal_ports[1], 50.0f);
+    meterController->setPortCurrent(internal_ports[1], 1.0f);
+    meter->startTelemetry(5);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    meter->stopTelemetry();
+    double running = meter->getPortEnergy(2);
+    meter->setEnergyCheckpoint("energy_test.txt", 60);
+    verifyError("setEnergyCheckpoint (running)", meter->getLastError());
+    meter->setEnergyCheckpoint("energy_test.txt", 60);
+    double restored = meter->getPortEnergy(2);
+    if (running <= 0.0 || restored < running + energy * 0.999 ||
+        restored > running + energy * 1.001) {
+        std::cerr << "setEnergyCheckpoint turned " << running << " + "
+                  << energy << " Wh into " << restored << " Wh" << std::endl;
+        return 1;
+    }
+    delete meter;
+    std::remove("energy_test.txt");
+
+    // Loading another XML file saves the counters before dropping them.
+    meterController = new TestPoeController(100, internal_ports);
+    meter = new RsPoeImpl(meterController, portMap);
+    meterController->setPortVoltage(internal_ports[1], 50.0f);
+    meterController->setPortCurrent(internal_ports[1], 1.0f);
+    meter->setEnergyCheckpoint("energy_test.txt", 60);
+    meter->startTelemetry(5);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    meter->stopTelemetry();
+    energy = meter->getPortEnergy(2);
+    meter->setXmlFile("missing.xml");
+    delete meter;
+
+    meter = new RsPoeImpl(new TestPoeController(100, internal_ports), portMap);
+    meter->setEnergyCheckpoint("energy_test.txt", 60);
+    if (energy <= 0.0 || meter->getPortEnergy(2) != energy) {
+        std::cerr << "setXmlFile dropped the energy counted since the last "
+                     "checkpoint"
+                  << std::endl;
+        return 1;
+    }
+    delete meter;
+    std::remove("energy_test.txt");
+
+    TestPoeController *budgetController =
+        new TestPoeController(100, internal_ports);
+    RsPoeImpl budget(budgetController, portMap);
+    for (int i = 0; i < 3; ++i)
+        budgetController->setPortVoltage(internal_ports[i], 48.0f);
+    budgetController->setPortCurrent(internal_ports[0], 0.5f);   // 24W
+    budgetController->setPortCurrent(internal_ports[1], 0.5f);   // 24W
+    budgetController->setPortCurrent(internal_ports[2], 0.25f);  // 12W
+
+    budget.setPortPriority(5, 1);
+    verifyError(
+        "setPortPriority (invalid port)",
+        budget.getLastError(),
+        std::errc::invalid_argument
+    );
+
+    budget.setBudgetLimit(-1);
+    verifyError(
+        "setBudgetLimit (invalid budget)",
+        budget.getLastError(),
+        std::errc::invalid_argument
+    );
+
+    // Port 4 has the lowest priority but draws nothing, so 60W against a
+    // 40W budget has to be fixed by shedding port 2.
+    budget.setPortPriority(1, 1);
+    budget.setPortPriority(2, 0);
+    budget.setPortPriority(3, 2);
+    budget.setPortPriority(4, -1);
+    budget.setBudgetLimit(40);
+    verifyError("setBudgetLimit", budget.getLastError());
+    budget.startTelemetry(2);
+
+    if (!waitFor([&] { return !budget.getShedPorts().empty(); }) ||
+        budget.getShedPorts() != std::vector<int>{2} ||
+        budget.getPortState(2) != rs::PoeState::Disabled) {
+        std::cerr << "Budget manager didn't shed the lowest priority port"
+                  << std::endl;
+        return 1;
+    }
+
+    budget.setPortPowerLimit(3, 10);
+    verifyError("setPortPowerLimit", budget.getLastError());
+    if (!waitFor([&] { return budget.getShedPorts().size() == 2; }) ||
+        budget.getPortState(3) != rs::PoeState::Disabled) {
+        std::cerr << "Budget manager didn't shed the port over its power limit"
+                  << std::endl;
+        return 1;
+    }
+
+    // The port would go over its limit again as soon as it's turned back on.
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    if (budget.getShedPorts().size() != 2 ||
+        budget.getPortState(3) != rs::PoeState::Disabled) {
+        std::cerr << "Budget manager restored a port over its power limit"
+                  << std::endl;
+        return 1;
+    }
+
+    // Taking control of a shed port keeps it from being restored.
+    budget.setPortState(3, rs::PoeState::Disabled);
+    budget.setPortPowerLimit(3, 0);
+    budget.setBudgetLimit(0);
+    if (!waitFor([&] { return budget.getShedPorts().empty(); }) ||
+        budget.getPortState(2) != rs::PoeState::Auto) {
+        std::cerr << "Budget manager didn't restore the shed port"
+                  << std::endl;
+        return 1;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    budget.stopTelemetry();
+    if (budget.getPortState(3) != rs::PoeState::Disabled) {
+        std::cerr << "Budget manager restored a port the user disabled"
+                  << std::endl;
+        return 1;
+    }
+
+    // Telemetry alone never sheds anything, even near the controller's
+    // total.
+    TestPoeController *defaultController =
+        new TestPoeController(62, internal_ports);
+    RsPoeImpl defaultBudget(defaultController, portMap);
+    for (int i = 0; i < 3; ++i)
+        defaultController->setPortVoltage(internal_ports[i], 48.0f);
+    defaultController->setPortCurrent(internal_ports[0], 0.5f);   // 24W
+    defaultController->setPortCurrent(internal_ports[1], 0.5f);   // 24W
+    defaultController->setPortCurrent(internal_ports[2], 0.25f);  // 12W
+    defaultBudget.startTelemetry(2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    if (!defaultBudget.getShedPorts().empty()) {
+        std::cerr << "Budget manager shed a port without a budget"
+                  << std::endl;
+        return 1;
+    }
+
+    // Once priorities are set the budget is the controller's total, and
+    // ports are shed before the total reaches it.
+    defaultBudget.setPortPriority(1, 1);
+    if (!waitFor([&] { return !defaultBudget.getShedPorts().empty(); }) ||
+        defaultBudget.getShedPorts() != std::vector<int>{3}) {
+        std::cerr << "Budget manager didn't shed near the controller's budget"
+                  << std::endl;
+        return 1;
+    }
+    defaultBudget.stopTelemetry();
+
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,174 @@
+#include <stdlib.h>
+
+#include <atomic>
+#include <iostream>
+#include <new>
+#include <thread>
+#include <utility>
+
+#include "../dio/src/rsdioimpl.h"
+#include "diocontroller.h"
+#include "utils.h"
+
+// Every allocation made while counting is on is counted, so any allocation
+// inside the real-time functions fails the test.
+static std::atomic<bool> counting(false);
+static std::atomic<int> allocations(0);
+
+void *operator new(size_t size)
+{
+    if (counting) ++allocations;
+    void *p = malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+// The real-time functions can't throw.
+static_assert(
+    noexcept(std::declval<rs::RsDio &>().rtReadPin(0, std::declval<bool &>())),
+    "rtReadPin must be noexcept"
+);
+static_assert(
+    noexcept(std::declval<rs::RsDio &>().rtWritePin(0, true)),
+    "rtWritePin must be noexcept"
+);
+static_assert(
+    noexcept(std::declval<rs::RsDio &>().rtReadPacked(
+        0, std::declval<uint64_t &>()
+    )),
+    "rtReadPacked must be noexcept"
+);
+static_assert(
+    noexcept(std::declval<rs::RsDio &>().rtWritePacked(0, 0, 0)),
+    "rtWritePacked must be noexcept"
+);
+
+int main()
+{
+    TestDioController *controller = new TestDioController();
+
+    PinConfig outputPin(2, 1, false, false, false, true);
+    PinConfig inputPin(3, 1, false, false, true, false);
+    PinConfig invertedPin(4, 1, true, false, false, true);
+
+    pinconfigmap_t pinMap = {{1, outputPin}, {2, inputPin}, {3, invertedPin}};
+    dioconfigmap_t dioMap = {{1, pinMap}};
+    RsDioImpl dio(controller, dioMap);
+
+    int output = dio.getPinHandle(1, 1);
+    verifyError("getPinHandle (output)", dio.getLastError());
+    int input = dio.getPinHandle(1, 2);
+    verifyError("getPinHandle (input)", dio.getLastError());
+    int inverted = dio.getPinHandle(1, 3);
+    verifyError("getPinHandle (inverted)", dio.getLastError());
+
+    dio.getPinHandle(1, 9);
+    verifyError(
+        "getPinHandle (invalid pin)",
+        dio.getLastError(),
+        std::errc::invalid_argument
+    );
+
+    if (dio.getPinHandle(1, 1) != output) {
+        std::cerr << "getPinHandle: Expected the same handle for the same pin"
+                  << std::endl;
+        return 1;
+    }
+
+    verifyError("rtAttachThread", dio.rtAttachThread(false));
+
+    bool state;
+    uint64_t packed = 0;
+    verifyError(
+        "rtReadPin (invalid handle)",
+        dio.rtReadPin(42, state),
+        std::errc::invalid_argument
+    );
+    verifyError(
+        "rtWritePin (input pin)",
+        dio.rtWritePin(input, true),
+        std::errc::function_not_supported
+    );
+    verifyError(
+        "rtWritePacked (input pin)",
+        dio.rtWritePacked(1, 0x04, 0x04),
+        std::errc::function_not_supported
+    );
+    verifyError(
+        "rtReadPacked (invalid dio)",
+        dio.rtReadPacked(2, packed),
+        std::errc::invalid_argument
+    );
+
+    counting = true;
+    bool outputState = false;
+    bool inputState = true;
+    bool invertedState = false;
+    bool failed = false;
+    for (int i = 0; i < 1000; ++i) {
+        bool high = (i & 1) != 0;
+        failed |= (bool)dio.rtWritePin(output, high);
+        failed |= (bool)dio.rtReadPin(output, outputState);
+        failed |= (bool)dio.rtReadPin(input, inputState);
+        failed |= (bool)dio.rtWritePin(inverted, !high);
+        failed |= (bool)dio.rtReadPin(inverted, invertedState);
+        failed |= invertedState == high;
+        // The register bit of the inverted pin is the opposite of its state.
+        failed |= ((controller->registerValue(invertedPin.offset) &
+                    invertedPin.bitmask) != 0) != high;
+        failed |= (bool)dio.rtWritePacked(1, 0x0a, high ? 0x08 : 0x02);
+        failed |= (bool)dio.rtReadPacked(1, packed);
+        failed |= !dio.rtReadPin(-1, inputState);
+    }
+    counting = false;
+
+    // The sampler can stop and start while the rt functions read the
+    // debounced state, and the other pin functions can run on the attached
+    // thread without taking its register access away.
+    dio.setDebounce(1, 2, rs::DebounceMode::Consecutive, 2);
+    std::thread restarter([&dio] {
+        for (int i = 0; i < 50; ++i) {
+            dio.startSampling(100);
+            dio.stopSampling();
+        }
+    });
+    for (int i = 0; i < 2000; ++i) {
+        failed |= (bool)dio.rtReadPin(input, inputState);
+        failed |= (bool)dio.rtReadPacked(1, packed);
+        dio.digitalRead(1, 2);
+        dio.readAllPacked();
+        failed |= (bool)dio.rtWritePin(output, false);
+    }
+    restarter.join();
+
+    dio.rtDetachThread();
+
+    if (controller->unpairedReleases() || controller->ungrantedAccesses()) {
+        std::cerr << "Real-time functions: Register access without a grant"
+                  << std::endl;
+        return 1;
+    }
+
+    if (allocations != 0) {
+        std::cerr << "Real-time functions made " << allocations
+                  << " allocations" << std::endl;
+        return 1;
+    }
+
+    // The last round wrote pin 3 high and pin 1 low, with pin 3 inverted.
+    uint8_t data = controller->registerValue(outputPin.offset);
+    if (failed || !outputState || inputState || packed != 0x08 ||
+        (data & outputPin.bitmask) || (data & invertedPin.bitmask)) {
+        std::cerr << "Real-time functions: Unexpected pin states, register "
+                  << (int)data << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
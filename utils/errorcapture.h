@@ -0,0 +1,42 @@
+#ifndef ERRORCAPTURE_H
+#define ERRORCAPTURE_H
+
+#include <exception>
+#include <string>
+#include <system_error>
+
+#include "../error/include/rserrors.h"
+
+// Helpers for functions that return their error instead of storing it, so the
+// same code can back both the last error and the ...Ex variants. what is
+// only filled in for callers that keep an error string and may be null.
+
+inline std::error_code
+failWith(std::error_code error, const char *message, std::string *what)
+{
+    if (what) *what = message;
+    return error;
+}
+
+// Maps the exception being handled to an error code. Only call this from a
+// catch block.
+inline std::error_code currentError(std::string *what)
+{
+    try {
+        throw;
+    }
+    catch (const std::system_error &ex) {
+        if (what) *what = ex.what();
+        return ex.code();
+    }
+    catch (const std::exception &ex) {
+        if (what) *what = ex.what();
+        return RsErrorCode::UnknownError;
+    }
+    catch (...) {
+        if (what) *what = "Unknown exception occurred";
+        return RsErrorCode::UnknownError;
+    }
+}
+
+#endif  // ERRORCAPTURE_H
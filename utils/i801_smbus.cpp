@@ -4,6 +4,8 @@
 
 #include <chrono>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <system_error>
 #include <thread>
 
@@ -28,7 +30,6 @@ typedef transaction_clock_t::time_point time_point_t;
 
 static const nanoseconds_t sleep_time{10};
 static const milliseconds_t max_time{100};
-static time_point_t transaction_start;
 
 // SMBus Registers and bits as described in the Intel chipset datasheet. (Page
 // 746 Table 18-2)
@@ -93,17 +94,32 @@ struct transaction_data {
     uint8_t *block;
     uint8_t size;
     char read_write;
+    time_point_t start;
 };
 
-static milliseconds_t timeElapsed()
+static milliseconds_t timeElapsed(transaction_data *data)
 {
     const time_point_t now = transaction_clock_t::now();
-    return std::chrono::duration_cast<milliseconds_t>(now - transaction_start);
+    return std::chrono::duration_cast<milliseconds_t>(now - data->start);
 }
 
-static milliseconds_t timeLeft()
+static milliseconds_t timeLeft(transaction_data *data)
 {
-    return std::chrono::duration_cast<milliseconds_t>(max_time - timeElapsed());
+    return std::chrono::duration_cast<milliseconds_t>(
+        max_time - timeElapsed(data)
+    );
+}
+
+// A transaction is a sequence of register accesses on the host controller so
+// two threads must never interleave transactions on the same bus. Separate
+// buses can still be used in parallel.
+static std::mutex &busMutex(uint16_t bus)
+{
+    static std::mutex registryMutex;
+    static std::map<uint16_t, std::mutex> mutexes;
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    return mutexes[bus];
 }
 
 static bool isBlockTransaction(transaction_data *data)
@@ -163,7 +179,7 @@ static int waitForIntr(transaction_data *data)
         status &= kStsErrorFlags | kStsIntr;
         if (!busy && status) return status & kStsErrorFlags;
 
-    } while (timeLeft().count() > 0);
+    } while (timeLeft(data).count() > 0);
 
     return -ETIMEDOUT;
 }
@@ -177,7 +193,7 @@ static int waitForByteDone(transaction_data *data)
         status = inb(HST_STS(data->bus));
         if (status & (kStsErrorFlags | kStsDone))
             return status & kStsErrorFlags;
-    } while (timeLeft().count() > 0);
+    } while (timeLeft(data).count() > 0);
 
     return -ETIMEDOUT;
 }
@@ -193,7 +209,7 @@ static void startTransaction(transaction_data *data)
         ctrl |= kCntrlLastByte;
     }
 
-    transaction_start = transaction_clock_t::now();
+    data->start = transaction_clock_t::now();
     outb(ctrl, HST_CTRL(data->bus));
 }
 
@@ -247,6 +263,8 @@ static void handleResult(transaction_data *data, int status)
 
 static void smbus_transaction(transaction_data *data)
 {
+    std::lock_guard<std::mutex> lock(busMutex(data->bus));
+
     initBus(data);
     setHostAddress(data);
 
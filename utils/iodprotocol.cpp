@@ -0,0 +1,212 @@
+#include "iodprotocol.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../error/include/rserrors.h"
+#include "errorcapture.h"
+
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+void iodEncodeError(
+    std::error_code error,
+    const std::string &message,
+    IodResponse &response
+)
+{
+    IodErrorCategory category = IodErrorCategory::Rs;
+    if (!error)
+        category = IodErrorCategory::None;
+    else if (error.category() == std::generic_category())
+        category = IodErrorCategory::Generic;
+    else if (error.category() == std::system_category())
+        category = IodErrorCategory::System;
+    else if (error.category() != errorCodeCategory())
+        error = RsErrorCode::UnknownError;
+
+    response.error = error.value();
+    response.category = static_cast<uint32_t>(category);
+    iodCopyString(response.message, sizeof(response.message), message);
+}
+
+std::error_code iodDecodeError(const IodResponse &response)
+{
+    switch (static_cast<IodErrorCategory>(response.category)) {
+        case IodErrorCategory::None:
+            return std::error_code();
+        case IodErrorCategory::Generic:
+            return std::error_code(response.error, std::generic_category());
+        case IodErrorCategory::System:
+            return std::error_code(response.error, std::system_category());
+        case IodErrorCategory::Rs:
+            return std::error_code(response.error, errorCodeCategory());
+    }
+
+    return RsErrorCode::UnknownError;
+}
+
+void iodCopyString(char *field, size_t size, const std::string &str)
+{
+    size_t length = str.size() < size - 1 ? str.size() : size - 1;
+    memcpy(field, str.data(), length);
+    field[length] = '\0';
+}
+
+std::string iodSocketPath()
+{
+    const char *path = getenv("RSIOD_SOCKET");
+    return path ? path : "/run/rsiod.sock";
+}
+
+std::string iodClientSocketPath()
+{
+    const char *path = getenv("RSIOD_SOCKET");
+    return path ? path : "";
+}
+
+std::error_code
+iodCheckXmlFile(const char *fileName, const char *served, std::string *what)
+{
+    if (!fileName) {
+        return failWith(
+            std::make_error_code(std::errc::invalid_argument),
+            "No configuration file given",
+            what
+        );
+    }
+
+    if (iodCanonicalPath(fileName) != served) {
+        return failWith(
+            std::make_error_code(std::errc::invalid_argument),
+            "rsiod serves a different configuration file",
+            what
+        );
+    }
+
+    return std::error_code();
+}
+
+#ifdef __linux__
+std::string iodCanonicalPath(const char *fileName)
+{
+    char *path = realpath(fileName, nullptr);
+    if (!path) return fileName;
+
+    std::string canonical = path;
+    free(path);
+    return canonical;
+}
+
+IodConnection *IodConnection::open(const std::string &socketPath)
+{
+    sockaddr_un address = {};
+    if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path))
+        return nullptr;
+
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, socketPath.data(), socketPath.size());
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0) return nullptr;
+
+    if (connect(fd, (const sockaddr *)&address, sizeof(address)) != 0) {
+        close(fd);
+        return nullptr;
+    }
+
+    // Nothing is mapped yet, so this can't use call.
+    IodRequest request = {};
+    IodResponse response = {};
+    request.command = static_cast<uint32_t>(IodCommand::Hello);
+    if (send(fd, &request, sizeof(request), MSG_NOSIGNAL) !=
+            (ssize_t)sizeof(request) ||
+        recv(fd, &response, sizeof(response), 0) !=
+            (ssize_t)sizeof(response) ||
+        response.value != kIodVersion) {
+        close(fd);
+        return nullptr;
+    }
+
+    response.message[sizeof(response.message) - 1] = '\0';
+    int shm = shm_open(response.message, O_RDONLY | O_CLOEXEC, 0);
+    if (shm < 0) {
+        close(fd);
+        return nullptr;
+    }
+
+    void *state =
+        mmap(nullptr, sizeof(IodSharedState), PROT_READ, MAP_SHARED, shm, 0);
+    close(shm);
+    if (state == MAP_FAILED) {
+        close(fd);
+        return nullptr;
+    }
+
+    const IodSharedState *shared = (const IodSharedState *)state;
+    if (shared->magic != kIodMagic || shared->version != kIodVersion) {
+        munmap(state, sizeof(IodSharedState));
+        close(fd);
+        return nullptr;
+    }
+
+    return new IodConnection(fd, shared);
+}
+
+IodConnection::IodConnection(int socket, const IodSharedState *state)
+    : m_socket(socket), mp_state(state)
+{
+}
+
+IodConnection::~IodConnection()
+{
+    munmap((void *)mp_state, sizeof(IodSharedState));
+    close(m_socket);
+}
+
+std::error_code IodConnection::call(
+    IodCommand command,
+    IodRequest &request,
+    IodResponse &response
+)
+{
+    request.command = static_cast<uint32_t>(command);
+
+    // Requests from several threads would otherwise get each other's
+    // responses.
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (send(m_socket, &request, sizeof(request), MSG_NOSIGNAL) !=
+        (ssize_t)sizeof(request))
+        return std::error_code(errno, std::generic_category());
+
+    ssize_t size = recv(m_socket, &response, sizeof(response), 0);
+    if (size < 0) return std::error_code(errno, std::generic_category());
+    if (size != (ssize_t)sizeof(response))
+        return std::make_error_code(std::errc::connection_reset);
+
+    response.message[sizeof(response.message) - 1] = '\0';
+    return std::error_code();
+}
+#else
+std::string iodCanonicalPath(const char *fileName) { return fileName; }
+
+IodConnection *IodConnection::open(const std::string &) { return nullptr; }
+
+IodConnection::IodConnection(int socket, const IodSharedState *state)
+    : m_socket(socket), mp_state(state)
+{
+}
+
+IodConnection::~IodConnection() {}
+
+std::error_code IodConnection::call(IodCommand, IodRequest &, IodResponse &)
+{
+    return std::make_error_code(std::errc::function_not_supported);
+}
+#endif
@@ -0,0 +1,228 @@
+#ifndef IODPROTOCOL_H
+#define IODPROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <system_error>
+
+// Everything rsiod and its clients share: the layout of the shared memory
+// segment the daemon publishes the hardware state in, and the messages sent
+// over its Unix domain socket.
+//
+// The segment is written by the daemon only and mapped read-only by the
+// clients. The DIO and PoE state are each a seqlocked block with a single
+// writer, so a client read is a copy of the block and a retry in the rare
+// case it overlapped a write. The socket is for everything that changes the
+// hardware or isn't published; each request gets exactly one response.
+
+static const uint32_t kIodMagic = 0x52534944;  // "RSID"
+static const uint32_t kIodVersion = 2;
+
+static const int kIodMaxDios = 8;
+static const int kIodMaxPorts = 16;
+static const size_t kIodMaxName = 64;
+static const size_t kIodMaxMessage = 160;
+static const size_t kIodMaxPath = 1024;
+
+static_assert(
+    ATOMIC_INT_LOCK_FREE == 2,
+    "The seqlocks need lock-free atomics to work across processes"
+);
+
+// A block of data guarded by a seqlock. The sequence is odd while the
+// writer is updating the data.
+template <typename T>
+struct IodSeqBlock {
+    std::atomic<uint32_t> sequence;
+    T data;
+};
+
+// Only one thread may publish to a block at a time.
+template <typename T>
+void iodPublish(IodSeqBlock<T> &block, const T &data)
+{
+    uint32_t sequence = block.sequence.load(std::memory_order_relaxed);
+    block.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    block.data = data;
+    block.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+// Copies the data of block. Gives up and returns false if every attempt
+// overlapped a write, which only happens if the writer died halfway.
+template <typename T>
+bool iodRead(const IodSeqBlock<T> &block, T &data)
+{
+    for (int attempt = 0; attempt < 100000; ++attempt) {
+        uint32_t before = block.sequence.load(std::memory_order_acquire);
+        if (before & 1) continue;
+
+        data = block.data;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (block.sequence.load(std::memory_order_relaxed) == before)
+            return true;
+    }
+
+    return false;
+}
+
+// Fixed for the lifetime of the daemon and written before the socket
+// accepts clients, so it's read without the seqlock.
+struct IodLayout {
+    uint32_t hasDio;
+    uint32_t hasPoe;
+    // Bit n of inputs[dio] / outputs[dio] is set if pin n of dio supports
+    // input / output mode.
+    uint64_t inputs[kIodMaxDios];
+    uint64_t outputs[kIodMaxDios];
+    uint32_t outputModes;  // Bit n is set if dio n has an output mode.
+    uint32_t portCount;
+    int32_t ports[kIodMaxPorts];  // Sorted, like RsPoe::getPortList.
+    // Canonical paths of the configuration files being served, empty if the
+    // daemon wasn't started from a file.
+    char dioFile[kIodMaxPath];
+    char poeFile[kIodMaxPath];
+};
+
+struct IodDioData {
+    uint64_t timestamp;  // Time of the scan, 0 before the first one.
+    uint64_t states[kIodMaxDios];
+    uint64_t valid[kIodMaxDios];
+};
+
+struct IodPortData {
+    int32_t state;  // rs::PoeState
+    float voltage;
+    float current;
+    float power;
+    double energy;
+};
+
+// ports[n] belongs to layout.ports[n].
+struct IodPoeData {
+    uint64_t timestamp;  // Time of the sweep, 0 before the first one.
+    IodPortData ports[kIodMaxPorts];
+};
+
+struct IodSharedState {
+    uint32_t magic;
+    uint32_t version;
+    IodLayout layout;
+    IodSeqBlock<IodDioData> dio;
+    IodSeqBlock<IodPoeData> poe;
+};
+
+enum class IodCommand : uint32_t {
+    Hello = 1,
+
+    SetOutputMode,
+    GetOutputMode,
+    DigitalRead,
+    DigitalWrite,
+    SetPinDirection,
+    GetPinDirection,
+    ReadGroup,
+    WriteGroup,
+
+    SetPortState,
+    SetPortStates,
+    Resync,
+    ResetPortEnergy,
+    SetBudgetLimit,
+    SetPortPriority,
+    SetPortPowerLimit,
+    GetShedPorts,
+    GetBudgetConsumed,
+    GetBudgetAvailable,
+    GetBudgetTotal,
+};
+
+// Fields a command doesn't use are ignored.
+struct IodRequest {
+    uint32_t command;  // IodCommand
+    int32_t target;    // DIO or port
+    int32_t pin;
+    int32_t arg;  // Output mode, direction, state, priority or flag
+    uint64_t value;
+    float watts;
+    char name[kIodMaxName];  // Group name
+    // Entries for SetPortStates.
+    uint32_t count;
+    int32_t ports[kIodMaxPorts];
+    int32_t states[kIodMaxPorts];
+};
+
+struct IodResponse {
+    int32_t error;
+    uint32_t category;  // IodErrorCategory
+    int64_t value;      // Result of the command. Hello: kIodVersion.
+    // Hello: name of the shared memory segment. Otherwise the error string.
+    char message[kIodMaxMessage];
+};
+
+// Error categories are per process, so errors cross the socket as one of
+// these plus the value.
+enum class IodErrorCategory : uint32_t { None, Generic, System, Rs };
+
+void iodEncodeError(
+    std::error_code error,
+    const std::string &message,
+    IodResponse &response
+);
+std::error_code iodDecodeError(const IodResponse &response);
+
+// Copies str into a fixed size field, cutting it short if needed.
+void iodCopyString(char *field, size_t size, const std::string &str);
+
+// Path the daemon listens on by default: $RSIOD_SOCKET if it's set,
+// otherwise /run/rsiod.sock.
+std::string iodSocketPath();
+
+// Path createRsDio and createRsPoe connect to: $RSIOD_SOCKET, or empty if it
+// isn't set. Clients don't support everything the library does, so a
+// process only uses the daemon if it asks for it.
+std::string iodClientSocketPath();
+
+// Absolute path of fileName with the links resolved, or fileName itself if
+// it can't be resolved.
+std::string iodCanonicalPath(const char *fileName);
+
+// Checks that fileName is served, the configuration file path the daemon
+// published in its layout.
+std::error_code
+iodCheckXmlFile(const char *fileName, const char *served, std::string *what);
+
+// A client's connection to the daemon.
+class IodConnection {
+   public:
+    // Returns null if there's no daemon on socketPath or it doesn't speak
+    // this version of the protocol.
+    static IodConnection *open(const std::string &socketPath);
+    ~IodConnection();
+
+    IodConnection(const IodConnection &) = delete;
+    IodConnection &operator=(const IodConnection &) = delete;
+
+    const IodSharedState &state() const { return *mp_state; }
+
+    // Sends request and waits for the response. Returns an error if the
+    // daemon can't be reached, not the error of the command itself.
+    std::error_code call(
+        IodCommand command,
+        IodRequest &request,
+        IodResponse &response
+    );
+
+   private:
+    IodConnection(int socket, const IodSharedState *state);
+
+    std::mutex m_mutex;
+    int m_socket;
+    const IodSharedState *mp_state;
+};
+
+#endif  // IODPROTOCOL_H
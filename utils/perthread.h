@@ -0,0 +1,61 @@
+#ifndef PERTHREAD_H
+#define PERTHREAD_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <unordered_map>
+
+// A member that holds a separate value for every thread, such as the last
+// error of an object several threads call into. Each thread only ever sees
+// the values it set itself, so no locking is needed.
+//
+// Values live in thread_local storage keyed by an id that's never reused,
+// so a new object can't pick up the values of a destroyed one. A thread's
+// values, including those of objects destroyed since, are freed when the
+// thread exits.
+template <typename T>
+class PerThread {
+   public:
+    PerThread() : m_id(nextId()) {}
+    PerThread(const PerThread &) : m_id(nextId()) {}
+    PerThread &operator=(const PerThread &other)
+    {
+        get() = other.get();
+        return *this;
+    }
+
+    PerThread &operator=(const T &value)
+    {
+        get() = value;
+        return *this;
+    }
+
+    operator const T &() const { return get(); }
+
+    // The calling thread's value, default constructed on first use.
+    T &get() const
+    {
+        // Most threads keep using the same object, so remember the last
+        // lookup instead of hashing on every access.
+        thread_local uint64_t lastId = 0;
+        thread_local T *last = nullptr;
+        if (lastId == m_id) return *last;
+
+        thread_local std::unordered_map<uint64_t, T> values;
+        last = &values[m_id];
+        lastId = m_id;
+        return *last;
+    }
+
+   private:
+    static uint64_t nextId()
+    {
+        static std::atomic<uint64_t> id(0);
+        return ++id;
+    }
+
+    uint64_t m_id;
+};
+
+#endif  // PERTHREAD_H
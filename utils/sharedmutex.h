@@ -0,0 +1,83 @@
+#ifndef SHAREDMUTEX_H
+#define SHAREDMUTEX_H
+
+#include <condition_variable>
+#include <mutex>
+
+// Reader-writer lock, since std::shared_mutex needs C++17. Any number of
+// threads can hold it shared, or one thread exclusively. Waiting writers
+// keep new readers out so a steady stream of readers can't starve them.
+//
+// The internal mutex is only held while the counts change, never while the
+// lock itself is held, so readers only briefly contend with each other.
+class SharedMutex {
+   public:
+    SharedMutex() : m_readers(0), m_writersWaiting(0), m_writer(false) {}
+
+    void lock()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        ++m_writersWaiting;
+        m_writerCondition.wait(lock, [this]() {
+            return !m_writer && m_readers == 0;
+        });
+        --m_writersWaiting;
+        m_writer = true;
+    }
+
+    void unlock()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_writer = false;
+        }
+        m_writerCondition.notify_one();
+        m_readerCondition.notify_all();
+    }
+
+    void lock_shared()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_readerCondition.wait(lock, [this]() {
+            return !m_writer && m_writersWaiting == 0;
+        });
+        ++m_readers;
+    }
+
+    void unlock_shared()
+    {
+        bool last;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            last = --m_readers == 0;
+        }
+        if (last) m_writerCondition.notify_one();
+    }
+
+   private:
+    std::mutex m_mutex;
+    std::condition_variable m_readerCondition;
+    std::condition_variable m_writerCondition;
+    int m_readers;
+    int m_writersWaiting;
+    bool m_writer;
+};
+
+// Holds a SharedMutex shared for its lifetime. Use std::lock_guard for
+// exclusive access.
+class SharedLock {
+   public:
+    explicit SharedLock(SharedMutex &mutex) : m_mutex(mutex)
+    {
+        m_mutex.lock_shared();
+    }
+    ~SharedLock() { m_mutex.unlock_shared(); }
+
+    SharedLock(const SharedLock &) = delete;
+    SharedLock &operator=(const SharedLock &) = delete;
+
+   private:
+    SharedMutex &m_mutex;
+};
+
+#endif  // SHAREDMUTEX_H
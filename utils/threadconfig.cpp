@@ -0,0 +1,169 @@
+#include "threadconfig.h"
+
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+
+#ifdef __linux__
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+const int JitterHistogram::kSubBits;
+const int JitterHistogram::kSubBuckets;
+const int JitterHistogram::kBuckets;
+
+#ifdef __linux__
+std::error_code applyThreadConfig(
+    std::thread &thread,
+    const rs::ThreadConfig &config
+)
+{
+    int policy = SCHED_OTHER;
+    if (config.policy == rs::SchedPolicy::Fifo)
+        policy = SCHED_FIFO;
+    else if (config.policy == rs::SchedPolicy::RoundRobin)
+        policy = SCHED_RR;
+
+    sched_param param;
+    param.sched_priority = policy == SCHED_OTHER ? 0 : config.priority;
+    if (param.sched_priority < sched_get_priority_min(policy) ||
+        param.sched_priority > sched_get_priority_max(policy))
+        return std::make_error_code(std::errc::invalid_argument);
+
+    if (config.lockMemory && mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+        return std::error_code(errno, std::generic_category());
+
+    if (!thread.joinable()) return std::error_code();
+
+    pthread_t handle = thread.native_handle();
+    if (config.cpuMask) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (int cpu = 0; cpu < 64; ++cpu) {
+            if (config.cpuMask & (1ULL << cpu)) CPU_SET(cpu, &cpus);
+        }
+
+        int error = pthread_setaffinity_np(handle, sizeof(cpus), &cpus);
+        if (error) return std::error_code(error, std::generic_category());
+    }
+
+    int error = pthread_setschedparam(handle, policy, &param);
+    if (error) return std::error_code(error, std::generic_category());
+
+    return std::error_code();
+}
+#else
+std::error_code applyThreadConfig(std::thread &, const rs::ThreadConfig &config)
+{
+    if (config.cpuMask || config.policy != rs::SchedPolicy::Default ||
+        config.lockMemory)
+        return std::make_error_code(std::errc::function_not_supported);
+
+    return std::error_code();
+}
+#endif
+
+std::error_code testThreadConfig(const rs::ThreadConfig &config)
+{
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool done = false;
+
+    std::thread thread([&] {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [&] { return done; });
+    });
+
+    std::error_code error = applyThreadConfig(thread, config);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+    }
+    condition.notify_all();
+    thread.join();
+
+    return error;
+}
+
+JitterHistogram::JitterHistogram() { clear(0); }
+
+void JitterHistogram::clear(int64_t target)
+{
+    m_target = target;
+    m_count = 0;
+    m_total = 0;
+    m_min = std::numeric_limits<uint64_t>::max();
+    m_max = 0;
+    for (int i = 0; i < kBuckets; ++i) m_buckets[i] = 0;
+}
+
+// Only ever called from the thread being measured, so the read-modify-write
+// of min and max doesn't race with itself.
+void JitterHistogram::add(int64_t period)
+{
+    uint64_t value = period > 0 ? period : 0;
+    m_buckets[bucket(value)].fetch_add(1, std::memory_order_relaxed);
+    m_total.fetch_add(value, std::memory_order_relaxed);
+    if (value < m_min.load(std::memory_order_relaxed))
+        m_min.store(value, std::memory_order_relaxed);
+    if (value > m_max.load(std::memory_order_relaxed))
+        m_max.store(value, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_release);
+}
+
+rs::JitterReport JitterHistogram::report() const
+{
+    rs::JitterReport r;
+    uint64_t count = m_count.load(std::memory_order_acquire);
+    r.periods = count;
+    r.targetUs = (float)(m_target / 1000.0);
+    r.minUs = 0.0f;
+    r.avgUs = 0.0f;
+    r.p99Us = 0.0f;
+    r.maxUs = 0.0f;
+    if (count == 0) return r;
+
+    uint64_t max = m_max;
+    r.minUs = (float)(m_min / 1000.0);
+    r.avgUs = (float)(m_total / 1000.0 / count);
+    r.maxUs = (float)(max / 1000.0);
+
+    // The upper edge of the bucket that holds the 99th percentile, but never
+    // more than the longest period actually seen.
+    uint64_t rank = count - count / 100;
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+        seen += m_buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            uint64_t limit = bucketLimit(i);
+            r.p99Us = (float)((limit < max ? limit : max) / 1000.0);
+            break;
+        }
+    }
+
+    return r;
+}
+
+int JitterHistogram::bucket(uint64_t value)
+{
+    if (value < (uint64_t)kSubBuckets) return (int)value;
+
+    int exponent = 63;
+    while (!(value >> exponent)) --exponent;
+    int sub = (int)(value >> (exponent - kSubBits)) & (kSubBuckets - 1);
+    return (exponent - kSubBits + 1) * kSubBuckets + sub;
+}
+
+// Largest value that falls into bucket index.
+uint64_t JitterHistogram::bucketLimit(int index)
+{
+    if (index < kSubBuckets) return index;
+
+    int exponent = index / kSubBuckets + kSubBits - 1;
+    uint64_t sub = index % kSubBuckets;
+    uint64_t base = (uint64_t)(kSubBuckets + sub) << (exponent - kSubBits);
+    return base + (1ULL << (exponent - kSubBits)) - 1;
+}
@@ -0,0 +1,50 @@
+#ifndef THREADCONFIG_H
+#define THREADCONFIG_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <system_error>
+#include <thread>
+
+#include "../error/include/rsthread.h"
+
+// Applies config to a running thread. Locking memory applies to the whole
+// process. Threads that were already joined are skipped.
+std::error_code applyThreadConfig(
+    std::thread &thread,
+    const rs::ThreadConfig &config
+);
+
+// Applies config to a short lived thread, so a config that can't be applied
+// is caught even while no background thread is running.
+std::error_code testThreadConfig(const rs::ThreadConfig &config);
+
+// Histogram of the periods of a periodic thread. Buckets are log-linear:
+// every power of two is split into kSubBuckets, so percentiles are within
+// about 6% no matter the period. Written by one thread and read by any.
+class JitterHistogram {
+   public:
+    static const int kSubBits = 4;
+    static const int kSubBuckets = 1 << kSubBits;
+    static const int kBuckets = (64 - kSubBits + 1) * kSubBuckets;
+
+    JitterHistogram();
+
+    void clear(int64_t target);
+    void add(int64_t period);
+    rs::JitterReport report() const;
+
+   private:
+    static int bucket(uint64_t value);
+    static uint64_t bucketLimit(int index);
+
+    std::atomic<int64_t> m_target;
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_total;
+    std::atomic<uint64_t> m_min;
+    std::atomic<uint64_t> m_max;
+    std::atomic<uint32_t> m_buckets[kBuckets];
+};
+
+#endif  // THREADCONFIG_H